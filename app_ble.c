@@ -27,6 +27,9 @@
 /**************************************************************************
  * include
  **************************************************************************/
+#include <stddef.h>
+#include <string.h>
+
 #include "nrf_soc.h"
 
 #include "boards.h"
@@ -36,6 +39,8 @@
 
 #include "app_error.h"
 #include "app_timer.h"
+#include "app_util_platform.h"
+#include "app_scheduler.h"
 
 #include "ble_advdata.h"
 #include "ble_conn_params.h"
@@ -44,8 +49,25 @@
 #include "ble_advertising.h"
 
 #include "ble_ios.h"
-
-#include "app_trace.h"
+#include "ble_diag.h"
+#include "app_cfg.h"
+#include "app_latency.h"
+#include "app_prepare.h"
+#include "app_link.h"
+#include "app_bulk.h"
+#include "app_evtrec.h"
+#include "app_pool.h"
+#include "app_mem.h"
+#include "app_crash.h"
+#include "app_boot.h"
+#include "app_suspend.h"
+#include "app_ts.h"
+#include "app_cpu.h"
+#include "app_budget.h"
+#include "app_evtdisp.h"
+#include "app_pack.h"
+
+#include "app_log.h"
 
 
 /**************************************************************************
@@ -56,6 +78,12 @@
 /** Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 #define DEAD_BEEF                       (0xDEADBEEF)
 
+/** 各モジュールの構造体から、それを持つBLE状態を得る */
+#define APP_BLE_FROM(p, member)         ((app_ble_t *)((uint8_t *)(p) - offsetof(app_ble_t, member)))
+#define APP_BLE_FROM_IOS(p_ios)         APP_BLE_FROM(p_ios, ios)
+#define APP_BLE_FROM_LINK(p_link)       APP_BLE_FROM(p_link, link)
+#define APP_BLE_FROM_BULK(p_bulk)       APP_BLE_FROM(p_bulk, bulk)
+
 
 /**
  * Include or not the service_changed characteristic.
@@ -117,11 +145,15 @@
 /* 最大時間[msec単位] */
 #define CONN_MAX_INTERVAL               (1000)
 
-/* slave latency */
-#define CONN_SLAVE_LATENCY              (0)
+/*
+ * slave latency
+ *   アイドル中の消費電流を抑えるため大きめにしておく。
+ *   送受信時はapp_latencyがローカルで0にするので、応答が遅れることはない。
+ */
+#define CONN_SLAVE_LATENCY              (4)
 
 /* connSupervisionTimeout[msec単位] */
-#define CONN_SUP_TIMEOUT                (4000)
+#define CONN_SUP_TIMEOUT                (12000)
 
 /** sd_ble_gap_conn_param_update()を実行してから初回の接続イベントを通知するまでの時間[msec単位] */
 /*
@@ -174,154 +206,310 @@
 #define SEC_PARAM_MAX_KEY_SIZE          (16)
 
 
-//設定値のチェック
-#if (APP_ADV_INTERVAL < 20)
-#error connInterval(Advertising) too small.
-#elif (APP_ADV_INTERVAL < 100)
-#warning connInterval(Advertisin) is too small in non-connectable mode
-#elif (10240 < APP_ADV_INTERVAL)
-#error connInterval(Advertising) too large.
-#endif  //APP_ADV_INTERVAL
-
-#if (APP_ADV_TIMEOUT_IN_SECONDS == BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED)
-//OK
-#elif (BLE_GAP_ADV_TIMEOUT_LIMITED_MAX < APP_ADV_TIMEOUT_IN_SECONDS)
-#warning Advertising Timeout is too large in limited discoverable mode
-#endif  //APP_ADV_TIMEOUT_IN_SECONDS
-
-#if (CONN_MIN_INTERVAL * 10 < 75)
-#error connInterval_Min(Connection) too small.
-#elif (4000 < CONN_MIN_INTERVAL)
-#error connInterval_Min(Connection) too large.
-#endif  //CONN_MIN_INTERVAL
-
-#if (CONN_MAX_INTERVAL * 10 < 75)
-#error connInterval_Max(Connection) too small.
-#elif (4000 < CONN_MAX_INTERVAL)
-#error connInterval_Max(Connection) too large.
-#endif  //CONN_MAX_INTERVAL
-
-#if (CONN_MAX_INTERVAL < CONN_MIN_INTERVAL)
-#error connInterval_Max < connInterval_Min
-#endif  //connInterval Max < Min
-
-#if (BLE_GAP_CP_SLAVE_LATENCY_MAX < CONN_SLAVE_LATENCY)
-#error connSlaveLatency too large.
-#endif  //CONN_SLAVE_LATENCY
-
-#if (CONN_SUP_TIMEOUT < 100)
-#error connSupervisionTimeout too small.
-#elif (32000 < CONN_SUP_TIMEOUT)
-#error connSupervisionTimeout too large.
-#endif  //CONN_SUP_TIMEOUT
-#if (CONN_SUP_TIMEOUT <= (1 + CONN_SLAVE_LATENCY) * (CONN_MAX_INTERVAL * 2))
-#error connSupervisionTimeout too small in manner 1.
-#endif
-#if (CONN_SUP_TIMEOUT * 4 <= CONN_MAX_INTERVAL * (CONN_SLAVE_LATENCY + 1))
-#error connSupervisionTimeout too small in manner 2.
-#endif
+/*
+ * Log streaming
+ */
+/** ログ送信時に残しておく送信バッファ数(アプリのNotify用) */
+#define LOG_TX_RESERVE                  (2)
+
+/** ログ1回の送信サイズ[byte] */
+#define LOG_CHUNK_SIZE                  (GATT_RX_MTU - 3)
+
+
+/*
+ * Sample packing
+ */
+/** アプリのサンプル1つのbyte数(app_pack, main.cのサンプリングはint16_t) */
+#define PACK_SAMPLE_SIZE                (2)
+
+
+/*
+ * Bulk transfer
+ */
+/**
+ * 一括転送のデータ元番号(STARTコマンドのsource) : アプリのFlash(ベクタテーブル～.dataの初期値)
+ * InputキャラクタリスティックはOPENで、ペアリングしていないCentralでも吸い出せてしまうので、
+ * -DENABLE_BULK_APP_FLASHを付けたデバッグビルドでだけ登録する。
+ */
+#define BULK_SRC_APP_FLASH              (0)
+
+
+/*
+ * 上記の値は初期値で、実際にはapp_cfgに保存された値があればそちらを使う。
+ * 値の範囲チェックは、初期値も含めてparams_check()で実行時に行う。
+ */
 
 
 /**************************************************************************
  * declaration
  **************************************************************************/
 
-/** Handle of the current connection. */
-static uint16_t                         m_conn_handle = BLE_CONN_HANDLE_INVALID;
+/** 送信待ちNotify(app_poolのブロック) */
+typedef struct notify_blk_t {
+    struct notify_blk_t *p_next;
+    uint16_t            length;
+    uint8_t             data[];
+} notify_blk_t;
+
+/** 受信データ(app_poolのブロック) */
+typedef struct {
+    uint16_t            length;
+    uint8_t             data[];
+} input_blk_t;
+
+/** 受信データのスケジューライベント(SCHED_MAX_EVENT_DATA_SIZE以内) */
+typedef struct {
+    app_ble_t           *p_ble;
+    input_blk_t         *p_blk;
+} input_evt_t;
+
+/** 実行時に変更可能なBLEパラメータ */
+typedef struct {
+    uint16_t    adv_interval;       /**< Advertising間隔[msec] */
+    uint16_t    adv_timeout;        /**< Advertisingタイムアウト[sec] */
+    uint16_t    conn_min_interval;  /**< PPCP 最小間隔[msec] */
+    uint16_t    conn_max_interval;  /**< PPCP 最大間隔[msec] */
+    uint16_t    conn_slave_latency; /**< PPCP slave latency */
+    uint16_t    conn_sup_timeout;   /**< PPCP connSupervisionTimeout[msec] */
+    ble_gap_sec_params_t    sec;    /**< Security */
+} ble_params_t;
+
+#ifdef ENABLE_BULK_APP_FLASH
+/* gcc_startup_nrf51.s, gcc_nrf51_common.ld */
+extern uint32_t __isr_vector;
+extern uint32_t __etext;
+extern uint32_t __data_start__;
+extern uint32_t __data_end__;
+#endif  //ENABLE_BULK_APP_FLASH
 
 #ifdef BLE_DFU_APP_SUPPORT
-static ble_dfu_t                        m_dfus;     /**< Structure used to identify the DFU service. */
-#endif // BLE_DFU_APP_SUPPORT
-
-static ble_ios_t                        m_ios;
+/**
+ * DFUのreset_prepareコールバック用(コンテキストを渡せない)。
+ * DFUは実機(SoftDevice 1つ)だけなので、app_ble_init()で初期化したBLE状態を指す。
+ */
+static app_ble_t                        *m_p_dfu_ble;
+#endif  //BLE_DFU_APP_SUPPORT
 
 
 /**************************************************************************
  * prototype
  **************************************************************************/
 
-static void ble_stack_init(void);
+static void ble_stack_init(app_ble_t *p_ble);
+static void params_load(ble_params_t *p_params);
+static bool params_check(const ble_params_t *p_params);
+static void ppcp_set(const ble_params_t *p_params, ble_gap_conn_params_t *p_conn_params);
+static void device_name_set(void);
+static void advdata_set(const app_ble_t *p_ble);
+static void adv_start(app_ble_t *p_ble);
 
 #ifdef BLE_DFU_APP_SUPPORT
 static void dfu_reset_prepare(void)
 #endif
 
-static void conn_params_evt_handler(ble_conn_params_evt_t * p_evt);
 static void conn_params_error_handler(uint32_t nrf_error);
 
-static void ble_evt_handler(ble_evt_t * p_ble_evt);
-static void ble_evt_dispatch(ble_evt_t * p_ble_evt);
+static void ble_evt_handler(void *p_context, ble_evt_t *p_ble_evt);
+static void conn_params_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+static void latency_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+static void prepare_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+static void link_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+static void bulk_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+static void ios_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+static void diag_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+#ifdef BLE_DFU_APP_SUPPORT
+static void dfu_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt);
+#endif // BLE_DFU_APP_SUPPORT
 
 
 static void svc_ios_handler_in(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
 static void svc_ios_handler_out(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
+static void svc_ios_handler_cfg(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
+static void cfg_readback(app_ble_t *p_ble, uint8_t key);
+static void link_report_handler(app_link_t *p_link, const app_link_telemetry_t *p_telemetry);
+static uint32_t bulk_send(app_bulk_t *p_bulk, const uint8_t *p_data, uint16_t length);
+static void pack_send(void *p_context, const uint8_t *p_data, uint16_t length);
+static void tx_used(app_ble_t *p_ble, uint32_t err_code);
+static void diag_value_set(app_ble_t *p_ble, ble_diag_char_t chr, const uint8_t *p_value, uint16_t length);
+static void notify_enqueue(app_ble_t *p_ble, const uint8_t *p_data, uint16_t length);
+static void notify_drain(app_ble_t *p_ble);
+static void input_accept(app_ble_t *p_ble, const uint8_t *p_value, uint16_t length);
+static void input_exec(void *p_event_data, uint16_t event_size);
+static void pool_exhausted_handler(app_pool_t *p_pool, uint16_t size);
+static void log_stream(app_ble_t *p_ble);
+static void evtrec_stream(app_ble_t *p_ble);
+static void mem_report(app_ble_t *p_ble);
+static void crash_report(app_ble_t *p_ble);
+static void boot_report(app_ble_t *p_ble);
+static void cpu_report(app_ble_t *p_ble);
+
+
+/** app_ble_evt_dispatch()の振り分け表(上から順に呼ぶ) */
+static const app_evtdisp_entry_t        m_evt_handlers[] = {
+    APP_EVTDISP_ENTRY(ble_evt_handler, APP_BUDGET_BLE_APP,
+                        BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GAP_EVT_SEC_PARAMS_REQUEST, BLE_GAP_EVT_AUTH_STATUS,
+                        BLE_GAP_EVT_SEC_INFO_REQUEST, BLE_GAP_EVT_TIMEOUT,
+                        BLE_GATTS_EVT_SYS_ATTR_MISSING, BLE_EVT_TX_COMPLETE),
+    APP_EVTDISP_ENTRY(conn_params_on_ble_evt, APP_BUDGET_BLE_CONN_PARAMS,
+                        BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED,
+                        BLE_GAP_EVT_CONN_PARAM_UPDATE, BLE_GATTS_EVT_WRITE),
+    APP_EVTDISP_ENTRY(latency_on_ble_evt, APP_BUDGET_BLE_LATENCY, APP_LATENCY_BLE_EVTS),
+    APP_EVTDISP_ENTRY(prepare_on_ble_evt, APP_BUDGET_BLE_PREPARE, APP_PREPARE_BLE_EVTS),
+    APP_EVTDISP_ENTRY(link_on_ble_evt, APP_BUDGET_BLE_LINK, APP_LINK_BLE_EVTS),
+    APP_EVTDISP_ENTRY(bulk_on_ble_evt, APP_BUDGET_BLE_BULK, APP_BULK_BLE_EVTS),
+    APP_EVTDISP_ENTRY(ios_on_ble_evt, APP_BUDGET_BLE_IOS, BLE_IOS_BLE_EVTS),
+    APP_EVTDISP_ENTRY(diag_on_ble_evt, APP_BUDGET_BLE_DIAG, BLE_DIAG_BLE_EVTS),
+#ifdef BLE_DFU_APP_SUPPORT
+    APP_EVTDISP_ENTRY_ALL(dfu_on_ble_evt, APP_BUDGET_BLE_DFU),
+#endif // BLE_DFU_APP_SUPPORT
+};
 
 
 /**************************************************************************
  * public function
  **************************************************************************/
 
-void app_ble_init(void)
+/**
+ * @brief BLE初期化
+ *
+ * @param[out]  p_ble   BLE状態
+ */
+void app_ble_init(app_ble_t *p_ble)
 {
-	ble_stack_init();
+    memset(p_ble, 0, sizeof(app_ble_t));
+    p_ble->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_ble->mem_report = true;
+    p_ble->sec_key.keys_periph.p_enc_key = &p_ble->bond.enc_key;
+    p_ble->sec_key.keys_periph.p_id_key = &p_ble->bond.id_key;
+    p_ble->sec_key.keys_periph.p_sign_key = &p_ble->bond.sign_key;
+#ifdef BLE_DFU_APP_SUPPORT
+    m_p_dfu_ble = p_ble;
+#endif  //BLE_DFU_APP_SUPPORT
+
+    app_pool_init(&p_ble->pool, pool_exhausted_handler);
+    app_suspend_attach(APP_SUSPEND_ID_BOND, &p_ble->bond, sizeof(p_ble->bond), NULL);
+    ble_stack_init(p_ble);
+    app_latency_init(&p_ble->latency);
 }
 
 
 /**
- * @brief Advertising開始
+ * @brief BLE初期化(後回し分)
+ *
+ * @details Advertising開始後に呼ぶ。接続前に済めばよいものをここで初期化する。
+ *
+ * @param[in,out]   p_ble   BLE状態
  */
-void app_ble_start(void)
+void app_ble_init_late(app_ble_t *p_ble)
 {
-    uint32_t             err_code;
-    ble_gap_adv_params_t adv_params;
+    uint32_t err_code;
 
-    // Start advertising
-    memset(&adv_params, 0, sizeof(adv_params));
+    //Diagnostics Service(I/Oサービスの後に追加するので、Handleは変わらない)
+    ble_diag_init(&p_ble->diag);
 
-    adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
-    adv_params.p_peer_addr = NULL;
-    adv_params.fp          = BLE_GAP_ADV_FP_ANY;
-    adv_params.interval    = MSEC_TO_UNITS(APP_ADV_INTERVAL, UNIT_0_625_MS);
-    adv_params.timeout     = APP_ADV_TIMEOUT_IN_SECONDS;
-#ifdef APP_ADV_DISABLE_CH37
-	adv_params.channel_mask.ch_37_off = 1;
-#endif	//APP_ADV_DISABLE_CH37
-#ifdef APP_ADV_DISABLE_CH38
-	adv_params.channel_mask.ch_38_off = 1;
-#endif	//APP_ADV_DISABLE_CH38
-#ifdef APP_ADV_DISABLE_CH39
-	adv_params.channel_mask.ch_39_off = 1;
-#endif	//APP_ADV_DISABLE_CH39
+    app_link_init(&p_ble->link, link_report_handler);
+    app_bulk_init(&p_ble->bulk, bulk_send, &p_ble->latency);
+#ifdef ENABLE_BULK_APP_FLASH
+    //.dataの初期値は__etextの後ろに置かれるので、そこまで含める
+    err_code = app_bulk_mem_source_set(&p_ble->bulk, BULK_SRC_APP_FLASH, (const uint8_t *)&__isr_vector,
+                    ((uint32_t)&__etext - (uint32_t)&__isr_vector) +
+                    ((uint32_t)&__data_end__ - (uint32_t)&__data_start__));
+    APP_ERROR_CHECK(err_code);
+#endif  //ENABLE_BULK_APP_FLASH
 
-    err_code = sd_ble_gap_adv_start(&adv_params);
+    //Outputキャラクタリスティックのサンプルはapp_pack経由(main.cのsample_block_handler())
+    app_pack_init(&p_ble->pack, PACK_SAMPLE_SIZE, pack_send, p_ble);
+
+    //Connectionイベント数とsample-to-air遅延の計測用(データ準備ハンドラは無し)
+    err_code = app_prepare_start(NRF_RADIO_NOTIFICATION_DISTANCE_800US, NULL);
     APP_ERROR_CHECK(err_code);
-    led_on(LED_PIN_NO_ADVERTISING);
+}
 
-    app_trace_log("advertising start\r\n");
+
+/**
+ * @brief Advertising開始
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+void app_ble_start(app_ble_t *p_ble)
+{
+    adv_start(p_ble);
 }
 
 
 #ifdef BLE_DFU_APP_SUPPORT
-void app_ble_stop(void)
+void app_ble_stop(app_ble_t *p_ble)
 {
     uint32_t err_code;
 
     err_code = sd_ble_gap_adv_stop();
     APP_ERROR_CHECK(err_code);
+    p_ble->advertising = false;
     led_off(LED_PIN_NO_ADVERTISING);
 
-    app_trace_log("advertising stop\r\n");
+    APP_LOG("advertising stop");
 }
 #endif // BLE_DFU_APP_SUPPORT
 
-int app_ble_is_connected(void)
+int app_ble_is_connected(const app_ble_t *p_ble)
 {
-	return m_conn_handle != BLE_CONN_HANDLE_INVALID;
+	return p_ble->conn_handle != BLE_CONN_HANDLE_INVALID;
+}
+
+void app_ble_nofify(app_ble_t *p_ble, const uint8_t *p_data, uint16_t length)
+{
+    uint32_t err_code;
+
+    //Centralからの応答を待たせないよう、毎イベント受信にしておく
+    app_latency_wake(&p_ble->latency);
+    app_prepare_sample_mark();
+
+    //順番を守るため、送信待ちがあれば後ろにつなぐ
+    //一括転送中はOutputキャラクタリスティックを転送が使うので、終わるまで待たせる
+    if ((p_ble->notify_head != NULL) || app_bulk_is_active(&p_ble->bulk)) {
+        notify_enqueue(p_ble, p_data, length);
+        return;
+    }
+
+    err_code = ble_ios_on_output(&p_ble->ios, p_data, length);
+    app_link_on_notify(&p_ble->link, err_code);
+    tx_used(p_ble, err_code);
+    if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+        //送信バッファが空いたらapp_ble_idle()で送る
+        notify_enqueue(p_ble, p_data, length);
+    }
+    else if (err_code != NRF_SUCCESS) {
+        APP_LOG("app_ble_nofify: err=%d", err_code);
+    }
 }
 
-void app_ble_nofify(const uint8_t *p_data, uint16_t length)
+
+/**
+ * @brief アイドル処理
+ *
+ * @details メインループで、スケジューラのイベントが無くなってから呼ぶ。
+ *          送信待ちのNotifyを送り、さらに送信バッファに余裕があれば、ログをNotifyで流す。
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+void app_ble_idle(app_ble_t *p_ble)
 {
-	//ble_ios_notify(&m_ios, p_data, length);
+    notify_drain(p_ble);
+    if (!p_ble->boot_reported) {
+        p_ble->boot_reported = true;
+        crash_report(p_ble);
+        boot_report(p_ble);
+    }
+    if (app_mem_poll() || p_ble->mem_report) {
+        p_ble->mem_report = false;
+        mem_report(p_ble);
+    }
+    if (app_cpu_poll()) {
+        cpu_report(p_ble);
+    }
+    evtrec_stream(p_ble);
+    log_stream(p_ble);
 }
 
 
@@ -330,21 +518,37 @@ void app_ble_nofify(const uint8_t *p_data, uint16_t length)
  *
  * @details BLEスタックイベント受信後、メインループのスケジューラから呼ばれる。
  *
- * @param[in]   p_ble_evt   BLEスタックイベント
+ * @param[in,out]   p_ble       BLE状態
+ * @param[in]       p_ble_evt   BLEスタックイベント
  */
-void app_ble_evt_dispatch(ble_evt_t *p_ble_evt)
+void app_ble_evt_dispatch(app_ble_t *p_ble, ble_evt_t *p_ble_evt)
 {
-    ble_evt_handler(p_ble_evt);
-    ble_conn_params_on_ble_evt(p_ble_evt);
+    uint32_t start = app_ts_now();
+    bool evtrec;
 
-    //I/O Service
-    ble_ios_on_ble_evt(&m_ios, p_ble_evt);
+    //扱うイベントIDが一致するハンドラだけを、表の順に呼ぶ
+    app_evtdisp_run(m_evt_handlers, ARRAY_SIZE(m_evt_handlers), p_ble, p_ble_evt);
 
-#ifdef BLE_DFU_APP_SUPPORT
-    /** @snippet [Propagating BLE Stack events to DFU Service] */
-    ble_dfu_on_ble_evt(&m_dfus, p_ble_evt);
-    /** @snippet [Propagating BLE Stack events to DFU Service] */
-#endif // BLE_DFU_APP_SUPPORT
+    //Diagnostics Service
+    if (!ble_diag_is_notify_enabled(&p_ble->diag, BLE_DIAG_CHAR_LOG)) {
+        app_log_reader_enable(APP_LOG_READER_BLE, false);
+    }
+    evtrec = ble_diag_is_notify_enabled(&p_ble->diag, BLE_DIAG_CHAR_EVTREC);
+    if (!evtrec) {
+        app_evtrec_freeze(&p_ble->evtrec, APP_EVTREC_READER_BLE, false);
+    }
+    if (evtrec != p_ble->ts_requested) {
+        p_ble->ts_requested = evtrec;
+        if (evtrec) {
+            app_ts_request();
+        }
+        else {
+            app_ts_release();
+        }
+    }
+
+    app_evtrec_put(&p_ble->evtrec, p_ble_evt, start);
+    app_cpu_irq_add(app_ts_now() - start);
 }
 
 
@@ -371,8 +575,10 @@ void app_ble_evt_dispatch(ble_evt_t *p_ble_evt)
  *      -# Service初期化
  *      -# Advertising初期化
  *      -# Connection初期化
+ *
+ * @param[in,out]   p_ble   BLE状態
  */
-static void ble_stack_init(void)
+static void ble_stack_init(app_ble_t *p_ble)
 {
     uint32_t err_code;
 
@@ -385,18 +591,10 @@ static void ble_stack_init(void)
         err_code = sd_ble_enable(&ble_enable_params);
         APP_ERROR_CHECK(err_code);
     }
+    app_boot_mark(APP_BOOT_BLE_ENABLE);
 
     /* デバイス名設定 */
-    {
-        //デバイス名へのWrite Permission(no protection, open link)
-        ble_gap_conn_sec_mode_t sec_mode;
-
-        BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
-        err_code = sd_ble_gap_device_name_set(&sec_mode,
-                                            (const uint8_t *)GAP_DEVICE_NAME,
-                                            strlen(GAP_DEVICE_NAME));
-        APP_ERROR_CHECK(err_code);
-    }
+    device_name_set();
 
 #ifdef GAP_USE_APPEARANCE
     /* Appearance設定 */
@@ -409,16 +607,13 @@ static void ble_stack_init(void)
      * ここで設定しておくと、Connection Parameter Update Reqを送信せずに済むらしい。
      */
     {
-        ble_gap_conn_params_t   gap_conn_params = {0};
-
-        gap_conn_params.min_conn_interval = MSEC_TO_UNITS(CONN_MIN_INTERVAL, UNIT_1_25_MS);
-        gap_conn_params.max_conn_interval = MSEC_TO_UNITS(CONN_MAX_INTERVAL, UNIT_1_25_MS);
-        gap_conn_params.slave_latency     = CONN_SLAVE_LATENCY;
-        gap_conn_params.conn_sup_timeout  = MSEC_TO_UNITS(CONN_SUP_TIMEOUT, UNIT_10_MS);
+        ble_params_t            params;
+        ble_gap_conn_params_t   gap_conn_params;
 
-        err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
-        APP_ERROR_CHECK(err_code);
+        params_load(&params);
+        ppcp_set(&params, &gap_conn_params);
     }
+    app_boot_mark(APP_BOOT_BLE_GAP);
 
     /*
      * Service初期化
@@ -428,60 +623,21 @@ static void ble_stack_init(void)
 
         ios_init.evt_handler_in = svc_ios_handler_in;
         //ios_init.evt_handler_out = svc_ios_handler_out;
-        ios_init.len_in = 64;
-        ios_init.len_out = 32;
-        ble_ios_init(&m_ios, &ios_init);
+        ios_init.evt_handler_cfg = svc_ios_handler_cfg;
+        ios_init.max_len[BLE_IOS_CHAR_INPUT] = 64;
+        ios_init.max_len[BLE_IOS_CHAR_OUTPUT] = 32;
+        ios_init.max_len[BLE_IOS_CHAR_CONFIG] = 1 + APP_CFG_VALUE_MAX;
+        ble_ios_init(&p_ble->ios, &ios_init);
+
+        //Diagnostics Serviceはapp_ble_init_late()で追加する
     }
+    app_boot_mark(APP_BOOT_BLE_SERVICES);
 
     /*
      * Advertising初期化
      */
-    {
-        ble_uuid_t adv_uuids[] = { { IOS_UUID_SERVICE, m_ios.uuid_type } };
-        ble_advdata_t advdata;
-        ble_advdata_t scanrsp;
-
-        memset(&advdata, 0, sizeof(advdata));
-        memset(&scanrsp, 0, sizeof(scanrsp));
-
-        /*
-         * ble_advdata_name_type_t (ble_advdata.h)
-         *
-         * BLE_ADVDATA_NO_NAME    : デバイス名無し
-         * BLE_ADVDATA_SHORT_NAME : デバイス名あり «Shortened Local Name»
-         * BLE_ADVDATA_FULL_NAME  : デバイス名あり «Complete Local Name»
-         *
-         * https://www.bluetooth.org/en-us/specification/assigned-numbers/generic-access-profile
-         * https://developer.nordicsemi.com/nRF51_SDK/nRF51_SDK_v7.x.x/doc/7.2.0/s110/html/a01015.html#ga03c5ccf232779001be9786021b1a563b
-         */
-        advdata.name_type = BLE_ADVDATA_FULL_NAME;
-
-        /*
-         * Appearanceが含まれるかどうか
-         */
-#ifdef GAP_USE_APPEARANCE
-        advdata.include_appearance = true;
-#else   //GAP_USE_APPEARANCE
-        advdata.include_appearance = false;
-#endif  //GAP_USE_APPEARANCE
-        /*
-         * Advertisingフラグの設定
-         * CSS_v4 : Part A  1.3 FLAGS
-         * https://developer.nordicsemi.com/nRF51_SDK/nRF51_SDK_v7.x.x/doc/7.2.0/s110/html/a00802.html
-         *
-         * BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE = BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE | BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED
-         *      BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE : LE Limited Discoverable Mode
-         *      BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED : BR/EDR not supported
-         */
-        advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;    //探索時間に制限あり
-
-        /* SCAN_RSPデータ設定 */
-        scanrsp.uuids_complete.uuid_cnt = ARRAY_SIZE(adv_uuids);
-        scanrsp.uuids_complete.p_uuids  = adv_uuids;
-
-        err_code = ble_advdata_set(&advdata, &scanrsp);
-        APP_ERROR_CHECK(err_code);
-    }
+    advdata_set(p_ble);
+    app_boot_mark(APP_BOOT_BLE_ADVDATA);
 
     /*
      * Connection初期化
@@ -495,8 +651,8 @@ static void ble_stack_init(void)
         cp_init.next_conn_params_update_delay  = APP_TIMER_TICKS(CONN_NEXT_PARAMS_UPDATE_DELAY, 0);
         cp_init.max_conn_params_update_count   = CONN_MAX_PARAMS_UPDATE_COUNT;
         cp_init.start_on_notify_cccd_handle    = BLE_GATT_HANDLE_INVALID;
-        cp_init.disconnect_on_fail             = false;
-        cp_init.evt_handler                    = conn_params_evt_handler;
+        cp_init.disconnect_on_fail             = true;     //失敗時の切断はble_conn_paramsに任せる
+        cp_init.evt_handler                    = NULL;
         cp_init.error_handler                  = conn_params_error_handler;
 
         err_code = ble_conn_params_init(&cp_init);
@@ -516,7 +672,7 @@ static void ble_stack_init(void)
         dfus_init.evt_handler    = dfu_app_on_dfu_evt;
         dfus_init.revision       = DFU_REVISION;
 
-        err_code = ble_dfu_init(&m_dfus, &dfus_init);
+        err_code = ble_dfu_init(&p_ble->dfus, &dfus_init);
         APP_ERROR_CHECK(err_code);
 
         dfu_app_reset_prepare_set(dfu_reset_prepare);
@@ -526,15 +682,252 @@ static void ble_stack_init(void)
 }
 
 
+/**
+ * @brief Advertising開始
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void adv_start(app_ble_t *p_ble)
+{
+    uint32_t             err_code;
+    ble_gap_adv_params_t adv_params;
+    ble_params_t         params;
+
+    params_load(&params);
+
+    // Start advertising
+    memset(&adv_params, 0, sizeof(adv_params));
+
+    adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
+    adv_params.p_peer_addr = NULL;
+    adv_params.fp          = BLE_GAP_ADV_FP_ANY;
+    adv_params.interval    = MSEC_TO_UNITS(params.adv_interval, UNIT_0_625_MS);
+    adv_params.timeout     = params.adv_timeout;
+#ifdef APP_ADV_DISABLE_CH37
+	adv_params.channel_mask.ch_37_off = 1;
+#endif	//APP_ADV_DISABLE_CH37
+#ifdef APP_ADV_DISABLE_CH38
+	adv_params.channel_mask.ch_38_off = 1;
+#endif	//APP_ADV_DISABLE_CH38
+#ifdef APP_ADV_DISABLE_CH39
+	adv_params.channel_mask.ch_39_off = 1;
+#endif	//APP_ADV_DISABLE_CH39
+
+    err_code = sd_ble_gap_adv_start(&adv_params);
+    APP_ERROR_CHECK(err_code);
+    p_ble->advertising = true;
+    led_on(LED_PIN_NO_ADVERTISING);
+
+    app_boot_mark(APP_BOOT_ADV_START);
+
+    APP_LOG("advertising start");
+}
+
+
+/**********************************************
+ * BLE : Parameters
+ **********************************************/
+
+/**
+ * @brief BLEパラメータ読込み
+ *
+ * app_cfgに保存されている値を使い、無ければ初期値(マクロ)を使う。
+ * 保存値の組み合わせが不正な場合は、全部初期値に戻す。
+ *
+ * @param[out]  p_params    BLEパラメータ
+ */
+static void params_load(ble_params_t *p_params)
+{
+    p_params->adv_interval       = app_cfg_get_u16(APP_CFG_KEY_ADV_INTERVAL, APP_ADV_INTERVAL);
+    p_params->adv_timeout        = app_cfg_get_u16(APP_CFG_KEY_ADV_TIMEOUT, APP_ADV_TIMEOUT_IN_SECONDS);
+    p_params->conn_min_interval  = app_cfg_get_u16(APP_CFG_KEY_CONN_MIN_INTERVAL, CONN_MIN_INTERVAL);
+    p_params->conn_max_interval  = app_cfg_get_u16(APP_CFG_KEY_CONN_MAX_INTERVAL, CONN_MAX_INTERVAL);
+    p_params->conn_slave_latency = app_cfg_get_u16(APP_CFG_KEY_CONN_SLAVE_LATENCY, CONN_SLAVE_LATENCY);
+    p_params->conn_sup_timeout   = app_cfg_get_u16(APP_CFG_KEY_CONN_SUP_TIMEOUT, CONN_SUP_TIMEOUT);
+    p_params->sec.bond           = app_cfg_get_u8(APP_CFG_KEY_SEC_BOND, SEC_PARAM_BOND);
+    p_params->sec.mitm           = app_cfg_get_u8(APP_CFG_KEY_SEC_MITM, SEC_PARAM_MITM);
+    p_params->sec.io_caps        = app_cfg_get_u8(APP_CFG_KEY_SEC_IO_CAPS, SEC_PARAM_IO_CAPABILITIES);
+    p_params->sec.oob            = app_cfg_get_u8(APP_CFG_KEY_SEC_OOB, SEC_PARAM_OOB);
+    p_params->sec.min_key_size   = app_cfg_get_u8(APP_CFG_KEY_SEC_MIN_KEY_SIZE, SEC_PARAM_MIN_KEY_SIZE);
+    p_params->sec.max_key_size   = app_cfg_get_u8(APP_CFG_KEY_SEC_MAX_KEY_SIZE, SEC_PARAM_MAX_KEY_SIZE);
+
+    if (!params_check(p_params)) {
+        APP_LOG("params_load: invalid config, use default");
+        p_params->adv_interval       = APP_ADV_INTERVAL;
+        p_params->adv_timeout        = APP_ADV_TIMEOUT_IN_SECONDS;
+        p_params->conn_min_interval  = CONN_MIN_INTERVAL;
+        p_params->conn_max_interval  = CONN_MAX_INTERVAL;
+        p_params->conn_slave_latency = CONN_SLAVE_LATENCY;
+        p_params->conn_sup_timeout   = CONN_SUP_TIMEOUT;
+        p_params->sec.bond           = SEC_PARAM_BOND;
+        p_params->sec.mitm           = SEC_PARAM_MITM;
+        p_params->sec.io_caps        = SEC_PARAM_IO_CAPABILITIES;
+        p_params->sec.oob            = SEC_PARAM_OOB;
+        p_params->sec.min_key_size   = SEC_PARAM_MIN_KEY_SIZE;
+        p_params->sec.max_key_size   = SEC_PARAM_MAX_KEY_SIZE;
+    }
+}
+
+
+/**
+ * @brief BLEパラメータの範囲チェック
+ *
+ * 以前は#errorでコンパイル時にチェックしていた内容。
+ *
+ * @param[in]   p_params    BLEパラメータ
+ * @retval      true        OK
+ */
+static bool params_check(const ble_params_t *p_params)
+{
+    //Advertising
+    if ((p_params->adv_interval < 20) || (10240 < p_params->adv_interval)) {
+        return false;
+    }
+    if ((p_params->adv_timeout == 0) || (BLE_GAP_ADV_TIMEOUT_LIMITED_MAX < p_params->adv_timeout)) {
+        //Limited Discoverable Modeで使うので(0は無制限になってしまう)
+        return false;
+    }
+
+    //Connection
+    if ((p_params->conn_min_interval * 10 < 75) || (4000 < p_params->conn_min_interval)) {
+        return false;
+    }
+    if ((p_params->conn_max_interval * 10 < 75) || (4000 < p_params->conn_max_interval)) {
+        return false;
+    }
+    if (p_params->conn_max_interval < p_params->conn_min_interval) {
+        return false;
+    }
+    if (BLE_GAP_CP_SLAVE_LATENCY_MAX < p_params->conn_slave_latency) {
+        return false;
+    }
+    if ((p_params->conn_sup_timeout < 100) || (32000 < p_params->conn_sup_timeout)) {
+        return false;
+    }
+    if ((uint32_t)p_params->conn_sup_timeout <=
+      (1 + (uint32_t)p_params->conn_slave_latency) * (p_params->conn_max_interval * 2)) {
+        return false;
+    }
+
+    //Security
+    if ((p_params->sec.io_caps > BLE_GAP_IO_CAPS_KEYBOARD_DISPLAY) ||
+      (p_params->sec.min_key_size < 7) || (16 < p_params->sec.max_key_size) ||
+      (p_params->sec.max_key_size < p_params->sec.min_key_size)) {
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief PPCP設定
+ *
+ * @param[in]   p_params        BLEパラメータ
+ * @param[out]  p_conn_params   設定したPPCP
+ */
+static void ppcp_set(const ble_params_t *p_params, ble_gap_conn_params_t *p_conn_params)
+{
+    uint32_t err_code;
+
+    p_conn_params->min_conn_interval = MSEC_TO_UNITS(p_params->conn_min_interval, UNIT_1_25_MS);
+    p_conn_params->max_conn_interval = MSEC_TO_UNITS(p_params->conn_max_interval, UNIT_1_25_MS);
+    p_conn_params->slave_latency     = p_params->conn_slave_latency;
+    p_conn_params->conn_sup_timeout  = MSEC_TO_UNITS(p_params->conn_sup_timeout, UNIT_10_MS);
+
+    err_code = sd_ble_gap_ppcp_set(p_conn_params);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**
+ * @brief デバイス名設定
+ */
+static void device_name_set(void)
+{
+    uint32_t                err_code;
+    ble_gap_conn_sec_mode_t sec_mode;
+    const uint8_t           *p_name;
+    uint16_t                len;
+
+    p_name = app_cfg_get(APP_CFG_KEY_DEVICE_NAME, &len);
+    if (p_name == NULL) {
+        p_name = (const uint8_t *)GAP_DEVICE_NAME;
+        len = strlen(GAP_DEVICE_NAME);
+    }
+
+    //デバイス名へのWrite Permission(no protection, open link)
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&sec_mode);
+    err_code = sd_ble_gap_device_name_set(&sec_mode, p_name, len);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**
+ * @brief Advertisingデータ設定
+ *
+ * @param[in]   p_ble   BLE状態
+ */
+static void advdata_set(const app_ble_t *p_ble)
+{
+    ble_uuid_t adv_uuids[] = { { IOS_UUID_SERVICE, p_ble->ios.uuid_type } };
+    ble_advdata_t advdata;
+    ble_advdata_t scanrsp;
+    uint32_t      err_code;
+
+    memset(&advdata, 0, sizeof(advdata));
+    memset(&scanrsp, 0, sizeof(scanrsp));
+
+    /*
+     * ble_advdata_name_type_t (ble_advdata.h)
+     *
+     * BLE_ADVDATA_NO_NAME    : デバイス名無し
+     * BLE_ADVDATA_SHORT_NAME : デバイス名あり «Shortened Local Name»
+     * BLE_ADVDATA_FULL_NAME  : デバイス名あり «Complete Local Name»
+     *
+     * https://www.bluetooth.org/en-us/specification/assigned-numbers/generic-access-profile
+     * https://developer.nordicsemi.com/nRF51_SDK/nRF51_SDK_v7.x.x/doc/7.2.0/s110/html/a01015.html#ga03c5ccf232779001be9786021b1a563b
+     */
+    advdata.name_type = BLE_ADVDATA_FULL_NAME;
+
+    /*
+     * Appearanceが含まれるかどうか
+     */
+#ifdef GAP_USE_APPEARANCE
+    advdata.include_appearance = true;
+#else   //GAP_USE_APPEARANCE
+    advdata.include_appearance = false;
+#endif  //GAP_USE_APPEARANCE
+    /*
+     * Advertisingフラグの設定
+     * CSS_v4 : Part A  1.3 FLAGS
+     * https://developer.nordicsemi.com/nRF51_SDK/nRF51_SDK_v7.x.x/doc/7.2.0/s110/html/a00802.html
+     *
+     * BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE = BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE | BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED
+     *      BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE : LE Limited Discoverable Mode
+     *      BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED : BR/EDR not supported
+     */
+    advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;    //探索時間に制限あり
+
+    /* SCAN_RSPデータ設定 */
+    scanrsp.uuids_complete.uuid_cnt = ARRAY_SIZE(adv_uuids);
+    scanrsp.uuids_complete.p_uuids  = adv_uuids;
+
+    err_code = ble_advdata_set(&advdata, &scanrsp);
+    APP_ERROR_CHECK(err_code);
+}
+
+
 /** @snippet [DFU BLE Reset prepare] */
 #ifdef BLE_DFU_APP_SUPPORT
 static void dfu_reset_prepare(void)
 {
+    app_ble_t *p_ble = m_p_dfu_ble;
     uint32_t err_code;
 
-    if (m_conn_handle != BLE_CONN_HANDLE_INVALID) {
+    if (p_ble->conn_handle != BLE_CONN_HANDLE_INVALID) {
         // Disconnect from peer.
-        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+        err_code = sd_ble_gap_disconnect(p_ble->conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
         APP_ERROR_CHECK(err_code);
         err_code = bsp_indication_set(BSP_INDICATE_IDLE);
         APP_ERROR_CHECK(err_code);
@@ -555,27 +948,6 @@ static void dfu_reset_prepare(void)
  * BLE : Connection
  **********************************************/
 
-/**
- * @brief Connectionパラメータモジュールイベントハンドラ
- *
- * @details Connectionパラメータモジュールでアプリに通知するイベントが発生した場合に呼ばれる。
- *          @note All this function does is to disconnect. This could have been done by simply
- *                setting the disconnect_on_fail config parameter, but instead we use the event
- *                handler mechanism to demonstrate its use.
- *
- * @param[in]   p_evt   Connectionパラメータモジュールから受信したイベント
- */
-static void conn_params_evt_handler(ble_conn_params_evt_t *p_evt)
-{
-    uint32_t err_code;
-
-    if(p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED) {
-        err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
-        APP_ERROR_CHECK(err_code);
-    }
-}
-
-
 /**
  * @brief Connectionパラメータエラーハンドラ
  *
@@ -594,23 +966,19 @@ static void conn_params_error_handler(uint32_t nrf_error)
 /**
  * @brief BLEスタックイベントハンドラ
  *
+ * @param[in]   p_context   BLE状態
  * @param[in]   p_ble_evt   BLEスタックイベント
  */
-static void ble_evt_handler(ble_evt_t *p_ble_evt)
+static void ble_evt_handler(void *p_context, ble_evt_t *p_ble_evt)
 {
+    app_ble_t                        *p_ble = (app_ble_t *)p_context;
     uint32_t                         err_code;
-    static ble_gap_evt_auth_status_t m_auth_status;
 	bool                             master_id_matches;
 	ble_gap_sec_kdist_t *            p_distributed_keys;
     ble_gap_enc_info_t               *p_enc_info;
 	ble_gap_irk_t *                  p_id_info;
 	ble_gap_sign_info_t *            p_sign_info;
 
-    static ble_gap_enc_key_t         m_enc_key;           /**< Encryption Key (Encryption Info and Master ID). */
-    static ble_gap_id_key_t          m_id_key;            /**< Identity Key (IRK and address). */
-    static ble_gap_sign_info_t       m_sign_key;          /**< Signing Key (Connection Signature Resolving Key). */
-    static ble_gap_sec_keyset_t      sec_key = {.keys_periph = {&m_enc_key, &m_id_key, &m_sign_key}};
-
 
     switch (p_ble_evt->header.evt_id) {
     /*************
@@ -619,39 +987,45 @@ static void ble_evt_handler(ble_evt_t *p_ble_evt)
 
     //接続が成立したとき
     case BLE_GAP_EVT_CONNECTED:
-        app_trace_log("BLE_GAP_EVT_CONNECTED\r\n");
+        APP_LOG("BLE_GAP_EVT_CONNECTED");
         led_on(LED_PIN_NO_CONNECTED);
         led_off(LED_PIN_NO_ADVERTISING);
-        m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        p_ble->advertising = false;
+        p_ble->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        {
+            uint8_t count;
+
+            err_code = sd_ble_tx_buffer_count_get(&count);
+            APP_ERROR_CHECK(err_code);
+            p_ble->tx_total = count;
+            p_ble->tx_free = count;
+        }
+        p_ble->mem_report = true;
         break;
 
     //相手から切断されたとき
     //必要があればsd_ble_gatts_sys_attr_get()でSystem Attributeを取得し、保持しておく。
     //保持したSystem Attributeは、EVT_SYS_ATTR_MISSINGで返すことになる。
     case BLE_GAP_EVT_DISCONNECTED:
-        app_trace_log("BLE_GAP_EVT_DISCONNECTED\r\n");
+        APP_LOG("BLE_GAP_EVT_DISCONNECTED");
         led_off(LED_PIN_NO_CONNECTED);
-        m_conn_handle = BLE_CONN_HANDLE_INVALID;
+        p_ble->conn_handle = BLE_CONN_HANDLE_INVALID;
 
-        app_ble_start();
+        adv_start(p_ble);
         break;
 
     //SMP Paring要求を受信したとき
     //sd_ble_gap_sec_params_reply()で値を返したあと、SMP Paring Phase 2に状態遷移する
     case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
-        app_trace_log("BLE_GAP_EVT_SEC_PARAMS_REQUEST\r\n");
+        APP_LOG("BLE_GAP_EVT_SEC_PARAMS_REQUEST");
         {
-            ble_gap_sec_params_t sec_param;
-            sec_param.bond         = SEC_PARAM_BOND;
-            sec_param.mitm         = SEC_PARAM_MITM;
-            sec_param.io_caps      = SEC_PARAM_IO_CAPABILITIES;
-            sec_param.oob          = SEC_PARAM_OOB;
-            sec_param.min_key_size = SEC_PARAM_MIN_KEY_SIZE;
-            sec_param.max_key_size = SEC_PARAM_MAX_KEY_SIZE;
-            err_code = sd_ble_gap_sec_params_reply(m_conn_handle,
+            ble_params_t params;
+
+            params_load(&params);
+            err_code = sd_ble_gap_sec_params_reply(p_ble->conn_handle,
                                                BLE_GAP_SEC_STATUS_SUCCESS,
-                                               &sec_param,
-                                               &sec_key);
+                                               &params.sec,
+                                               &p_ble->sec_key);
             APP_ERROR_CHECK(err_code);
         }
         break;
@@ -659,36 +1033,36 @@ static void ble_evt_handler(ble_evt_t *p_ble_evt)
     //Just Works(Bonding有り)の場合、SMP Paring Phase 3のあとでPeripheral Keyが渡される。
     //ここではPeripheral Keyを保存だけしておき、次のBLE_GAP_EVT_SEC_INFO_REQUESTで処理する。
     case BLE_GAP_EVT_AUTH_STATUS:
-        app_trace_log("BLE_GAP_EVT_AUTH_STATUS\r\n");
-        m_auth_status = p_ble_evt->evt.gap_evt.params.auth_status;
+        APP_LOG("BLE_GAP_EVT_AUTH_STATUS");
+        p_ble->bond.auth_status = p_ble_evt->evt.gap_evt.params.auth_status;
         break;
 
     //SMP Paringが終わったとき？
     case BLE_GAP_EVT_SEC_INFO_REQUEST:
-        app_trace_log("BLE_GAP_EVT_SEC_INFO_REQUEST\r\n");
+        APP_LOG("BLE_GAP_EVT_SEC_INFO_REQUEST");
 		master_id_matches  = memcmp(&p_ble_evt->evt.gap_evt.params.sec_info_request.master_id,
-		                            &m_enc_key.master_id,
+		                            &p_ble->bond.enc_key.master_id,
 		                            sizeof(ble_gap_master_id_t)) == 0;
-		p_distributed_keys = &m_auth_status.kdist_periph;
+		p_distributed_keys = &p_ble->bond.auth_status.kdist_periph;
 
-		p_enc_info  = (p_distributed_keys->enc  && master_id_matches) ? &m_enc_key.enc_info : NULL;
-		p_id_info   = (p_distributed_keys->id   && master_id_matches) ? &m_id_key.id_info   : NULL;
-		p_sign_info = (p_distributed_keys->sign && master_id_matches) ? &m_sign_key         : NULL;
-		err_code = sd_ble_gap_sec_info_reply(m_conn_handle, p_enc_info, p_id_info, p_sign_info);
+		p_enc_info  = (p_distributed_keys->enc  && master_id_matches) ? &p_ble->bond.enc_key.enc_info : NULL;
+		p_id_info   = (p_distributed_keys->id   && master_id_matches) ? &p_ble->bond.id_key.id_info   : NULL;
+		p_sign_info = (p_distributed_keys->sign && master_id_matches) ? &p_ble->bond.sign_key         : NULL;
+		err_code = sd_ble_gap_sec_info_reply(p_ble->conn_handle, p_enc_info, p_id_info, p_sign_info);
         APP_ERROR_CHECK(err_code);
         break;
 
     //Advertisingか認証のタイムアウト発生
     case BLE_GAP_EVT_TIMEOUT:
-        app_trace_log("BLE_GAP_EVT_TIMEOUT\r\n");
+        APP_LOG("BLE_GAP_EVT_TIMEOUT");
         switch (p_ble_evt->evt.gap_evt.params.timeout.src) {
         case BLE_GAP_TIMEOUT_SRC_ADVERTISING: //Advertisingのタイムアウト
             /* Advertising LEDを消灯 */
             led_off(LED_PIN_NO_ADVERTISING);
+            p_ble->advertising = false;
 
-            /* System-OFFにする(もう戻ってこない) */
-            err_code = sd_power_system_off();
-            APP_ERROR_CHECK(err_code);
+            /* 状態を保持してSystem-OFFにする(復帰はリセットから) */
+            app_suspend_enter();
             break;
 
         case BLE_GAP_TIMEOUT_SRC_SECURITY_REQUEST:  //Security requestのタイムアウト
@@ -706,12 +1080,27 @@ static void ble_evt_handler(ble_evt_t *p_ble_evt)
     //接続後、Bondingした相手からSystem Attribute要求を受信したとき
     //System Attributeは、EVT_DISCONNECTEDで保持するが、今回は保持しないのでNULLを返す。
     case BLE_GATTS_EVT_SYS_ATTR_MISSING:
-        app_trace_log("BLE_GATTS_EVT_SYS_ATTR_MISSING\r\n");
-        err_code = sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0,
+        APP_LOG("BLE_GATTS_EVT_SYS_ATTR_MISSING");
+        err_code = sd_ble_gatts_sys_attr_set(p_ble->conn_handle, NULL, 0,
         			BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS | BLE_GATTS_SYS_ATTR_FLAG_USR_SRVCS);
         APP_ERROR_CHECK(err_code);
         break;
 
+    /*********************
+     * Common event
+     *********************/
+
+    //Notify送信完了(空いた送信バッファ数)
+    case BLE_EVT_TX_COMPLETE:
+        CRITICAL_REGION_ENTER();
+        p_ble->tx_free += p_ble_evt->evt.common_evt.params.tx_complete.count;
+        //数え漏らしたhvxがあっても総数は超えない
+        if (p_ble->tx_free > p_ble->tx_total) {
+            p_ble->tx_free = p_ble->tx_total;
+        }
+        CRITICAL_REGION_EXIT();
+        break;
+
     default:
         // No implementation needed.
         break;
@@ -719,6 +1108,85 @@ static void ble_evt_handler(ble_evt_t *p_ble_evt)
 }
 
 
+/*
+ * 振り分け表用 : p_contextはapp_ble_evt_dispatch()に渡されたBLE状態
+ */
+
+/** Connectionパラメータモジュールへ渡す */
+static void conn_params_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    app_ble_t *p_ble = (app_ble_t *)p_context;
+    ble_gap_conn_params_t conn_params;
+    uint32_t err_code;
+
+    ble_conn_params_on_ble_evt(p_ble_evt);
+
+    //未接続中に変えたPPCPを、ble_conn_paramsの希望値にする(接続を見てからでないと受け付けない)
+    if ((p_ble_evt->header.evt_id == BLE_GAP_EVT_CONNECTED) && p_ble->conn_params_pending) {
+        p_ble->conn_params_pending = false;
+        err_code = sd_ble_gap_ppcp_get(&conn_params);
+        APP_ERROR_CHECK(err_code);
+        err_code = ble_conn_params_change_conn_params(&conn_params);
+        if (err_code != NRF_SUCCESS) {
+            APP_LOG("conn_params_on_ble_evt: conn_params err=%d", err_code);
+        }
+    }
+}
+
+
+/** Slave latency制御へ渡す */
+static void latency_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    app_latency_on_ble_evt(&((app_ble_t *)p_context)->latency, p_ble_evt);
+}
+
+
+/** データ準備(Radio Notification)へ渡す */
+static void prepare_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    app_prepare_on_ble_evt(p_ble_evt);
+}
+
+
+/** リンク品質監視へ渡す */
+static void link_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    app_link_on_ble_evt(&((app_ble_t *)p_context)->link, p_ble_evt);
+}
+
+
+/** 一括転送へ渡す */
+static void bulk_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    app_bulk_on_ble_evt(&((app_ble_t *)p_context)->bulk, p_ble_evt);
+}
+
+
+/** I/Oサービスへ渡す */
+static void ios_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    ble_ios_on_ble_evt(&((app_ble_t *)p_context)->ios, p_ble_evt);
+}
+
+
+/** 診断サービスへ渡す */
+static void diag_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    ble_diag_on_ble_evt(&((app_ble_t *)p_context)->diag, p_ble_evt);
+}
+
+
+#ifdef BLE_DFU_APP_SUPPORT
+/** DFUサービスへ渡す */
+static void dfu_on_ble_evt(void *p_context, ble_evt_t *p_ble_evt)
+{
+    /** @snippet [Propagating BLE Stack events to DFU Service] */
+    ble_dfu_on_ble_evt(&((app_ble_t *)p_context)->dfus, p_ble_evt);
+    /** @snippet [Propagating BLE Stack events to DFU Service] */
+}
+#endif // BLE_DFU_APP_SUPPORT
+
+
 /**********************************************
  * BLE : Services
  **********************************************/
@@ -732,7 +1200,69 @@ static void ble_evt_handler(ble_evt_t *p_ble_evt)
  */
 static void svc_ios_handler_in(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length)
 {
-    app_trace_log("svc_ios_handler_in\r\n");
+    uint32_t start = app_ts_now();
+
+    APP_LOG("svc_ios_handler_in");
+    input_accept(APP_BLE_FROM_IOS(p_ios), p_value, length);
+    app_budget_check(APP_BUDGET_IOS_IN, start);
+}
+
+
+/**
+ * @brief I/Oサービス : 受信データ受付
+ *
+ * バルク転送のコマンド以外は、メインループで処理するようスケジューラに積む。
+ *
+ * @param[in,out]   p_ble   BLE状態
+ * @param[in]       p_value 受信バッファ
+ * @param[in]       length  受信データ長
+ */
+static void input_accept(app_ble_t *p_ble, const uint8_t *p_value, uint16_t length)
+{
+    input_evt_t evt;
+    uint32_t err_code;
+
+    if (app_bulk_on_command(&p_ble->bulk, p_value, length)) {
+        return;
+    }
+
+    //BLEイベント処理から抜けてから、メインループで処理する
+    evt.p_ble = p_ble;
+    evt.p_blk = (input_blk_t *)app_pool_alloc(&p_ble->pool, sizeof(input_blk_t) + length);
+    if (evt.p_blk == NULL) {
+        return;
+    }
+    evt.p_blk->length = length;
+    memcpy(evt.p_blk->data, p_value, length);
+    err_code = app_sched_event_put(&evt, sizeof(evt), input_exec);
+    if (err_code != NRF_SUCCESS) {
+        APP_LOG("svc_ios_handler_in: sched err=%d", err_code);
+        app_pool_free(&p_ble->pool, evt.p_blk);
+        return;
+    }
+    app_cpu_sched_put();
+}
+
+
+/**
+ * @brief I/Oサービス : 受信データ処理
+ *
+ * @details スケジューラから呼ばれる。
+ *
+ * @param[in]   p_event_data    input_evt_t
+ * @param[in]   event_size      sizeof(input_evt_t)
+ */
+static void input_exec(void *p_event_data, uint16_t event_size)
+{
+    const input_evt_t *p_evt = (const input_evt_t *)p_event_data;
+    uint32_t start = app_ts_now();
+
+    UNUSED_PARAMETER(event_size);
+
+    //YOUR_JOB: アプリのコマンド処理(p_evt->p_blk->data, p_evt->p_blk->length)
+
+    app_pool_free(&p_evt->p_ble->pool, p_evt->p_blk);
+    app_budget_check(APP_BUDGET_SCHED_INPUT, start);
 }
 
 /**
@@ -744,6 +1274,462 @@ static void svc_ios_handler_in(ble_ios_t *p_ios, const uint8_t *p_value, uint16_
  */
 static void svc_ios_handler_out(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length)
 {
-    app_trace_log("svc_ios_handler_out\r\n");
+    APP_LOG("svc_ios_handler_out");
+}
+
+
+/**
+ * @brief I/Oサービスイベントハンドラ : Config
+ *
+ * 書込みデータは[key(1byte)][value]。
+ * keyだけ書いた場合は値を変えず、読み出し用の値を[key][現在値]に更新する。
+ * 値はチェックしてから保存し、PPCPやAdvertisingパラメータはすぐに反映する。
+ *
+ * @param[in]   p_ios   I/Oサービス構造体
+ * @param[in]   p_value 受信バッファ
+ * @param[in]   length  受信データ長
+ */
+static void svc_ios_handler_cfg(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length)
+{
+    app_ble_t    *p_ble = APP_BLE_FROM_IOS(p_ios);
+    uint32_t     err_code;
+    uint8_t      key;
+    ble_params_t params;
+    uint16_t     val;
+
+    APP_LOG("svc_ios_handler_cfg");
+
+    if ((length < 1) || (p_value[0] >= APP_CFG_KEY_MAX)) {
+        return;
+    }
+    key = p_value[0];
+    p_value++;
+    length--;
+    if (length == 0) {
+        cfg_readback(p_ble, key);
+        return;
+    }
+
+    params_load(&params);
+    if (key == APP_CFG_KEY_DEVICE_NAME) {
+        if (length > APP_CFG_VALUE_MAX) {
+            cfg_readback(p_ble, key);
+            return;
+        }
+    }
+    else {
+        //数値 : uint16_tは2byte、uint8_tは1byte
+        if (length != ((key <= APP_CFG_KEY_CONN_SUP_TIMEOUT) ? 2 : 1)) {
+            cfg_readback(p_ble, key);
+            return;
+        }
+        val = (length == 2) ? (uint16_t)(p_value[0] | (p_value[1] << 8)) : p_value[0];
+        if ((key == APP_CFG_KEY_SEC_IO_CAPS) && (val > BLE_GAP_IO_CAPS_KEYBOARD_DISPLAY)) {
+            //bitfieldに入れる前にチェック
+            cfg_readback(p_ble, key);
+            return;
+        }
+
+        //変更後の組み合わせでチェックする
+        switch (key) {
+        case APP_CFG_KEY_ADV_INTERVAL:       params.adv_interval = val;         break;
+        case APP_CFG_KEY_ADV_TIMEOUT:        params.adv_timeout = val;          break;
+        case APP_CFG_KEY_CONN_MIN_INTERVAL:  params.conn_min_interval = val;    break;
+        case APP_CFG_KEY_CONN_MAX_INTERVAL:  params.conn_max_interval = val;    break;
+        case APP_CFG_KEY_CONN_SLAVE_LATENCY: params.conn_slave_latency = val;   break;
+        case APP_CFG_KEY_CONN_SUP_TIMEOUT:   params.conn_sup_timeout = val;     break;
+        case APP_CFG_KEY_SEC_BOND:           params.sec.bond = (val != 0);      break;
+        case APP_CFG_KEY_SEC_MITM:           params.sec.mitm = (val != 0);      break;
+        case APP_CFG_KEY_SEC_IO_CAPS:        params.sec.io_caps = val;          break;
+        case APP_CFG_KEY_SEC_OOB:            params.sec.oob = (val != 0);       break;
+        case APP_CFG_KEY_SEC_MIN_KEY_SIZE:   params.sec.min_key_size = val;     break;
+        case APP_CFG_KEY_SEC_MAX_KEY_SIZE:   params.sec.max_key_size = val;     break;
+        default:                                                                break;
+        }
+        if (!params_check(&params)) {
+            APP_LOG("svc_ios_handler_cfg: invalid value");
+            cfg_readback(p_ble, key);
+            return;
+        }
+    }
+
+    err_code = app_cfg_set((app_cfg_key_t)key, p_value, length);
+    APP_ERROR_CHECK(err_code);
+
+    //反映
+    switch (key) {
+    case APP_CFG_KEY_CONN_MIN_INTERVAL:
+    case APP_CFG_KEY_CONN_MAX_INTERVAL:
+    case APP_CFG_KEY_CONN_SLAVE_LATENCY:
+    case APP_CFG_KEY_CONN_SUP_TIMEOUT:
+        {
+            ble_gap_conn_params_t conn_params;
+
+            ppcp_set(&params, &conn_params);
+            if (p_ble->conn_handle != BLE_CONN_HANDLE_INVALID) {
+                //Centralに更新を要求する(受け入れるかはCentral次第)
+                err_code = ble_conn_params_change_conn_params(&conn_params);
+                if (err_code != NRF_SUCCESS) {
+                    APP_LOG("svc_ios_handler_cfg: conn_params err=%d", err_code);
+                }
+            }
+            else {
+                //SDK 8.1のble_conn_paramsは未接続だと希望値を変えない(初期化時のPPCPのまま)。
+                //放っておくと接続後に古い値へ戻されるので、次の接続で渡す。
+                p_ble->conn_params_pending = true;
+            }
+        }
+        break;
+
+    case APP_CFG_KEY_DEVICE_NAME:
+        device_name_set();
+        advdata_set(p_ble);
+        break;
+
+    case APP_CFG_KEY_ADV_INTERVAL:
+    case APP_CFG_KEY_ADV_TIMEOUT:
+        //接続中はAdvertisingしていないので、次回開始時に反映される
+        if (p_ble->advertising) {
+            err_code = sd_ble_gap_adv_stop();
+            APP_ERROR_CHECK(err_code);
+            adv_start(p_ble);
+        }
+        break;
+
+    default:
+        //Securityは次のペアリングから
+        break;
+    }
+
+    cfg_readback(p_ble, key);
+}
+
+
+/**
+ * @brief Configキャラクタリスティックの読み出し値更新
+ *
+ * @param[in,out]   p_ble   BLE状態
+ * @param[in]       key     設定Key
+ */
+static void cfg_readback(app_ble_t *p_ble, uint8_t key)
+{
+    uint8_t         buf[1 + APP_CFG_VALUE_MAX];
+    const uint8_t   *p_value;
+    uint16_t        len = 0;
+
+    buf[0] = key;
+    p_value = app_cfg_get((app_cfg_key_t)key, &len);
+    if (p_value != NULL) {
+        memcpy(&buf[1], p_value, len);
+    }
+    ble_ios_cfg_value_set(&p_ble->ios, buf, 1 + len);
+}
+
+
+/**
+ * @brief リンク品質テレメトリ更新
+ *
+ * @param[in]   p_link          リンク品質監視
+ * @param[in]   p_telemetry     最新のテレメトリ
+ */
+static void link_report_handler(app_link_t *p_link, const app_link_telemetry_t *p_telemetry)
+{
+    diag_value_set(APP_BLE_FROM_LINK(p_link), BLE_DIAG_CHAR_LINK,
+                        (const uint8_t *)p_telemetry, sizeof(app_link_telemetry_t));
+}
+
+
+/**
+ * @brief 一括転送 : パケット送信
+ *
+ * @param[in]   p_bulk  一括転送
+ * @param[in]   p_data  送信データ
+ * @param[in]   length  送信データ長
+ * @return      sd_ble_gatts_hvx()の戻り値
+ */
+static uint32_t bulk_send(app_bulk_t *p_bulk, const uint8_t *p_data, uint16_t length)
+{
+    app_ble_t *p_ble = APP_BLE_FROM_BULK(p_bulk);
+    uint32_t err_code;
+
+    err_code = ble_ios_on_output(&p_ble->ios, p_data, length);
+    app_link_on_notify(&p_ble->link, err_code);
+    tx_used(p_ble, err_code);
+    return err_code;
 }
 
+
+/**
+ * @brief サンプル詰め : パケット送信
+ *
+ * @param[in]   p_context   BLE状態
+ * @param[in]   p_data      送信データ
+ * @param[in]   length      送信データ長
+ */
+static void pack_send(void *p_context, const uint8_t *p_data, uint16_t length)
+{
+    app_ble_nofify((app_ble_t *)p_context, p_data, length);
+}
+
+
+/**********************************************
+ * Notify queue
+ **********************************************/
+
+/**
+ * @brief 送信待ちNotifyの追加
+ *
+ * @param[in,out]   p_ble   BLE状態
+ * @param[in]       p_data  送信データ
+ * @param[in]       length  送信データ長
+ */
+static void notify_enqueue(app_ble_t *p_ble, const uint8_t *p_data, uint16_t length)
+{
+    notify_blk_t *p_blk;
+
+    p_blk = (notify_blk_t *)app_pool_alloc(&p_ble->pool, sizeof(notify_blk_t) + length);
+    if (p_blk == NULL) {
+        APP_LOG("notify_enqueue: drop len=%d", length);
+        return;
+    }
+    p_blk->p_next = NULL;
+    p_blk->length = length;
+    memcpy(p_blk->data, p_data, length);
+
+    //app_ble_nofify()はSWI1(app_prepare)からも呼ばれるので、つなぎ替えは割込み禁止で行う
+    CRITICAL_REGION_ENTER();
+    if (p_ble->notify_tail != NULL) {
+        p_ble->notify_tail->p_next = p_blk;
+    }
+    else {
+        p_ble->notify_head = p_blk;
+    }
+    p_ble->notify_tail = p_blk;
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**
+ * @brief 送信待ちNotifyの送信
+ *
+ * 送信バッファが一杯になるまで先頭から送る。
+ * 切断されていたら全部捨てる。
+ * メインループからだけ呼ぶ(取り出しは1箇所だけなので、先頭の参照は割込み禁止にしない)。
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void notify_drain(app_ble_t *p_ble)
+{
+    notify_blk_t *p_blk;
+    uint32_t err_code;
+
+    while (p_ble->notify_head != NULL) {
+        p_blk = p_ble->notify_head;
+        if (p_ble->conn_handle != BLE_CONN_HANDLE_INVALID) {
+            if (app_bulk_is_active(&p_ble->bulk)) {
+                //一括転送のパケットと混ざらないよう、終わってから送る
+                break;
+            }
+            err_code = ble_ios_on_output(&p_ble->ios, p_blk->data, p_blk->length);
+            app_link_on_notify(&p_ble->link, err_code);
+            tx_used(p_ble, err_code);
+            if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+                break;
+            }
+            if (err_code != NRF_SUCCESS) {
+                APP_LOG("notify_drain: err=%d", err_code);
+            }
+        }
+
+        //p_nextを読んでからtailを消すまでに追加されると失われるので、まとめて行う
+        CRITICAL_REGION_ENTER();
+        p_ble->notify_head = p_blk->p_next;
+        if (p_ble->notify_head == NULL) {
+            p_ble->notify_tail = NULL;
+        }
+        CRITICAL_REGION_EXIT();
+        app_pool_free(&p_ble->pool, p_blk);
+    }
+}
+
+
+/**
+ * @brief メモリレポート更新
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void mem_report(app_ble_t *p_ble)
+{
+    app_mem_report_t report;
+
+    app_mem_report_get(&report);
+    diag_value_set(p_ble, BLE_DIAG_CHAR_MEM, (const uint8_t *)&report, sizeof(report));
+}
+
+
+/**
+ * @brief クラッシュ記録更新
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void crash_report(app_ble_t *p_ble)
+{
+    const app_crash_record_t *p_record = app_crash_get();
+
+    if (p_record != NULL) {
+        diag_value_set(p_ble, BLE_DIAG_CHAR_CRASH, (const uint8_t *)p_record, sizeof(app_crash_record_t));
+    }
+}
+
+
+/**
+ * @brief 起動時間レポート更新
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void boot_report(app_ble_t *p_ble)
+{
+    app_boot_report_t report;
+
+    app_boot_report_get(&report);
+    diag_value_set(p_ble, BLE_DIAG_CHAR_BOOT, (const uint8_t *)&report, sizeof(report));
+}
+
+
+/**
+ * @brief CPU使用率レポート更新
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void cpu_report(app_ble_t *p_ble)
+{
+    app_cpu_report_t report;
+
+    app_cpu_report_get(&report);
+    diag_value_set(p_ble, BLE_DIAG_CHAR_CPU, (const uint8_t *)&report, sizeof(report));
+}
+
+
+/**
+ * @brief 診断値更新(Notifyしたら送信バッファ数に反映する)
+ *
+ * @param[in,out]   p_ble       BLE状態
+ * @param[in]       chr         更新するキャラクタリスティック
+ * @param[in]       p_value     データバッファ
+ * @param[in]       length      データサイズ
+ */
+static void diag_value_set(app_ble_t *p_ble, ble_diag_char_t chr, const uint8_t *p_value, uint16_t length)
+{
+    uint32_t hvx_result;
+
+    ble_diag_value_set(&p_ble->diag, chr, p_value, length, &hvx_result);
+    tx_used(p_ble, hvx_result);
+}
+
+
+/**
+ * @brief メモリプール枯渇
+ *
+ * @param[in]   p_pool  プール
+ * @param[in]   size    要求サイズ[byte]
+ */
+static void pool_exhausted_handler(app_pool_t *p_pool, uint16_t size)
+{
+    APP_LOG("pool exhausted: size=%d", size);
+}
+
+
+/**********************************************
+ * Log streaming
+ **********************************************/
+
+/**
+ * @brief 送信バッファ使用
+ *
+ * @param[in,out]   p_ble       BLE状態
+ * @param[in]       err_code    sd_ble_gatts_hvx()の戻り値
+ */
+static void tx_used(app_ble_t *p_ble, uint32_t err_code)
+{
+    CRITICAL_REGION_ENTER();
+    if (err_code == NRF_SUCCESS) {
+        if (p_ble->tx_free != 0) {
+            p_ble->tx_free--;
+        }
+    }
+    else if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+        p_ble->tx_free = 0;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**
+ * @brief ログ送信
+ *
+ * 診断サービスのLogキャラクタリスティックでNotifyが有効なときだけ、
+ * 送信バッファをLOG_TX_RESERVE個残してapp_logのリングを流す。
+ * 一括転送中は送らない。
+ * Notifyはレコードの区切りを気にせずに詰めるので、受信側で連結してデコードする。
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void log_stream(app_ble_t *p_ble)
+{
+    uint8_t  buf[LOG_CHUNK_SIZE];
+    uint16_t len;
+    uint32_t pos;
+    uint32_t err_code;
+
+    if (!ble_diag_is_notify_enabled(&p_ble->diag, BLE_DIAG_CHAR_LOG)) {
+        return;
+    }
+    app_log_reader_enable(APP_LOG_READER_BLE, true);
+    if (app_bulk_is_active(&p_ble->bulk)) {
+        return;
+    }
+
+    while (p_ble->tx_free > LOG_TX_RESERVE) {
+        len = app_log_peek(APP_LOG_READER_BLE, buf, sizeof(buf), &pos);
+        if (len == 0) {
+            break;
+        }
+        err_code = ble_diag_notify(&p_ble->diag, BLE_DIAG_CHAR_LOG, buf, len);
+        tx_used(p_ble, err_code);
+        if (err_code != NRF_SUCCESS) {
+            break;
+        }
+        app_log_consume(APP_LOG_READER_BLE, pos, len);
+    }
+}
+
+
+/**
+ * @brief BLEイベント記録の送信
+ *
+ * 診断サービスのEvtRecキャラクタリスティックでNotifyが有効になったら記録を凍結し、
+ * 残っている記録を古い順に1Notifyに1つずつ送る。
+ * Notifyを無効にするか切断すると、記録を再開する。
+ *
+ * @param[in,out]   p_ble   BLE状態
+ */
+static void evtrec_stream(app_ble_t *p_ble)
+{
+    app_evtrec_t rec;
+    uint32_t err_code;
+
+    if (!ble_diag_is_notify_enabled(&p_ble->diag, BLE_DIAG_CHAR_EVTREC)) {
+        return;
+    }
+    app_evtrec_freeze(&p_ble->evtrec, APP_EVTREC_READER_BLE, true);
+
+    while ((p_ble->tx_free > LOG_TX_RESERVE) && app_evtrec_peek(&p_ble->evtrec, APP_EVTREC_READER_BLE, &rec)) {
+        err_code = ble_diag_notify(&p_ble->diag, BLE_DIAG_CHAR_EVTREC,
+                                    (const uint8_t *)&rec, sizeof(rec));
+        tx_used(p_ble, err_code);
+        if (err_code != NRF_SUCCESS) {
+            break;
+        }
+        app_evtrec_consume(&p_ble->evtrec, APP_EVTREC_READER_BLE);
+    }
+}
@@ -29,8 +29,69 @@
 /**************************************************************************
  * include
  **************************************************************************/
+#include <stdbool.h>
+
 #include "nrf.h"
 #include "ble.h"
+#ifdef BLE_DFU_APP_SUPPORT
+#include "ble_dfu.h"
+#endif // BLE_DFU_APP_SUPPORT
+
+#include "ble_ios.h"
+#include "ble_diag.h"
+#include "app_pool.h"
+#include "app_link.h"
+#include "app_latency.h"
+#include "app_bulk.h"
+#include "app_pack.h"
+#include "app_evtrec.h"
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** ボンディング情報(System OFF中も保持する) */
+typedef struct {
+    ble_gap_evt_auth_status_t   auth_status;
+    ble_gap_enc_key_t           enc_key;    /**< Encryption Key (Encryption Info and Master ID). */
+    ble_gap_id_key_t            id_key;     /**< Identity Key (IRK and address). */
+    ble_gap_sign_info_t         sign_key;   /**< Signing Key (Connection Signature Resolving Key). */
+} app_ble_bond_t;
+
+
+/**
+ * @brief BLE状態
+ *
+ * 1デバイス分の状態をまとめたもの。呼出し側で確保し、全APIに渡す。中身は触らないこと。
+ * ファームウェアではSoftDeviceが1つなのでmain.cに1つだけ置く。
+ * Linuxのシミュレーション(test/bench_fleet.c)では、仮想デバイスの数だけ置く。
+ */
+typedef struct {
+    uint16_t                conn_handle;    /**< Handle of the current connection. */
+#ifdef BLE_DFU_APP_SUPPORT
+    ble_dfu_t               dfus;           /**< Structure used to identify the DFU service. */
+#endif // BLE_DFU_APP_SUPPORT
+    ble_ios_t               ios;
+    ble_diag_t              diag;
+    app_pool_t              pool;           /**< 送信待ちNotifyと受信データのブロック */
+    app_link_t              link;
+    app_latency_t           latency;
+    app_bulk_t              bulk;
+    app_pack_t              pack;           /**< Outputキャラクタリスティックへのサンプル詰め */
+    app_evtrec_ring_t       evtrec;
+    bool                    advertising;    /**< Advertising中かどうか(設定変更時の再開判定用) */
+    volatile uint8_t        tx_free;        /**< 空いている送信バッファ数(ログ送信の判定用) */
+    uint8_t                 tx_total;       /**< 送信バッファ総数(tx_freeの上限) */
+    volatile bool           mem_report;     /**< メモリレポートを更新するかどうか */
+    bool                    boot_reported;  /**< 起動時のレポート(クラッシュ記録/起動時間)を載せたかどうか */
+    bool                    ts_requested;   /**< EvtRecの購読中はタイムスタンプを高分解能にする */
+    bool                    conn_params_pending;    /**< 未接続中にPPCPを変えた(次の接続でble_conn_paramsへ渡す) */
+    struct notify_blk_t     *notify_head;   /**< 送信待ちNotifyキュー */
+    struct notify_blk_t     *notify_tail;
+    app_ble_bond_t          bond;
+    ble_gap_sec_keyset_t    sec_key;        /**< ペアリング時にbondへ鍵を受け取る */
+} app_ble_t;
 
 
 /**************************************************************************
@@ -38,14 +99,16 @@
  **************************************************************************/
 
 /* BLE */
-void app_ble_init(void);
-void app_ble_start(void);
+void app_ble_init(app_ble_t *p_ble);
+void app_ble_init_late(app_ble_t *p_ble);
+void app_ble_start(app_ble_t *p_ble);
 #ifdef BLE_DFU_APP_SUPPORT
-void app_ble_stop(void)
+void app_ble_stop(app_ble_t *p_ble);
 #endif	//BLE_DFU_APP_SUPPORT
-int app_ble_is_connected(void);
-void app_ble_nofify(const uint8_t *p_data, uint16_t length);
+int app_ble_is_connected(const app_ble_t *p_ble);
+void app_ble_nofify(app_ble_t *p_ble, const uint8_t *p_data, uint16_t length);
+void app_ble_idle(app_ble_t *p_ble);
 
-void app_ble_evt_dispatch(ble_evt_t *p_ble_evt);
+void app_ble_evt_dispatch(app_ble_t *p_ble, ble_evt_t *p_ble_evt);
 
 #endif /* APP_BLE_H__ */
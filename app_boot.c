@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_boot.c
+ *
+ * 起動時間計測
+ *
+ * main()の先頭からTIMER1(16bit, 62.5kHz)を回し、各段階の終わりでキャプチャする。
+ * 1秒ほどで一周するので、それまでにapp_boot_done()を呼ぶこと。
+ * リセットからmain()までのスタートアップ(.data/.bssの初期化)は含まない。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "nrf.h"
+
+#include "app_boot.h"
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 16MHz / 2^8 = 62.5kHz */
+#define BOOT_TIMER_PRESCALER            (8)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static app_boot_report_t                m_report;
+static bool                             m_running;
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_boot_init(void)
+{
+    memset(&m_report, 0, sizeof(m_report));
+
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->TASKS_CLEAR = 1;
+    NRF_TIMER1->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    NRF_TIMER1->PRESCALER = BOOT_TIMER_PRESCALER;
+    NRF_TIMER1->TASKS_START = 1;
+    m_running = true;
+}
+
+
+void app_boot_mark(app_boot_stage_t stage)
+{
+    if (!m_running || (m_report.stage[stage] != 0)) {
+        return;
+    }
+    NRF_TIMER1->TASKS_CAPTURE[0] = 1;
+    m_report.stage[stage] = (uint16_t)NRF_TIMER1->CC[0];
+}
+
+
+void app_boot_done(void)
+{
+    uint8_t stage;
+    uint32_t prev = 0;
+
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->TASKS_SHUTDOWN = 1;
+
+    for (stage = 0; stage < APP_BOOT_STAGE_MAX; stage++) {
+        if (m_report.stage[stage] != 0) {
+            APP_LOG("boot: stage=%u %uus (+%uus)", stage, app_boot_us((app_boot_stage_t)stage),
+                        app_boot_us((app_boot_stage_t)stage) - prev);
+            prev = app_boot_us((app_boot_stage_t)stage);
+        }
+    }
+}
+
+
+uint32_t app_boot_us(app_boot_stage_t stage)
+{
+    return (uint32_t)m_report.stage[stage] * APP_BOOT_TICK_USEC;
+}
+
+
+void app_boot_report_get(app_boot_report_t *p_report)
+{
+    memcpy(p_report, &m_report, sizeof(app_boot_report_t));
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_boot.h
+ *
+ * 起動時間計測
+ */
+#ifndef APP_BOOT_H__
+#define APP_BOOT_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 記録の単位[usec] */
+#define APP_BOOT_TICK_USEC              (16)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** 起動段階(起動順) */
+typedef enum {
+    APP_BOOT_DRV,                       /**< GPIO/タイマ/スケジューラ */
+    APP_BOOT_SOFTDEVICE,                /**< LFCLK開始とSoftDevice有効化 */
+    APP_BOOT_CFG,                       /**< 設定値読込み */
+    APP_BOOT_BLE_ENABLE,                /**< sd_ble_enable() */
+    APP_BOOT_BLE_GAP,                   /**< デバイス名/PPCP */
+    APP_BOOT_BLE_SERVICES,              /**< Service登録 */
+    APP_BOOT_BLE_ADVDATA,               /**< Advertisingデータ設定 */
+    APP_BOOT_ADV_START,                 /**< Advertising開始 */
+    APP_BOOT_LATE_INIT,                 /**< 後回しにした初期化 */
+    //
+    APP_BOOT_STAGE_MAX
+} app_boot_stage_t;
+
+
+/**
+ * @brief 起動時間レポート
+ *
+ * リセットから各段階の終わりまでの時間[APP_BOOT_TICK_USEC]。
+ * 診断キャラクタリスティックにはこのままリトルエンディアンで載せる(20byte以内)。
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t    stage[APP_BOOT_STAGE_MAX];
+} app_boot_report_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 計測開始
+ *
+ * main()の先頭で呼ぶ。
+ */
+void app_boot_init(void);
+
+
+/**@brief 段階の終わりを記録
+ *
+ * 計測終了後や、既に記録した段階では何もしない。
+ *
+ * @param[in]   stage       終わった段階
+ */
+void app_boot_mark(app_boot_stage_t stage);
+
+
+/**@brief 計測終了
+ *
+ * タイマを止めて、内訳をログに出す。
+ */
+void app_boot_done(void);
+
+
+/**@brief 段階の終わりまでの時間
+ *
+ * @param[in]   stage       段階
+ * @return      リセットからの時間[usec](未記録なら0)
+ */
+uint32_t app_boot_us(app_boot_stage_t stage);
+
+
+/**@brief レポート取得
+ *
+ * @param[out]  p_report    レポート
+ */
+void app_boot_report_get(app_boot_report_t *p_report);
+
+#endif /* APP_BOOT_H__ */
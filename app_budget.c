@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_budget.c
+ *
+ * ハンドラ処理時間の監視とWDT
+ *
+ * 処理時間はapp_ts_now()で測る(通常はRTCの分解能)。
+ * 上限を超えたら回数を数え、ハンドラごとの最大値を更新したときだけログに出す。
+ *
+ * WDTはCPUが寝ている間は止まる設定にし、メインループ1周ごとに更新する。
+ * 寝ないまま(メインループが回らないまま)WDT_CONFIG_RELOAD_VALUE[msec]経つとリセットする。
+ * リセット直前のWDT割込みで、割り込まれたPCをapp_crashに残す。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include "nrf.h"
+#include "nrf_drv_config.h"
+#if (WDT_ENABLED == 1)
+#include "nrf_wdt.h"
+#endif  //WDT_ENABLED
+
+#include "app_budget.h"
+#include "app_ts.h"
+#include "app_crash.h"
+
+#include "app_util_platform.h"
+#include "app_log.h"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static app_budget_stat_t                m_stat[APP_BUDGET_ID_MAX];
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_budget_init(void)
+{
+#if (WDT_ENABLED == 1)
+    NRF_WDT->CONFIG = WDT_CONFIG_BEHAVIOUR;
+    NRF_WDT->CRV = (uint32_t)(((uint64_t)WDT_CONFIG_RELOAD_VALUE * 32768) / 1000);
+    NRF_WDT->RREN = WDT_RREN_RR0_Msk;
+    NRF_WDT->INTENSET = WDT_INTENSET_TIMEOUT_Msk;
+    NVIC_ClearPendingIRQ(WDT_IRQn);
+    NVIC_SetPriority(WDT_IRQn, WDT_CONFIG_IRQ_PRIORITY);
+    NVIC_EnableIRQ(WDT_IRQn);
+    NRF_WDT->TASKS_START = 1;
+#endif  //WDT_ENABLED
+}
+
+
+void app_budget_feed(void)
+{
+#if (WDT_ENABLED == 1)
+    NRF_WDT->RR[0] = WDT_RR_RR_Reload;
+#endif  //WDT_ENABLED
+}
+
+
+void app_budget_set(app_budget_id_t id, uint16_t budget_us)
+{
+    m_stat[id].budget_us = budget_us;
+}
+
+
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start)
+{
+    uint32_t now = app_ts_now();
+    uint32_t elapsed = now - start;
+    uint32_t budget = (m_stat[id].budget_us != 0) ? m_stat[id].budget_us : APP_BUDGET_DEFAULT_US;
+    bool log = false;
+
+    if (elapsed <= budget) {
+        return now;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if (m_stat[id].overrun != UINT16_MAX) {
+        m_stat[id].overrun++;
+    }
+    if (elapsed > m_stat[id].max_us) {
+        m_stat[id].max_us = elapsed;
+        log = true;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (log) {
+        APP_LOG("budget: id=%u %uus > %uus", id, elapsed, budget);
+    }
+    return now;
+}
+
+
+void app_budget_stat_get(app_budget_id_t id, app_budget_stat_t *p_stat)
+{
+    CRITICAL_REGION_ENTER();
+    *p_stat = m_stat[id];
+    CRITICAL_REGION_EXIT();
+    if (p_stat->budget_us == 0) {
+        p_stat->budget_us = APP_BUDGET_DEFAULT_US;
+    }
+}
+
+
+#if (WDT_ENABLED == 1)
+/**
+ * @brief WDT割込み
+ *
+ * 2 LFCLK(約60usec)後にリセットされるので、間に合う範囲で記録する。
+ * このアプリはMSPしか使わない。
+ */
+void WDT_IRQHandler(void) __attribute__((naked));
+void WDT_IRQHandler(void)
+{
+    __asm volatile(
+        "   mrs     r0, msp             \n"
+        "   bl      app_budget_on_wdt   \n"
+    );
+}
+
+
+/**
+ * @brief WDT割込み(C側)
+ *
+ * @param[in]   p_frame     例外フレーム
+ */
+void app_budget_on_wdt(const uint32_t *p_frame) __attribute__((used, noreturn));
+void app_budget_on_wdt(const uint32_t *p_frame)
+{
+    app_crash_reset(APP_CRASH_WDT, 0, NULL, p_frame[6], p_frame[5], p_frame + 8);
+}
+#endif  //WDT_ENABLED
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_budget.h
+ *
+ * ハンドラ処理時間の監視とWDT
+ */
+#ifndef APP_BUDGET_H__
+#define APP_BUDGET_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 処理時間の上限の初期値[usec] */
+#define APP_BUDGET_DEFAULT_US           (2000)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** 監視するハンドラ */
+typedef enum {
+    APP_BUDGET_SCHED_TIMER,             /**< app_wheelのタイマハンドラ */
+    APP_BUDGET_SCHED_INPUT,             /**< I/OサービスのInput処理 */
+    APP_BUDGET_BLE_APP,                 /**< app_bleのBLEイベント処理 */
+    APP_BUDGET_BLE_CONN_PARAMS,         /**< ble_conn_params */
+    APP_BUDGET_BLE_LATENCY,             /**< app_latency */
+    APP_BUDGET_BLE_PREPARE,             /**< app_prepare */
+    APP_BUDGET_BLE_LINK,                /**< app_link */
+    APP_BUDGET_BLE_BULK,                /**< app_bulk */
+    APP_BUDGET_BLE_IOS,                 /**< I/Oサービス(IOS_INを含む) */
+    APP_BUDGET_BLE_DIAG,                /**< 診断サービス */
+    APP_BUDGET_BLE_DFU,                 /**< DFUサービス(BLE_DFU_APP_SUPPORT) */
+    APP_BUDGET_IOS_IN,                  /**< I/OサービスのInputハンドラ(evt_handler_in) */
+    APP_BUDGET_SAMPLE,                  /**< app_sampleのブロック処理 */
+    //
+    APP_BUDGET_ID_MAX
+} app_budget_id_t;
+
+
+/** 統計 */
+typedef struct {
+    uint16_t    budget_us;      /**< 上限[usec] */
+    uint16_t    overrun;        /**< 超過回数(65535で飽和) */
+    uint32_t    max_us;         /**< 最大処理時間[usec] */
+} app_budget_stat_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief WDT開始
+ *
+ * WDT_ENABLED(nrf_drv_config.h)が1のとき、WDTを開始する。
+ * 一度開始すると止められないので、メインループに入る直前に呼ぶこと。
+ */
+void app_budget_init(void);
+
+
+/**@brief WDTの更新
+ *
+ * メインループが1周するたびに呼ぶ。
+ * CPUが寝ている間はWDTも止まるので、ハンドラや割込みから戻らなくなったときだけ満了する。
+ * 満了したら、割り込まれた場所をapp_crashに残してリセットする。
+ */
+void app_budget_feed(void);
+
+
+/**@brief 処理時間の上限設定
+ *
+ * @param[in]   id          ハンドラ
+ * @param[in]   budget_us   上限[usec](0:APP_BUDGET_DEFAULT_US)
+ */
+void app_budget_set(app_budget_id_t id, uint16_t budget_us);
+
+
+/**@brief 処理時間の確認
+ *
+ * ハンドラの前にapp_ts_now()で取った時刻を渡す。
+ * 上限を超えていれば数え、最大値を更新したらログに出す。
+ * 割込みからも呼べる。
+ *
+ * @param[in]   id          ハンドラ
+ * @param[in]   start       ハンドラ呼出し前のapp_ts_now()
+ * @return      現在のapp_ts_now()(続けて次のハンドラのstartに使える)
+ */
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start);
+
+
+/**@brief 統計取得
+ *
+ * @param[in]   id          ハンドラ
+ * @param[out]  p_stat      統計
+ */
+void app_budget_stat_get(app_budget_id_t id, app_budget_stat_t *p_stat);
+
+#endif /* APP_BUDGET_H__ */
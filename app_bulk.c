@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_bulk.c
+ *
+ * 一括転送
+ *
+ * 数十KBを吸い出すとき、通常のPPCP(500～1000msec)で1回ずつNotifyしていると
+ * 何分もかかる。Inputへのコマンドで一括転送モードに入り、
+ *  - 最小のConnection間隔を要求する
+ *  - TX_COMPLETEのたびにTXバッファが空かなくなるまでNotifyを積む
+ *  - Centralからのウィンドウ単位のACKで受信を確認し、NACKで送り直す(Go-Back-N)
+ * を行い、終わったら元のパラメータに戻す。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_bulk.h"
+#include "app_latency.h"
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_conn_params.h"
+
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** ACK無しで送信できるパケット数 */
+#define BULK_WINDOW                     (32)
+
+/** 一括転送中のConnection間隔[1.25msec単位] (7.5～15msec) */
+#define BULK_MIN_CONN_INTERVAL          (6)
+#define BULK_MAX_CONN_INTERVAL          (12)
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void bulk_start(app_bulk_t *p_bulk, uint8_t id, uint32_t offset, uint32_t length);
+static void bulk_finish(app_bulk_t *p_bulk, bool completed);
+static void bulk_fill(app_bulk_t *p_bulk);
+static uint16_t get_u16(const uint8_t *p);
+static uint32_t get_u32(const uint8_t *p);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_bulk_init(app_bulk_t *p_bulk, app_bulk_send_t send, app_latency_t *p_latency)
+{
+    memset(p_bulk, 0, sizeof(app_bulk_t));
+    p_bulk->send = send;
+    p_bulk->p_latency = p_latency;
+    p_bulk->state = APP_BULK_ST_IDLE;
+    p_bulk->conn_handle = BLE_CONN_HANDLE_INVALID;
+}
+
+
+uint32_t app_bulk_source_set(app_bulk_t *p_bulk, uint8_t id, app_bulk_read_t read, uint32_t size)
+{
+    if (id >= APP_BULK_SOURCE_MAX) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    p_bulk->sources[id].read  = read;
+    p_bulk->sources[id].p_mem = NULL;
+    p_bulk->sources[id].size  = size;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_bulk_mem_source_set(app_bulk_t *p_bulk, uint8_t id, const uint8_t *p_data, uint32_t size)
+{
+    if (id >= APP_BULK_SOURCE_MAX) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    p_bulk->sources[id].read  = NULL;
+    p_bulk->sources[id].p_mem = p_data;
+    p_bulk->sources[id].size  = size;
+    return NRF_SUCCESS;
+}
+
+
+bool app_bulk_on_command(app_bulk_t *p_bulk, const uint8_t *p_value, uint16_t length)
+{
+    if (length < 1) {
+        return false;
+    }
+
+    switch (p_value[0]) {
+    case APP_BULK_CMD_START:
+        if (length == 10) {
+            bulk_start(p_bulk, p_value[1], get_u32(&p_value[2]), get_u32(&p_value[6]));
+        }
+        break;
+
+    case APP_BULK_CMD_ACK:
+        if ((length == 3) && (p_bulk->state != APP_BULK_ST_IDLE)) {
+            uint16_t seq = get_u16(&p_value[1]);
+
+            if ((seq > p_bulk->acked) && (seq <= p_bulk->next_seq)) {
+                p_bulk->acked = seq;
+                bulk_fill(p_bulk);
+            }
+        }
+        break;
+
+    case APP_BULK_CMD_NACK:
+        if ((length == 3) && (p_bulk->state == APP_BULK_ST_RUN)) {
+            uint16_t seq = get_u16(&p_value[1]);
+
+            if ((seq >= p_bulk->acked) && (seq < p_bulk->next_seq)) {
+                p_bulk->stats.resent += p_bulk->next_seq - seq;
+                p_bulk->next_seq = seq;
+                bulk_fill(p_bulk);
+            }
+        }
+        break;
+
+    case APP_BULK_CMD_ABORT:
+        if (p_bulk->state != APP_BULK_ST_IDLE) {
+            bulk_finish(p_bulk, false);
+        }
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+
+void app_bulk_on_ble_evt(app_bulk_t *p_bulk, ble_evt_t *p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        p_bulk->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        if (p_bulk->restore_pending) {
+            //ble_conn_paramsの希望値をPPCPにそろえる(ble_conn_params_on_ble_evt()の後に呼ばれること)
+            ble_gap_conn_params_t params;
+            uint32_t err_code;
+
+            p_bulk->restore_pending = false;
+            err_code = sd_ble_gap_ppcp_get(&params);
+            APP_ERROR_CHECK(err_code);
+            err_code = ble_conn_params_change_conn_params(&params);
+            if (err_code != NRF_SUCCESS) {
+                APP_LOG("bulk: conn_params err=%d", err_code);
+            }
+        }
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        p_bulk->conn_handle = BLE_CONN_HANDLE_INVALID;
+        if (p_bulk->state != APP_BULK_ST_IDLE) {
+            bulk_finish(p_bulk, false);
+        }
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        //TXバッファが空いた
+        bulk_fill(p_bulk);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+bool app_bulk_is_active(const app_bulk_t *p_bulk)
+{
+    return p_bulk->state != APP_BULK_ST_IDLE;
+}
+
+
+void app_bulk_stats_get(const app_bulk_t *p_bulk, app_bulk_stats_t *p_stats)
+{
+    *p_stats = p_bulk->stats;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 転送開始
+ *
+ * @param[in,out]   p_bulk      一括転送
+ * @param[in]       id          データ元番号
+ * @param[in]       offset      データ元の開始位置
+ * @param[in]       length      転送byte数
+ */
+static void bulk_start(app_bulk_t *p_bulk, uint8_t id, uint32_t offset, uint32_t length)
+{
+    uint32_t                err_code;
+    ble_gap_conn_params_t   params;
+
+    if ((p_bulk->state != APP_BULK_ST_IDLE) || (p_bulk->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+      (id >= APP_BULK_SOURCE_MAX) || (p_bulk->sources[id].size == 0) ||
+      (offset > p_bulk->sources[id].size) || (length > p_bulk->sources[id].size - offset) ||
+      ((length + APP_BULK_PAYLOAD - 1) / APP_BULK_PAYLOAD > UINT16_MAX - 1)) {
+        APP_LOG("bulk_start: invalid");
+        return;
+    }
+
+    p_bulk->p_src        = &p_bulk->sources[id];
+    p_bulk->offset     = offset;
+    p_bulk->length     = length;
+    p_bulk->total      = (uint16_t)((length + APP_BULK_PAYLOAD - 1) / APP_BULK_PAYLOAD);
+    p_bulk->next_seq   = 0;
+    p_bulk->acked      = 0;
+    memset(&p_bulk->stats, 0, sizeof(p_bulk->stats));
+
+    //最小のConnection間隔を要求(Centralが受け入れるまでは今の間隔で送る)
+    err_code = sd_ble_gap_ppcp_get(&p_bulk->saved_params);
+    APP_ERROR_CHECK(err_code);
+    params = p_bulk->saved_params;
+    params.min_conn_interval = BULK_MIN_CONN_INTERVAL;
+    params.max_conn_interval = BULK_MAX_CONN_INTERVAL;
+    params.slave_latency     = 0;
+    err_code = ble_conn_params_change_conn_params(&params);
+    if (err_code != NRF_SUCCESS) {
+        APP_LOG("bulk_start: conn_params err=%d", err_code);
+    }
+    app_latency_wake(p_bulk->p_latency);
+
+    err_code = app_timer_cnt_get(&p_bulk->start_tick);
+    APP_ERROR_CHECK(err_code);
+
+    APP_LOG("bulk_start: %d bytes", length);
+    p_bulk->state = APP_BULK_ST_RUN;
+    bulk_fill(p_bulk);
+}
+
+
+/**
+ * @brief 転送終了
+ *
+ * @param[in,out]   p_bulk      一括転送
+ * @param[in]       completed   true:全データ送信完了
+ */
+static void bulk_finish(app_bulk_t *p_bulk, bool completed)
+{
+    uint32_t err_code;
+    uint32_t now;
+
+    p_bulk->state = APP_BULK_ST_IDLE;
+
+    if (completed) {
+        err_code = app_timer_cnt_get(&now);
+        APP_ERROR_CHECK(err_code);
+        app_timer_cnt_diff_compute(now, p_bulk->start_tick, &p_bulk->stats.ticks);
+        p_bulk->stats.bytes = p_bulk->length;
+        if (p_bulk->stats.ticks != 0) {
+            //RTC1は32768Hz
+            p_bulk->stats.bytes_per_sec = (uint16_t)(((uint64_t)p_bulk->stats.bytes * 32768) / p_bulk->stats.ticks);
+        }
+        APP_LOG("bulk_finish: %d bytes/sec, resent=%d",
+                    p_bulk->stats.bytes_per_sec, p_bulk->stats.resent);
+    }
+    else {
+        APP_LOG("bulk_finish: aborted");
+    }
+
+    if (p_bulk->conn_handle != BLE_CONN_HANDLE_INVALID) {
+        //元のパラメータに戻す
+        err_code = ble_conn_params_change_conn_params(&p_bulk->saved_params);
+        if (err_code != NRF_SUCCESS) {
+            APP_LOG("bulk_finish: conn_params err=%d", err_code);
+        }
+    }
+    else {
+        /*
+         * 切断時 : ble_conn_paramsは未接続だと希望値を更新しない(SDK 8.1)。
+         * そのままだと以降の接続でも一括転送用の間隔を要求し続けるので、
+         * PPCPを戻したうえで、次の接続時にble_conn_paramsにも渡す。
+         */
+        err_code = sd_ble_gap_ppcp_set(&p_bulk->saved_params);
+        APP_ERROR_CHECK(err_code);
+        (void)ble_conn_params_change_conn_params(&p_bulk->saved_params);
+        p_bulk->restore_pending = true;
+    }
+}
+
+
+/**
+ * @brief TXバッファが一杯になるまで送信
+ *
+ * @param[in,out]   p_bulk      一括転送
+ */
+static void bulk_fill(app_bulk_t *p_bulk)
+{
+    uint32_t    err_code;
+    uint8_t     pkt[2 + APP_BULK_PAYLOAD];
+    uint32_t    pos;
+    uint16_t    len;
+
+    while ((p_bulk->state == APP_BULK_ST_RUN) &&
+      (p_bulk->next_seq < p_bulk->total) && (p_bulk->next_seq < p_bulk->acked + BULK_WINDOW)) {
+        pos = (uint32_t)p_bulk->next_seq * APP_BULK_PAYLOAD;
+        len = (p_bulk->length - pos > APP_BULK_PAYLOAD) ? APP_BULK_PAYLOAD : (uint16_t)(p_bulk->length - pos);
+
+        pkt[0] = (uint8_t)p_bulk->next_seq;
+        pkt[1] = (uint8_t)(p_bulk->next_seq >> 8);
+        if (p_bulk->p_src->read != NULL) {
+            p_bulk->p_src->read(p_bulk->offset + pos, &pkt[2], len);
+        }
+        else {
+            memcpy(&pkt[2], p_bulk->p_src->p_mem + p_bulk->offset + pos, len);
+        }
+
+        err_code = p_bulk->send(p_bulk, pkt, 2 + len);
+        if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+            //TX_COMPLETEで続きを送る
+            return;
+        }
+        if (err_code != NRF_SUCCESS) {
+            bulk_finish(p_bulk, false);
+            return;
+        }
+        p_bulk->next_seq++;
+    }
+
+    if ((p_bulk->state == APP_BULK_ST_RUN) && (p_bulk->acked == p_bulk->total)) {
+        p_bulk->state = APP_BULK_ST_END;
+    }
+    if (p_bulk->state == APP_BULK_ST_END) {
+        pkt[0] = (uint8_t)p_bulk->total;
+        pkt[1] = (uint8_t)(p_bulk->total >> 8);
+        err_code = p_bulk->send(p_bulk, pkt, 2);
+        if (err_code == NRF_SUCCESS) {
+            bulk_finish(p_bulk, true);
+        }
+        else if (err_code != BLE_ERROR_NO_TX_BUFFERS) {
+            bulk_finish(p_bulk, false);
+        }
+    }
+}
+
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_bulk.h
+ *
+ * 一括転送
+ */
+#ifndef APP_BULK_H__
+#define APP_BULK_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "app_latency.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/*
+ * Inputキャラクタリスティックへのコマンド
+ *   START : [0xB0][source(1)][offset(4)][length(4)]
+ *   ACK   : [0xB1][seq(2)]     seq未満のパケットを受信済み
+ *   NACK  : [0xB2][seq(2)]     seqから送り直し
+ *   ABORT : [0xB3]
+ *
+ * Outputキャラクタリスティックからのパケット
+ *   DATA  : [seq(2)][data(最大18)]
+ *   END   : [seq(2)]           seq = 総パケット数
+ * (数値はリトルエンディアン)
+ */
+#define APP_BULK_CMD_START              (0xB0)
+#define APP_BULK_CMD_ACK                (0xB1)
+#define APP_BULK_CMD_NACK               (0xB2)
+#define APP_BULK_CMD_ABORT              (0xB3)
+
+/** 1パケットのデータ長 */
+#define APP_BULK_PAYLOAD                (18)
+
+/** 登録できるデータ元の数 */
+#define APP_BULK_SOURCE_MAX             (4)
+
+/** app_bulk_on_ble_evt()が扱うイベント(app_evtdisp) */
+#define APP_BULK_BLE_EVTS               BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED, BLE_EVT_TX_COMPLETE
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief データ元の読出し
+ *
+ * @param[in]   offset      読出し位置
+ * @param[out]  p_buf       読出し先
+ * @param[in]   len         読出し長
+ */
+typedef void (*app_bulk_read_t)(uint32_t offset, uint8_t *p_buf, uint16_t len);
+
+
+/** Forward declaration of the app_bulk_t type. */
+typedef struct app_bulk_s app_bulk_t;
+
+
+/**
+ * @brief パケット送信(Notify)
+ *
+ * @param[in]   p_bulk      一括転送
+ * @param[in]   p_data      送信データ
+ * @param[in]   length      送信データ長
+ * @return      sd_ble_gatts_hvx()の戻り値
+ */
+typedef uint32_t (*app_bulk_send_t)(app_bulk_t *p_bulk, const uint8_t *p_data, uint16_t length);
+
+
+/**@brief 転送結果 */
+typedef struct {
+    uint32_t    bytes;              /**< 転送byte数 */
+    uint32_t    ticks;              /**< 所要時間[RTC tick] */
+    uint16_t    resent;             /**< NACKで送り直したパケット数 */
+    uint16_t    bytes_per_sec;      /**< 実効速度[byte/sec] */
+} app_bulk_stats_t;
+
+
+/** @cond */
+typedef enum {
+    APP_BULK_ST_IDLE,
+    APP_BULK_ST_RUN,                /**< データ送信中 */
+    APP_BULK_ST_END                 /**< 全ACK受信済み、ENDパケット送信待ち */
+} app_bulk_state_t;
+
+typedef struct {
+    app_bulk_read_t     read;
+    const uint8_t       *p_mem;     /**< readがNULLならここからコピー */
+    uint32_t            size;
+} app_bulk_source_t;
+/** @endcond */
+
+
+/**
+ * @brief 一括転送
+ *
+ * 接続1つ分の状態。呼出し側で確保し、中身は触らないこと。
+ */
+typedef struct app_bulk_s {
+    app_bulk_send_t         send;
+    app_latency_t           *p_latency;     /**< 転送開始時に起こすslave latency制御 */
+    app_bulk_source_t       sources[APP_BULK_SOURCE_MAX];
+
+    app_bulk_state_t        state;
+    uint16_t                conn_handle;
+    const app_bulk_source_t *p_src;
+    uint32_t                offset;         /**< データ元の開始位置 */
+    uint32_t                length;         /**< 転送byte数 */
+    uint16_t                total;          /**< 総パケット数 */
+    uint16_t                next_seq;       /**< 次に送るパケット */
+    uint16_t                acked;          /**< これ未満は受信確認済み */
+
+    ble_gap_conn_params_t   saved_params;   /**< 転送前のPPCP(終了時に戻す) */
+    bool                    restore_pending;    /**< 切断中に戻したので、次の接続でble_conn_paramsにも渡す */
+
+    uint32_t                start_tick;
+    app_bulk_stats_t        stats;
+} app_bulk_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * @param[out]  p_bulk      一括転送
+ * @param[in]   send        パケット送信関数
+ * @param[in]   p_latency   転送開始時にapp_latency_wake()するslave latency制御
+ */
+void app_bulk_init(app_bulk_t *p_bulk, app_bulk_send_t send, app_latency_t *p_latency);
+
+
+/**@brief データ元登録
+ *
+ * RAM/Flashはどちらもメモリ空間にあるので、app_bulk_mem_source_set()でよい。
+ *
+ * @param[in,out]   p_bulk      一括転送
+ * @param[in]       id          データ元番号(STARTコマンドのsource)
+ * @param[in]       read        読出し関数
+ * @param[in]       size        データ元のサイズ
+ * @retval          NRF_SUCCESS 成功
+ */
+uint32_t app_bulk_source_set(app_bulk_t *p_bulk, uint8_t id, app_bulk_read_t read, uint32_t size);
+
+
+/**@brief データ元登録(メモリ領域)
+ *
+ * @param[in,out]   p_bulk      一括転送
+ * @param[in]       id          データ元番号
+ * @param[in]       p_data      先頭アドレス(RAM/Flash)
+ * @param[in]       size        サイズ
+ * @retval          NRF_SUCCESS 成功
+ */
+uint32_t app_bulk_mem_source_set(app_bulk_t *p_bulk, uint8_t id, const uint8_t *p_data, uint32_t size);
+
+
+/**@brief コマンド処理
+ *
+ * Inputキャラクタリスティックへの書込みを渡す。
+ *
+ * @param[in,out]   p_bulk      一括転送
+ * @param[in]       p_value     受信データ
+ * @param[in]       length      受信データ長
+ * @retval          true        一括転送のコマンドだった
+ */
+bool app_bulk_on_command(app_bulk_t *p_bulk, const uint8_t *p_value, uint16_t length);
+
+
+/**@brief BLEイベントハンドラ
+ *
+ * app_ble_evt_dispatch()から呼び出すこと。
+ *
+ * @param[in,out]   p_bulk      一括転送
+ * @param[in]       p_ble_evt   BLEスタックイベント
+ */
+void app_bulk_on_ble_evt(app_bulk_t *p_bulk, ble_evt_t *p_ble_evt);
+
+
+/**@brief 転送中かどうか
+ *
+ * @param[in]   p_bulk      一括転送
+ * @retval      true        転送中
+ */
+bool app_bulk_is_active(const app_bulk_t *p_bulk);
+
+
+/**@brief 前回の転送結果
+ *
+ * @param[in]   p_bulk      一括転送
+ * @param[out]  p_stats     転送結果
+ */
+void app_bulk_stats_get(const app_bulk_t *p_bulk, app_bulk_stats_t *p_stats);
+
+#endif /* APP_BULK_H__ */
@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_cfg.c
+ *
+ * 設定値保存
+ *
+ * Flashの2ページを交互に使うログ構造のKey-Valueストア。
+ * 値の更新はアクティブページの末尾に追記するだけなので、同じ場所を何度も消去しない。
+ * ページが一杯になったら、もう一方のページを消去して最新値だけをコピーし、
+ * 最後にページヘッダ(magic + 世代番号)を書いて切り替える。
+ * ヘッダを最後に書くので、途中で電源が落ちても古いページが有効なまま残る。
+ *
+ * ページレイアウト:
+ *      [magic][seq][record][record]...[0xFFFFFFFF...]
+ * レコード:
+ *      [key:8 | len:8 | sum:16][value(4byte境界まで0xFF埋め)]
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "nrf_soc.h"
+
+#include "app_cfg.h"
+#include "app_suspend.h"
+
+#include "app_error.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/*
+ * 使用するFlash領域
+ *   ble_app_gcc_nrf51.ldでFLASHの末尾2ページをアプリから外してある。
+ */
+#define CFG_PAGE_SIZE                   (1024)
+#define CFG_PAGE_ADDR(page)             (0x3F800 + (page) * CFG_PAGE_SIZE)
+
+#define CFG_PAGE_MAGIC                  (0x31474643)    /* "CFG1" */
+#define CFG_PAGE_HDR_SIZE               (8)
+#define CFG_ERASED                      (0xFFFFFFFF)
+
+#define CFG_WORDS(len)                  (((len) + 3) / 4)
+#define CFG_REC_SIZE(len)               (4 + CFG_WORDS(len) * 4)
+
+/** Flash操作がエラーになったときの再試行回数 */
+#define CFG_RETRY_MAX                   (3)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** Flash操作の状態 */
+typedef enum {
+    CFG_ST_IDLE,
+    CFG_ST_WRITE,           /**< アクティブページへ追記中 */
+    CFG_ST_ERASE,           /**< コンパクション : 移動先ページ消去中 */
+    CFG_ST_COPY,            /**< コンパクション : 最新値コピー中 */
+    CFG_ST_COMMIT           /**< コンパクション : ページヘッダ書込み中 */
+} cfg_state_t;
+
+
+/** Keyごとの最大長 */
+static const uint8_t                    m_key_size[APP_CFG_KEY_MAX] = {
+    2,      /* APP_CFG_KEY_ADV_INTERVAL */
+    2,      /* APP_CFG_KEY_ADV_TIMEOUT */
+    2,      /* APP_CFG_KEY_CONN_MIN_INTERVAL */
+    2,      /* APP_CFG_KEY_CONN_MAX_INTERVAL */
+    2,      /* APP_CFG_KEY_CONN_SLAVE_LATENCY */
+    2,      /* APP_CFG_KEY_CONN_SUP_TIMEOUT */
+    1,      /* APP_CFG_KEY_SEC_BOND */
+    1,      /* APP_CFG_KEY_SEC_MITM */
+    1,      /* APP_CFG_KEY_SEC_IO_CAPS */
+    1,      /* APP_CFG_KEY_SEC_OOB */
+    1,      /* APP_CFG_KEY_SEC_MIN_KEY_SIZE */
+    1,      /* APP_CFG_KEY_SEC_MAX_KEY_SIZE */
+    APP_CFG_VALUE_MAX,  /* APP_CFG_KEY_DEVICE_NAME */
+};
+
+/*
+ * RAMインデックスとFlashログの位置
+ *   value[key_offset[key]]から最大m_key_size[key]byteが値。
+ *   len[key] == 0は未設定。
+ * System OFFからの復帰時は、Flashを走査せずにapp_suspendから戻す。
+ */
+static struct {
+    uint8_t     key_offset[APP_CFG_KEY_MAX];
+    uint8_t     len[APP_CFG_KEY_MAX];
+    uint8_t     value[2 * 6 + 1 * 6 + APP_CFG_VALUE_MAX];
+    uint8_t     active;         /**< アクティブページ(0/1) */
+    uint16_t    wr_off;         /**< アクティブページの次の書込み位置 */
+    uint32_t    seq;            /**< アクティブページの世代番号 */
+} m_idx;
+
+/* Flashログの状態 */
+static uint32_t                         m_dirty;        /**< Flashに書く必要があるKey(bit) */
+static uint32_t                         m_copy;         /**< コンパクションでコピーするKey(bit) */
+static uint32_t                         m_cmp_dirty;    /**< コンパクション開始時に未書込みだったKey(bit) */
+static uint16_t                         m_cmp_off;      /**< コンパクション先の書込み位置 */
+
+/* 実行中のFlash操作 */
+static cfg_state_t                      m_state = CFG_ST_IDLE;
+static uint8_t                          m_op_key;
+static uint32_t                         *m_op_dst;
+static uint16_t                         m_op_words;
+static uint8_t                          m_op_retry;
+
+/** sd_flash_write()の書込み元(完了まで保持しておく必要がある) */
+static uint32_t                         m_wbuf[1 + CFG_WORDS(APP_CFG_VALUE_MAX)];
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void cfg_scan(void);
+static bool cfg_can_save(void);
+static void load_page(uint8_t page);
+static bool page_valid(uint8_t page, uint32_t *p_seq);
+static uint16_t rec_sum(uint8_t key, uint8_t len, const uint8_t *p_value);
+static void set_ram(uint8_t key, const uint8_t *p_value, uint8_t len);
+static void kick(void);
+static void copy_next(void);
+static void write_record(uint32_t addr, uint8_t key);
+static void flash_exec(void);
+static void abort_op(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_cfg_init(void)
+{
+    m_dirty = 0;
+    m_copy = 0;
+    m_state = CFG_ST_IDLE;
+
+    //System OFFからの復帰ならFlashを走査しない
+    if (app_suspend_attach(APP_SUSPEND_ID_CFG, &m_idx, sizeof(m_idx), cfg_can_save)) {
+        return;
+    }
+    cfg_scan();
+}
+
+
+const uint8_t *app_cfg_get(app_cfg_key_t key, uint16_t *p_len)
+{
+    if ((key >= APP_CFG_KEY_MAX) || (m_idx.len[key] == 0)) {
+        return NULL;
+    }
+    if (p_len != NULL) {
+        *p_len = m_idx.len[key];
+    }
+    return &m_idx.value[m_idx.key_offset[key]];
+}
+
+
+uint8_t app_cfg_get_u8(app_cfg_key_t key, uint8_t def)
+{
+    uint16_t len;
+    const uint8_t *p = app_cfg_get(key, &len);
+
+    return ((p != NULL) && (len == 1)) ? p[0] : def;
+}
+
+
+uint16_t app_cfg_get_u16(app_cfg_key_t key, uint16_t def)
+{
+    uint16_t len;
+    const uint8_t *p = app_cfg_get(key, &len);
+
+    //リトルエンディアン
+    return ((p != NULL) && (len == 2)) ? (uint16_t)(p[0] | (p[1] << 8)) : def;
+}
+
+
+uint32_t app_cfg_set(app_cfg_key_t key, const uint8_t *p_value, uint16_t len)
+{
+    if (key >= APP_CFG_KEY_MAX) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (len > m_key_size[key]) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if ((len == m_idx.len[key]) && (memcmp(&m_idx.value[m_idx.key_offset[key]], p_value, len) == 0)) {
+        //変化無し : Flashを消耗させない
+        return NRF_SUCCESS;
+    }
+
+    set_ram(key, p_value, (uint8_t)len);
+    m_dirty |= (1UL << key);
+    kick();
+
+    return NRF_SUCCESS;
+}
+
+
+bool app_cfg_is_busy(void)
+{
+    return (m_state != CFG_ST_IDLE) || (m_dirty != 0);
+}
+
+
+void app_cfg_on_sys_evt(uint32_t sys_evt)
+{
+    if (m_state == CFG_ST_IDLE) {
+        //BUSYで中断していれば、他のFlash操作が終わったところで再開する
+        if ((sys_evt == NRF_EVT_FLASH_OPERATION_SUCCESS) || (sys_evt == NRF_EVT_FLASH_OPERATION_ERROR)) {
+            kick();
+        }
+        return;
+    }
+
+    if (sys_evt == NRF_EVT_FLASH_OPERATION_ERROR) {
+        //Radioとの競合で失敗することがあるので再試行する
+        if (m_op_retry < CFG_RETRY_MAX) {
+            m_op_retry++;
+            flash_exec();
+        }
+        else {
+            abort_op();
+        }
+        return;
+    }
+    if (sys_evt != NRF_EVT_FLASH_OPERATION_SUCCESS) {
+        return;
+    }
+
+    switch (m_state) {
+    case CFG_ST_WRITE:
+        //書込み中に長さが変わることがあるので、RAMインデックスではなく書いたレコードの長さで進める
+        m_idx.wr_off += m_op_words * 4;
+        m_state = CFG_ST_IDLE;
+        kick();
+        break;
+
+    case CFG_ST_ERASE:
+        {
+            uint8_t key;
+
+            //移動先には最新値を書くので、未書込みの更新もまとめて反映される
+            m_copy = 0;
+            for (key = 0; key < APP_CFG_KEY_MAX; key++) {
+                if (m_idx.len[key] != 0) {
+                    m_copy |= (1UL << key);
+                }
+            }
+            m_cmp_dirty = m_dirty;
+            m_dirty = 0;
+            m_cmp_off = CFG_PAGE_HDR_SIZE;
+            copy_next();
+        }
+        break;
+
+    case CFG_ST_COPY:
+        m_cmp_off += m_op_words * 4;
+        copy_next();
+        break;
+
+    case CFG_ST_COMMIT:
+        m_idx.active ^= 1;
+        m_idx.seq++;
+        m_idx.wr_off = m_cmp_off;
+        m_state = CFG_ST_IDLE;
+        kick();
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief Flash走査
+ *
+ * 有効なページのうち新しい方を読み込んで、RAMインデックスを作る。
+ */
+static void cfg_scan(void)
+{
+    uint8_t key;
+    uint8_t offset = 0;
+    uint32_t seq0;
+    uint32_t seq1;
+    bool valid0;
+    bool valid1;
+
+    for (key = 0; key < APP_CFG_KEY_MAX; key++) {
+        m_idx.key_offset[key] = offset;
+        offset += m_key_size[key];
+        m_idx.len[key] = 0;
+    }
+    APP_ERROR_CHECK_BOOL(offset <= sizeof(m_idx.value));
+
+    valid0 = page_valid(0, &seq0);
+    valid1 = page_valid(1, &seq1);
+    if (valid0 && (!valid1 || ((int32_t)(seq0 - seq1) > 0))) {
+        m_idx.active = 0;
+        m_idx.seq = seq0;
+        load_page(0);
+    }
+    else if (valid1) {
+        m_idx.active = 1;
+        m_idx.seq = seq1;
+        load_page(1);
+    }
+    else {
+        //有効なページが無い : 最初の書込みでページ0へコンパクションさせる
+        m_idx.active = 1;
+        m_idx.seq = 0;
+        m_idx.wr_off = CFG_PAGE_SIZE;
+    }
+}
+
+
+/**
+ * @brief System OFF前の保存可否
+ *
+ * 書込み待ち/書込み中があると、保存したインデックスとFlashが一致しないので保存しない。
+ *
+ * @retval  true    保存してよい
+ */
+static bool cfg_can_save(void)
+{
+    return !app_cfg_is_busy();
+}
+
+
+/**
+ * @brief ページヘッダ確認
+ *
+ * @param[in]   page    ページ(0/1)
+ * @param[out]  p_seq   世代番号
+ * @retval      true    有効なページ
+ */
+static bool page_valid(uint8_t page, uint32_t *p_seq)
+{
+    const uint32_t *p_hdr = (const uint32_t *)CFG_PAGE_ADDR(page);
+
+    *p_seq = p_hdr[1];
+    return p_hdr[0] == CFG_PAGE_MAGIC;
+}
+
+
+/**
+ * @brief ページ読込み
+ *
+ * レコードを先頭から順に適用し、後のものほど新しい値とする。
+ * 壊れたレコードを見つけたらそこで打ち切り、次の書込みでコンパクションさせる。
+ *
+ * @param[in]   page    ページ(0/1)
+ */
+static void load_page(uint8_t page)
+{
+    const uint8_t *p_page = (const uint8_t *)CFG_PAGE_ADDR(page);
+    uint16_t off = CFG_PAGE_HDR_SIZE;
+
+    while (off + 4 <= CFG_PAGE_SIZE) {
+        uint32_t hdr = *(const uint32_t *)(p_page + off);
+        uint8_t key = (uint8_t)hdr;
+        uint8_t len = (uint8_t)(hdr >> 8);
+
+        if (hdr == CFG_ERASED) {
+            break;
+        }
+        if ((key >= APP_CFG_KEY_MAX) || (len > m_key_size[key]) ||
+          (off + CFG_REC_SIZE(len) > CFG_PAGE_SIZE) ||
+          ((uint16_t)(hdr >> 16) != rec_sum(key, len, p_page + off + 4))) {
+            off = CFG_PAGE_SIZE;
+            break;
+        }
+        set_ram(key, p_page + off + 4, len);
+        off += CFG_REC_SIZE(len);
+    }
+    m_idx.wr_off = off;
+}
+
+
+/**
+ * @brief レコードのチェックサム
+ *
+ * 書込み途中の電源断で中途半端に残ったレコードを検出するため。
+ */
+static uint16_t rec_sum(uint8_t key, uint8_t len, const uint8_t *p_value)
+{
+    uint16_t sum = 0x5A00 + key + len;
+    uint8_t lp;
+
+    for (lp = 0; lp < len; lp++) {
+        sum = (uint16_t)((sum << 1) | (sum >> 15)) + p_value[lp];
+    }
+    return sum;
+}
+
+
+/**
+ * @brief RAMインデックス更新
+ */
+static void set_ram(uint8_t key, const uint8_t *p_value, uint8_t len)
+{
+    memcpy(&m_idx.value[m_idx.key_offset[key]], p_value, len);
+    m_idx.len[key] = len;
+}
+
+
+/**
+ * @brief 未書込みのKeyがあればFlash操作を開始する
+ */
+static void kick(void)
+{
+    uint8_t key;
+
+    if ((m_state != CFG_ST_IDLE) || (m_dirty == 0)) {
+        return;
+    }
+
+    for (key = 0; (m_dirty & (1UL << key)) == 0; key++) {
+        ;
+    }
+
+    if (m_idx.wr_off + CFG_REC_SIZE(m_idx.len[key]) > CFG_PAGE_SIZE) {
+        //アクティブページが一杯 : もう一方へコンパクション
+        m_state = CFG_ST_ERASE;
+        m_op_dst = (uint32_t *)CFG_PAGE_ADDR(m_idx.active ^ 1);
+        m_op_retry = 0;
+        flash_exec();
+        return;
+    }
+
+    //書込み中に再度更新されたら、また立つ
+    m_dirty &= ~(1UL << key);
+    m_state = CFG_ST_WRITE;
+    write_record(CFG_PAGE_ADDR(m_idx.active) + m_idx.wr_off, key);
+}
+
+
+/**
+ * @brief コンパクション : 次のKeyをコピー、終わればページヘッダを書く
+ */
+static void copy_next(void)
+{
+    uint8_t key;
+    uint32_t target = CFG_PAGE_ADDR(m_idx.active ^ 1);
+
+    for (key = 0; key < APP_CFG_KEY_MAX; key++) {
+        if (m_copy & (1UL << key)) {
+            m_copy &= ~(1UL << key);
+            if (m_idx.len[key] != 0) {
+                m_state = CFG_ST_COPY;
+                write_record(target + m_cmp_off, key);
+                return;
+            }
+        }
+    }
+
+    m_wbuf[0] = CFG_PAGE_MAGIC;
+    m_wbuf[1] = m_idx.seq + 1;
+    m_state = CFG_ST_COMMIT;
+    m_op_dst = (uint32_t *)target;
+    m_op_words = CFG_PAGE_HDR_SIZE / 4;
+    m_op_retry = 0;
+    flash_exec();
+}
+
+
+/**
+ * @brief レコード書込み開始
+ *
+ * @param[in]   addr    書込み先アドレス
+ * @param[in]   key     設定Key
+ */
+static void write_record(uint32_t addr, uint8_t key)
+{
+    uint8_t len = m_idx.len[key];
+    const uint8_t *p_value = &m_idx.value[m_idx.key_offset[key]];
+
+    memset(m_wbuf, 0xff, sizeof(m_wbuf));
+    m_wbuf[0] = key | ((uint32_t)len << 8) | ((uint32_t)rec_sum(key, len, p_value) << 16);
+    memcpy(&m_wbuf[1], p_value, len);
+
+    m_op_key = key;
+    m_op_dst = (uint32_t *)addr;
+    m_op_words = 1 + CFG_WORDS(len);
+    m_op_retry = 0;
+    flash_exec();
+}
+
+
+/**
+ * @brief 現在のFlash操作をSoftDeviceに要求する
+ *
+ * 完了はNRF_EVT_FLASH_OPERATION_xxxでapp_cfg_on_sys_evt()に通知される。
+ */
+static void flash_exec(void)
+{
+    uint32_t err_code;
+
+    if (m_state == CFG_ST_ERASE) {
+        err_code = sd_flash_page_erase((uint32_t)m_op_dst / CFG_PAGE_SIZE);
+    }
+    else {
+        err_code = sd_flash_write(m_op_dst, m_wbuf, m_op_words);
+    }
+    if (err_code == NRF_ERROR_BUSY) {
+        //他のFlash操作中 : その完了イベントでapp_cfg_on_sys_evt()から再開する
+        abort_op();
+        return;
+    }
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**
+ * @brief Flash操作の中断
+ *
+ * 書けなかった更新はm_dirtyに戻す。
+ * コンパクション中なら移動先は次回消去し直すので、アクティブページはそのまま使える。
+ */
+static void abort_op(void)
+{
+    switch (m_state) {
+    case CFG_ST_WRITE:
+        m_dirty |= (1UL << m_op_key);
+        break;
+
+    case CFG_ST_COPY:
+    case CFG_ST_COMMIT:
+        m_dirty |= m_cmp_dirty;
+        m_copy = 0;
+        break;
+
+    default:
+        break;
+    }
+    m_state = CFG_ST_IDLE;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_cfg.h
+ *
+ * 設定値保存(Flash上のログ構造Key-Value)
+ */
+#ifndef APP_CFG_H__
+#define APP_CFG_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 1つのKeyに保存できる最大byte数 */
+#define APP_CFG_VALUE_MAX               (20)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief 設定Key
+ *
+ * Flashに記録されるので、値の再割り当てはしないこと(追加は末尾に)。
+ */
+typedef enum {
+    APP_CFG_KEY_ADV_INTERVAL,           /**< Advertising間隔[msec] : uint16_t */
+    APP_CFG_KEY_ADV_TIMEOUT,            /**< Advertisingタイムアウト[sec] : uint16_t */
+    APP_CFG_KEY_CONN_MIN_INTERVAL,      /**< PPCP 最小間隔[msec] : uint16_t */
+    APP_CFG_KEY_CONN_MAX_INTERVAL,      /**< PPCP 最大間隔[msec] : uint16_t */
+    APP_CFG_KEY_CONN_SLAVE_LATENCY,     /**< PPCP slave latency : uint16_t */
+    APP_CFG_KEY_CONN_SUP_TIMEOUT,       /**< PPCP connSupervisionTimeout[msec] : uint16_t */
+    APP_CFG_KEY_SEC_BOND,               /**< 1:Bondingあり 0:なし : uint8_t */
+    APP_CFG_KEY_SEC_MITM,               /**< 1:MITMあり 0:なし : uint8_t */
+    APP_CFG_KEY_SEC_IO_CAPS,            /**< IO能力 : uint8_t */
+    APP_CFG_KEY_SEC_OOB,                /**< 1:OOBあり 0:なし : uint8_t */
+    APP_CFG_KEY_SEC_MIN_KEY_SIZE,       /**< 符号化鍵サイズ最小 : uint8_t */
+    APP_CFG_KEY_SEC_MAX_KEY_SIZE,       /**< 符号化鍵サイズ最大 : uint8_t */
+    APP_CFG_KEY_DEVICE_NAME,            /**< デバイス名(UTF-8, \0無し) */
+    //
+    APP_CFG_KEY_MAX
+} app_cfg_key_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * Flashのログを走査してRAMインデックスを作る。
+ * System OFFからの復帰時は、走査せずにapp_suspendが保持していたインデックスを使う。
+ * sd_flash_xxx()を使うので、SoftDevice有効化後に呼ぶこと。
+ */
+void app_cfg_init(void);
+
+
+/**@brief 値取得
+ *
+ * RAMインデックスから読むだけなので、Keyの数によらず一定時間で終わる。
+ *
+ * @param[in]   key         設定Key
+ * @param[out]  p_len       値の長さ(NULL可)
+ * @return      値へのポインタ(未設定ならNULL)
+ */
+const uint8_t *app_cfg_get(app_cfg_key_t key, uint16_t *p_len);
+
+
+/**@brief 値取得(uint8_t)
+ *
+ * @param[in]   key         設定Key
+ * @param[in]   def         未設定時の値
+ * @return      設定値
+ */
+uint8_t app_cfg_get_u8(app_cfg_key_t key, uint8_t def);
+
+
+/**@brief 値取得(uint16_t)
+ *
+ * @param[in]   key         設定Key
+ * @param[in]   def         未設定時の値
+ * @return      設定値
+ */
+uint16_t app_cfg_get_u16(app_cfg_key_t key, uint16_t def);
+
+
+/**@brief 値設定
+ *
+ * RAMインデックスは即座に更新し、Flashへの追記はバックグラウンドで行う。
+ *
+ * @param[in]   key         設定Key
+ * @param[in]   p_value     値
+ * @param[in]   len         値の長さ(APP_CFG_VALUE_MAX以下)
+ * @retval      NRF_SUCCESS 成功
+ * @retval      NRF_ERROR_INVALID_PARAM     keyが範囲外
+ * @retval      NRF_ERROR_INVALID_LENGTH    lenが長すぎる
+ */
+uint32_t app_cfg_set(app_cfg_key_t key, const uint8_t *p_value, uint16_t len);
+
+
+/**@brief Flash書込み中かどうか
+ *
+ * @retval  true    書込み待ち/書込み中の値がある
+ */
+bool app_cfg_is_busy(void);
+
+
+/**@brief システムイベント
+ *
+ * main_sys_evt_dispatch()から呼び出すこと(Flash操作完了通知)。
+ *
+ * @param[in]   sys_evt     NRF_EVT_xxx
+ */
+void app_cfg_on_sys_evt(uint32_t sys_evt);
+
+#endif /* APP_CFG_H__ */
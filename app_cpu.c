@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_cpu.c
+ *
+ * CPU使用率
+ *
+ * メインループのsd_app_evt_wait()の前後で時刻を取り、起きていた時間と寝ていた時間を積算する。
+ * このアプリはBLEイベントを割込み(SWI2)で処理するので、寝ている間の割込み処理時間は
+ * app_cpu_irq_add()で受け取って、起きていた時間に移す。
+ * 時刻はapp_ts_now()を使う(通常はRTCの分解能で、窓1秒に対しては十分)。
+ *
+ * 集計用のタイマは使わず、起床時に窓の時間が過ぎていれば閉じる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_cpu.h"
+#include "app_ts.h"
+
+#include "app_util_platform.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define AVG(avg, val)                   ((uint16_t)((avg) + (((int32_t)(val) - (int32_t)(avg)) >> APP_CPU_AVG_SHIFT)))
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static app_cpu_report_t                 m_report;
+static bool                             m_updated;
+static bool                             m_first = true;
+
+static uint32_t                         m_window_start;
+static uint32_t                         m_sleep_start;
+static uint32_t                         m_sleep_us;     /**< 窓内で寝ていた時間 */
+static uint32_t                         m_wakeups;      /**< 窓内の起床回数 */
+static uint32_t                         m_events_last;  /**< 窓の開始時のm_events */
+
+static volatile bool                    m_sleeping;
+static volatile uint32_t                m_irq_us;       /**< 寝ている間の割込み処理時間 */
+static volatile uint32_t                m_events;       /**< 積んだイベント数(フリーラン) */
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void window_close(uint32_t now);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_cpu_sleep(void)
+{
+    m_sleep_start = app_ts_now();
+    m_sleeping = true;
+}
+
+
+void app_cpu_wake(void)
+{
+    uint32_t now = app_ts_now();
+    uint32_t slept;
+    uint32_t irq;
+
+    CRITICAL_REGION_ENTER();
+    m_sleeping = false;
+    irq = m_irq_us;
+    m_irq_us = 0;
+    CRITICAL_REGION_EXIT();
+
+    if (m_first) {
+        //最初の1回は窓の開始にするだけ
+        m_first = false;
+        m_window_start = now;
+        m_events_last = m_events;
+        return;
+    }
+
+    slept = now - m_sleep_start;
+    m_sleep_us += (irq < slept) ? slept - irq : 0;
+    m_wakeups++;
+
+    if (now - m_window_start >= APP_CPU_WINDOW_US) {
+        window_close(now);
+    }
+}
+
+
+void app_cpu_irq_add(uint32_t us)
+{
+    CRITICAL_REGION_ENTER();
+    if (m_sleeping) {
+        m_irq_us += us;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+void app_cpu_sched_put(void)
+{
+    CRITICAL_REGION_ENTER();
+    m_events++;
+    CRITICAL_REGION_EXIT();
+}
+
+
+bool app_cpu_poll(void)
+{
+    bool updated = m_updated;
+
+    m_updated = false;
+    return updated;
+}
+
+
+void app_cpu_report_get(app_cpu_report_t *p_report)
+{
+    memcpy(p_report, &m_report, sizeof(app_cpu_report_t));
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 窓を閉じて集計する
+ *
+ * @param[in]   now     現在時刻[usec]
+ */
+static void window_close(uint32_t now)
+{
+    uint32_t window = now - m_window_start;
+    uint32_t active = (m_sleep_us < window) ? window - m_sleep_us : 0;
+    uint32_t events = m_events - m_events_last;
+    bool first = (m_report.window_us == 0);
+
+    m_report.window_us = window;
+    m_report.active_us = active;
+    m_report.load = (uint16_t)(((uint64_t)active * 1000) / window);
+    m_report.wakeups = (uint16_t)(((uint64_t)m_wakeups * 1000000) / window);
+    m_report.events = (uint16_t)((events * 100) / m_wakeups);
+    if (first) {
+        m_report.load_avg = m_report.load;
+        m_report.wakeups_avg = m_report.wakeups;
+        m_report.events_avg = m_report.events;
+    }
+    else {
+        m_report.load_avg = AVG(m_report.load_avg, m_report.load);
+        m_report.wakeups_avg = AVG(m_report.wakeups_avg, m_report.wakeups);
+        m_report.events_avg = AVG(m_report.events_avg, m_report.events);
+    }
+    m_updated = true;
+
+    m_window_start = now;
+    m_events_last += events;
+    m_sleep_us = 0;
+    m_wakeups = 0;
+}
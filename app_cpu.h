@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_cpu.h
+ *
+ * CPU使用率
+ */
+#ifndef APP_CPU_H__
+#define APP_CPU_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 集計窓[usec] */
+#define APP_CPU_WINDOW_US               (1000000UL)
+
+/** 移動平均の重み(1/2^n) */
+#define APP_CPU_AVG_SHIFT               (3)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief レポート
+ *
+ * 診断サービスのCpuキャラクタリスティックにこのままリトルエンディアンで載せる。
+ * xxx_avgは窓ごとの値の指数移動平均。
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t    load;               /**< 直近の窓のCPU使用率[0.1%] */
+    uint16_t    load_avg;           /**< 移動平均[0.1%] */
+    uint16_t    wakeups;            /**< 直近の窓の起床回数[回/sec] */
+    uint16_t    wakeups_avg;        /**< 移動平均[回/sec] */
+    uint16_t    events;             /**< 直近の窓の1起床あたりのスケジューライベント数[1/100] */
+    uint16_t    events_avg;         /**< 移動平均[1/100] */
+    uint32_t    active_us;          /**< 直近の窓の起きていた時間[usec] */
+    uint32_t    window_us;          /**< 直近の窓の長さ[usec] */
+} app_cpu_report_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief スリープ直前
+ *
+ * drv_event_exec()でsd_app_evt_wait()の直前に呼ぶ。
+ */
+void app_cpu_sleep(void);
+
+
+/**@brief 起床直後
+ *
+ * drv_event_exec()でsd_app_evt_wait()の直後に呼ぶ。
+ * 窓の時間が経っていれば集計する。
+ */
+void app_cpu_wake(void);
+
+
+/**@brief 割込み内の処理時間
+ *
+ * スリープ中に割込みで処理した時間は、起きていた時間に足す。
+ * 割込みからも呼べる。
+ *
+ * @param[in]   us          処理時間[usec]
+ */
+void app_cpu_irq_add(uint32_t us);
+
+
+/**@brief スケジューラにイベントを積んだ
+ *
+ * app_sched_event_put()の後に呼ぶ。割込みからも呼べる。
+ */
+void app_cpu_sched_put(void);
+
+
+/**@brief 集計が更新されたかどうか
+ *
+ * 前回呼んでから窓を閉じていればtrue。
+ *
+ * @retval      true        更新された
+ */
+bool app_cpu_poll(void);
+
+
+/**@brief レポート取得
+ *
+ * @param[out]  p_report    レポート
+ */
+void app_cpu_report_get(app_cpu_report_t *p_report);
+
+#endif /* APP_CPU_H__ */
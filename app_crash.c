@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_crash.c
+ *
+ * クラッシュ記録
+ *
+ * APP_ERROR_CHECK()やHardFaultで止まる代わりに、保持RAM(.noinit)へ記録してリセットする。
+ * .noinitはリンカスクリプトでRAM末尾に置き、スタートアップで初期化されない。
+ * 電源投入直後は中身が不定なので、マジックとチェックサムで有効かどうかを判定する。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "nrf.h"
+
+#include "app_crash.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CRASH_MAGIC                     (0x43524153)    //"CRAS"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    uint32_t            magic;
+    uint32_t            pending;    /**< 1:リセット後にまだ起動していない */
+    uint32_t            check;      /**< recordのチェックサム */
+    app_crash_record_t  record;
+} retained_t;
+
+static retained_t                       m_retained __attribute__((section(".noinit")));
+
+static bool                             m_valid;
+static bool                             m_warm_boot;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint32_t checksum(const app_crash_record_t *p_record);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_crash_init(void)
+{
+    m_valid = (m_retained.magic == CRASH_MAGIC) &&
+              (m_retained.check == checksum(&m_retained.record));
+    if (!m_valid) {
+        memset(&m_retained, 0, sizeof(m_retained));
+        return;
+    }
+    m_warm_boot = (m_retained.pending != 0);
+    m_retained.pending = 0;
+}
+
+
+bool app_crash_is_warm_boot(void)
+{
+    return m_warm_boot;
+}
+
+
+void app_crash_boot_time_set(uint32_t boot_us)
+{
+    if (m_warm_boot) {
+        m_retained.record.boot_us = boot_us;
+        m_retained.check = checksum(&m_retained.record);
+    }
+}
+
+
+const app_crash_record_t *app_crash_get(void)
+{
+    return (m_valid) ? &m_retained.record : NULL;
+}
+
+
+void app_crash_reset(uint32_t error_code, uint32_t line, const uint8_t *p_file,
+                        uint32_t pc, uint32_t lr, const uint32_t *p_sp)
+{
+    app_crash_record_t *p_record = &m_retained.record;
+    uint16_t count;
+    size_t len;
+
+    count = p_record->count;    //無効な記録はapp_crash_init()で0クリア済み
+    memset(p_record, 0, sizeof(app_crash_record_t));
+    p_record->error_code = error_code;
+    p_record->line = line;
+    p_record->pc = pc;
+    p_record->lr = lr;
+    if (p_sp != NULL) {
+        memcpy(p_record->stack, p_sp, sizeof(p_record->stack));
+    }
+    if (p_file != NULL) {
+        //パスは長いので末尾だけ残す
+        len = strlen((const char *)p_file);
+        if (len > APP_CRASH_FILE_LEN) {
+            p_file += len - APP_CRASH_FILE_LEN;
+            len = APP_CRASH_FILE_LEN;
+        }
+        memcpy(p_record->file, p_file, len);
+    }
+    p_record->count = count + 1;
+    app_mem_report_get(&p_record->mem);
+
+    m_retained.magic = CRASH_MAGIC;
+    m_retained.pending = 1;
+    m_retained.check = checksum(p_record);
+
+    NVIC_SystemReset();
+    while (1) {
+        //ここには来ない
+    }
+}
+
+
+/**
+ * @brief HardFault
+ *
+ * 例外フレーム(r0-r3, r12, lr, pc, xPSR)からPC/LRを取り出して記録する。
+ * このアプリはMSPしか使わない。
+ */
+void HardFault_Handler(void) __attribute__((naked));
+void HardFault_Handler(void)
+{
+    __asm volatile(
+        "   mrs     r0, msp             \n"
+        "   bl      app_crash_on_hardfault  \n"
+    );
+}
+
+
+/**
+ * @brief HardFault(C側)
+ *
+ * @param[in]   p_frame     例外フレーム
+ */
+void app_crash_on_hardfault(const uint32_t *p_frame) __attribute__((used, noreturn));
+void app_crash_on_hardfault(const uint32_t *p_frame)
+{
+    app_crash_reset(APP_CRASH_HARDFAULT, 0, NULL, p_frame[6], p_frame[5], p_frame + 8);
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief チェックサム
+ *
+ * @param[in]   p_record    記録
+ * @return      チェックサム
+ */
+static uint32_t checksum(const app_crash_record_t *p_record)
+{
+    const uint8_t *p = (const uint8_t *)p_record;
+    uint32_t sum = CRASH_MAGIC;
+    uint16_t lp;
+
+    for (lp = 0; lp < sizeof(app_crash_record_t); lp++) {
+        sum = (sum << 1 | sum >> 31) + p[lp];
+    }
+    return sum;
+}
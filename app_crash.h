@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_crash.h
+ *
+ * クラッシュ記録
+ */
+#ifndef APP_CRASH_H__
+#define APP_CRASH_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_mem.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** スタックのスナップショット[word] */
+#define APP_CRASH_STACK_WORDS           (6)
+
+/** ファイル名(末尾)の保存byte数 */
+#define APP_CRASH_FILE_LEN              (12)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief クラッシュ記録
+ *
+ * 診断キャラクタリスティックにはこのままリトルエンディアンで載せる(Read Longで読む)。
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t    error_code;     /**< エラーコード(HardFaultは0xFFFFFFFF) */
+    uint32_t    line;           /**< 行番号 */
+    uint32_t    pc;             /**< PC(APP_ERROR_CHECK()ではapp_error_handler()の戻り先) */
+    uint32_t    lr;             /**< LR(HardFaultのみ) */
+    uint32_t    stack[APP_CRASH_STACK_WORDS];   /**< SPからのスナップショット */
+    char        file[APP_CRASH_FILE_LEN];       /**< ファイル名の末尾(\0終端とは限らない) */
+    uint16_t    count;          /**< クラッシュ回数(電源断でクリア) */
+    uint32_t    boot_us;        /**< 再起動からAdvertising開始まで[usec] */
+    app_mem_report_t    mem;    /**< クラッシュ時のメモリレポート */
+} app_crash_record_t;
+
+
+/** HardFaultのエラーコード */
+#define APP_CRASH_HARDFAULT             (0xFFFFFFFF)
+
+/** WDT満了のエラーコード(app_budget) */
+#define APP_CRASH_WDT                   (0xFFFFFFFE)
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * main()の先頭で呼ぶ。保持RAMの記録を確認する。
+ */
+void app_crash_init(void);
+
+
+/**@brief クラッシュからの再起動かどうか
+ *
+ * @retval  true    直前のリセットはapp_crash_reset()によるもの
+ */
+bool app_crash_is_warm_boot(void);
+
+
+/**@brief 再起動からAdvertising開始までの時間を記録
+ *
+ * クラッシュからの再起動でなければ何もしない。
+ *
+ * @param[in]   boot_us     再起動からAdvertising開始まで[usec]
+ */
+void app_crash_boot_time_set(uint32_t boot_us);
+
+
+/**@brief クラッシュ記録取得
+ *
+ * @return  記録(無ければNULL)
+ */
+const app_crash_record_t *app_crash_get(void);
+
+
+/**@brief 記録してリセット
+ *
+ * @param[in]   error_code      エラーコード
+ * @param[in]   line            行番号
+ * @param[in]   p_file          ファイル名(NULL可)
+ * @param[in]   pc              PC
+ * @param[in]   lr              LR
+ * @param[in]   p_sp            スタック(NULL可)
+ */
+void app_crash_reset(uint32_t error_code, uint32_t line, const uint8_t *p_file,
+                        uint32_t pc, uint32_t lr, const uint32_t *p_sp) __attribute__((noreturn));
+
+#endif /* APP_CRASH_H__ */
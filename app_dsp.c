@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_dsp.c
+ *
+ * 固定小数点の信号処理
+ *
+ * Cortex-M0にはFPUも割り算命令も無いので、Q15の整数演算とシフトだけで作る。
+ * 生のサンプルをBLEで送るより、ここで減らしてから送る方が電流が少ない。
+ *   サンプル → app_dsp_xxx_put() → app_pack_put()
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_dsp.h"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+const int16_t app_dsp_fir_lp4[APP_DSP_FIR_LP4_TAPS] = {
+      -42,  -177,  -406,  -352,   669,  2961,  5846,  7885,
+     7885,  5846,  2961,   669,  -352,  -406,  -177,   -42,
+};
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static int16_t saturate(int32_t x);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+/**********************************************
+ * 移動平均
+ **********************************************/
+
+void app_dsp_ma_init(app_dsp_ma_t *p_ma, int16_t *p_buf, uint8_t shift)
+{
+    p_ma->p_buf = p_buf;
+    p_ma->shift = shift;
+    p_ma->pos = 0;
+    p_ma->sum = 0;
+    memset(p_buf, 0, sizeof(int16_t) << shift);
+}
+
+
+int16_t app_dsp_ma_put(app_dsp_ma_t *p_ma, int16_t x)
+{
+    //窓から出るサンプルを引いて、入るサンプルを足す
+    p_ma->sum += x - p_ma->p_buf[p_ma->pos];
+    p_ma->p_buf[p_ma->pos] = x;
+    p_ma->pos = (p_ma->pos + 1) & ((1 << p_ma->shift) - 1);
+    return (int16_t)(p_ma->sum >> p_ma->shift);
+}
+
+
+/**********************************************
+ * デシメーションFIR
+ **********************************************/
+
+void app_dsp_fir_init(app_dsp_fir_t *p_fir, const int16_t *p_coef, int16_t *p_buf,
+                        uint16_t taps, uint8_t decim)
+{
+    p_fir->p_coef = p_coef;
+    p_fir->p_buf = p_buf;
+    p_fir->taps = taps;
+    p_fir->pos = 0;
+    p_fir->decim = decim;
+    p_fir->phase = decim;
+    memset(p_buf, 0, sizeof(int16_t) * taps);
+}
+
+
+bool app_dsp_fir_put(app_dsp_fir_t *p_fir, int16_t x, int16_t *p_y)
+{
+    const int16_t *p_coef = p_fir->p_coef;
+    const int16_t *p_buf = p_fir->p_buf;
+    int32_t  acc = 0;
+    uint16_t newest = p_fir->pos;
+    uint16_t lp;
+
+    p_fir->p_buf[newest] = x;
+    p_fir->pos = (newest + 1 == p_fir->taps) ? 0 : newest + 1;
+    if (--p_fir->phase != 0) {
+        //出力しない入力では積和しない
+        return false;
+    }
+    p_fir->phase = p_fir->decim;
+
+    //係数[0]が最新のサンプル。剰余を使わないよう、リングの折り返しで2回に分ける
+    for (lp = 0; lp <= newest; lp++) {
+        acc += (int32_t)p_coef[lp] * p_buf[newest - lp];
+    }
+    for (; lp < p_fir->taps; lp++) {
+        acc += (int32_t)p_coef[lp] * p_buf[p_fir->taps + newest - lp];
+    }
+    *p_y = saturate((acc + (1 << 14)) >> 15);
+    return true;
+}
+
+
+/**********************************************
+ * デシメーションCIC
+ **********************************************/
+
+void app_dsp_cic_init(app_dsp_cic_t *p_cic, uint8_t order, uint8_t decim_shift)
+{
+    memset(p_cic, 0, sizeof(app_dsp_cic_t));
+    p_cic->order = order;
+    p_cic->decim_shift = decim_shift;
+}
+
+
+bool app_dsp_cic_put(app_dsp_cic_t *p_cic, int16_t x, int16_t *p_y)
+{
+    uint32_t v = (uint32_t)(int32_t)x;
+    uint32_t prev;
+    uint8_t  lp;
+
+    for (lp = 0; lp < p_cic->order; lp++) {
+        p_cic->integ[lp] += v;
+        v = p_cic->integ[lp];
+    }
+    if (++p_cic->count < (1UL << p_cic->decim_shift)) {
+        return false;
+    }
+    p_cic->count = 0;
+
+    //出力レートで櫛形フィルタ(2の補数の折り返しは、ここで打ち消される)
+    for (lp = 0; lp < p_cic->order; lp++) {
+        prev = p_cic->comb[lp];
+        p_cic->comb[lp] = v;
+        v -= prev;
+    }
+    *p_y = (int16_t)((int32_t)v >> (p_cic->order * p_cic->decim_shift));
+    return true;
+}
+
+
+/**********************************************
+ * 窓統計
+ **********************************************/
+
+void app_dsp_stats_init(app_dsp_stats_t *p_stats, uint8_t shift)
+{
+    p_stats->shift = shift;
+    p_stats->count = 0;
+    p_stats->min = INT16_MAX;
+    p_stats->max = INT16_MIN;
+    p_stats->sumsq = 0;
+}
+
+
+bool app_dsp_stats_put(app_dsp_stats_t *p_stats, int16_t x, app_dsp_stats_result_t *p_result)
+{
+    if (x < p_stats->min) {
+        p_stats->min = x;
+    }
+    if (x > p_stats->max) {
+        p_stats->max = x;
+    }
+    p_stats->sumsq += (uint32_t)((int32_t)x * x);
+    if (++p_stats->count < (1 << p_stats->shift)) {
+        return false;
+    }
+
+    p_result->min = p_stats->min;
+    p_result->max = p_stats->max;
+    p_result->rms = app_dsp_isqrt((uint32_t)(p_stats->sumsq >> p_stats->shift));
+    app_dsp_stats_init(p_stats, p_stats->shift);
+    return true;
+}
+
+
+/**********************************************
+ * しきい値検出
+ **********************************************/
+
+void app_dsp_thr_init(app_dsp_thr_t *p_thr, int16_t high, int16_t low, uint8_t hold)
+{
+    p_thr->high = high;
+    p_thr->low = low;
+    p_thr->hold = hold;
+    p_thr->count = 0;
+    p_thr->above = false;
+}
+
+
+app_dsp_thr_evt_t app_dsp_thr_put(app_dsp_thr_t *p_thr, int16_t x)
+{
+    bool cross = (p_thr->above) ? (x <= p_thr->low) : (x >= p_thr->high);
+
+    if (!cross) {
+        p_thr->count = 0;
+        return APP_DSP_THR_NONE;
+    }
+    if (++p_thr->count < p_thr->hold) {
+        return APP_DSP_THR_NONE;
+    }
+    p_thr->count = 0;
+    p_thr->above = !p_thr->above;
+    return (p_thr->above) ? APP_DSP_THR_RISE : APP_DSP_THR_FALL;
+}
+
+
+/**********************************************
+ * 共通
+ **********************************************/
+
+uint16_t app_dsp_isqrt(uint32_t x)
+{
+    uint32_t res = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)res;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief int16_tに飽和
+ *
+ * @param[in]   x   入力
+ * @return      INT16_MIN～INT16_MAXに収めた値
+ */
+static int16_t saturate(int32_t x)
+{
+    if (x > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (x < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)x;
+}
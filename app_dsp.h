@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_dsp.h
+ *
+ * 固定小数点の信号処理
+ */
+#ifndef APP_DSP_H__
+#define APP_DSP_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** CICの最大次数 */
+#define APP_DSP_CIC_ORDER_MAX           (3)
+
+/** app_dsp_fir_lp4のタップ数 */
+#define APP_DSP_FIR_LP4_TAPS            (16)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/*
+ * サンプルはint16_t(Q15)。
+ * 割り算は使わず、窓の長さやデシメーション率は2のべき乗にしてシフトで割る。
+ * 各構造体は呼出し側で確保し、中身は触らないこと。
+ */
+
+/** 移動平均 */
+typedef struct {
+    int16_t     *p_buf;         /**< 過去のサンプル(1 << shift個) */
+    uint8_t     shift;          /**< 窓の長さ(log2) */
+    uint16_t    pos;            /**< 次に書く位置 */
+    int32_t     sum;            /**< 窓内の合計 */
+} app_dsp_ma_t;
+
+
+/** デシメーションFIR */
+typedef struct {
+    const int16_t   *p_coef;    /**< 係数(Q15, |係数|の合計は2.0未満) */
+    int16_t         *p_buf;     /**< 過去のサンプル(taps個) */
+    uint16_t        taps;       /**< タップ数 */
+    uint16_t        pos;        /**< 次に書く位置 */
+    uint8_t         decim;      /**< デシメーション率 */
+    uint8_t         phase;      /**< 出力までの残り入力数 */
+} app_dsp_fir_t;
+
+
+/** デシメーションCIC(差分遅延1) */
+typedef struct {
+    uint32_t    integ[APP_DSP_CIC_ORDER_MAX];   /**< 積分器(桁あふれは打ち消し合うので放置) */
+    uint32_t    comb[APP_DSP_CIC_ORDER_MAX];    /**< 櫛形フィルタの1つ前の値 */
+    uint8_t     order;          /**< 次数 */
+    uint8_t     decim_shift;    /**< デシメーション率(log2) */
+    uint32_t    count;          /**< 出力までの入力数(decim_shiftは16まであるので32bit) */
+} app_dsp_cic_t;
+
+
+/** 窓統計(結果) */
+typedef struct {
+    int16_t     min;
+    int16_t     max;
+    uint16_t    rms;
+} app_dsp_stats_result_t;
+
+
+/** 窓統計 */
+typedef struct {
+    uint8_t     shift;          /**< 窓の長さ(log2) */
+    uint16_t    count;          /**< 窓内のサンプル数 */
+    int16_t     min;
+    int16_t     max;
+    uint64_t    sumsq;          /**< 2乗和 */
+} app_dsp_stats_t;
+
+
+/** しきい値検出の結果 */
+typedef enum {
+    APP_DSP_THR_NONE,           /**< 変化なし */
+    APP_DSP_THR_RISE,           /**< highを超えた */
+    APP_DSP_THR_FALL            /**< lowを下回った */
+} app_dsp_thr_evt_t;
+
+
+/** しきい値検出(ヒステリシス付き) */
+typedef struct {
+    int16_t     high;           /**< これ以上がhold回続いたら上 */
+    int16_t     low;            /**< これ以下がhold回続いたら下 */
+    uint8_t     hold;           /**< 確定に必要な連続回数 */
+    uint8_t     count;          /**< 連続回数 */
+    bool        above;          /**< true:上にいる */
+} app_dsp_thr_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/** 4分の1デシメーション用ローパス(カットオフfs/8, Hamming窓, 16タップ, DC利得1.0, Q15) */
+extern const int16_t app_dsp_fir_lp4[APP_DSP_FIR_LP4_TAPS];
+
+
+/**@brief 移動平均 : 初期化
+ *
+ * @param[out]  p_ma    移動平均
+ * @param[in]   p_buf   作業領域(1 << shift個)
+ * @param[in]   shift   窓の長さ(log2, 0～15)
+ */
+void app_dsp_ma_init(app_dsp_ma_t *p_ma, int16_t *p_buf, uint8_t shift);
+
+
+/**@brief 移動平均 : サンプル入力
+ *
+ * 窓が埋まるまでは、足りない分を0として平均する。
+ *
+ * @param[in,out]   p_ma    移動平均
+ * @param[in]       x       入力
+ * @return          平均(0方向ではなく-∞方向に丸める)
+ */
+int16_t app_dsp_ma_put(app_dsp_ma_t *p_ma, int16_t x);
+
+
+/**@brief デシメーションFIR : 初期化
+ *
+ * @param[out]  p_fir   FIR
+ * @param[in]   p_coef  係数(Q15, taps個, |係数|の合計は2.0未満)
+ * @param[in]   p_buf   作業領域(taps個)
+ * @param[in]   taps    タップ数
+ * @param[in]   decim   デシメーション率(1以上)
+ */
+void app_dsp_fir_init(app_dsp_fir_t *p_fir, const int16_t *p_coef, int16_t *p_buf,
+                        uint16_t taps, uint8_t decim);
+
+
+/**@brief デシメーションFIR : サンプル入力
+ *
+ * 出力を出す入力のときだけ積和演算をする。
+ *
+ * @param[in,out]   p_fir   FIR
+ * @param[in]       x       入力
+ * @param[out]      p_y     出力(戻り値がtrueのときのみ)
+ * @retval          true    出力あり(decim回に1回)
+ */
+bool app_dsp_fir_put(app_dsp_fir_t *p_fir, int16_t x, int16_t *p_y);
+
+
+/**@brief デシメーションCIC : 初期化
+ *
+ * ゲイン(2^(order*decim_shift))はシフトで戻すので、出力は入力と同じスケールになる。
+ * order * decim_shiftは16以下にすること。
+ *
+ * @param[out]  p_cic       CIC
+ * @param[in]   order       次数(1～APP_DSP_CIC_ORDER_MAX)
+ * @param[in]   decim_shift デシメーション率(log2, 1以上)
+ */
+void app_dsp_cic_init(app_dsp_cic_t *p_cic, uint8_t order, uint8_t decim_shift);
+
+
+/**@brief デシメーションCIC : サンプル入力
+ *
+ * @param[in,out]   p_cic   CIC
+ * @param[in]       x       入力
+ * @param[out]      p_y     出力(戻り値がtrueのときのみ)
+ * @retval          true    出力あり(2^decim_shift回に1回)
+ */
+bool app_dsp_cic_put(app_dsp_cic_t *p_cic, int16_t x, int16_t *p_y);
+
+
+/**@brief 窓統計 : 初期化
+ *
+ * @param[out]  p_stats     窓統計
+ * @param[in]   shift       窓の長さ(log2, 0～15)
+ */
+void app_dsp_stats_init(app_dsp_stats_t *p_stats, uint8_t shift);
+
+
+/**@brief 窓統計 : サンプル入力
+ *
+ * 窓が埋まったら結果を返し、次の窓を始める(窓は重ならない)。
+ *
+ * @param[in,out]   p_stats     窓統計
+ * @param[in]       x           入力
+ * @param[out]      p_result    最小/最大/RMS(戻り値がtrueのときのみ)
+ * @retval          true        窓が埋まった
+ */
+bool app_dsp_stats_put(app_dsp_stats_t *p_stats, int16_t x, app_dsp_stats_result_t *p_result);
+
+
+/**@brief しきい値検出 : 初期化
+ *
+ * 下にいる状態から始める。
+ *
+ * @param[out]  p_thr   しきい値検出
+ * @param[in]   high    上しきい値
+ * @param[in]   low     下しきい値(high以下)
+ * @param[in]   hold    確定に必要な連続回数(1以上)
+ */
+void app_dsp_thr_init(app_dsp_thr_t *p_thr, int16_t high, int16_t low, uint8_t hold);
+
+
+/**@brief しきい値検出 : サンプル入力
+ *
+ * @param[in,out]   p_thr   しきい値検出
+ * @param[in]       x       入力
+ * @return          状態が変わったときはRISE/FALL
+ */
+app_dsp_thr_evt_t app_dsp_thr_put(app_dsp_thr_t *p_thr, int16_t x);
+
+
+/**@brief 整数平方根
+ *
+ * 割り算を使わないビット毎の計算(16回のループ)。
+ *
+ * @param[in]   x       入力
+ * @return      floor(sqrt(x))
+ */
+uint16_t app_dsp_isqrt(uint32_t x);
+
+#endif /* APP_DSP_H__ */
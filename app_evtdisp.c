@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_evtdisp.c
+ *
+ * BLEイベントの振り分け
+ *
+ * 各モジュールは扱うイベントIDを宣言し、app_bleの振り分け表に並べる。
+ * 全ハンドラを呼んでそれぞれのswitchで捨てる代わりに、ビットマップを1回見るだけで飛ばす。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include "app_evtdisp.h"
+#include "app_ts.h"
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_evtdisp_run(const app_evtdisp_entry_t *p_table, uint8_t num, void *p_context, ble_evt_t *p_ble_evt)
+{
+    uint16_t evt_id = p_ble_evt->header.evt_id;
+    uint8_t word = (uint8_t)(evt_id >> 5);
+    uint32_t bit = 1UL << (evt_id & 31);
+    uint32_t t = app_ts_now();
+    uint8_t lp;
+
+    for (lp = 0; lp < num; lp++) {
+        if (p_table[lp].all || ((word < APP_EVTDISP_WORDS) && (p_table[lp].mask[word] & bit))) {
+            p_table[lp].handler(p_context, p_ble_evt);
+            t = app_budget_check(p_table[lp].budget, t);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_evtdisp.h
+ *
+ * BLEイベントの振り分け
+ */
+#ifndef APP_EVTDISP_H__
+#define APP_EVTDISP_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ble.h"
+
+#include "app_budget.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** ビットマップのword数(イベントID 0x00～0x7Fを扱う) */
+#define APP_EVTDISP_WORDS               (4)
+
+/** @cond */
+#define APP_EVTDISP_BIT_(id, w)         ((((id) >> 5) == (w)) ? (1UL << ((id) & 31)) : 0UL)
+/* 13個目(m)まで埋め草でなければIDが多すぎるので、負の配列長でコンパイルエラーにする */
+#define APP_EVTDISP_NUM_CHECK_(m)       (0UL * sizeof(char[((m) == 0xffff) ? 1 : -1]))
+#define APP_EVTDISP_W_(w, a, b, c, d, e, f, g, h, i, j, k, l, m, ...)                   \
+    (APP_EVTDISP_BIT_(a, w) | APP_EVTDISP_BIT_(b, w) | APP_EVTDISP_BIT_(c, w) |         \
+     APP_EVTDISP_BIT_(d, w) | APP_EVTDISP_BIT_(e, w) | APP_EVTDISP_BIT_(f, w) |         \
+     APP_EVTDISP_BIT_(g, w) | APP_EVTDISP_BIT_(h, w) | APP_EVTDISP_BIT_(i, w) |         \
+     APP_EVTDISP_BIT_(j, w) | APP_EVTDISP_BIT_(k, w) | APP_EVTDISP_BIT_(l, w) |         \
+     APP_EVTDISP_NUM_CHECK_(m))
+#define APP_EVTDISP_PAD_                0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, \
+                                        0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, \
+                                        0xffff, 0xffff
+#define APP_EVTDISP_WX_(...)            APP_EVTDISP_W_(__VA_ARGS__)
+#define APP_EVTDISP_MASK_(...)                                                          \
+    { APP_EVTDISP_WX_(0, __VA_ARGS__, APP_EVTDISP_PAD_),                                \
+      APP_EVTDISP_WX_(1, __VA_ARGS__, APP_EVTDISP_PAD_),                                \
+      APP_EVTDISP_WX_(2, __VA_ARGS__, APP_EVTDISP_PAD_),                                \
+      APP_EVTDISP_WX_(3, __VA_ARGS__, APP_EVTDISP_PAD_) }
+/** @endcond */
+
+/**
+ * @brief 振り分け表の1行
+ *
+ * 扱うイベントIDのビットマップはコンパイル時に作る(IDは最大12個)。
+ * 13個以上並べると"size of unnamed array is negative"でコンパイルエラーになる。
+ *
+ * @param[in]   handler     ハンドラ
+ * @param[in]   budget      app_budget_id_t
+ * @param[in]   ...         扱うイベントID(BLE_xxx_EVT_xxx)
+ */
+#define APP_EVTDISP_ENTRY(handler, budget, ...)                                         \
+    { (handler), APP_EVTDISP_MASK_(__VA_ARGS__), (budget), false }
+
+/**
+ * @brief 振り分け表の1行(全イベント)
+ *
+ * SDKのモジュールなど、扱うイベントIDが決まっていないもの用。
+ *
+ * @param[in]   handler     ハンドラ
+ * @param[in]   budget      app_budget_id_t
+ */
+#define APP_EVTDISP_ENTRY_ALL(handler, budget)                                          \
+    { (handler), { 0, 0, 0, 0 }, (budget), true }
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief ハンドラ
+ *
+ * @param[in]   p_context   app_evtdisp_run()に渡したコンテキスト
+ * @param[in]   p_ble_evt   BLEイベント
+ */
+typedef void (*app_evtdisp_handler_t)(void *p_context, ble_evt_t *p_ble_evt);
+
+
+/**
+ * @brief 振り分け表
+ *
+ * constで定義してFlashに置く。APP_EVTDISP_ENTRY()で作ること。
+ */
+typedef struct {
+    app_evtdisp_handler_t   handler;
+    uint32_t                mask[APP_EVTDISP_WORDS];    /**< 扱うイベントID */
+    app_budget_id_t         budget;                     /**< 処理時間の監視ID */
+    bool                    all;                        /**< true:全イベント */
+} app_evtdisp_entry_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief イベント振り分け
+ *
+ * 振り分け表の順に、イベントIDが一致するハンドラだけを呼ぶ。
+ * 各ハンドラの処理時間はapp_budgetで監視する。
+ * 振り分け表はconstで共有し、インスタンスごとの状態はp_contextで渡す。
+ *
+ * @param[in]   p_table     振り分け表
+ * @param[in]   num         振り分け表の行数
+ * @param[in]   p_context   各ハンドラに渡すコンテキスト
+ * @param[in]   p_ble_evt   BLEイベント
+ */
+void app_evtdisp_run(const app_evtdisp_entry_t *p_table, uint8_t num, void *p_context, ble_evt_t *p_ble_evt);
+
+#endif /* APP_EVTDISP_H__ */
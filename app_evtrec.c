@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_evtrec.c
+ *
+ * BLEイベント記録
+ *
+ * フィールドで起きた問題を再現できるよう、app_ble_evt_dispatch()が受け取った
+ * BLEイベントの順序と主な値、ハンドラの処理時間をRAMのリングに残す。
+ * 古いものから上書きし、読み出すときだけ凍結する。
+ * 読出しはBLE(診断サービス)とUART(app_log)の2通り。
+ * Linuxではtest/replay.cが記録からイベントを組み立て直し、app_ble_evt_dispatch()に流し直す。
+ *
+ * 記録する値(dataは16bit値ならリトルエンディアン):
+ *      BLE_GAP_EVT_CONNECTED           : arg0=max_conn_interval, arg1=slave_latency,
+ *                                        data=min_conn_interval(2), conn_sup_timeout(2)
+ *      BLE_GAP_EVT_DISCONNECTED        : arg0=reason
+ *      BLE_GAP_EVT_CONN_PARAM_UPDATE   : CONNECTEDと同じ
+ *      BLE_GAP_EVT_TIMEOUT             : arg0=src
+ *      BLE_GAP_EVT_RSSI_CHANGED        : arg0=rssi
+ *      BLE_GATTS_EVT_WRITE             : arg0=handle, arg1=len, data=書込みデータの先頭APP_EVTREC_DATA_MAX byte
+ *      BLE_EVT_TX_COMPLETE             : arg0=count
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_util_platform.h"
+
+#include "app_evtrec.h"
+#include "app_ts.h"
+#include "app_log.h"
+
+#ifdef ENABLE_DEBUG_LOG_SUPPORT
+#include "app_uart.h"
+#endif  //ENABLE_DEBUG_LOG_SUPPORT
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define EVTREC_MASK                     (APP_EVTREC_NUM - 1)
+
+/** APP_LOG()1つに載せる記録(4byte単位) */
+#define EVTREC_WORDS                    (sizeof(app_evtrec_t) / sizeof(uint32_t))
+
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void conn_params_put(app_evtrec_t *p_rec, const ble_gap_conn_params_t *p_params);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_evtrec_put(app_evtrec_ring_t *p_ring, const ble_evt_t *p_ble_evt, uint32_t start)
+{
+    app_evtrec_t *p_rec;
+    uint32_t cost;
+
+    if (p_ring->frozen != 0) {
+        return;
+    }
+
+    cost = app_ts_now() - start;
+    if (cost > 0xffff) {
+        cost = 0xffff;
+    }
+
+    CRITICAL_REGION_ENTER();
+    p_rec = &p_ring->rec[p_ring->wr & EVTREC_MASK];
+    p_ring->wr++;
+    CRITICAL_REGION_EXIT();
+
+    p_rec->time = start;
+    p_rec->cost = (uint16_t)cost;
+    p_rec->evt_id = (uint8_t)p_ble_evt->header.evt_id;
+    p_rec->seq = p_ring->seq++;
+    p_rec->arg0 = 0;
+    p_rec->arg1 = 0;
+    memset(p_rec->data, 0, sizeof(p_rec->data));
+
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        p_rec->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        conn_params_put(p_rec, &p_ble_evt->evt.gap_evt.params.connected.conn_params);
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        p_rec->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        p_rec->arg0 = p_ble_evt->evt.gap_evt.params.disconnected.reason;
+        break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        p_rec->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        conn_params_put(p_rec, &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params);
+        break;
+
+    case BLE_GAP_EVT_TIMEOUT:
+        p_rec->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        p_rec->arg0 = p_ble_evt->evt.gap_evt.params.timeout.src;
+        break;
+
+    case BLE_GAP_EVT_RSSI_CHANGED:
+        p_rec->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        p_rec->arg0 = (uint16_t)(int16_t)p_ble_evt->evt.gap_evt.params.rssi_changed.rssi;
+        break;
+
+    case BLE_GATTS_EVT_WRITE:
+        p_rec->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
+        p_rec->arg0 = p_ble_evt->evt.gatts_evt.params.write.handle;
+        p_rec->arg1 = p_ble_evt->evt.gatts_evt.params.write.len;
+        memcpy(p_rec->data, p_ble_evt->evt.gatts_evt.params.write.data,
+                (p_rec->arg1 < APP_EVTREC_DATA_MAX) ? p_rec->arg1 : APP_EVTREC_DATA_MAX);
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        p_rec->conn_handle = p_ble_evt->evt.common_evt.conn_handle;
+        p_rec->arg0 = p_ble_evt->evt.common_evt.params.tx_complete.count;
+        break;
+
+    default:
+        //GAP/GATTSともconn_handleは先頭にある
+        p_rec->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        break;
+    }
+}
+
+
+void app_evtrec_freeze(app_evtrec_ring_t *p_ring, app_evtrec_reader_t reader, bool freeze)
+{
+    CRITICAL_REGION_ENTER();
+    if (freeze) {
+        if ((p_ring->frozen & (1 << reader)) == 0) {
+            p_ring->rd[reader] = (p_ring->wr > APP_EVTREC_NUM) ? p_ring->wr - APP_EVTREC_NUM : 0;
+            p_ring->frozen |= (1 << reader);
+        }
+    }
+    else {
+        p_ring->frozen &= ~(1 << reader);
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+bool app_evtrec_peek(const app_evtrec_ring_t *p_ring, app_evtrec_reader_t reader, app_evtrec_t *p_rec)
+{
+    if (((p_ring->frozen & (1 << reader)) == 0) || (p_ring->rd[reader] == p_ring->wr)) {
+        return false;
+    }
+    memcpy(p_rec, &p_ring->rec[p_ring->rd[reader] & EVTREC_MASK], sizeof(app_evtrec_t));
+    return true;
+}
+
+
+void app_evtrec_consume(app_evtrec_ring_t *p_ring, app_evtrec_reader_t reader)
+{
+    if (((p_ring->frozen & (1 << reader)) != 0) && (p_ring->rd[reader] != p_ring->wr)) {
+        p_ring->rd[reader]++;
+    }
+}
+
+
+void app_evtrec_uart_poll(app_evtrec_ring_t *p_ring)
+{
+#ifdef ENABLE_DEBUG_LOG_SUPPORT
+    uint8_t cmd;
+    app_evtrec_t rec;
+    uint32_t word[EVTREC_WORDS];
+
+    if ((app_uart_get(&cmd) == NRF_SUCCESS) && (cmd == APP_EVTREC_UART_CMD)) {
+        app_evtrec_freeze(p_ring, APP_EVTREC_READER_UART, true);
+    }
+    if ((p_ring->frozen & (1 << APP_EVTREC_READER_UART)) == 0) {
+        return;
+    }
+
+    //前の記録がUARTへ出きってから次を積む
+    if (app_log_unread(APP_LOG_READER_UART) != 0) {
+        return;
+    }
+    if (!app_evtrec_peek(p_ring, APP_EVTREC_READER_UART, &rec)) {
+        APP_LOG("evtrec: end");
+        app_evtrec_freeze(p_ring, APP_EVTREC_READER_UART, false);
+        return;
+    }
+    memcpy(word, &rec, sizeof(word));
+    APP_LOG("evtrec: %08x %08x %08x %08x %08x", word[0], word[1], word[2], word[3], word[4]);
+    app_evtrec_consume(p_ring, APP_EVTREC_READER_UART);
+#endif  //ENABLE_DEBUG_LOG_SUPPORT
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 接続パラメータの記録
+ *
+ * replay時に元のパラメータを組み立てられるよう、4つとも残す。
+ */
+static void conn_params_put(app_evtrec_t *p_rec, const ble_gap_conn_params_t *p_params)
+{
+    p_rec->arg0 = p_params->max_conn_interval;
+    p_rec->arg1 = p_params->slave_latency;
+    memcpy(&p_rec->data[0], &p_params->min_conn_interval, sizeof(uint16_t));
+    memcpy(&p_rec->data[2], &p_params->conn_sup_timeout, sizeof(uint16_t));
+}
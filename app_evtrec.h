@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_evtrec.h
+ *
+ * BLEイベント記録
+ */
+#ifndef APP_EVTREC_H__
+#define APP_EVTREC_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 記録できるイベント数(2のべき乗) */
+#define APP_EVTREC_NUM                  (32)
+
+/** 1記録に残すデータ長(書込みデータの先頭など) */
+#define APP_EVTREC_DATA_MAX             (6)
+
+/** UARTで記録の読出しを要求するコマンド(1byte) */
+#define APP_EVTREC_UART_CMD             ('E')
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief 記録
+ *
+ * 診断キャラクタリスティックにはこのままリトルエンディアンで載せる(20byteで1Notifyに1つ)。
+ * arg0/arg1/dataの中身はイベントごとに異なる(app_evtrec.c, tools/evtrec.py参照)。
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t    time;           /**< ハンドラ呼出し前の時刻[usec](app_ts_now()) */
+    uint16_t    cost;           /**< 処理時間[usec](0xffffで飽和) */
+    uint8_t     evt_id;         /**< BLE_xxx_EVT_xxx */
+    uint8_t     seq;            /**< 連番 */
+    uint16_t    conn_handle;    /**< Connection Handle */
+    uint16_t    arg0;           /**< イベントごとの値 */
+    uint16_t    arg1;           /**< イベントごとの値 */
+    uint8_t     data[APP_EVTREC_DATA_MAX];  /**< イベントごとのデータ */
+} app_evtrec_t;
+
+
+/** 読出し側 */
+typedef enum {
+    APP_EVTREC_READER_BLE,              /**< 診断サービスのEvtRecキャラクタリスティック */
+    APP_EVTREC_READER_UART,             /**< UART(app_logのレコードとして流す) */
+    //
+    APP_EVTREC_READER_MAX
+} app_evtrec_reader_t;
+
+
+/**
+ * @brief 記録のリング
+ *
+ * 1デバイス分の記録。呼出し側で0クリアした領域を確保し、中身は触らないこと。
+ */
+typedef struct {
+    app_evtrec_t        rec[APP_EVTREC_NUM];
+    uint32_t            wr;                             /**< 書込み位置(フリーラン) */
+    uint32_t            rd[APP_EVTREC_READER_MAX];      /**< 読出し位置(フリーラン) */
+    uint8_t             seq;
+    volatile uint8_t    frozen;                         /**< 凍結中の読出し側(bit) */
+} app_evtrec_ring_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief イベント記録
+ *
+ * app_ble_evt_dispatch()で各ハンドラを呼んだ後に呼ぶ。
+ * 凍結中は何もしない。
+ *
+ * @param[in,out]   p_ring      記録のリング
+ * @param[in]       p_ble_evt   BLEイベント
+ * @param[in]       start       ハンドラ呼出し前のapp_ts_now()
+ */
+void app_evtrec_put(app_evtrec_ring_t *p_ring, const ble_evt_t *p_ble_evt, uint32_t start);
+
+
+/**@brief 記録の凍結/再開
+ *
+ * 読み出している間に上書きされないよう、読出し前に凍結する。
+ * 凍結すると、その時点で残っている最も古い記録から読み出せるようになる。
+ * どれかの読出し側が凍結している間は記録しない。
+ *
+ * @param[in,out]   p_ring      記録のリング
+ * @param[in]       reader      読出し側
+ * @param[in]       freeze      true:凍結
+ */
+void app_evtrec_freeze(app_evtrec_ring_t *p_ring, app_evtrec_reader_t reader, bool freeze);
+
+
+/**@brief 記録の読出し
+ *
+ * 凍結中のみ読み出せる。
+ *
+ * @param[in]   p_ring      記録のリング
+ * @param[in]   reader      読出し側
+ * @param[out]  p_rec       読出し先
+ * @retval      true        読み出した
+ * @retval      false       もう無い(または凍結していない)
+ */
+bool app_evtrec_peek(const app_evtrec_ring_t *p_ring, app_evtrec_reader_t reader, app_evtrec_t *p_rec);
+
+
+/**@brief 読出し位置を進める
+ *
+ * @param[in,out]   p_ring      記録のリング
+ * @param[in]       reader      読出し側
+ */
+void app_evtrec_consume(app_evtrec_ring_t *p_ring, app_evtrec_reader_t reader);
+
+
+/**@brief UARTからの記録の読出し
+ *
+ * メインループで、app_log_flush()の後に呼ぶ。
+ * UARTでAPP_EVTREC_UART_CMDを受けたら凍結し、記録を古い順に1つずつAPP_LOG()で積む。
+ * ログのUART出力が追いついてから次を積むので、ログのリングは溢れない。
+ * 全部積んだら"evtrec: end"を積んで再開する。
+ * ENABLE_DEBUG_LOG_SUPPORTが無ければ何もしない。
+ *
+ * @param[in,out]   p_ring      記録のリング
+ */
+void app_evtrec_uart_poll(app_evtrec_ring_t *p_ring);
+
+#endif /* APP_EVTREC_H__ */
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_latency.c
+ *
+ * Slave latency制御
+ *
+ * PPCPでは大きめのslave latencyをネゴシエーションしておき、アイドル中は
+ * Connectionイベントを読み飛ばして消費電流を抑える。
+ * 送受信が始まりそうなときはBLE_GAP_OPT_LOCAL_CONN_LATENCYでローカルの
+ * latencyを0にして毎イベント受信し、Centralからのデータを待たせないようにする。
+ * (ネゴシエーションし直すわけではないので、Centralとのやりとりは発生しない)
+ *
+ * app_latency_wake()は割込み(SWI1)からも呼ばれるので、fastの判定と変更、
+ * それに伴うローカルlatencyとタイマの操作はクリティカルセクションでまとめて行う。
+ * 途中で割り込まれると、fastとSoftDeviceに設定したlatencyが食い違ったままになる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_latency.h"
+
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "app_wheel.h"
+
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 通信が途切れてからアイドルに戻すまでの時間[msec単位] */
+#define APP_LATENCY_IDLE_TIMEOUT        (2000)
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void local_latency_set(const app_latency_t *p_latency, uint16_t latency);
+static void idle_timeout_handler(void *p_context);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_latency_init(app_latency_t *p_latency)
+{
+    //動作中のタイマがあればホイールから外れるよう、構造体ごとクリアはしない
+    app_wheel_stop(&p_latency->idle_timer);
+    p_latency->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_latency->peer_latency = 0;
+    p_latency->fast = false;
+    p_latency->activity = false;
+}
+
+
+void app_latency_on_ble_evt(app_latency_t *p_latency, ble_evt_t *p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        CRITICAL_REGION_ENTER();
+        p_latency->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        p_latency->peer_latency = p_ble_evt->evt.gap_evt.params.connected.conn_params.slave_latency;
+        p_latency->fast = false;
+        CRITICAL_REGION_EXIT();
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        CRITICAL_REGION_ENTER();
+        p_latency->conn_handle = BLE_CONN_HANDLE_INVALID;
+        if (p_latency->fast) {
+            p_latency->fast = false;
+            app_wheel_stop(&p_latency->idle_timer);
+        }
+        CRITICAL_REGION_EXIT();
+        break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        //latency 0で動作中なら、アイドルに戻るときに新しい値を使う
+        CRITICAL_REGION_ENTER();
+        p_latency->peer_latency = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.slave_latency;
+        if (!p_latency->fast) {
+            local_latency_set(p_latency, p_latency->peer_latency);
+        }
+        CRITICAL_REGION_EXIT();
+        break;
+
+    case BLE_GATTS_EVT_WRITE:
+        //Centralからコマンドが来た : 続きがあるはず
+        app_latency_wake(p_latency);
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        p_latency->activity = true;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+void app_latency_wake(app_latency_t *p_latency)
+{
+    p_latency->activity = true;
+
+    CRITICAL_REGION_ENTER();
+    //未接続か、もともと毎イベント受信している(peer_latency == 0)なら何もしない
+    if (!p_latency->fast && (p_latency->conn_handle != BLE_CONN_HANDLE_INVALID) &&
+      (p_latency->peer_latency != 0)) {
+        p_latency->fast = true;
+        local_latency_set(p_latency, 0);
+        app_wheel_start(&p_latency->idle_timer, APP_WHEEL_TICKS(APP_LATENCY_IDLE_TIMEOUT),
+                            APP_WHEEL_MODE_REPEATED, idle_timeout_handler, p_latency);
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief ローカルのslave latency設定
+ *
+ * ネゴシエーション済みの値を超えることはできない。
+ *
+ * @param[in]   p_latency   Slave latency制御
+ * @param[in]   latency     使用するslave latency
+ */
+static void local_latency_set(const app_latency_t *p_latency, uint16_t latency)
+{
+    uint32_t    err_code;
+    ble_opt_t   opt;
+    uint16_t    actual;
+
+    if (p_latency->conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return;
+    }
+
+    memset(&opt, 0, sizeof(opt));
+    opt.gap_opt.local_conn_latency.conn_handle       = p_latency->conn_handle;
+    opt.gap_opt.local_conn_latency.requested_latency = latency;
+    opt.gap_opt.local_conn_latency.p_actual_latency  = &actual;
+    err_code = sd_ble_opt_set(BLE_GAP_OPT_LOCAL_CONN_LATENCY, &opt);
+    if (err_code != NRF_SUCCESS) {
+        //切断直後などは失敗するが、次の接続で設定し直すので無視する
+        APP_LOG("local_latency_set: err=%d", err_code);
+    }
+}
+
+
+/**
+ * @brief アイドル判定タイマ
+ *
+ * 1周期の間に通信が無ければ、ネゴシエーション済みのlatencyに戻す。
+ *
+ * @param[in]   p_context   Slave latency制御
+ */
+static void idle_timeout_handler(void *p_context)
+{
+    app_latency_t *p_latency = (app_latency_t *)p_context;
+
+    if (p_latency->activity) {
+        p_latency->activity = false;
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if (p_latency->fast) {
+        p_latency->fast = false;
+        app_wheel_stop(&p_latency->idle_timer);
+        local_latency_set(p_latency, p_latency->peer_latency);
+    }
+    CRITICAL_REGION_EXIT();
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_latency.h
+ *
+ * Slave latency制御
+ */
+#ifndef APP_LATENCY_H__
+#define APP_LATENCY_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "app_wheel.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** app_latency_on_ble_evt()が扱うイベント(app_evtdisp) */
+#define APP_LATENCY_BLE_EVTS            BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED, BLE_GAP_EVT_CONN_PARAM_UPDATE, \
+                                        BLE_GATTS_EVT_WRITE, BLE_EVT_TX_COMPLETE
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief Slave latency制御
+ *
+ * 接続1つ分の状態。呼出し側で0クリアした領域を確保し、中身は触らないこと。
+ */
+typedef struct {
+    app_wheel_timer_t   idle_timer;
+    uint16_t            conn_handle;
+    uint16_t            peer_latency;   /**< ネゴシエーション済みのslave latency */
+    volatile bool       fast;           /**< true:latency 0で動作中(割込みからのapp_latency_wake()でも変わる) */
+    volatile bool       activity;       /**< 前回のタイマ満了以降に通信があったか */
+} app_latency_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * 状態を初期化する。アイドル判定にはapp_wheelを使うので、app_wheel_init()の後に呼ぶこと。
+ *
+ * @param[in,out]   p_latency   Slave latency制御
+ */
+void app_latency_init(app_latency_t *p_latency);
+
+
+/**@brief BLEイベントハンドラ
+ *
+ * app_ble_evt_dispatch()から呼び出すこと。
+ *
+ * @param[in,out]   p_latency   Slave latency制御
+ * @param[in]       p_ble_evt   BLEスタックイベント
+ */
+void app_latency_on_ble_evt(app_latency_t *p_latency, ble_evt_t *p_ble_evt);
+
+
+/**@brief 全Connectionイベントで受信する状態にする
+ *
+ * Outputにデータを積むときや、Centralからのコマンドを待つときに呼ぶ。
+ * 通信が APP_LATENCY_IDLE_TIMEOUT 途切れると、ネゴシエーション済みのslave latencyに戻る。
+ * 割込みからも呼べる。
+ *
+ * @param[in,out]   p_latency   Slave latency制御
+ */
+void app_latency_wake(app_latency_t *p_latency);
+
+#endif /* APP_LATENCY_H__ */
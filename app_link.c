@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_link.c
+ *
+ * リンク品質監視
+ *
+ * 接続中はRSSI通知を有効にしてフィルタ(指数移動平均)し、
+ * 目標値との差に応じてsd_ble_gap_tx_power_set()で送信電力を1段ずつ変える。
+ * 電波状況が悪くなったときにスループットが落ちた原因を追えるよう、
+ * Notifyの成否やConnectionイベント数と合わせてテレメトリにまとめる。
+ *
+ * 測れるのはCentralからの受信RSSIなので、上りと下りで伝搬損失が同じとみなしている。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_link.h"
+#include "app_prepare.h"
+
+#include "app_error.h"
+
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 目標RSSI[dBm] : これより弱ければ送信電力を上げる */
+#define LINK_TARGET_RSSI                (-70)
+
+/** ヒステリシス[dB] : 目標+この値より強ければ送信電力を下げる */
+#define LINK_RSSI_HYSTERESIS            (8)
+
+/** 送信電力を変更する間隔[RSSIイベント数] */
+#define LINK_ADJUST_INTERVAL            (16)
+
+/** 指数移動平均の係数(1/2^n) */
+#define LINK_FILTER_SHIFT               (3)
+
+/** 小数部のbit数 */
+#define LINK_Q                          (4)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** nRF51で設定可能な送信電力[dBm] */
+static const int8_t                     m_tx_power_tbl[] = {
+    -30, -20, -16, -12, -8, -4, 0, 4
+};
+#define LINK_TX_POWER_DEFAULT           (6)     /* 0dBm */
+#define LINK_TX_POWER_NUM               (sizeof(m_tx_power_tbl) / sizeof(m_tx_power_tbl[0]))
+
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void on_rssi(app_link_t *p_link, int8_t rssi);
+static void tx_power_apply(app_link_t *p_link, uint8_t idx);
+static void report(app_link_t *p_link);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_link_init(app_link_t *p_link, app_link_report_handler_t handler)
+{
+    memset(p_link, 0, sizeof(app_link_t));
+    p_link->handler = handler;
+    p_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_link->tx_power_idx = LINK_TX_POWER_DEFAULT;
+    p_link->telemetry.tx_power = m_tx_power_tbl[p_link->tx_power_idx];
+}
+
+
+void app_link_on_ble_evt(app_link_t *p_link, ble_evt_t *p_ble_evt)
+{
+    uint32_t err_code;
+
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        p_link->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        memset(&p_link->telemetry, 0, sizeof(p_link->telemetry));
+        p_link->rssi_valid = false;
+        p_link->rssi_count = 0;
+        p_link->conn_events_base = app_prepare_event_count();
+        tx_power_apply(p_link, LINK_TX_POWER_DEFAULT);
+
+        err_code = sd_ble_gap_rssi_start(p_link->conn_handle);
+        APP_ERROR_CHECK(err_code);
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        //RSSI通知は切断で止まる
+        report(p_link);
+        p_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+        //下げたままだと次のAdvertisingが届かなくなるので既定値に戻す
+        tx_power_apply(p_link, LINK_TX_POWER_DEFAULT);
+        break;
+
+    case BLE_GAP_EVT_RSSI_CHANGED:
+        on_rssi(p_link, p_ble_evt->evt.gap_evt.params.rssi_changed.rssi);
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        p_link->telemetry.tx_complete += p_ble_evt->evt.common_evt.params.tx_complete.count;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+void app_link_on_notify(app_link_t *p_link, uint32_t err_code)
+{
+    if (err_code == NRF_SUCCESS) {
+        p_link->telemetry.notify_ok++;
+    }
+    else if (err_code == BLE_ERROR_NO_TX_BUFFERS) {
+        p_link->telemetry.notify_retry++;
+    }
+    else {
+        p_link->telemetry.notify_fail++;
+    }
+}
+
+
+void app_link_telemetry_get(app_link_t *p_link, app_link_telemetry_t *p_telemetry)
+{
+    p_link->telemetry.conn_events = app_prepare_event_count() - p_link->conn_events_base;
+    *p_telemetry = p_link->telemetry;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief RSSI更新
+ *
+ * @param[in,out]   p_link  リンク品質監視
+ * @param[in]       rssi    受信したRSSI[dBm]
+ */
+static void on_rssi(app_link_t *p_link, int8_t rssi)
+{
+    int32_t filtered;
+
+    p_link->telemetry.rssi_last = rssi;
+    if (!p_link->rssi_valid) {
+        p_link->rssi_q = (int32_t)rssi << LINK_Q;
+        p_link->rssi_valid = true;
+    }
+    else {
+        p_link->rssi_q += (((int32_t)rssi << LINK_Q) - p_link->rssi_q) >> LINK_FILTER_SHIFT;
+    }
+    filtered = p_link->rssi_q >> LINK_Q;
+    p_link->telemetry.rssi_filtered = (int8_t)filtered;
+
+    if (++p_link->rssi_count < LINK_ADJUST_INTERVAL) {
+        return;
+    }
+    p_link->rssi_count = 0;
+
+    //1段ずつ変えて様子を見る
+    if ((filtered < LINK_TARGET_RSSI) && (p_link->tx_power_idx < LINK_TX_POWER_NUM - 1)) {
+        tx_power_apply(p_link, p_link->tx_power_idx + 1);
+    }
+    else if ((filtered > LINK_TARGET_RSSI + LINK_RSSI_HYSTERESIS) && (p_link->tx_power_idx > 0)) {
+        tx_power_apply(p_link, p_link->tx_power_idx - 1);
+    }
+    report(p_link);
+}
+
+
+/**
+ * @brief 送信電力変更
+ *
+ * @param[in,out]   p_link  リンク品質監視
+ * @param[in]       idx     m_tx_power_tblのindex
+ */
+static void tx_power_apply(app_link_t *p_link, uint8_t idx)
+{
+    uint32_t err_code;
+
+    err_code = sd_ble_gap_tx_power_set(m_tx_power_tbl[idx]);
+    if (err_code != NRF_SUCCESS) {
+        APP_LOG("tx_power_apply: err=%d", err_code);
+        return;
+    }
+    if (idx != p_link->tx_power_idx) {
+        p_link->telemetry.tx_power_changes++;
+    }
+    p_link->tx_power_idx = idx;
+    p_link->telemetry.tx_power = m_tx_power_tbl[idx];
+}
+
+
+/**
+ * @brief テレメトリ通知
+ *
+ * @param[in,out]   p_link  リンク品質監視
+ */
+static void report(app_link_t *p_link)
+{
+    app_link_telemetry_t telemetry;
+
+    if (p_link->handler != NULL) {
+        app_link_telemetry_get(p_link, &telemetry);
+        p_link->handler(p_link, &telemetry);
+    }
+}
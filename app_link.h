@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_link.h
+ *
+ * リンク品質監視
+ */
+#ifndef APP_LINK_H__
+#define APP_LINK_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** app_link_on_ble_evt()が扱うイベント(app_evtdisp) */
+#define APP_LINK_BLE_EVTS               BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED, BLE_GAP_EVT_RSSI_CHANGED, \
+                                        BLE_EVT_TX_COMPLETE
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief テレメトリ
+ *
+ * 診断キャラクタリスティックにはこのままリトルエンディアンで載せる(20byte以内)。
+ */
+typedef struct __attribute__((packed)) {
+    int8_t      rssi_filtered;      /**< フィルタ後RSSI[dBm] */
+    int8_t      rssi_last;          /**< 最新RSSI[dBm] */
+    int8_t      tx_power;           /**< 現在の送信電力[dBm] */
+    uint8_t     tx_power_changes;   /**< 送信電力変更回数 */
+    uint16_t    notify_ok;          /**< Notify成功数 */
+    uint16_t    notify_fail;        /**< Notify失敗数(NO_TX_BUFFERS以外) */
+    uint16_t    notify_retry;       /**< NO_TX_BUFFERSで再送が必要になった数 */
+    uint16_t    tx_complete;        /**< 送信完了パケット数 */
+    uint32_t    conn_events;        /**< Connectionイベント数 */
+} app_link_telemetry_t;
+
+
+/** Forward declaration of the app_link_t type. */
+typedef struct app_link_s app_link_t;
+
+
+/**
+ * @brief テレメトリ通知ハンドラ
+ *
+ * @param[in]   p_link          リンク品質監視
+ * @param[in]   p_telemetry     最新のテレメトリ
+ */
+typedef void (*app_link_report_handler_t)(app_link_t *p_link, const app_link_telemetry_t *p_telemetry);
+
+
+/**
+ * @brief リンク品質監視
+ *
+ * 接続1つ分の状態。呼出し側で確保し、中身は触らないこと。
+ */
+typedef struct app_link_s {
+    app_link_report_handler_t   handler;
+    uint16_t                    conn_handle;
+    app_link_telemetry_t        telemetry;
+    int32_t                     rssi_q;             /**< フィルタ後RSSI(固定小数点) */
+    bool                        rssi_valid;
+    uint8_t                     tx_power_idx;
+    uint8_t                     rssi_count;
+    uint32_t                    conn_events_base;   /**< 接続時のapp_prepareのイベント数 */
+} app_link_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * @param[out]  p_link      リンク品質監視
+ * @param[in]   handler     テレメトリ更新時に呼ばれる(NULL可)
+ */
+void app_link_init(app_link_t *p_link, app_link_report_handler_t handler);
+
+
+/**@brief BLEイベントハンドラ
+ *
+ * app_ble_evt_dispatch()から呼び出すこと。
+ *
+ * @param[in,out]   p_link      リンク品質監視
+ * @param[in]       p_ble_evt   BLEスタックイベント
+ */
+void app_link_on_ble_evt(app_link_t *p_link, ble_evt_t *p_ble_evt);
+
+
+/**@brief Notify結果の記録
+ *
+ * @param[in,out]   p_link      リンク品質監視
+ * @param[in]       err_code    sd_ble_gatts_hvx()の戻り値
+ */
+void app_link_on_notify(app_link_t *p_link, uint32_t err_code);
+
+
+/**@brief テレメトリ取得
+ *
+ * @param[in,out]   p_link          リンク品質監視
+ * @param[out]      p_telemetry     テレメトリ
+ */
+void app_link_telemetry_get(app_link_t *p_link, app_link_telemetry_t *p_telemetry);
+
+#endif /* APP_LINK_H__ */
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_log.c
+ *
+ * 遅延バイナリログ
+ *
+ * app_trace_log()はその場で整形してUARTへ出すので、BLEイベント処理中に呼ぶと
+ * タイミングが大きく変わってしまう。
+ * ここでは文字列IDと引数をリングに積むだけにして、メインループが暇なときに流す。
+ *
+ * リング内のレコード(出力先にもこのまま流す, リトルエンディアン):
+ *      [0xA5][len][id(2)][timestamp(3) : RTC1 COUNTER][seq(1)][args(4 * nargs)][sum(2)][len][0x5A]
+ *   len : レコード全体のbyte数(12 + 4 * nargs)
+ *   sum : 先頭のlenからargsの末尾までの8bit Fletcher(ck_a, ck_b)
+ * IDはビルド時に作る文字列テーブル(_build/<出力名>.logstr.bin)のオフセット。
+ * 引数やタイムスタンプにも0xA5は現れるので、デコーダは末尾のlen/0x5Aとsumが合うものだけを
+ * レコードとし、合わなければ1byteずらして同期し直す。
+ *
+ * リングが一杯になったら古いレコードから上書きする(後から購読した側も直近の履歴を読める)。
+ * 読出し側(UART/BLE)はそれぞれ読出し位置を持ち、上書きされた分は飛ばされる。
+ * 飛ばされたことはseqの抜けで分かる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include "nrf.h"
+
+#include "app_log.h"
+
+#include "app_util_platform.h"
+
+#ifdef ENABLE_DEBUG_LOG_SUPPORT
+#include "app_uart.h"
+#endif  //ENABLE_DEBUG_LOG_SUPPORT
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** リングサイズ[byte] (2のべき乗) */
+#define LOG_RING_SIZE                   (512)
+#define LOG_RING_MASK                   (LOG_RING_SIZE - 1)
+
+#define LOG_SYNC                        (0xA5)
+#define LOG_END                         (0x5A)
+
+/** レコードのヘッダ(8byte)と末尾(4byte) */
+#define LOG_OVERHEAD                    (12)
+
+#define LOG_BYTE(pos)                   (((const uint8_t *)m_ring)[(pos) & LOG_RING_MASK])
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static uint32_t                         m_ring[LOG_RING_SIZE / 4];
+
+/*
+ * 位置[byte] : フリーランで、m_wr - m_tailがリング内のデータ量
+ *   m_tail : 最も古いレコードの先頭
+ *   m_rd   : 読出し側ごとの次に読む位置(m_tail～m_wr)
+ */
+static volatile uint32_t                m_wr;
+static volatile uint32_t                m_tail;
+static volatile uint32_t                m_rd[APP_LOG_READER_MAX];
+static uint8_t                          m_enabled;      /**< 有効な読出し側(bit) */
+
+static uint8_t                          m_seq;
+static volatile uint32_t                m_dropped;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void sum_add(uint32_t word, uint8_t *p_ck_a, uint8_t *p_ck_b);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_log_put(uint32_t id, const uint32_t *p_args, uint8_t nargs)
+{
+    uint32_t size = LOG_OVERHEAD + nargs * 4;
+    uint32_t word;
+    uint32_t pos;
+    uint8_t ck_a = 0;
+    uint8_t ck_b = 0;
+    uint8_t lp;
+    bool lost = false;
+
+    CRITICAL_REGION_ENTER();
+
+    //空きが無ければ古いレコードを捨てる
+    while (LOG_RING_SIZE - (m_wr - m_tail) < size) {
+        m_tail += LOG_BYTE(m_tail + 1);
+    }
+    for (lp = 0; lp < APP_LOG_READER_MAX; lp++) {
+        if ((int32_t)(m_rd[lp] - m_tail) < 0) {
+            m_rd[lp] = m_tail;
+            if (m_enabled & (1 << lp)) {
+                lost = true;
+            }
+        }
+    }
+    if (lost) {
+        m_dropped++;
+    }
+
+    pos = m_wr;
+    word = LOG_SYNC | (size << 8) | (id << 16);
+    m_ring[(pos & LOG_RING_MASK) / 4] = word;
+    sum_add(word & 0xffffff00, &ck_a, &ck_b);
+    pos += 4;
+    word = (NRF_RTC1->COUNTER & 0x00ffffff) | ((uint32_t)m_seq << 24);
+    m_ring[(pos & LOG_RING_MASK) / 4] = word;
+    sum_add(word, &ck_a, &ck_b);
+    for (lp = 0; lp < nargs; lp++) {
+        pos += 4;
+        m_ring[(pos & LOG_RING_MASK) / 4] = p_args[lp];
+        sum_add(p_args[lp], &ck_a, &ck_b);
+    }
+    pos += 4;
+    m_ring[(pos & LOG_RING_MASK) / 4] = ck_a | ((uint32_t)ck_b << 8) | (size << 16) | ((uint32_t)LOG_END << 24);
+    m_seq++;
+    m_wr += size;
+
+    CRITICAL_REGION_EXIT();
+}
+
+
+void app_log_reader_enable(app_log_reader_t reader, bool enable)
+{
+    CRITICAL_REGION_ENTER();
+    if (enable) {
+        if ((m_enabled & (1 << reader)) == 0) {
+            //残っている履歴の先頭から読む
+            m_rd[reader] = m_tail;
+            m_enabled |= (1 << reader);
+        }
+    }
+    else {
+        m_enabled &= ~(1 << reader);
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+uint16_t app_log_peek(app_log_reader_t reader, uint8_t *p_buf, uint16_t max, uint32_t *p_pos)
+{
+    uint16_t len = 0;
+    uint32_t pos;
+
+    CRITICAL_REGION_ENTER();
+    pos = m_rd[reader];
+    while ((len < max) && (pos + len != m_wr)) {
+        p_buf[len] = LOG_BYTE(pos + len);
+        len++;
+    }
+    CRITICAL_REGION_EXIT();
+
+    *p_pos = pos;
+    return len;
+}
+
+
+void app_log_consume(app_log_reader_t reader, uint32_t pos, uint16_t len)
+{
+    CRITICAL_REGION_ENTER();
+    //peekの後で上書きされていたら、読出し位置は既に進められている
+    if (m_rd[reader] == pos) {
+        m_rd[reader] = pos + len;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+uint32_t app_log_unread(app_log_reader_t reader)
+{
+    uint32_t len = 0;
+
+    CRITICAL_REGION_ENTER();
+    if ((m_enabled & (1 << reader)) != 0) {
+        len = m_wr - m_rd[reader];
+    }
+    CRITICAL_REGION_EXIT();
+
+    return len;
+}
+
+
+void app_log_flush(void)
+{
+#ifdef ENABLE_DEBUG_LOG_SUPPORT
+    uint8_t data;
+    uint32_t pos;
+
+    app_log_reader_enable(APP_LOG_READER_UART, true);
+
+    //1byteずつ送り、FIFOが一杯になったら次回の続きにする
+    while (app_log_peek(APP_LOG_READER_UART, &data, 1, &pos) != 0) {
+        if (app_uart_put(data) != NRF_SUCCESS) {
+            break;
+        }
+        app_log_consume(APP_LOG_READER_UART, pos, 1);
+    }
+#endif  //ENABLE_DEBUG_LOG_SUPPORT
+}
+
+
+uint32_t app_log_dropped(void)
+{
+    return m_dropped;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief チェックサム加算(4byte, リトルエンディアン順)
+ *
+ * 先頭の0xA5は含めないので、呼出し元で0にしておく(最初のbyteが0ならck_a/ck_bとも0のまま)。
+ */
+static void sum_add(uint32_t word, uint8_t *p_ck_a, uint8_t *p_ck_b)
+{
+    uint8_t lp;
+
+    for (lp = 0; lp < 4; lp++) {
+        *p_ck_a += (uint8_t)word;
+        *p_ck_b += *p_ck_a;
+        word >>= 8;
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_log.h
+ *
+ * 遅延バイナリログ
+ */
+#ifndef APP_LOG_H__
+#define APP_LOG_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 1レコードの最大引数 */
+#define APP_LOG_ARGS_MAX                (8)
+
+/** @cond */
+#define APP_LOG_NARGS(...)              APP_LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define APP_LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...)  N
+/** @endcond */
+
+/**
+ * @brief ログ出力
+ *
+ * 書式文字列は.logstrセクション(ロードされない)に置き、そのオフセットをIDとして
+ * 引数(整数のみ、最大APP_LOG_ARGS_MAX個)と一緒にRAMのリングへ積むだけ。
+ * 文字列への整形はLinux側(tools/logdec.py)で行う。
+ * 割込みからも呼べる。
+ *
+ * @param[in]   fmt     書式文字列(%d/%u/%x/%cのみ。%sは使えない)
+ */
+#define APP_LOG(fmt, ...)                                                           \
+    do {                                                                            \
+        static const char app_log_str_[] __attribute__((section(".logstr"), used)) = fmt; \
+        const uint32_t app_log_args_[] = { 0, ##__VA_ARGS__ };                      \
+        app_log_put((uint32_t)app_log_str_, &app_log_args_[1],                      \
+                    APP_LOG_NARGS(__VA_ARGS__));                                    \
+    } while (0)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** 読出し側 */
+typedef enum {
+    APP_LOG_READER_UART,                /**< UART(app_trace) */
+    APP_LOG_READER_BLE,                 /**< 診断サービスのLogキャラクタリスティック */
+    //
+    APP_LOG_READER_MAX
+} app_log_reader_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief ログを積む
+ *
+ * APP_LOG()から呼ばれる。直接は呼ばないこと。
+ *
+ * @param[in]   id          文字列ID(.logstr内のアドレス)
+ * @param[in]   p_args      引数
+ * @param[in]   nargs       引数の数
+ */
+void app_log_put(uint32_t id, const uint32_t *p_args, uint8_t nargs);
+
+
+/**@brief 読出し側の有効/無効
+ *
+ * 有効にすると、リングに残っている最も古いレコードから読み出す。
+ *
+ * @param[in]   reader      読出し側
+ * @param[in]   enable      true:有効
+ */
+void app_log_reader_enable(app_log_reader_t reader, bool enable);
+
+
+/**@brief ログの読出し(読出し位置は進めない)
+ *
+ * 出力できたらapp_log_consume()で読出し位置を進める。
+ * レコードの途中で区切られることがある(デコーダ側で連結する)。
+ *
+ * @param[in]   reader      読出し側
+ * @param[out]  p_buf       読出し先
+ * @param[in]   max         読出し先のサイズ
+ * @param[out]  p_pos       読出し位置(app_log_consume()に渡す)
+ * @return      読み出したbyte数
+ */
+uint16_t app_log_peek(app_log_reader_t reader, uint8_t *p_buf, uint16_t max, uint32_t *p_pos);
+
+
+/**@brief 読出し位置を進める
+ *
+ * @param[in]   reader      読出し側
+ * @param[in]   pos         app_log_peek()で得た読出し位置
+ * @param[in]   len         出力できたbyte数
+ */
+void app_log_consume(app_log_reader_t reader, uint32_t pos, uint16_t len);
+
+
+/**@brief 読出し側がまだ読んでいないbyte数
+ *
+ * @param[in]   reader      読出し側
+ * @return      未読のbyte数(無効な読出し側は0)
+ */
+uint32_t app_log_unread(app_log_reader_t reader);
+
+
+/**@brief UARTへのログ出力処理
+ *
+ * メインループで、スケジューラのイベントが無くなってから呼ぶ。
+ * UART(app_trace)に送れるだけ送る。
+ */
+void app_log_flush(void);
+
+
+/**@brief 取りこぼし数
+ *
+ * @return  有効な読出し側が読む前に上書きされたレコード数(起動後の累計)
+ */
+uint32_t app_log_dropped(void);
+
+#endif /* APP_LOG_H__ */
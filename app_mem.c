@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_mem.c
+ *
+ * RAM使用量監視
+ *
+ * 領域の大きさはリンカスクリプト(gcc_nrf51_common.ld)のシンボルから求める。
+ * モジュールごとの内訳はビルド時にtools/ramuse.pyでmapファイルから出す。
+ *
+ * スタックは起動時にSTACK_PAINTで塗っておき、塗った値が残っていない深さを
+ * 最大使用量とする(塗った値と同じ値を書かれると少なめに出る)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "nrf.h"
+
+#include "app_mem.h"
+#include "app_pool.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define STACK_PAINT                     (0xDEADBEEF)
+
+/** 塗るときに現在のSPから空けておくword数 */
+#define STACK_PAINT_MARGIN              (16)
+
+/** app_mem_poll()で走査する間隔[回] */
+#define APP_MEM_POLL_COUNT              (64)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/* gcc_nrf51_common.ld */
+extern uint32_t __data_start__;
+extern uint32_t __data_end__;
+extern uint32_t __bss_start__;
+extern uint32_t __bss_end__;
+extern uint32_t __end__;
+extern uint32_t __HeapLimit;
+extern uint32_t __StackLimit;
+extern uint32_t __StackTop;
+
+static const app_pool_t                 *m_p_pool;
+static uint16_t                         m_stack_used;
+static uint8_t                          m_poll_count;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint16_t stack_scan(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_mem_init(const app_pool_t *p_pool)
+{
+    uint32_t *p = &__StackLimit;
+    uint32_t *p_sp = (uint32_t *)__get_MSP() - STACK_PAINT_MARGIN;
+
+    while (p < p_sp) {
+        *p++ = STACK_PAINT;
+    }
+    m_p_pool = p_pool;
+    m_stack_used = stack_scan();
+}
+
+
+bool app_mem_poll(void)
+{
+    uint16_t used;
+
+    if (++m_poll_count < APP_MEM_POLL_COUNT) {
+        return false;
+    }
+    m_poll_count = 0;
+
+    used = stack_scan();
+    if (used > m_stack_used) {
+        m_stack_used = used;
+        return true;
+    }
+    return false;
+}
+
+
+void app_mem_report_get(app_mem_report_t *p_report)
+{
+    uint8_t cls;
+    app_pool_stats_t stats;
+
+    p_report->data = (uint16_t)((uint32_t)&__data_end__ - (uint32_t)&__data_start__);
+    p_report->bss = (uint16_t)((uint32_t)&__bss_end__ - (uint32_t)&__bss_start__);
+    p_report->heap = (uint16_t)((uint32_t)&__HeapLimit - (uint32_t)&__end__);
+    p_report->stack = (uint16_t)((uint32_t)&__StackTop - (uint32_t)&__StackLimit);
+    p_report->stack_used = m_stack_used;
+
+    memset(p_report->pool_high_water, 0, sizeof(p_report->pool_high_water));
+    p_report->pool_fail = 0;
+    for (cls = 0; (m_p_pool != NULL) && (cls < APP_POOL_CLASS_MAX); cls++) {
+        app_pool_stats_get(m_p_pool, (app_pool_class_t)cls, &stats);
+        if (cls < sizeof(p_report->pool_high_water)) {
+            p_report->pool_high_water[cls] = stats.high_water;
+        }
+        p_report->pool_fail += stats.fail;
+    }
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief スタック使用量を求める
+ *
+ * @return  使用量[byte]
+ */
+static uint16_t stack_scan(void)
+{
+    const uint32_t *p = &__StackLimit;
+
+    while ((p < &__StackTop) && (*p == STACK_PAINT)) {
+        p++;
+    }
+    return (uint16_t)((uint32_t)&__StackTop - (uint32_t)p);
+}
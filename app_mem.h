@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_mem.h
+ *
+ * RAM使用量監視
+ */
+#ifndef APP_MEM_H__
+#define APP_MEM_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "app_pool.h"
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief メモリレポート
+ *
+ * 診断キャラクタリスティックにはこのままリトルエンディアンで載せる(20byte以内)。
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t    data;           /**< .data[byte] */
+    uint16_t    bss;            /**< .bss[byte] */
+    uint16_t    heap;           /**< ヒープ[byte] */
+    uint16_t    stack;          /**< スタック領域[byte] */
+    uint16_t    stack_used;     /**< スタック最大使用量[byte] */
+    uint8_t     pool_high_water[3]; /**< app_poolのクラスごとの最大使用数 */
+    uint16_t    pool_fail;      /**< app_poolで空きが無かった回数(全クラス) */
+} app_mem_report_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief スタックを塗る
+ *
+ * main()から呼ぶ。スタック領域のうち、現在のSPより下を既知の値で埋める。
+ * main()より深い所で使われた分は数えられないので、なるべく早めに呼ぶこと。
+ * レポートのapp_pool欄には、ここで渡したプールの統計を載せる。
+ *
+ * @param[in]   p_pool      レポートに載せるプール(NULL:載せない)
+ */
+void app_mem_init(const app_pool_t *p_pool);
+
+
+/**@brief スタック最大使用量の更新
+ *
+ * メインループから呼ぶ。毎回は走査せず、APP_MEM_POLL_COUNT回に1回だけ走査する。
+ *
+ * @retval  true    最大使用量が増えた
+ */
+bool app_mem_poll(void);
+
+
+/**@brief メモリレポート取得
+ *
+ * @param[out]  p_report    レポート
+ */
+void app_mem_report_get(app_mem_report_t *p_report);
+
+#endif /* APP_MEM_H__ */
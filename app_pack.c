@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_pack.c
+ *
+ * サンプルの詰め込み
+ *
+ * 数byteのサンプルを1つずつNotifyすると、1パケットの大半と送信バッファを無駄にする。
+ * 先頭サンプルのタイムスタンプと、以降のサンプルの差分(1byte)だけを付けて
+ * 1Notifyに詰められるだけ詰めてから送る。
+ * 詰め終わらなくても、APP_PACK_MAX_AGE経ったら送る。
+ * 受信側はtools/packdec.pyでデコードする。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_pack.h"
+
+#include "app_wheel.h"
+#include "app_ts.h"
+
+#include "app_log.h"
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void age_timeout_handler(void *p_context);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_pack_init(app_pack_t *p_pack, uint8_t sample_size, app_pack_send_t send, void *p_context)
+{
+    if ((sample_size == 0) || (APP_PACK_SAMPLE_MAX < sample_size)) {
+        APP_LOG("app_pack_init: invalid size=%d", sample_size);
+        sample_size = APP_PACK_SAMPLE_MAX;
+    }
+    //動作中のタイマがあればホイールから外れるよう、構造体ごとクリアはしない
+    app_wheel_stop(&p_pack->age_timer);
+    p_pack->send = send;
+    p_pack->p_context = p_context;
+    p_pack->size = sample_size;
+    p_pack->len = 0;
+    p_pack->seq = 0;
+    memset(&p_pack->stats, 0, sizeof(p_pack->stats));
+}
+
+
+void app_pack_put(app_pack_t *p_pack, const uint8_t *p_sample)
+{
+    app_pack_put_at(p_pack, p_sample, app_ts_now());
+}
+
+
+void app_pack_put_at(app_pack_t *p_pack, const uint8_t *p_sample, uint32_t now)
+{
+    uint32_t delta = 0;
+
+    if (p_pack->len != 0) {
+        //誤差が積もらないよう、受信側で復元される時刻からの差分にする
+        delta = (now - p_pack->last + APP_PACK_DELTA_US / 2) / APP_PACK_DELTA_US;
+        if (delta > UINT8_MAX) {
+            //差分に入りきらないので、新しいパケットにする
+            app_pack_flush(p_pack);
+        }
+    }
+
+    if (p_pack->len == 0) {
+        p_pack->buf[0] = (uint8_t)((p_pack->seq << 4) | p_pack->size);
+        p_pack->buf[1] = (uint8_t)now;
+        p_pack->buf[2] = (uint8_t)(now >> 8);
+        p_pack->buf[3] = (uint8_t)(now >> 16);
+        p_pack->buf[4] = (uint8_t)(now >> 24);
+        p_pack->len = APP_PACK_HDR_LEN;
+        p_pack->last = now;
+        app_wheel_start(&p_pack->age_timer, APP_WHEEL_TICKS(APP_PACK_MAX_AGE),
+                            APP_WHEEL_MODE_SINGLE_SHOT, age_timeout_handler, p_pack);
+    }
+    else {
+        p_pack->buf[p_pack->len++] = (uint8_t)delta;
+        p_pack->last += delta * APP_PACK_DELTA_US;
+    }
+    memcpy(&p_pack->buf[p_pack->len], p_sample, p_pack->size);
+    p_pack->len += p_pack->size;
+    p_pack->stats.samples++;
+
+    if (p_pack->len + 1 + p_pack->size > APP_PACK_PAYLOAD) {
+        //次のサンプルは入らない
+        app_pack_flush(p_pack);
+    }
+}
+
+
+void app_pack_flush(app_pack_t *p_pack)
+{
+    if (p_pack->len == 0) {
+        return;
+    }
+    app_wheel_stop(&p_pack->age_timer);
+    if (p_pack->send != NULL) {
+        p_pack->send(p_pack->p_context, p_pack->buf, p_pack->len);
+    }
+    p_pack->len = 0;
+    p_pack->seq = (p_pack->seq + 1) & 0x0f;
+    p_pack->stats.packets++;
+}
+
+
+void app_pack_stats_get(const app_pack_t *p_pack, app_pack_stats_t *p_stats)
+{
+    *p_stats = p_pack->stats;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 送信待ち時間満了
+ *
+ * @param[in]   p_context   サンプル詰め
+ */
+static void age_timeout_handler(void *p_context)
+{
+    app_pack_t *p_pack = (app_pack_t *)p_context;
+
+    if (p_pack->len != 0) {
+        p_pack->stats.age_flush++;
+    }
+    app_pack_flush(p_pack);
+}
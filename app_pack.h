@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_pack.h
+ *
+ * サンプルの詰め込み
+ */
+#ifndef APP_PACK_H__
+#define APP_PACK_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_wheel.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/*
+ * Outputキャラクタリスティックからのパケット
+ *   [seq(4bit)|size(4bit)][base(4)][sample0(size)]{[delta(1)][sampleN(size)]}...
+ *
+ *   seq    : パケット毎に+1(受信側の欠落検出用)
+ *   size   : 1サンプルのbyte数
+ *   base   : sample0のタイムスタンプ[usec](app_ts_now()基準)
+ *   delta  : 1つ前のサンプルからの経過[APP_PACK_DELTA_US単位]
+ * (数値はリトルエンディアン)
+ * サンプル数はパケット長から求める。
+ */
+
+/** パケットの最大長(Notify 1回分) */
+#define APP_PACK_PAYLOAD                (20)
+
+/** ヘッダ長 */
+#define APP_PACK_HDR_LEN                (5)
+
+/** 1サンプルの最大byte数 */
+#define APP_PACK_SAMPLE_MAX             (APP_PACK_PAYLOAD - APP_PACK_HDR_LEN)
+
+/** deltaの単位[usec] */
+#define APP_PACK_DELTA_US               (1000)
+
+/** 最初のサンプルを詰めてから送信するまでの最大時間[msec](deltaの最大値未満にする) */
+#define APP_PACK_MAX_AGE                (100)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief パケット送信
+ *
+ * @param[in]   p_context   app_pack_init()で渡したもの
+ * @param[in]   p_data      送信データ
+ * @param[in]   length      送信データ長
+ */
+typedef void (*app_pack_send_t)(void *p_context, const uint8_t *p_data, uint16_t length);
+
+
+/** 統計 */
+typedef struct {
+    uint32_t    samples;        /**< 詰めたサンプル数 */
+    uint32_t    packets;        /**< 送信したパケット数 */
+    uint32_t    age_flush;      /**< APP_PACK_MAX_AGEで送信したパケット数 */
+} app_pack_stats_t;
+
+
+/**
+ * @brief サンプル詰め
+ *
+ * 送信先1つ分の状態。呼出し側で0クリアした領域を確保し、中身は触らないこと。
+ */
+typedef struct {
+    app_pack_send_t     send;
+    void                *p_context;
+    uint8_t             size;               /**< 1サンプルのbyte数 */
+    uint8_t             seq;                /**< 次のパケットのseq */
+    uint16_t            len;                /**< bufの使用byte数(0:空) */
+    uint8_t             buf[APP_PACK_PAYLOAD];  /**< 詰めかけのパケット */
+    uint32_t            last;               /**< 最後に詰めたサンプルの時刻(受信側で復元される値)[usec] */
+    app_wheel_timer_t   age_timer;
+    app_pack_stats_t    stats;
+} app_pack_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * app_wheel_init()の後で呼ぶこと。
+ *
+ * @param[in,out]  p_pack      サンプル詰め
+ * @param[in]      sample_size 1サンプルのbyte数(1～APP_PACK_SAMPLE_MAX)
+ * @param[in]      send        パケット送信関数
+ * @param[in]      p_context   sendに渡すもの(送信先のapp_ble_tなど)
+ */
+void app_pack_init(app_pack_t *p_pack, uint8_t sample_size, app_pack_send_t send, void *p_context);
+
+
+/**@brief サンプル追加
+ *
+ * パケットが一杯になったらすぐ送信する。
+ * そうでなければ、最初のサンプルからAPP_PACK_MAX_AGE経つと送信する。
+ * メインループ(スケジューラ)から呼ぶこと。
+ *
+ * @param[in,out]  p_pack      サンプル詰め
+ * @param[in]      p_sample    サンプル(app_pack_init()で指定したbyte数)
+ */
+void app_pack_put(app_pack_t *p_pack, const uint8_t *p_sample);
+
+
+/**@brief サンプル追加(時刻指定)
+ *
+ * まとめて処理するサンプルに、取得したときの時刻を付ける場合に使う。
+ * 時刻は単調増加にすること。それ以外はapp_pack_put()と同じ。
+ *
+ * @param[in,out]  p_pack      サンプル詰め
+ * @param[in]      p_sample    サンプル(app_pack_init()で指定したbyte数)
+ * @param[in]      now         サンプルの時刻[usec](app_ts_now()と同じ基準)
+ */
+void app_pack_put_at(app_pack_t *p_pack, const uint8_t *p_sample, uint32_t now);
+
+
+/**@brief 詰めかけのパケットを送信
+ *
+ * 空なら何もしない。
+ *
+ * @param[in,out]  p_pack      サンプル詰め
+ */
+void app_pack_flush(app_pack_t *p_pack);
+
+
+/**@brief 統計取得
+ *
+ * @param[in]      p_pack      サンプル詰め
+ * @param[out]     p_stats     統計
+ */
+void app_pack_stats_get(const app_pack_t *p_pack, app_pack_stats_t *p_stats);
+
+#endif /* APP_PACK_H__ */
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_pool.c
+ *
+ * 固定長ブロックのメモリプール
+ *
+ * サイズクラスごとの領域をapp_pool_tに持ち、空きブロックを単方向リストでつなぐ。
+ * 空きブロックの先頭を次の空きブロックへのポインタに使う。
+ * 解放時のクラスは、アドレスがどの領域に入っているかで判定する。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stddef.h>
+#include <string.h>
+
+#include "nrf.h"
+#include "app_util_platform.h"
+
+#include "app_pool.h"
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint32_t *next_get(const uint32_t *p_block);
+static void next_set(uint32_t *p_block, uint32_t *p_next);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_pool_init(app_pool_t *p_pool, app_pool_exhausted_handler_t handler)
+{
+    static const uint16_t SIZE[APP_POOL_CLASS_MAX] = {
+        APP_POOL_SMALL_SIZE, APP_POOL_PAYLOAD_SIZE, APP_POOL_LARGE_SIZE
+    };
+    static const uint8_t NUM[APP_POOL_CLASS_MAX] = {
+        APP_POOL_SMALL_NUM, APP_POOL_PAYLOAD_NUM, APP_POOL_LARGE_NUM
+    };
+    uint32_t *area[APP_POOL_CLASS_MAX] = {
+        p_pool->area_small, p_pool->area_payload, p_pool->area_large
+    };
+    uint8_t cls;
+    uint32_t *p;
+    app_pool_class_state_t *p_cls;
+
+    p_pool->exhausted_handler = handler;
+
+    for (cls = 0; cls < APP_POOL_CLASS_MAX; cls++) {
+        p_cls = &p_pool->cls[cls];
+        p_cls->p_start = area[cls];
+        p_cls->p_end = area[cls] + APP_POOL_WORDS(SIZE[cls]) * NUM[cls];
+        p_cls->p_free = NULL;
+        p_cls->block_size = SIZE[cls];
+        p_cls->num = NUM[cls];
+        p_cls->used = 0;
+        p_cls->high_water = 0;
+        p_cls->fail = 0;
+
+        //後ろからつないで、先頭のブロックから使われるようにする
+        p = p_cls->p_end;
+        while (p != p_cls->p_start) {
+            p -= APP_POOL_WORDS(p_cls->block_size);
+            next_set(p, p_cls->p_free);
+            p_cls->p_free = p;
+        }
+    }
+}
+
+
+void *app_pool_alloc(app_pool_t *p_pool, uint16_t size)
+{
+    uint8_t cls;
+    uint32_t *p_block = NULL;
+    app_pool_class_state_t *p_cls;
+
+    for (cls = 0; cls < APP_POOL_CLASS_MAX; cls++) {
+        p_cls = &p_pool->cls[cls];
+        if (size > p_cls->block_size) {
+            continue;
+        }
+
+        CRITICAL_REGION_ENTER();
+        p_block = p_cls->p_free;
+        if (p_block != NULL) {
+            p_cls->p_free = next_get(p_block);
+            p_cls->used++;
+            if (p_cls->used > p_cls->high_water) {
+                p_cls->high_water = p_cls->used;
+            }
+        }
+        else {
+            p_cls->fail++;
+        }
+        CRITICAL_REGION_EXIT();
+
+        if (p_block != NULL) {
+            break;
+        }
+    }
+
+    if ((p_block == NULL) && (p_pool->exhausted_handler != NULL)) {
+        p_pool->exhausted_handler(p_pool, size);
+    }
+    return p_block;
+}
+
+
+void app_pool_free(app_pool_t *p_pool, void *p_block)
+{
+    uint8_t cls;
+    uint32_t *p = (uint32_t *)p_block;
+    app_pool_class_state_t *p_cls;
+
+    if (p == NULL) {
+        return;
+    }
+
+    for (cls = 0; cls < APP_POOL_CLASS_MAX; cls++) {
+        p_cls = &p_pool->cls[cls];
+        if ((p_cls->p_start <= p) && (p < p_cls->p_end)) {
+            CRITICAL_REGION_ENTER();
+            next_set(p, p_cls->p_free);
+            p_cls->p_free = p;
+            p_cls->used--;
+            CRITICAL_REGION_EXIT();
+            return;
+        }
+    }
+}
+
+
+void app_pool_stats_get(const app_pool_t *p_pool, app_pool_class_t cls, app_pool_stats_t *p_stats)
+{
+    const app_pool_class_state_t *p_cls = &p_pool->cls[cls];
+
+    p_stats->block_size = p_cls->block_size;
+    p_stats->num = p_cls->num;
+    p_stats->used = p_cls->used;
+    p_stats->high_water = p_cls->high_water;
+    p_stats->fail = p_cls->fail;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 空きブロックから次の空きブロックを取り出す
+ *
+ * ホスト(64bit)ではポインタが1wordに収まらないので、ポインタの大きさでコピーする。
+ * どのクラスもブロックはポインタより大きい。
+ */
+static uint32_t *next_get(const uint32_t *p_block)
+{
+    uint32_t *p_next;
+
+    memcpy(&p_next, p_block, sizeof(p_next));
+    return p_next;
+}
+
+
+static void next_set(uint32_t *p_block, uint32_t *p_next)
+{
+    memcpy(p_block, &p_next, sizeof(p_next));
+}
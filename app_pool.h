@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_pool.h
+ *
+ * 固定長ブロックのメモリプール
+ */
+#ifndef APP_POOL_H__
+#define APP_POOL_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/*
+ * サイズクラスごとのブロックサイズ[byte](4の倍数)と個数。
+ * RAMが足りなくなったら、app_pool_stats_get()の最大使用数を見て調整する。
+ */
+/** SMALL : 短いコマンド用 */
+#define APP_POOL_SMALL_SIZE             (12)
+#define APP_POOL_SMALL_NUM              (8)
+
+/** PAYLOAD : Notify 1パケット分(ATT_MTU-3)とヘッダ用 */
+#define APP_POOL_PAYLOAD_SIZE           (28)
+#define APP_POOL_PAYLOAD_NUM            (8)
+
+/** LARGE : I/OサービスのInput(64byte)とヘッダ用 */
+#define APP_POOL_LARGE_SIZE             (68)
+#define APP_POOL_LARGE_NUM              (2)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** サイズクラス(小さい順) */
+typedef enum {
+    APP_POOL_CLASS_SMALL,
+    APP_POOL_CLASS_PAYLOAD,
+    APP_POOL_CLASS_LARGE,
+    //
+    APP_POOL_CLASS_MAX
+} app_pool_class_t;
+
+
+/** 統計 */
+typedef struct {
+    uint16_t    block_size;     /**< ブロックサイズ[byte] */
+    uint8_t     num;            /**< ブロック数 */
+    uint8_t     used;           /**< 使用中のブロック数 */
+    uint8_t     high_water;     /**< 最大使用数 */
+    uint16_t    fail;           /**< 空きが無かった回数(大きいクラスで確保できた場合も含む) */
+} app_pool_stats_t;
+
+
+/** Forward declaration of the app_pool_t type. */
+typedef struct app_pool_s app_pool_t;
+
+
+/**@brief 枯渇ハンドラ
+ *
+ * 確保に失敗したときに呼ばれる。割込みから呼ばれることもある。
+ *
+ * @param[in]   p_pool      プール
+ * @param[in]   size        要求サイズ[byte]
+ */
+typedef void (*app_pool_exhausted_handler_t)(app_pool_t *p_pool, uint16_t size);
+
+
+/** @cond */
+#define APP_POOL_WORDS(size)            (((size) + 3) / 4)
+
+typedef struct {
+    uint32_t    *p_start;       /**< 領域先頭 */
+    uint32_t    *p_end;         /**< 領域末尾の次 */
+    uint32_t    *p_free;        /**< 空きリスト先頭 */
+    uint16_t    block_size;     /**< ブロックサイズ[byte] */
+    uint8_t     num;
+    uint8_t     used;
+    uint8_t     high_water;
+    uint16_t    fail;
+} app_pool_class_state_t;
+/** @endcond */
+
+
+/**
+ * @brief プール
+ *
+ * 呼出し側で確保し、中身は触らないこと。
+ * 領域も含むので、プールごとに独立して確保/解放できる。
+ */
+typedef struct app_pool_s {
+    app_pool_exhausted_handler_t    exhausted_handler;
+    app_pool_class_state_t          cls[APP_POOL_CLASS_MAX];
+    uint32_t                        area_small[APP_POOL_WORDS(APP_POOL_SMALL_SIZE) * APP_POOL_SMALL_NUM];
+    uint32_t                        area_payload[APP_POOL_WORDS(APP_POOL_PAYLOAD_SIZE) * APP_POOL_PAYLOAD_NUM];
+    uint32_t                        area_large[APP_POOL_WORDS(APP_POOL_LARGE_SIZE) * APP_POOL_LARGE_NUM];
+} app_pool_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * @param[out]  p_pool      プール
+ * @param[in]   handler     枯渇ハンドラ(NULL可)
+ */
+void app_pool_init(app_pool_t *p_pool, app_pool_exhausted_handler_t handler);
+
+
+/**@brief ブロック確保
+ *
+ * sizeが収まる最も小さいクラスから確保し、空きが無ければ大きいクラスから確保する。
+ * 一定時間で終わり、割込みからも呼べる。
+ *
+ * @param[in,out]   p_pool      プール
+ * @param[in]       size        必要なサイズ[byte]
+ * @return          ブロック(確保できなければNULL)
+ */
+void *app_pool_alloc(app_pool_t *p_pool, uint16_t size);
+
+
+/**@brief ブロック解放
+ *
+ * 割込みからも呼べる。
+ *
+ * @param[in,out]   p_pool      app_pool_alloc()で確保したプール
+ * @param[in]       p_block     app_pool_alloc()で確保したブロック(NULLは無視)
+ */
+void app_pool_free(app_pool_t *p_pool, void *p_block);
+
+
+/**@brief 統計取得
+ *
+ * @param[in]   p_pool      プール
+ * @param[in]   cls         サイズクラス
+ * @param[out]  p_stats     統計
+ */
+void app_pool_stats_get(const app_pool_t *p_pool, app_pool_class_t cls, app_pool_stats_t *p_stats);
+
+#endif /* APP_POOL_H__ */
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_prepare.c
+ *
+ * Connectionイベント直前のデータ準備
+ *
+ * Radio Notification(sd_radio_notification_cfg_set)でRadio動作開始の少し前に
+ * 割込みを受け、登録されたハンドラでサンプリング・送信キューへの積込みを行う。
+ * いつ呼ばれるか分からないapp_ble_nofify()だと、データが古くなったり
+ * 直前のイベントに間に合わなかったりするため。
+ *
+ * 効果を確認するため、サンプリングしてからRadio動作開始までの時間を
+ * ヒストグラムで記録する(アライメント有無のどちらでも計測する)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_prepare.h"
+
+#include "app_util_platform.h"
+
+#include "app_ts.h"
+#include "app_log.h"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static app_prepare_handler_t            m_handler;
+static bool                             m_enabled;
+static bool                             m_connected;
+
+/** 通知からRadio動作開始までの時間[usec] */
+static uint32_t                         m_distance_us;
+
+/** 送信待ちサンプルの時刻[usec] */
+static uint32_t                         m_sample_ts;
+static volatile bool                    m_sample_pending;
+
+static uint16_t                         m_hist[APP_PREPARE_HIST_NUM];
+
+/** 接続中のRadio動作開始回数 */
+static volatile uint32_t                m_event_count;
+
+/** ヒストグラム区間の上限[msec] */
+static const uint16_t                   m_hist_limit[APP_PREPARE_HIST_NUM - 1] = {
+    1, 2, 5, 10, 50, 100, 500
+};
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint32_t distance_to_us(nrf_radio_notification_distance_t distance);
+static void hist_add(uint32_t us);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+uint32_t app_prepare_start(nrf_radio_notification_distance_t distance, app_prepare_handler_t handler)
+{
+    uint32_t err_code;
+
+    m_handler = handler;
+    m_distance_us = distance_to_us(distance);
+
+    err_code = sd_nvic_ClearPendingIRQ(RADIO_NOTIFICATION_IRQn);
+    if (err_code != NRF_SUCCESS) {
+        return err_code;
+    }
+    err_code = sd_nvic_SetPriority(RADIO_NOTIFICATION_IRQn, APP_IRQ_PRIORITY_LOW);
+    if (err_code != NRF_SUCCESS) {
+        return err_code;
+    }
+    err_code = sd_nvic_EnableIRQ(RADIO_NOTIFICATION_IRQn);
+    if (err_code != NRF_SUCCESS) {
+        return err_code;
+    }
+
+    err_code = sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE, distance);
+    if (err_code == NRF_SUCCESS) {
+        m_enabled = true;
+    }
+    return err_code;
+}
+
+
+uint32_t app_prepare_stop(void)
+{
+    uint32_t err_code;
+
+    m_enabled = false;
+    err_code = sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_NONE,
+                                             NRF_RADIO_NOTIFICATION_DISTANCE_NONE);
+    if (err_code != NRF_SUCCESS) {
+        return err_code;
+    }
+    return sd_nvic_DisableIRQ(RADIO_NOTIFICATION_IRQn);
+}
+
+
+void app_prepare_on_ble_evt(ble_evt_t *p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        m_connected = true;
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        m_connected = false;
+        m_sample_pending = false;
+        //接続ごとの遅延分布を出力しておく
+        APP_LOG("sample-to-air(<1,2,5,10,50,100,500ms,>=): %d %d %d %d %d %d %d %d",
+                    m_hist[0], m_hist[1], m_hist[2], m_hist[3],
+                    m_hist[4], m_hist[5], m_hist[6], m_hist[7]);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+void app_prepare_sample_mark(void)
+{
+    if (m_sample_pending) {
+        //まだ送信されていない古いサンプルの時刻を残す
+        return;
+    }
+    //app_timer_cnt_get()はタイマが動いていないとRTC1ごと止まっているので、app_tsを使う
+    m_sample_ts = app_ts_now();
+    m_sample_pending = true;
+}
+
+
+uint32_t app_prepare_event_count(void)
+{
+    return m_event_count;
+}
+
+
+void app_prepare_hist_get(uint16_t *p_hist)
+{
+    CRITICAL_REGION_ENTER();
+    memcpy(p_hist, m_hist, sizeof(m_hist));
+    CRITICAL_REGION_EXIT();
+}
+
+
+void app_prepare_hist_clear(void)
+{
+    CRITICAL_REGION_ENTER();
+    memset(m_hist, 0, sizeof(m_hist));
+    CRITICAL_REGION_EXIT();
+}
+
+
+/**************************************************************************
+ * interrupt
+ **************************************************************************/
+
+/**
+ * @brief Radio Notification割込み
+ *
+ * Radio動作開始のdistance前に呼ばれる。
+ * ハンドラで取ったサンプルも今回のイベントで送信されるので、ハンドラの後で締める
+ * (先に締めると、次のイベントまで1間隔分遅れたものとして数えてしまう)。
+ */
+void RADIO_NOTIFICATION_IRQHandler(void)
+{
+    if (!m_enabled || !m_connected) {
+        return;
+    }
+    m_event_count++;
+
+    if (m_handler != NULL) {
+        m_handler();
+    }
+
+    //前回のイベント以降に取ったサンプルは、今回のイベントで送信される
+    if (m_sample_pending) {
+        hist_add(app_ts_now() - m_sample_ts + m_distance_us);
+        m_sample_pending = false;
+    }
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 通知距離をusecに変換
+ */
+static uint32_t distance_to_us(nrf_radio_notification_distance_t distance)
+{
+    uint32_t usec;
+
+    switch (distance) {
+    case NRF_RADIO_NOTIFICATION_DISTANCE_800US:     usec = 800;     break;
+    case NRF_RADIO_NOTIFICATION_DISTANCE_1740US:    usec = 1740;    break;
+    case NRF_RADIO_NOTIFICATION_DISTANCE_2680US:    usec = 2680;    break;
+    case NRF_RADIO_NOTIFICATION_DISTANCE_3620US:    usec = 3620;    break;
+    default:                                        usec = 0;       break;
+    }
+    return usec;
+}
+
+
+/**
+ * @brief ヒストグラム加算
+ *
+ * @param[in]   us      sample-to-air遅延[usec]
+ */
+static void hist_add(uint32_t us)
+{
+    uint8_t lp;
+
+    for (lp = 0; lp < APP_PREPARE_HIST_NUM - 1; lp++) {
+        if (us < (uint32_t)m_hist_limit[lp] * 1000) {
+            break;
+        }
+    }
+    if (m_hist[lp] != UINT16_MAX) {
+        m_hist[lp]++;
+    }
+}
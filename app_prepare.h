@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_prepare.h
+ *
+ * Connectionイベント直前のデータ準備
+ */
+#ifndef APP_PREPARE_H__
+#define APP_PREPARE_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include "nrf_soc.h"
+#include "ble.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** sample-to-air遅延のヒストグラム区間数 */
+#define APP_PREPARE_HIST_NUM            (8)
+
+/** app_prepare_on_ble_evt()が扱うイベント(app_evtdisp) */
+#define APP_PREPARE_BLE_EVTS            BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief データ準備ハンドラ
+ *
+ * Connectionイベントの設定時間前にRADIO_NOTIFICATION_IRQ(SWI1)から呼ばれる。
+ * ここでサンプリングしてapp_ble_nofify()すれば、直後のイベントで送信される。
+ */
+typedef void (*app_prepare_handler_t)(void);
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief データ準備モード開始
+ *
+ * 接続中のみハンドラが呼ばれる。
+ *
+ * @param[in]   distance    Radio動作開始の何usec前に通知するか(NRF_RADIO_NOTIFICATION_DISTANCE_xxx)
+ * @param[in]   handler     データ準備ハンドラ(NULLなら遅延の計測のみ)
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t app_prepare_start(nrf_radio_notification_distance_t distance, app_prepare_handler_t handler);
+
+
+/**@brief データ準備モード停止
+ *
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t app_prepare_stop(void);
+
+
+/**@brief BLEイベントハンドラ
+ *
+ * app_ble_evt_dispatch()から呼び出すこと。
+ *
+ * @param[in]   p_ble_evt   BLEスタックイベント
+ */
+void app_prepare_on_ble_evt(ble_evt_t *p_ble_evt);
+
+
+/**@brief サンプリング時刻の記録
+ *
+ * データを取得したときに呼ぶ(データ準備モードかどうかによらない)。
+ * 次のRadio動作開始までの時間をヒストグラムに加算する。
+ */
+void app_prepare_sample_mark(void);
+
+
+/**@brief Connectionイベント数取得
+ *
+ * データ準備モード中に、接続中のRadio動作開始を数えたもの。
+ *
+ * @return      起動後の累計
+ */
+uint32_t app_prepare_event_count(void);
+
+
+/**@brief sample-to-air遅延のヒストグラム取得
+ *
+ * 区間は 1, 2, 5, 10, 50, 100, 500msec未満, それ以上。
+ *
+ * @param[out]  p_hist      APP_PREPARE_HIST_NUM個の度数
+ */
+void app_prepare_hist_get(uint16_t *p_hist);
+
+
+/**@brief ヒストグラムクリア */
+void app_prepare_hist_clear(void);
+
+#endif /* APP_PREPARE_H__ */
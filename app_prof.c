@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_prof.c
+ *
+ * PCサンプリングプロファイラ
+ *
+ * TIMER2を周期割込みにして、例外フレームに積まれたPC(割り込まれた場所)を
+ * アドレス範囲ごとのバケットで数える。
+ * xPSRのIPSRも見て、メインループか割込み中かを分ける。
+ * SoftDeviceの領域(APP_PROF_BASEより前)は1つにまとめる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "nrf.h"
+
+#include "app_prof.h"
+#include "app_wheel.h"
+
+#include "app_util_platform.h"
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 16MHz / 2^4 = 1MHz */
+#define PROF_TIMER_PRESCALER            (4)
+
+/** 例外フレームの位置 */
+#define FRAME_PC                        (6)
+#define FRAME_XPSR                      (7)
+
+#define IPSR_MASK                       (0x3f)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static uint16_t                         m_bucket[APP_PROF_BUCKET_NUM];
+static app_prof_summary_t               m_summary;
+static uint16_t                         m_period_us;
+static app_wheel_timer_t                m_dump_timer;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void dump_timeout_handler(void *p_context);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_prof_start(uint16_t period_us)
+{
+    app_prof_clear();
+    m_period_us = period_us;
+
+    NRF_TIMER2->TASKS_STOP = 1;
+    NRF_TIMER2->TASKS_CLEAR = 1;
+    NRF_TIMER2->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER2->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    NRF_TIMER2->PRESCALER = PROF_TIMER_PRESCALER;
+    NRF_TIMER2->CC[0] = period_us;
+    NRF_TIMER2->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+    NRF_TIMER2->EVENTS_COMPARE[0] = 0;
+    NRF_TIMER2->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+
+    NVIC_ClearPendingIRQ(TIMER2_IRQn);
+    NVIC_SetPriority(TIMER2_IRQn, APP_IRQ_PRIORITY_HIGH);
+    NVIC_EnableIRQ(TIMER2_IRQn);
+    NRF_TIMER2->TASKS_START = 1;
+
+    app_wheel_start(&m_dump_timer, APP_WHEEL_TICKS(APP_PROF_DUMP_SEC * 1000),
+                        APP_WHEEL_MODE_REPEATED, dump_timeout_handler, NULL);
+    APP_LOG("prof: start period=%uus", period_us);
+}
+
+
+void app_prof_stop(void)
+{
+    app_wheel_stop(&m_dump_timer);
+
+    NVIC_DisableIRQ(TIMER2_IRQn);
+    NRF_TIMER2->INTENCLR = TIMER_INTENSET_COMPARE0_Msk;
+    NRF_TIMER2->TASKS_STOP = 1;
+    NRF_TIMER2->TASKS_SHUTDOWN = 1;
+    m_period_us = 0;
+}
+
+
+void app_prof_clear(void)
+{
+    CRITICAL_REGION_ENTER();
+    memset(m_bucket, 0, sizeof(m_bucket));
+    memset(&m_summary, 0, sizeof(m_summary));
+    CRITICAL_REGION_EXIT();
+}
+
+
+void app_prof_dump(void)
+{
+    uint32_t idx[3];
+    uint32_t cnt[3];
+    uint8_t num = 0;
+    uint16_t lp;
+
+    APP_LOG("prof: hdr base=0x%x shift=%u period=%uus",
+                APP_PROF_BASE, APP_PROF_SHIFT, m_period_us);
+    APP_LOG("prof: sum total=%u thread=%u sd=%u out=%u",
+                m_summary.total, m_summary.thread, m_summary.sd, m_summary.out);
+
+    //ログ1件の引数は8個までなので、3バケットずつ出す
+    for (lp = 0; lp < APP_PROF_BUCKET_NUM; lp++) {
+        if (m_bucket[lp] == 0) {
+            continue;
+        }
+        idx[num] = lp;
+        cnt[num] = m_bucket[lp];
+        num++;
+        if (num == 3) {
+            APP_LOG("prof: b %u=%u %u=%u %u=%u", idx[0], cnt[0], idx[1], cnt[1], idx[2], cnt[2]);
+            num = 0;
+        }
+    }
+    if (num == 2) {
+        APP_LOG("prof: b %u=%u %u=%u", idx[0], cnt[0], idx[1], cnt[1]);
+    }
+    else if (num == 1) {
+        APP_LOG("prof: b %u=%u", idx[0], cnt[0]);
+    }
+}
+
+
+const uint16_t *app_prof_get(app_prof_summary_t *p_summary)
+{
+    CRITICAL_REGION_ENTER();
+    memcpy(p_summary, &m_summary, sizeof(app_prof_summary_t));
+    CRITICAL_REGION_EXIT();
+    return m_bucket;
+}
+
+
+/**
+ * @brief TIMER2割込み
+ *
+ * 例外フレームの位置を渡すため、MSPを読んでからC側を呼ぶ。
+ * このアプリはMSPしか使わない。
+ */
+void TIMER2_IRQHandler(void) __attribute__((naked));
+void TIMER2_IRQHandler(void)
+{
+    __asm volatile(
+        "   mrs     r0, msp             \n"
+        "   push    {lr}                \n"
+        "   bl      app_prof_on_irq     \n"
+        "   pop     {pc}                \n"
+    );
+}
+
+
+/**
+ * @brief TIMER2割込み(C側)
+ *
+ * @param[in]   p_frame     例外フレーム
+ */
+void app_prof_on_irq(const uint32_t *p_frame) __attribute__((used));
+void app_prof_on_irq(const uint32_t *p_frame)
+{
+    uint32_t pc = p_frame[FRAME_PC];
+    uint32_t offset;
+
+    NRF_TIMER2->EVENTS_COMPARE[0] = 0;
+    (void)NRF_TIMER2->EVENTS_COMPARE[0];    //書込み完了待ち(割込みの再発生防止)
+
+    m_summary.total++;
+    if ((p_frame[FRAME_XPSR] & IPSR_MASK) == 0) {
+        m_summary.thread++;
+    }
+    if (pc < APP_PROF_BASE) {
+        m_summary.sd++;
+        return;
+    }
+    offset = (pc - APP_PROF_BASE) >> APP_PROF_SHIFT;
+    if (offset >= APP_PROF_BUCKET_NUM) {
+        m_summary.out++;
+        return;
+    }
+    if (m_bucket[offset] != UINT16_MAX) {
+        m_bucket[offset]++;
+    }
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 定期出力
+ *
+ * @param[in]   p_context   未使用
+ */
+static void dump_timeout_handler(void *p_context)
+{
+    app_prof_dump();
+    app_prof_clear();
+}
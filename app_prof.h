@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_prof.h
+ *
+ * PCサンプリングプロファイラ
+ */
+#ifndef APP_PROF_H__
+#define APP_PROF_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 集計するアドレスの先頭(アプリ領域の先頭) */
+#define APP_PROF_BASE                   (0x18000)
+
+/** 1バケットのアドレス幅(2^n byte) */
+#define APP_PROF_SHIFT                  (9)
+
+/** バケット数(APP_PROF_BASEから 数 << APP_PROF_SHIFT byteを集計) */
+#define APP_PROF_BUCKET_NUM             (128)
+
+/** 標準のサンプリング周期[usec](他の周期処理と揃わないよう素数にする) */
+#define APP_PROF_PERIOD_US              (997)
+
+/** 結果をログに出して集計し直す周期[sec] */
+#define APP_PROF_DUMP_SEC               (10)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** 集計 */
+typedef struct {
+    uint32_t    total;          /**< サンプル数 */
+    uint32_t    thread;         /**< うちメインループ(割込み外) */
+    uint32_t    sd;             /**< うちAPP_PROF_BASEより前(SoftDevice, sd_app_evt_wait()の待ちを含む) */
+    uint32_t    out;            /**< うちバケットの範囲外 */
+} app_prof_summary_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief サンプリング開始
+ *
+ * TIMER2の割込み(APP_IRQ_PRIORITY_HIGH)で、割り込まれたPCを数える。
+ * 1回の割込みは数usecなので、周期1msecなら負荷は1%未満。
+ * SoftDeviceの割込み中とクリティカルセクション中は、抜けた直後にまとめて数えられる。
+ * APP_PROF_DUMP_SEC毎にapp_prof_dump()して集計し直す。
+ *
+ * @param[in]   period_us   サンプリング周期[usec](2～65535)
+ */
+void app_prof_start(uint16_t period_us);
+
+
+/**@brief サンプリング停止
+ */
+void app_prof_stop(void);
+
+
+/**@brief 集計クリア
+ */
+void app_prof_clear(void);
+
+
+/**@brief 集計をログに出す
+ *
+ * APP_LOGなので、UARTとLogキャラクタリスティックの両方に流れる。
+ * tools/profsym.pyでシンボルに対応付けられる。
+ */
+void app_prof_dump(void);
+
+
+/**@brief 集計取得
+ *
+ * @param[out]  p_summary   集計
+ * @return      バケット(APP_PROF_BUCKET_NUM個、65535で飽和)
+ */
+const uint16_t *app_prof_get(app_prof_summary_t *p_summary);
+
+#endif /* APP_PROF_H__ */
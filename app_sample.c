@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_sample.c
+ *
+ * 周期サンプリング
+ *
+ * TIMER2のCOMPARE[0]からPPIでADCを起動するので、変換開始にCPUは要らない。
+ * 変換完了割込みでは結果をリングに積むだけにして、
+ * メインループでブロック単位にまとめて処理する(割込みの中でBLE送信しない)。
+ * リングは割込みだけが書込み位置を、メインループだけが読出し位置を進めるので、
+ * 割込み禁止は要らない。
+ *
+ * Linuxでビルドした場合は周辺機能を使わず、app_sample_sim_convert()を変換完了の代わりにする。
+ *
+ * リングとブロックでRAMを約640byte使うので、ENABLE_SAMPLINGが無ければ何もビルドしない。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "app_sample.h"
+#include "app_ts.h"
+
+#include "nrf_error.h"
+#if !defined(__linux__)
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#endif
+
+#include "app_log.h"
+
+#ifdef ENABLE_SAMPLING
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 16MHz / 2^9 = 31250Hz(1count = 32usec) */
+#define SAMPLE_TIMER_PRESCALER          (9)
+#define SAMPLE_TIMER_HZ                 (31250)
+#define SAMPLE_TIMER_US                 (32)
+
+/** TIMER2 COMPARE[0] -> ADC START(0はapp_tsが使う) */
+#define SAMPLE_PPI_CH                   (1)
+
+#define RING_MASK                       (APP_SAMPLE_RING_SIZE - 1)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 割込みとメインループの間のリング */
+static int16_t                          m_ring[APP_SAMPLE_RING_SIZE];
+
+/** 書込み位置(割込みだけが進める) */
+static volatile uint16_t                m_wr;
+
+/** 読出し位置(メインループだけが進める) */
+static volatile uint16_t                m_rd;
+
+/** 最後に積んだサンプルの時刻[usec] */
+static volatile uint32_t                m_last_ts;
+
+/** ハンドラに渡すブロック(リングの折り返しをまたぐので、ここに並べ直す) */
+static int16_t                          m_block[APP_SAMPLE_BLOCK_MAX];
+
+static app_sample_handler_t             m_handler;
+static uint16_t                         m_block_size;
+static uint32_t                         m_period_us;
+
+static app_sample_stats_t               m_stats;
+
+/** 最後に統計をログに出した時刻[usec] */
+static uint32_t                         m_report_ts;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void sample_push(int16_t value);
+static void report(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+uint32_t app_sample_start(const app_sample_config_t *p_config, app_sample_handler_t handler)
+{
+    uint32_t cc;
+
+    if ((p_config->rate_hz == 0) || (APP_SAMPLE_RATE_MAX < p_config->rate_hz) ||
+      (p_config->block_size == 0) || (APP_SAMPLE_BLOCK_MAX < p_config->block_size) ||
+      (p_config->ain > 7) || (handler == NULL)) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    app_sample_stop();
+
+    cc = (SAMPLE_TIMER_HZ + p_config->rate_hz / 2) / p_config->rate_hz;
+    m_period_us = cc * SAMPLE_TIMER_US;
+    m_block_size = p_config->block_size;
+    m_rd = m_wr;
+    m_stats.samples = 0;
+    m_stats.overruns = 0;
+    m_stats.blocks = 0;
+    m_stats.isr_us = 0;
+    m_stats.proc_us = 0;
+    m_report_ts = app_ts_now();
+    m_handler = handler;
+
+#if !defined(__linux__)
+    {
+        uint32_t err_code;
+
+        NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
+                          (ADC_CONFIG_INPSEL_AnalogInputOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                          (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos) |
+                          ((1UL << p_config->ain) << ADC_CONFIG_PSEL_Pos) |
+                          (ADC_CONFIG_EXTREFSEL_None << ADC_CONFIG_EXTREFSEL_Pos);
+        NRF_ADC->EVENTS_END = 0;
+        NRF_ADC->INTENSET = ADC_INTENSET_END_Msk;
+        NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Enabled;
+        NVIC_ClearPendingIRQ(ADC_IRQn);
+        NVIC_SetPriority(ADC_IRQn, APP_IRQ_PRIORITY_LOW);
+        NVIC_EnableIRQ(ADC_IRQn);
+
+        err_code = sd_ppi_channel_assign(SAMPLE_PPI_CH, &NRF_TIMER2->EVENTS_COMPARE[0], &NRF_ADC->TASKS_START);
+        APP_ERROR_CHECK(err_code);
+        err_code = sd_ppi_channel_enable_set(1UL << SAMPLE_PPI_CH);
+        APP_ERROR_CHECK(err_code);
+
+        NRF_TIMER2->TASKS_CLEAR = 1;
+        NRF_TIMER2->MODE = TIMER_MODE_MODE_Timer;
+        NRF_TIMER2->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+        NRF_TIMER2->PRESCALER = SAMPLE_TIMER_PRESCALER;
+        NRF_TIMER2->CC[0] = cc;
+        NRF_TIMER2->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+        NRF_TIMER2->EVENTS_COMPARE[0] = 0;
+        NRF_TIMER2->TASKS_START = 1;
+    }
+#endif  //__linux__
+
+    APP_LOG("sample: start period=%uus block=%u", m_period_us, m_block_size);
+    return NRF_SUCCESS;
+}
+
+
+void app_sample_stop(void)
+{
+    if (m_handler == NULL) {
+        return;
+    }
+
+#if !defined(__linux__)
+    {
+        uint32_t err_code;
+
+        NRF_TIMER2->TASKS_STOP = 1;
+        err_code = sd_ppi_channel_enable_clr(1UL << SAMPLE_PPI_CH);
+        APP_ERROR_CHECK(err_code);
+        NVIC_DisableIRQ(ADC_IRQn);
+        NRF_ADC->INTENCLR = ADC_INTENCLR_END_Msk;
+        NRF_ADC->TASKS_STOP = 1;
+        NRF_ADC->ENABLE = ADC_ENABLE_ENABLE_Disabled;
+    }
+#endif  //__linux__
+
+    m_handler = NULL;
+    m_period_us = 0;
+    m_rd = m_wr;
+}
+
+
+uint32_t app_sample_period_us(void)
+{
+    return m_period_us;
+}
+
+
+void app_sample_poll(void)
+{
+    uint16_t wr;
+    uint16_t rd;
+    uint16_t lp;
+    uint32_t ts;
+    uint32_t start;
+
+    if (m_handler == NULL) {
+        return;
+    }
+
+    while (true) {
+        //割込みに挟まれたら読み直す(書込み位置と時刻の組を揃える)
+        do {
+            wr = m_wr;
+            ts = m_last_ts;
+        } while (wr != m_wr);
+        rd = m_rd;
+        if ((uint16_t)(wr - rd) < m_block_size) {
+            break;
+        }
+
+        start = app_ts_now();
+
+        //先頭サンプルの時刻は、最後に積んだサンプルから周期で戻って求める
+        ts -= (uint32_t)(uint16_t)(wr - 1 - rd) * m_period_us;
+        for (lp = 0; lp < m_block_size; lp++) {
+            m_block[lp] = m_ring[(uint16_t)(rd + lp) & RING_MASK];
+        }
+        //並べ直したので、ハンドラを呼ぶ前にリングを空ける
+        m_rd = rd + m_block_size;
+
+        m_handler(m_block, m_block_size, ts);
+        m_stats.blocks++;
+        m_stats.proc_us += app_ts_now() - start;
+    }
+
+    report();
+}
+
+
+void app_sample_stats_get(app_sample_stats_t *p_stats)
+{
+    *p_stats = m_stats;
+}
+
+
+#if defined(__linux__)
+
+void app_sample_sim_convert(int16_t value)
+{
+    if (m_handler != NULL) {
+        sample_push(value);
+    }
+}
+
+#else
+
+/**
+ * @brief ADC変換完了割込み
+ */
+void ADC_IRQHandler(void)
+{
+    NRF_ADC->EVENTS_END = 0;
+    sample_push((int16_t)NRF_ADC->RESULT);
+}
+
+#endif  //__linux__
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief リングに積む
+ *
+ * 変換完了割込みから呼ばれる。一杯なら捨てて数える。
+ * 捨てた後は時刻に隙間ができるので、その前後のサンプルの時刻はずれる。
+ *
+ * @param[in]   value   変換結果
+ */
+static void sample_push(int16_t value)
+{
+    uint32_t start = app_ts_now();
+    uint16_t wr = m_wr;
+
+    m_stats.samples++;
+    if ((uint16_t)(wr - m_rd) >= APP_SAMPLE_RING_SIZE) {
+        m_stats.overruns++;
+    }
+    else {
+        m_ring[wr & RING_MASK] = value;
+        m_last_ts = start;
+        m_wr = wr + 1;
+    }
+    m_stats.isr_us += app_ts_now() - start;
+}
+
+
+/**
+ * @brief 統計をログに出す
+ *
+ * APP_SAMPLE_REPORT_SEC毎。1サンプルあたりの処理時間は割込みとブロック処理の合計。
+ */
+static void report(void)
+{
+    uint32_t now = app_ts_now();
+    uint32_t cost_ns = 0;
+
+    if (now - m_report_ts < APP_SAMPLE_REPORT_SEC * 1000000UL) {
+        return;
+    }
+    m_report_ts = now;
+
+    if (m_stats.samples != 0) {
+        cost_ns = (uint32_t)(((uint64_t)m_stats.isr_us + m_stats.proc_us) * 1000 / m_stats.samples);
+    }
+    APP_LOG("sample: n=%u ovr=%u blk=%u cost=%uns/sample",
+                m_stats.samples, m_stats.overruns, m_stats.blocks, cost_ns);
+}
+
+#endif  //ENABLE_SAMPLING
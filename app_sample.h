@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_sample.h
+ *
+ * 周期サンプリング
+ */
+#ifndef APP_SAMPLE_H__
+#define APP_SAMPLE_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 割込みとメインループの間のリングのサンプル数(2のべき乗) */
+#define APP_SAMPLE_RING_SIZE            (256)
+
+/** 1ブロックの最大サンプル数 */
+#define APP_SAMPLE_BLOCK_MAX            (64)
+
+/** サンプリング周波数の上限[Hz](10bit変換は約68usec) */
+#define APP_SAMPLE_RATE_MAX             (4000)
+
+/** 統計をログに出す間隔[sec] */
+#define APP_SAMPLE_REPORT_SEC           (10)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** 設定 */
+typedef struct {
+    uint16_t    rate_hz;        /**< サンプリング周波数[Hz](1～APP_SAMPLE_RATE_MAX) */
+    uint16_t    block_size;     /**< 1ブロックのサンプル数(1～APP_SAMPLE_BLOCK_MAX) */
+    uint8_t     ain;            /**< ADC入力(0～7 : AIN0～AIN7) */
+} app_sample_config_t;
+
+
+/**
+ * @brief ブロック処理ハンドラ
+ *
+ * メインループから呼ばれる。
+ *
+ * @param[in]   p_samples   サンプル(ADCの値, 10bit)
+ * @param[in]   num         サンプル数(block_size)
+ * @param[in]   ts          先頭サンプルの時刻[usec](app_ts_now()基準)
+ */
+typedef void (*app_sample_handler_t)(const int16_t *p_samples, uint16_t num, uint32_t ts);
+
+
+/** 統計 */
+typedef struct {
+    uint32_t    samples;        /**< 変換したサンプル数 */
+    uint32_t    overruns;       /**< リングが一杯で捨てたサンプル数 */
+    uint32_t    blocks;         /**< 処理したブロック数 */
+    uint32_t    isr_us;         /**< 割込み処理時間の合計[usec](計測自体を含む) */
+    uint32_t    proc_us;        /**< ブロック処理時間の合計[usec](ハンドラを含む) */
+} app_sample_stats_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief サンプリング開始
+ *
+ * TIMER2のCOMPARE[0]からPPIでADCの変換を開始し、変換完了割込みでリングに積む。
+ * TIMER2はapp_profと共用なので、ENABLE_PROFILERと同時には使えない。
+ * ENABLE_SAMPLINGを定義したときだけビルドされる。
+ *
+ * @param[in]   p_config    設定
+ * @param[in]   handler     ブロック処理ハンドラ
+ * @retval      NRF_SUCCESS 成功
+ * @retval      NRF_ERROR_INVALID_PARAM     設定が範囲外
+ */
+uint32_t app_sample_start(const app_sample_config_t *p_config, app_sample_handler_t handler);
+
+
+/**@brief サンプリング停止
+ *
+ * リングに残っているサンプルは捨てる。
+ */
+void app_sample_stop(void);
+
+
+/**@brief サンプリング周期[usec]
+ *
+ * TIMER2の分解能(32usec)に丸めた値。
+ *
+ * @return      周期[usec](停止中は0)
+ */
+uint32_t app_sample_period_us(void);
+
+
+/**@brief ブロック処理
+ *
+ * メインループで呼ぶ。リングにblock_size個以上あれば、ブロック単位でハンドラに渡す。
+ */
+void app_sample_poll(void);
+
+
+/**@brief 統計取得
+ *
+ * @param[out]  p_stats     統計
+ */
+void app_sample_stats_get(app_sample_stats_t *p_stats);
+
+
+#if defined(__linux__)
+/**@brief 変換完了(シミュレーション)
+ *
+ * Linuxでは周辺機能が無いので、ADCの変換完了割込みの代わりにこれを呼ぶ。
+ *
+ * @param[in]   value   変換結果
+ */
+void app_sample_sim_convert(int16_t value);
+#endif  //__linux__
+
+#endif /* APP_SAMPLE_H__ */
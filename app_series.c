@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_series.c
+ *
+ * 時系列バッファ(圧縮)
+ *
+ * Centralがいない間のサンプルを、少ないRAMでなるべく長く保持する。
+ * 一定周期のサンプリングなら時刻の差分の差分はほぼ0、
+ * ゆっくり変わる値なら前の値とのXORは下位bitだけになるので、
+ * どちらも1byteのvarintに収まることが多い(生の時刻+値は8byte)。
+ * 固定長ブロックのリングにして、古い方からブロック単位で捨てる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "app_series.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** varintの最大byte数(uint32_t) */
+#define VARINT_MAX                      (5)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static app_series_block_t               m_blocks[APP_SERIES_BLOCK_NUM];
+
+/** 最も古いブロック */
+static uint8_t                          m_head;
+
+/** 使用中のブロック数 */
+static uint8_t                          m_num;
+
+/** 末尾ブロックの符号化状態 */
+static uint32_t                         m_prev_ts;
+static int32_t                          m_prev_delta;
+static uint32_t                         m_prev_val;
+
+static uint32_t                         m_dropped;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void block_start(uint32_t ts, uint32_t val);
+static uint8_t varint_put(uint8_t *p_buf, uint32_t value);
+static uint32_t varint_get(const uint8_t *p_buf, uint16_t *p_pos);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_series_init(void)
+{
+    m_head = 0;
+    m_num = 0;
+    m_dropped = 0;
+}
+
+
+void app_series_append(uint32_t ts, uint32_t val)
+{
+    app_series_block_t *p_blk;
+    uint8_t  buf[VARINT_MAX * 2];
+    uint8_t  len;
+    int32_t  delta;
+    int32_t  dod;
+
+    if (m_num == 0) {
+        block_start(ts, val);
+        return;
+    }
+
+    delta = (int32_t)(ts - m_prev_ts);
+    dod = delta - m_prev_delta;
+    len = varint_put(buf, ((uint32_t)dod << 1) ^ (uint32_t)(dod >> 31));
+    len += varint_put(&buf[len], val ^ m_prev_val);
+
+    p_blk = &m_blocks[(m_head + m_num - 1) % APP_SERIES_BLOCK_NUM];
+    if ((p_blk->len + len > sizeof(p_blk->data)) || (p_blk->count == UINT16_MAX)) {
+        block_start(ts, val);
+        return;
+    }
+    memcpy(&p_blk->data[p_blk->len], buf, len);
+    p_blk->len += len;
+    p_blk->count++;
+
+    m_prev_ts = ts;
+    m_prev_delta = delta;
+    m_prev_val = val;
+}
+
+
+void app_series_iter_init(app_series_iter_t *p_it)
+{
+    memset(p_it, 0, sizeof(app_series_iter_t));
+}
+
+
+bool app_series_iter_next(app_series_iter_t *p_it, uint32_t *p_ts, uint32_t *p_val)
+{
+    const app_series_block_t *p_blk;
+    uint32_t zz;
+
+    while (p_it->block < m_num) {
+        p_blk = &m_blocks[(m_head + p_it->block) % APP_SERIES_BLOCK_NUM];
+        if (p_it->index < p_blk->count) {
+            break;
+        }
+        //次のブロックへ
+        p_it->block++;
+        p_it->index = 0;
+        p_it->pos = 0;
+    }
+    if (p_it->block >= m_num) {
+        return false;
+    }
+
+    if (p_it->index == 0) {
+        p_it->ts = p_blk->ts0;
+        p_it->delta = 0;
+        p_it->val = p_blk->val0;
+    }
+    else {
+        zz = varint_get(p_blk->data, &p_it->pos);
+        p_it->delta += (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+        p_it->ts += (uint32_t)p_it->delta;
+        p_it->val ^= varint_get(p_blk->data, &p_it->pos);
+    }
+    p_it->index++;
+
+    *p_ts = p_it->ts;
+    *p_val = p_it->val;
+    return true;
+}
+
+
+uint16_t app_series_oldest_count(void)
+{
+    return (m_num != 0) ? m_blocks[m_head].count : 0;
+}
+
+
+uint16_t app_series_drop_oldest(void)
+{
+    uint16_t count;
+
+    if (m_num == 0) {
+        return 0;
+    }
+    count = m_blocks[m_head].count;
+    m_head = (m_head + 1) % APP_SERIES_BLOCK_NUM;
+    m_num--;
+    return count;
+}
+
+
+void app_series_stats_get(app_series_stats_t *p_stats)
+{
+    uint8_t lp;
+
+    p_stats->samples = 0;
+    for (lp = 0; lp < m_num; lp++) {
+        p_stats->samples += m_blocks[(m_head + lp) % APP_SERIES_BLOCK_NUM].count;
+    }
+    p_stats->blocks = m_num;
+    p_stats->dropped = m_dropped;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 新しいブロックを始める
+ *
+ * 空きが無ければ最も古いブロックを捨てる。
+ *
+ * @param[in]   ts      先頭サンプルの時刻
+ * @param[in]   val     先頭サンプルの値
+ */
+static void block_start(uint32_t ts, uint32_t val)
+{
+    app_series_block_t *p_blk;
+
+    if (m_num == APP_SERIES_BLOCK_NUM) {
+        m_dropped += app_series_drop_oldest();
+    }
+    p_blk = &m_blocks[(m_head + m_num) % APP_SERIES_BLOCK_NUM];
+    m_num++;
+
+    p_blk->ts0 = ts;
+    p_blk->val0 = val;
+    p_blk->count = 1;
+    p_blk->len = 0;
+
+    m_prev_ts = ts;
+    m_prev_delta = 0;
+    m_prev_val = val;
+}
+
+
+/**
+ * @brief varint書込み
+ *
+ * 下位から7bitずつ、続きがあればbit7を立てる。
+ *
+ * @param[out]  p_buf   書込み先(VARINT_MAX byte以上)
+ * @param[in]   value   値
+ * @return      書き込んだbyte数
+ */
+static uint8_t varint_put(uint8_t *p_buf, uint32_t value)
+{
+    uint8_t len = 0;
+
+    while (value >= 0x80) {
+        p_buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p_buf[len++] = (uint8_t)value;
+    return len;
+}
+
+
+/**
+ * @brief varint読出し
+ *
+ * @param[in]       p_buf   読出し元
+ * @param[in,out]   p_pos   読出し位置
+ * @return          値
+ */
+static uint32_t varint_get(const uint8_t *p_buf, uint16_t *p_pos)
+{
+    uint32_t value = 0;
+    uint8_t  shift = 0;
+    uint8_t  b;
+
+    do {
+        b = p_buf[(*p_pos)++];
+        value |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return value;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_series.h
+ *
+ * 時系列バッファ(圧縮)
+ */
+#ifndef APP_SERIES_H__
+#define APP_SERIES_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 1ブロックのbyte数(4の倍数) */
+#define APP_SERIES_BLOCK_SIZE           (128)
+
+/** ブロック数 */
+#define APP_SERIES_BLOCK_NUM            (8)
+
+/** ブロックヘッダのbyte数 */
+#define APP_SERIES_BLOCK_HDR            (12)
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief ブロック
+ *
+ * 先頭サンプルはそのまま持ち、2つ目以降はdataに可変長で詰める。
+ *   時刻 : 差分の差分(delta-of-delta)をzigzag + varint
+ *   値   : 1つ前の値とのXORをvarint
+ * 中身は触らないこと。
+ */
+typedef struct {
+    uint32_t    ts0;            /**< 先頭サンプルの時刻 */
+    uint32_t    val0;           /**< 先頭サンプルの値 */
+    uint16_t    count;          /**< サンプル数 */
+    uint16_t    len;            /**< dataの使用byte数 */
+    uint8_t     data[APP_SERIES_BLOCK_SIZE - APP_SERIES_BLOCK_HDR];
+} app_series_block_t;
+
+
+/**
+ * @brief 読出し位置
+ *
+ * app_series_iter_init()で初期化する。中身は触らないこと。
+ */
+typedef struct {
+    uint8_t     block;          /**< 読んでいるブロック(古い方から何番目か) */
+    uint16_t    index;          /**< ブロック内のサンプル番号 */
+    uint16_t    pos;            /**< data内の位置 */
+    uint32_t    ts;             /**< 直前に読んだ時刻 */
+    int32_t     delta;          /**< 直前に読んだ時刻の差分 */
+    uint32_t    val;            /**< 直前に読んだ値 */
+} app_series_iter_t;
+
+
+/** 統計 */
+typedef struct {
+    uint32_t    samples;        /**< 保持しているサンプル数 */
+    uint8_t     blocks;         /**< 使用中のブロック数 */
+    uint32_t    dropped;        /**< 満杯で捨てたサンプル数 */
+} app_series_stats_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化(全部捨てる)
+ */
+void app_series_init(void);
+
+
+/**@brief サンプル追加
+ *
+ * 末尾ブロックに入らなければ次のブロックに進む。
+ * ブロックが無ければ最も古いブロックを捨てる。
+ * 時刻の単位は呼出し側で決めてよいが、単調増加にすること。
+ * メインループ(スケジューラ)から呼ぶこと。
+ *
+ * @param[in]   ts      時刻
+ * @param[in]   val     値
+ */
+void app_series_append(uint32_t ts, uint32_t val);
+
+
+/**@brief 読出し開始
+ *
+ * 最も古いサンプルから読む。
+ * app_series_drop_oldest()/app_series_init()を呼んだら初期化し直すこと。
+ *
+ * @param[out]  p_it    読出し位置
+ */
+void app_series_iter_init(app_series_iter_t *p_it);
+
+
+/**@brief 次のサンプルを読む
+ *
+ * @param[in,out]   p_it    読出し位置
+ * @param[out]      p_ts    時刻
+ * @param[out]      p_val   値
+ * @retval          true    読み出した
+ * @retval          false   もう無い
+ */
+bool app_series_iter_next(app_series_iter_t *p_it, uint32_t *p_ts, uint32_t *p_val);
+
+
+/**@brief 最も古いブロックのサンプル数
+ *
+ * 送信側はこの数だけ読んで送り終えたら、app_series_drop_oldest()で捨てる。
+ *
+ * @return      サンプル数(空なら0)
+ */
+uint16_t app_series_oldest_count(void);
+
+
+/**@brief 最も古いブロックを捨てる
+ *
+ * @return      捨てたサンプル数
+ */
+uint16_t app_series_drop_oldest(void);
+
+
+/**@brief 統計取得
+ *
+ * @param[out]  p_stats     統計
+ */
+void app_series_stats_get(app_series_stats_t *p_stats);
+
+#endif /* APP_SERIES_H__ */
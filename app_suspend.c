@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_suspend.c
+ *
+ * System OFFからの高速復帰
+ *
+ * System OFFからはリセットで起き上がるので、状態は保持RAM(.noinit)に置く。
+ * .noinitのあるRAMブロック1はSystem OFF中も保持させる(RAMONのOFFRAM1)。
+ *
+ * 保持RAMのレイアウト(word単位):
+ *      [id | size << 16][data(sizeを4byte境界まで)]...
+ *
+ * 復帰要因:
+ *  - WAKE_PIN_NO(boards.h)が0以上ならそのピンのLOW
+ *  - LPCOMP_ENABLED(nrf_drv_config.h)が1ならLPCOMP_CONFIG_xxxの設定
+ * どちらも無ければリセットでしか起きないので、状態は保持せずに従来通りSystem OFFにする。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <string.h>
+
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_gpio.h"
+#include "nrf_drv_config.h"
+#if (LPCOMP_ENABLED == 1)
+#include "nrf_lpcomp.h"
+#endif  //LPCOMP_ENABLED
+#include "boards.h"
+
+#include "app_suspend.h"
+
+#include "app_error.h"
+
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define SUSPEND_MAGIC                   (0x53555350)    //"SUSP"
+
+/** 保持領域[word] */
+#define SUSPEND_AREA_WORDS              (48)
+
+#define WORDS(size)                     (((size) + 3) / 4)
+
+/** 復帰要因が設定されているかどうか */
+#define SUSPEND_HAS_WAKE_SOURCE         ((WAKE_PIN_NO >= 0) || (LPCOMP_ENABLED == 1))
+
+/** 復帰要因として見るRESETREAS */
+#define WAKE_REASON_MASK                (POWER_RESETREAS_OFF_Msk | POWER_RESETREAS_LPCOMP_Msk)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    check;          /**< dataのチェックサム */
+    uint32_t    words;          /**< dataの使用量[word] */
+    uint32_t    data[SUSPEND_AREA_WORDS];
+} retained_t;
+
+static retained_t                       m_retained __attribute__((section(".noinit")));
+
+typedef struct {
+    void                    *p_data;
+    uint16_t                size;
+    app_suspend_can_save_t  can_save;
+} block_t;
+
+static block_t                          m_block[APP_SUSPEND_ID_MAX];
+
+static bool                             m_resume;
+static uint32_t                         m_wake_reason;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint32_t checksum(const uint32_t *p_data, uint32_t words);
+static void retained_save(void);
+static void wakeup_config(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_suspend_init(void)
+{
+    m_wake_reason = NRF_POWER->RESETREAS & WAKE_REASON_MASK;
+    NRF_POWER->RESETREAS = m_wake_reason;      //1を書いてクリア
+
+    m_resume = (m_wake_reason != 0) &&
+               (m_retained.magic == SUSPEND_MAGIC) &&
+               (m_retained.words <= SUSPEND_AREA_WORDS) &&
+               (m_retained.check == checksum(m_retained.data, m_retained.words));
+
+    //次にSystem OFF以外から起きたときに使わないよう、無効にしておく(中身は残す)
+    m_retained.magic = 0;
+
+#if !SUSPEND_HAS_WAKE_SOURCE
+    APP_LOG("suspend: no wake source, resume disabled");
+#endif  //SUSPEND_HAS_WAKE_SOURCE
+}
+
+
+bool app_suspend_is_resume(void)
+{
+    return m_resume;
+}
+
+
+uint32_t app_suspend_wake_reason(void)
+{
+    return m_wake_reason;
+}
+
+
+bool app_suspend_attach(app_suspend_id_t id, void *p_data, uint16_t size, app_suspend_can_save_t can_save)
+{
+    uint32_t pos = 0;
+    uint32_t hdr;
+
+    m_block[id].p_data = p_data;
+    m_block[id].size = size;
+    m_block[id].can_save = can_save;
+
+    if (!m_resume) {
+        return false;
+    }
+    while (pos < m_retained.words) {
+        hdr = m_retained.data[pos++];
+        if (hdr == (id | ((uint32_t)size << 16))) {
+            memcpy(p_data, &m_retained.data[pos], size);
+            return true;
+        }
+        pos += WORDS(hdr >> 16);
+    }
+    return false;
+}
+
+
+void app_suspend_enter(void)
+{
+    uint32_t err_code;
+
+    if (!SUSPEND_HAS_WAKE_SOURCE) {
+        //起きるのはリセットだけで、復帰としては扱われないので保持しない
+        APP_LOG("suspend: no wake source, plain system off");
+        app_log_flush();
+    }
+    else {
+        retained_save();
+        wakeup_config();
+
+        //.noinitのあるRAMブロック1を保持する
+        err_code = sd_power_ramon_set(POWER_RAMON_OFFRAM1_Msk);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    err_code = sd_power_system_off();
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief チェックサム
+ *
+ * @param[in]   p_data      データ
+ * @param[in]   words       データ長[word]
+ * @return      チェックサム
+ */
+static uint32_t checksum(const uint32_t *p_data, uint32_t words)
+{
+    uint32_t sum = SUSPEND_MAGIC;
+
+    while (words--) {
+        sum = (sum << 1 | sum >> 31) + *p_data++;
+    }
+    return sum;
+}
+
+
+/**
+ * @brief 登録された状態を保持RAMに保存
+ */
+static void retained_save(void)
+{
+    uint32_t pos = 0;
+    uint8_t id;
+    const block_t *p_block;
+
+    for (id = 0; id < APP_SUSPEND_ID_MAX; id++) {
+        p_block = &m_block[id];
+        if ((p_block->p_data == NULL) ||
+          ((p_block->can_save != NULL) && !p_block->can_save())) {
+            continue;
+        }
+        if (pos + 1 + WORDS(p_block->size) > SUSPEND_AREA_WORDS) {
+            //入らなければ、復帰時に再計算してもらう
+            continue;
+        }
+        m_retained.data[pos++] = id | ((uint32_t)p_block->size << 16);
+        memcpy(&m_retained.data[pos], p_block->p_data, p_block->size);
+        pos += WORDS(p_block->size);
+    }
+    m_retained.words = pos;
+    m_retained.check = checksum(m_retained.data, pos);
+    m_retained.magic = SUSPEND_MAGIC;
+}
+
+
+/**
+ * @brief 復帰要因設定
+ */
+static void wakeup_config(void)
+{
+#if (WAKE_PIN_NO >= 0)
+    nrf_gpio_cfg_sense_input(WAKE_PIN_NO, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+#endif  //WAKE_PIN_NO
+
+#if (LPCOMP_ENABLED == 1)
+    NRF_LPCOMP->PSEL = LPCOMP_CONFIG_INPUT;
+    NRF_LPCOMP->REFSEL = LPCOMP_CONFIG_REFERENCE;
+    NRF_LPCOMP->ANADETECT = LPCOMP_CONFIG_DETECTION;
+    NRF_LPCOMP->ENABLE = LPCOMP_ENABLE_ENABLE_Enabled;
+    NRF_LPCOMP->TASKS_START = 1;
+#endif  //LPCOMP_ENABLED
+}
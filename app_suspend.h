@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_suspend.h
+ *
+ * System OFFからの高速復帰
+ */
+#ifndef APP_SUSPEND_H__
+#define APP_SUSPEND_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**
+ * @brief 保持する状態
+ *
+ * 保持RAMにはIDとサイズを付けて置くので、順番を変えても構わない。
+ */
+typedef enum {
+    APP_SUSPEND_ID_CFG,                 /**< app_cfgのRAMインデックス */
+    APP_SUSPEND_ID_BOND,                /**< ボンディング情報(app_ble) */
+    //
+    APP_SUSPEND_ID_MAX
+} app_suspend_id_t;
+
+
+/**@brief 保存可否
+ *
+ * System OFFに入る直前に呼ばれる。
+ *
+ * @retval  true    保存してよい(状態が一貫している)
+ */
+typedef bool (*app_suspend_can_save_t)(void);
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * main()の先頭(SoftDevice有効化前)で呼ぶ。リセット要因を読んで、復帰かどうかを判定する。
+ */
+void app_suspend_init(void);
+
+
+/**@brief System OFFからの復帰かどうか
+ *
+ * @retval  true    保持していた状態がある
+ */
+bool app_suspend_is_resume(void);
+
+
+/**@brief 復帰要因
+ *
+ * @return  リセット要因(NRF_POWER->RESETREASのOFF/LPCOMP bit)
+ */
+uint32_t app_suspend_wake_reason(void);
+
+
+/**@brief 状態の登録と復元
+ *
+ * 各モジュールの初期化で呼ぶ。System OFFに入るときに保存され、
+ * 復帰時にはここで書き戻す。
+ *
+ * @param[in]       id          ID
+ * @param[in,out]   p_data      状態
+ * @param[in]       size        状態のサイズ[byte]
+ * @param[in]       can_save    保存可否(NULLなら常に保存する)
+ * @retval          true        書き戻した(再計算不要)
+ */
+bool app_suspend_attach(app_suspend_id_t id, void *p_data, uint16_t size, app_suspend_can_save_t can_save);
+
+
+/**@brief System OFF
+ *
+ * 登録された状態を保持RAMに保存し、復帰要因を設定してSystem OFFにする。
+ * 復帰要因が設定されていなければ(WAKE_PIN_NOが負、かつLPCOMP_ENABLEDが0)、
+ * 保存せずにそのままSystem OFFにする。
+ * 戻ってこない。
+ */
+void app_suspend_enter(void);
+
+#endif /* APP_SUSPEND_H__ */
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_ts.c
+ *
+ * usec単位のタイムスタンプ
+ *
+ * RTC1(32768Hz)の数に、TIMER1(1MHz)で測った「直前のRTC tickからの経過」を足す。
+ * PPIでRTC1のTICKイベントからTIMER1をクリアするので、TIMER1は30usec程度しか数えず、
+ * 16bitでも一周しない。RTCとTIMERの値を同じtick内で読めたときだけ採用する。
+ *
+ * TIMER1/PPI/TICKイベントはapp_ts_request()中だけ動かす。
+ *
+ * app_timerは動作中のタイマが無いとRTC1を止めるので、app_ts_init()で
+ * 長周期のタイマを1つ動かしておく(止まるとTICKも来ないので、TIMER1も30で張り付く)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdbool.h>
+
+#include "app_ts.h"
+
+#if defined(__linux__)
+#include <time.h>
+#else
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "app_timer.h"
+#endif
+
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 16MHz / 2^4 = 1MHz */
+#define TS_TIMER_PRESCALER              (4)
+
+/** RTC TICK -> TIMER1 CLEAR */
+#define TS_PPI_CH                       (0)
+
+/** RTC1 COUNTERは24bit */
+#define RTC_MASK                        (0x00ffffff)
+
+/** 1 RTC tick[usec] = 15625 / 512 */
+#define RTC_TO_US(ticks)                ((uint32_t)(((uint64_t)(ticks) * 15625) >> 9))
+
+/** 1 RTC tick内のTIMER1の最大値 */
+#define TS_FINE_MAX                     (30)
+
+/** オーバーヘッド計測回数 */
+#define TS_CALIB_NUM                    (8)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static uint8_t                          m_req_cnt;
+static uint32_t                         m_overhead;
+static bool                             m_calibrated;
+
+#if !defined(__linux__)
+static uint64_t                         m_rtc_ticks;    /**< RTC1の拡張カウント */
+static uint32_t                         m_rtc_last;
+static uint32_t                         m_last;         /**< 最後に返した値 */
+static app_timer_id_t                   m_keepalive_timer_id;
+#endif
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void calibrate(void);
+#if !defined(__linux__)
+static void keepalive_timeout_handler(void *p_context);
+#endif
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+#if defined(__linux__)
+
+void app_ts_init(void)
+{
+}
+
+
+uint32_t app_ts_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+
+void app_ts_request(void)
+{
+    m_req_cnt++;
+    if (!m_calibrated) {
+        calibrate();
+    }
+}
+
+
+void app_ts_release(void)
+{
+    if (m_req_cnt != 0) {
+        m_req_cnt--;
+    }
+}
+
+#else
+
+void app_ts_init(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_keepalive_timer_id, APP_TIMER_MODE_REPEATED, keepalive_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_start(m_keepalive_timer_id, APP_TIMER_TICKS(APP_TS_KEEPALIVE_MS, 0), NULL);
+    APP_ERROR_CHECK(err_code);
+
+    //ここまでの経過を捨てて、今のCOUNTERから数える
+    CRITICAL_REGION_ENTER();
+    m_rtc_last = NRF_RTC1->COUNTER;
+    CRITICAL_REGION_EXIT();
+}
+
+
+uint32_t app_ts_now(void)
+{
+    uint32_t now;
+    uint32_t c1;
+    uint32_t c2;
+    uint32_t fine = 0;
+
+    CRITICAL_REGION_ENTER();
+    if (m_req_cnt != 0) {
+        //TIMER1のクリアとRTCのカウントアップをまたいだら読み直す
+        do {
+            c1 = NRF_RTC1->COUNTER;
+            NRF_TIMER1->TASKS_CAPTURE[0] = 1;
+            fine = NRF_TIMER1->CC[0];
+            c2 = NRF_RTC1->COUNTER;
+        } while (c1 != c2);
+        if (fine > TS_FINE_MAX) {
+            fine = TS_FINE_MAX;
+        }
+    }
+    else {
+        c1 = NRF_RTC1->COUNTER;
+    }
+    m_rtc_ticks += (c1 - m_rtc_last) & RTC_MASK;
+    m_rtc_last = c1;
+    now = RTC_TO_US(m_rtc_ticks) + fine;
+
+    //COUNTERの同期待ちで、tick直後は戻って見えることがある
+    if ((int32_t)(now - m_last) < 0) {
+        now = m_last;
+    }
+    m_last = now;
+    CRITICAL_REGION_EXIT();
+
+    return now;
+}
+
+
+void app_ts_request(void)
+{
+    uint32_t err_code;
+
+    if (m_req_cnt++ != 0) {
+        return;
+    }
+
+    err_code = sd_clock_hfclk_request();
+    APP_ERROR_CHECK(err_code);
+
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->MODE = TIMER_MODE_MODE_Timer;
+    NRF_TIMER1->BITMODE = TIMER_BITMODE_BITMODE_16Bit;
+    NRF_TIMER1->PRESCALER = TS_TIMER_PRESCALER;
+    NRF_TIMER1->TASKS_CLEAR = 1;
+
+    err_code = sd_ppi_channel_assign(TS_PPI_CH, &NRF_RTC1->EVENTS_TICK, &NRF_TIMER1->TASKS_CLEAR);
+    APP_ERROR_CHECK(err_code);
+    err_code = sd_ppi_channel_enable_set(1UL << TS_PPI_CH);
+    APP_ERROR_CHECK(err_code);
+
+    //割込みは有効にしない(app_timerはTICKを使わない)
+    NRF_RTC1->EVTENSET = RTC_EVTEN_TICK_Msk;
+    NRF_TIMER1->TASKS_START = 1;
+
+    if (!m_calibrated) {
+        calibrate();
+    }
+}
+
+
+void app_ts_release(void)
+{
+    uint32_t err_code;
+
+    if ((m_req_cnt == 0) || (--m_req_cnt != 0)) {
+        return;
+    }
+
+    NRF_RTC1->EVTENCLR = RTC_EVTEN_TICK_Msk;
+    err_code = sd_ppi_channel_enable_clr(1UL << TS_PPI_CH);
+    APP_ERROR_CHECK(err_code);
+    NRF_TIMER1->TASKS_STOP = 1;
+    NRF_TIMER1->TASKS_SHUTDOWN = 1;
+
+    err_code = sd_clock_hfclk_release();
+    APP_ERROR_CHECK(err_code);
+}
+
+#endif  //__linux__
+
+
+uint32_t app_ts_overhead(void)
+{
+    return m_overhead;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief app_ts_now()の処理時間を測る
+ *
+ * 割込みが入った回を除くため、最小値を使う。
+ */
+static void calibrate(void)
+{
+    uint8_t lp;
+    uint32_t t0;
+    uint32_t t1;
+    uint32_t min = UINT32_MAX;
+
+    for (lp = 0; lp < TS_CALIB_NUM; lp++) {
+        t0 = app_ts_now();
+        t1 = app_ts_now();
+        if (t1 - t0 < min) {
+            min = t1 - t0;
+        }
+    }
+    m_overhead = min;
+    m_calibrated = true;
+    APP_LOG("ts: overhead=%uus", m_overhead);
+}
+
+
+#if !defined(__linux__)
+/**
+ * @brief RTC1維持タイマ満了
+ *
+ * 何もしなくてもRTC1は動き続けるが、COUNTERが一周する前に拡張しておく。
+ *
+ * @param[in]   p_context   未使用
+ */
+static void keepalive_timeout_handler(void *p_context)
+{
+    (void)app_ts_now();
+}
+#endif  //__linux__
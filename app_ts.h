@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_ts.h
+ *
+ * usec単位のタイムスタンプ
+ */
+#ifndef APP_TS_H__
+#define APP_TS_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** RTC1を止めないためのタイマ周期[msec](24bitのCOUNTERが一周する512秒より短くする) */
+#define APP_TS_KEEPALIVE_MS             (256000)
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * app_timerは動作中のタイマが無いとRTC1を止めるので、そのままでは時刻も止まる。
+ * 長周期(APP_TS_KEEPALIVE_MS)の繰り返しタイマを1つ使ってRTC1を動かし続け、
+ * 満了のたびに24bitのCOUNTERを拡張する。
+ * app_timerを1つ使うので、APP_TIMER_NUM_USERAPPに数えること。
+ * LFCLKはSoftDeviceが起動するので、SoftDevice有効化後に呼ぶこと。
+ */
+void app_ts_init(void);
+
+
+/**@brief 現在時刻[usec]
+ *
+ * RTC1(app_timer)を基準にした時刻で、32bitで一周する(差分は符号なし減算で取ること)。
+ * app_ts_request()中は約1usec、それ以外はRTCの分解能(約30usec)になる。
+ * app_ts_init()より前はRTC1が止まっていることがあり、時刻が進まない。
+ * 割込みからも呼べる。
+ *
+ * Linuxでは CLOCK_MONOTONIC を返す。
+ *
+ * @return      時刻[usec]
+ */
+uint32_t app_ts_now(void);
+
+
+/**@brief 高分解能の要求
+ *
+ * HFCLKとTIMER1を起動する(参照カウント)。使い終わったらapp_ts_release()を呼ぶこと。
+ * TIMER1はapp_bootが起動中に使うので、app_boot_done()の後に呼ぶこと。
+ * HFCLK(水晶)が安定するまでは、TIMER1は内蔵RCで動く。
+ */
+void app_ts_request(void);
+
+
+/**@brief 高分解能の解放
+ */
+void app_ts_release(void);
+
+
+/**@brief app_ts_now()自身の処理時間[usec]
+ *
+ * 初めて高分解能にしたときに、連続して呼んだ差の最小値を測る。
+ * 計測値にはこの分が上乗せされている。
+ *
+ * @return      処理時間[usec](未計測なら0)
+ */
+uint32_t app_ts_overhead(void);
+
+#endif /* APP_TS_H__ */
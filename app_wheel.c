@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_wheel.c
+ *
+ * タイミングホイール
+ *
+ * app_timerは開始/停止のたびに操作キューを通り、リストを線形にたどるので、
+ * タイマが増えると重くなる。
+ * ここではapp_timerを1つだけ周期tickに使い、その上で2段のホイールを回す。
+ *
+ *  - 段0 : WHEEL_SLOTS個のスロット、1スロット=1tick
+ *  - 段1 : WHEEL_SLOTS個のスロット、1スロット=WHEEL_SLOTS tick
+ * 段1のスロットは、そのスロットの番が来たときに段0へ振り直す(カスケード)。
+ * 段1でも届かない遠いタイマは段1の一番遠いスロットに置き、カスケード時に置き直す。
+ *
+ * 開始/停止はスロットの双方向リストへの付け外しだけなので一定時間で終わる。
+ * app_timerはスケジューラ経由(APP_TIMER_APPSH_INIT)なので、満了ハンドラは
+ * 1tick分まとめてメインループから呼ばれる。
+ * 動作中のタイマが無いときはtickも止める。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stddef.h>
+
+#include "app_wheel.h"
+#include "app_ts.h"
+#include "app_budget.h"
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define WHEEL_BITS                      (5)
+#define WHEEL_SLOTS                     (1 << WHEEL_BITS)
+#define WHEEL_MASK                      (WHEEL_SLOTS - 1)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static app_timer_id_t                   m_tick_timer_id;
+
+static app_wheel_node_t                 m_level0[WHEEL_SLOTS];
+static app_wheel_node_t                 m_level1[WHEEL_SLOTS];
+
+static uint32_t                         m_now;          /**< 現在tick */
+static uint16_t                         m_active;       /**< 動作中のタイマ数 */
+static bool                             m_ticking;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void list_init(app_wheel_node_t *p_head);
+static void list_add(app_wheel_node_t *p_head, app_wheel_node_t *p_node);
+static void list_del(app_wheel_node_t *p_node);
+static void insert(app_wheel_timer_t *p_timer);
+static void cascade(void);
+static void tick_timeout_handler(void *p_context);
+static void tick_update(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_wheel_init(void)
+{
+    uint32_t err_code;
+    uint8_t slot;
+
+    for (slot = 0; slot < WHEEL_SLOTS; slot++) {
+        list_init(&m_level0[slot]);
+        list_init(&m_level1[slot]);
+    }
+
+    err_code = app_timer_create(&m_tick_timer_id, APP_TIMER_MODE_REPEATED, tick_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void app_wheel_start(app_wheel_timer_t *p_timer, uint32_t ticks, app_wheel_mode_t mode,
+                        app_wheel_handler_t handler, void *p_context)
+{
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if (p_timer->node.p_next != NULL) {
+        list_del(&p_timer->node);
+        m_active--;
+    }
+    p_timer->handler = handler;
+    p_timer->p_context = p_context;
+    p_timer->period = (mode == APP_WHEEL_MODE_REPEATED) ? ticks : 0;
+    p_timer->expire = m_now + ticks;
+    insert(p_timer);
+    m_active++;
+    CRITICAL_REGION_EXIT();
+
+    tick_update();
+}
+
+
+void app_wheel_stop(app_wheel_timer_t *p_timer)
+{
+    CRITICAL_REGION_ENTER();
+    if (p_timer->node.p_next != NULL) {
+        list_del(&p_timer->node);
+        m_active--;
+    }
+    CRITICAL_REGION_EXIT();
+
+    tick_update();
+}
+
+
+bool app_wheel_is_running(const app_wheel_timer_t *p_timer)
+{
+    return p_timer->node.p_next != NULL;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+static void list_init(app_wheel_node_t *p_head)
+{
+    p_head->p_next = p_head;
+    p_head->p_prev = p_head;
+}
+
+
+static void list_add(app_wheel_node_t *p_head, app_wheel_node_t *p_node)
+{
+    p_node->p_next = p_head;
+    p_node->p_prev = p_head->p_prev;
+    p_head->p_prev->p_next = p_node;
+    p_head->p_prev = p_node;
+}
+
+
+static void list_del(app_wheel_node_t *p_node)
+{
+    p_node->p_prev->p_next = p_node->p_next;
+    p_node->p_next->p_prev = p_node->p_prev;
+    p_node->p_next = NULL;
+    p_node->p_prev = NULL;
+}
+
+
+/**
+ * @brief 満了tickに応じたスロットへ入れる
+ *
+ * クリティカルセクション内で呼ぶこと。
+ *
+ * @param[in]   p_timer     タイマ
+ */
+static void insert(app_wheel_timer_t *p_timer)
+{
+    uint32_t delta = p_timer->expire - m_now;
+
+    if (delta < WHEEL_SLOTS) {
+        list_add(&m_level0[p_timer->expire & WHEEL_MASK], &p_timer->node);
+    }
+    else if (((p_timer->expire >> WHEEL_BITS) - (m_now >> WHEEL_BITS)) < WHEEL_SLOTS) {
+        list_add(&m_level1[(p_timer->expire >> WHEEL_BITS) & WHEEL_MASK], &p_timer->node);
+    }
+    else {
+        //届かない : 一番遠いスロットに置いて、カスケード時に置き直す
+        list_add(&m_level1[((m_now >> WHEEL_BITS) - 1) & WHEEL_MASK], &p_timer->node);
+    }
+}
+
+
+/**
+ * @brief 段1の現在スロットを段0へ振り直す
+ *
+ * クリティカルセクション内で呼ぶこと。
+ */
+static void cascade(void)
+{
+    app_wheel_node_t *p_head = &m_level1[(m_now >> WHEEL_BITS) & WHEEL_MASK];
+    app_wheel_node_t list;
+    app_wheel_node_t *p_node;
+
+    if (p_head->p_next == p_head) {
+        return;
+    }
+
+    //付け替え中に同じスロットへ戻るものがあるので、いったん外す
+    list.p_next = p_head->p_next;
+    list.p_prev = p_head->p_prev;
+    list.p_next->p_prev = &list;
+    list.p_prev->p_next = &list;
+    list_init(p_head);
+
+    while (list.p_next != &list) {
+        p_node = list.p_next;
+        list_del(p_node);
+        insert((app_wheel_timer_t *)p_node);
+    }
+}
+
+
+/**
+ * @brief tick(スケジューラから呼ばれる)
+ *
+ * 現在スロットのタイマを外してからハンドラを呼ぶ。
+ * ハンドラ内や割込みからの開始/停止は、次のtick以降に反映される。
+ */
+static void tick_timeout_handler(void *p_context)
+{
+    app_wheel_node_t expired;
+    app_wheel_node_t *p_head;
+    app_wheel_timer_t *p_timer;
+    app_wheel_handler_t handler;
+    void *p_ctx;
+    uint32_t start;
+
+    UNUSED_PARAMETER(p_context);
+
+    CRITICAL_REGION_ENTER();
+    m_now++;
+    if ((m_now & WHEEL_MASK) == 0) {
+        cascade();
+    }
+
+    //満了したものを一時リストへ移す
+    list_init(&expired);
+    p_head = &m_level0[m_now & WHEEL_MASK];
+    if (p_head->p_next != p_head) {
+        expired.p_next = p_head->p_next;
+        expired.p_prev = p_head->p_prev;
+        expired.p_next->p_prev = &expired;
+        expired.p_prev->p_next = &expired;
+        list_init(p_head);
+    }
+    CRITICAL_REGION_EXIT();
+
+    while (1) {
+        CRITICAL_REGION_ENTER();
+        p_timer = NULL;
+        if (expired.p_next != &expired) {
+            p_timer = (app_wheel_timer_t *)expired.p_next;
+            list_del(&p_timer->node);
+            handler = p_timer->handler;
+            p_ctx = p_timer->p_context;
+            if (p_timer->period != 0) {
+                p_timer->expire += p_timer->period;
+                insert(p_timer);
+            }
+            else {
+                m_active--;
+            }
+        }
+        CRITICAL_REGION_EXIT();
+
+        if (p_timer == NULL) {
+            break;
+        }
+        start = app_ts_now();
+        handler(p_ctx);
+        app_budget_check(APP_BUDGET_SCHED_TIMER, start);
+    }
+
+    tick_update();
+}
+
+
+/**
+ * @brief 動作中のタイマの有無でtickを開始/停止
+ *
+ * 判定とapp_timerの操作の間に割込みで開始/停止されると、操作の順序が入れ替わって
+ * m_tickingとtickの状態が食い違う(tickが止まったまま全タイマが満了しなくなる)。
+ * そのため、app_timerの操作まで割込み禁止のまま行う(操作キューに積むだけなので短い)。
+ */
+static void tick_update(void)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    CRITICAL_REGION_ENTER();
+    if ((m_active != 0) && !m_ticking) {
+        m_ticking = true;
+        err_code = app_timer_start(m_tick_timer_id, APP_WHEEL_TICK_RTC, NULL);
+    }
+    else if ((m_active == 0) && m_ticking) {
+        m_ticking = false;
+        err_code = app_timer_stop(m_tick_timer_id);
+    }
+    CRITICAL_REGION_EXIT();
+
+    APP_ERROR_CHECK(err_code);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_wheel.h
+ *
+ * タイミングホイール
+ */
+#ifndef APP_WHEEL_H__
+#define APP_WHEEL_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** 1tickのRTC1カウント数(32768Hz, prescaler 0) */
+#define APP_WHEEL_TICK_RTC              (256)
+
+/** msecをtickに変換(切り上げ) */
+#define APP_WHEEL_TICKS(ms)             ((uint32_t)(((uint64_t)(ms) * 32768 + 1000 * APP_WHEEL_TICK_RTC - 1) / (1000 * APP_WHEEL_TICK_RTC)))
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/** 満了ハンドラ(スケジューラから呼ばれる) */
+typedef void (*app_wheel_handler_t)(void *p_context);
+
+
+/** タイマモード */
+typedef enum {
+    APP_WHEEL_MODE_SINGLE_SHOT,
+    APP_WHEEL_MODE_REPEATED
+} app_wheel_mode_t;
+
+
+/** @cond */
+typedef struct app_wheel_node_t {
+    struct app_wheel_node_t *p_next;
+    struct app_wheel_node_t *p_prev;
+} app_wheel_node_t;
+/** @endcond */
+
+
+/**
+ * @brief タイマ
+ *
+ * 呼出し側で静的に確保し、中身は触らないこと。
+ */
+typedef struct {
+    app_wheel_node_t        node;
+    uint32_t                expire;     /**< 満了tick */
+    uint32_t                period;     /**< 周期[tick](0:単発) */
+    app_wheel_handler_t     handler;
+    void                    *p_context;
+} app_wheel_timer_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief 初期化
+ *
+ * app_timerを1つ使う。APP_TIMER_APPSH_INIT()の後で呼ぶこと。
+ */
+void app_wheel_init(void);
+
+
+/**@brief タイマ開始
+ *
+ * 動作中なら止めてからやり直す。一定時間で終わり、割込みからも呼べる。
+ * tickの途中で開始するので、最初の満了は最大1tick早まる。
+ *
+ * @param[in]   p_timer     タイマ
+ * @param[in]   ticks       満了までの時間[tick](1以上, APP_WHEEL_TICKS()で変換)
+ * @param[in]   mode        モード
+ * @param[in]   handler     満了ハンドラ
+ * @param[in]   p_context   ハンドラに渡す値
+ */
+void app_wheel_start(app_wheel_timer_t *p_timer, uint32_t ticks, app_wheel_mode_t mode,
+                        app_wheel_handler_t handler, void *p_context);
+
+
+/**@brief タイマ停止
+ *
+ * 止まっていれば何もしない。一定時間で終わり、割込みからも呼べる。
+ *
+ * @param[in]   p_timer     タイマ
+ */
+void app_wheel_stop(app_wheel_timer_t *p_timer);
+
+
+/**@brief タイマ動作中かどうか
+ *
+ * @param[in]   p_timer     タイマ
+ * @retval      true        動作中
+ */
+bool app_wheel_is_running(const app_wheel_timer_t *p_timer);
+
+#endif /* APP_WHEEL_H__ */
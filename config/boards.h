@@ -10,6 +10,9 @@
 /** LED : Assert発生 */
 #define LED_PIN_NO_ASSERT               (27)
 
+/** System OFFからの復帰 : LOWで起きるピン(使わないなら-1) */
+#define WAKE_PIN_NO                     (-1)
+
 /** app_trace */
 #define RX_PIN_NUMBER                   (9)
 #define TX_PIN_NUMBER                   (8)
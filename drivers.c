@@ -39,6 +39,14 @@
 #include "app_timer_appsh.h"
 
 #include "app_trace.h"
+#include "app_log.h"
+#include "app_evtrec.h"
+#include "app_boot.h"
+#include "app_wheel.h"
+#include "app_cpu.h"
+#include "app_budget.h"
+#include "app_sample.h"
+#include "app_ts.h"
 
 
 /**************************************************************************
@@ -59,7 +67,7 @@
 #define APP_TIMER_NUM_BLE               (1)
 
 /** ユーザアプリで使用するタイマ数 */
-#define APP_TIMER_NUM_USERAPP           (0)
+#define APP_TIMER_NUM_USERAPP           (2)     //app_wheel, app_ts
 
 /** 同時に生成する最大タイマ数 */
 #define APP_TIMER_MAX_TIMERS            (APP_TIMER_NUM_BLE+APP_TIMER_NUM_USERAPP)
@@ -72,6 +80,7 @@
  */
 // YOUR_JOB: Modify these according to requirements (e.g. if other event types are to pass through
 //           the scheduler).
+//           I/OサービスのInputはBLE状態とapp_poolのブロックへのポインタだけを積むので、これを超えない。
 #define SCHED_MAX_EVENT_DATA_SIZE       sizeof(app_timer_event_t)                   /**< Maximum size of scheduler events. Note that scheduler BLE stack events do not contain any data, as the events are being pulled from the stack in the event handler. */
 
 /** Maximum number of events in the scheduler queue. */
@@ -79,16 +88,13 @@
 
 
 
-/**************************************************************************
- * declaration
- **************************************************************************/
-
 /**************************************************************************
  * prototype
  **************************************************************************/
 
 static void gpio_init(void);
 static void timers_init(void);
+static uint32_t timer_evt_schedule(app_timer_timeout_handler_t timeout_handler, void *p_context);
 //static void timers_start(void);
 static void scheduler_init(void);
 static void softdevice_init(void);
@@ -106,18 +112,40 @@ void drv_init(void)
     timers_init();      //app_button_init()やble_conn_params_init()よりも前に呼ぶこと!
                         //呼ばなかったら、NRF_ERROR_INVALID_STATE(8)が発生する。
     scheduler_init();
+    app_boot_mark(APP_BOOT_DRV);
     softdevice_init();
+    app_boot_mark(APP_BOOT_SOFTDEVICE);
+    app_ts_init();      //RTC1を止めないようにする(LFCLKはSoftDeviceが起動する)
 }
 
 
-void drv_event_exec(void)
+void drv_event_exec(app_ble_t *p_ble)
 {
     uint32_t err_code;
 
     //スケジュール済みイベントの実行(mainloop内で呼び出す)
     app_sched_execute();
+    app_budget_feed();
+
+#ifdef ENABLE_SAMPLING
+    {
+        //溜まったサンプルのブロック処理
+        uint32_t start = app_ts_now();
+
+        app_sample_poll();
+        app_budget_check(APP_BUDGET_SAMPLE, start);
+    }
+#endif  //ENABLE_SAMPLING
+
+    //暇になったのでログを流す
+    app_log_flush();
+    app_evtrec_uart_poll(&p_ble->evtrec);
+    app_ble_idle(p_ble);
+
+    app_cpu_sleep();
     err_code = sd_app_evt_wait();
     APP_ERROR_CHECK(err_code);
+    app_cpu_wake();
 }
 
 
@@ -189,9 +217,13 @@ static void gpio_init(void)
 static void timers_init(void)
 {
     // Initialize timer module, making it use the scheduler
-    APP_TIMER_APPSH_INIT(0, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, true);
+    //  APP_TIMER_APPSH_INIT()と同じだが、積んだイベントをapp_cpuで数える
+    APP_TIMER_INIT(0, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, timer_evt_schedule);
 //    APP_TIMER_INIT(0, APP_TIMER_MAX_TIMERS, APP_TIMER_OP_QUEUE_SIZE, false);
 
+    //アプリのタイマはapp_wheelに載せる(app_timerは1つだけ使う)
+    app_wheel_init();
+
 #if 0
     /* YOUR_JOB: Create any timers to be used by the application.
                  Below is an example of how to create a timer.
@@ -203,6 +235,24 @@ static void timers_init(void)
 #endif
 }
 
+/**
+ * @brief app_timerのタイムアウトをスケジューラに積む
+ *
+ * @param[in]   timeout_handler タイムアウトハンドラ
+ * @param[in]   p_context       ハンドラに渡す値
+ * @return      app_timer_evt_schedule()の戻り値
+ */
+static uint32_t timer_evt_schedule(app_timer_timeout_handler_t timeout_handler, void *p_context)
+{
+    uint32_t err_code = app_timer_evt_schedule(timeout_handler, p_context);
+
+    if (err_code == NRF_SUCCESS) {
+        app_cpu_sched_put();
+    }
+    return err_code;
+}
+
+
 #if 0
 /**
  * @brief タイマ開始
@@ -260,8 +310,9 @@ static void softdevice_init(void)
 
     /* BLEイベントハンドラの設定 */
     {
-        err_code = softdevice_ble_evt_handler_set(app_ble_evt_dispatch);
+        err_code = softdevice_ble_evt_handler_set(main_ble_evt_dispatch);
         APP_ERROR_CHECK(err_code);
     }
 }
 
+
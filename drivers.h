@@ -30,6 +30,7 @@
  * include
  **************************************************************************/
 #include "nrf.h"
+#include "app_ble.h"
 
 
 /**************************************************************************
@@ -38,7 +39,7 @@
 
 /* DRV */
 void drv_init(void);
-void drv_event_exec(void);
+void drv_event_exec(app_ble_t *p_ble);
 
 /* LED */
 void led_on(int pin);
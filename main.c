@@ -34,23 +34,67 @@
 #include "main.h"
 #include "drivers.h"
 #include "app_ble.h"
+#include "app_cfg.h"
+#include "app_mem.h"
+#include "app_crash.h"
+#include "app_boot.h"
+#include "app_suspend.h"
+#include "app_prof.h"
+#include "app_budget.h"
+#include "app_sample.h"
+#include "app_dsp.h"
+#include "app_pack.h"
 
 #include "app_error.h"
 #include "app_trace.h"
+#include "app_log.h"
 
 
 /**************************************************************************
  * macro
  **************************************************************************/
 
+#ifdef ENABLE_SAMPLING
+#ifdef ENABLE_PROFILER
+#error "ENABLE_SAMPLING and ENABLE_PROFILER both use TIMER2"
+#endif  //ENABLE_PROFILER
+
+/** サンプリング周波数[Hz] */
+#define SAMPLE_RATE_HZ                  (200)
+
+/** 1ブロックのサンプル数 */
+#define SAMPLE_BLOCK_SIZE               (32)
+
+/** ADC入力(AINx) */
+#define SAMPLE_AIN                      (2)
+
+/** 送信前のデシメーション率(app_dsp_fir_lp4用) */
+#define SAMPLE_DECIM                    (4)
+#endif  //ENABLE_SAMPLING
+
+
 /**************************************************************************
  * declaration
  **************************************************************************/
 
+/** BLE状態(SoftDeviceは1つなので1つだけ) */
+static app_ble_t                        m_ble;
+
+#ifdef ENABLE_SAMPLING
+static app_dsp_fir_t                    m_sample_fir;
+static int16_t                          m_sample_fir_buf[APP_DSP_FIR_LP4_TAPS];
+#endif  //ENABLE_SAMPLING
+
+
 /**************************************************************************
  * prototype
  **************************************************************************/
 
+#ifdef ENABLE_SAMPLING
+static void sample_start(void);
+static void sample_block_handler(const int16_t *p_samples, uint16_t num, uint32_t ts);
+#endif  //ENABLE_SAMPLING
+
 /**************************************************************************
  * main entry
  **************************************************************************/
@@ -59,20 +103,50 @@
  */
 int main(void)
 {
-    // 初期化
+    // 初期化(Advertising開始に必要なものだけ)
+    app_boot_init();    //起動時間を測るので最初に呼ぶこと
+    app_suspend_init(); //app_cfg_init()/app_ble_init()が保持していた状態を戻すので、その前に呼ぶこと
+    app_crash_init();
     drv_init();
-    app_ble_init();
-
-    app_trace_init();
-    app_trace_log("START\r\n");
+    app_cfg_init();     //app_ble_init()が設定値を読むので、その前に呼ぶこと
+    app_boot_mark(APP_BOOT_CFG);
+    app_ble_init(&m_ble);
 
     // 処理開始
     //timers_start();
-    app_ble_start();
+    app_ble_start(&m_ble);
+
+    // 残りの初期化(Advertisingと並行して進む)
+    app_mem_init(&m_ble.pool);  //スタックを塗る
+    app_trace_init();   //UART初期化(ログはapp_logが流す)
+    app_ble_init_late(&m_ble);
+    app_boot_mark(APP_BOOT_LATE_INIT);
+    app_boot_done();
+    app_crash_boot_time_set(app_boot_us(APP_BOOT_ADV_START));
+
+    APP_LOG("START");
+    if (app_crash_is_warm_boot()) {
+        const app_crash_record_t *p_crash = app_crash_get();
+
+        APP_LOG("crash: err=0x%x line=%u pc=0x%08x boot=%uus",
+                    p_crash->error_code, p_crash->line, p_crash->pc, p_crash->boot_us);
+    }
+    if (app_suspend_is_resume()) {
+        //起床からAdvertising再開まで
+        APP_LOG("resume: wake=0x%x ready=%uus",
+                    app_suspend_wake_reason(), app_boot_us(APP_BOOT_ADV_START));
+    }
+#ifdef ENABLE_PROFILER
+    app_prof_start(APP_PROF_PERIOD_US);
+#endif  //ENABLE_PROFILER
+#ifdef ENABLE_SAMPLING
+    sample_start();
+#endif  //ENABLE_SAMPLING
+    app_budget_init();  //WDT開始
 
     // メインループ
     while (1) {
-        drv_event_exec();
+        drv_event_exec(&m_ble);
     }
 }
 
@@ -84,7 +158,8 @@ int main(void)
 /**@brief エラーハンドラ
  *
  * APP_ERROR_HANDLER()やAPP_ERROR_CHECK()から呼び出される(app_error.h)。
- * 引数は見ず、ASSERT LEDを点灯させて処理を止める。
+ * ASSERT LEDを点灯させ、保持RAMに記録してからリセットする。
+ * 記録は再起動後に診断サービスのCrashキャラクタリスティックで読める。
  *
  * @param[in] error_code  エラーコード
  * @param[in] line_num    エラー発生行(__LINE__など)
@@ -95,15 +170,10 @@ void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_
     //ASSERT LED点灯
     led_on(LED_PIN_NO_ASSERT);
 
-#if 0
-    //リセットによる再起動
-    NVIC_SystemReset();
-#else
-    //留まる
-    while(1) {
-        __WFI();
-    }
-#endif
+    //記録してリセットによる再起動
+    app_crash_reset(error_code, line_num, p_file_name,
+                    (uint32_t)__builtin_return_address(0), 0,
+                    (const uint32_t *)__get_MSP());
 }
 
 
@@ -125,8 +195,21 @@ void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_
  */
 void main_sys_evt_dispatch(uint32_t sys_evt)
 {
-	/* 上位のハンドラを呼ぶようにしておくか？ */
-	/* とりあえず放置しておく */
+    /* 設定値保存(Flash操作完了) */
+    app_cfg_on_sys_evt(sys_evt);
+}
+
+
+/**@brief BLEイベント発生
+ *
+ * SoftDeviceでBLEイベントが発生した場合にコールバックされる。
+ * SoftDeviceのハンドラにはコンテキストを渡せないので、BLE状態を持つmainで受ける。
+ *
+ * @param[in]   p_ble_evt   BLEスタックイベント
+ */
+void main_ble_evt_dispatch(ble_evt_t *p_ble_evt)
+{
+    app_ble_evt_dispatch(&m_ble, p_ble_evt);
 }
 
 
@@ -134,3 +217,47 @@ void main_sys_evt_dispatch(uint32_t sys_evt)
  * private function
  **************************************************************************/
 
+#ifdef ENABLE_SAMPLING
+/**
+ * @brief サンプリング開始
+ *
+ * ADC → app_sample(ブロック) → app_dsp(デシメーション) → app_pack → Outputキャラクタリスティック
+ */
+static void sample_start(void)
+{
+    const app_sample_config_t config = {
+        .rate_hz    = SAMPLE_RATE_HZ,
+        .block_size = SAMPLE_BLOCK_SIZE,
+        .ain        = SAMPLE_AIN,
+    };
+    uint32_t err_code;
+
+    app_dsp_fir_init(&m_sample_fir, app_dsp_fir_lp4, m_sample_fir_buf,
+                        APP_DSP_FIR_LP4_TAPS, SAMPLE_DECIM);
+    err_code = app_sample_start(&config, sample_block_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**
+ * @brief サンプルのブロック処理
+ *
+ * 接続中だけ、デシメーションした値をNotifyに詰める。
+ *
+ * @param[in]   p_samples   サンプル
+ * @param[in]   num         サンプル数
+ * @param[in]   ts          先頭サンプルの時刻[usec]
+ */
+static void sample_block_handler(const int16_t *p_samples, uint16_t num, uint32_t ts)
+{
+    uint32_t period = app_sample_period_us();
+    uint16_t lp;
+    int16_t  y;
+
+    for (lp = 0; lp < num; lp++) {
+        if (app_dsp_fir_put(&m_sample_fir, p_samples[lp], &y) && app_ble_is_connected(&m_ble)) {
+            app_pack_put_at(&m_ble.pack, (const uint8_t *)&y, ts + lp * period);
+        }
+    }
+}
+#endif  //ENABLE_SAMPLING
@@ -1,6 +1,9 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include "ble.h"
+
 void main_sys_evt_dispatch(uint32_t sys_evt);
+void main_ble_evt_dispatch(ble_evt_t *p_ble_evt);
 
 #endif /* MAIN_H */
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    ble_diag.c
+ *
+ * 診断サービス
+ *
+ * フィールドでの調査用に、テレメトリをRead/Notifyで公開する。
+ * 値の中身は各モジュールが作り、ここでは区別せずにバイト列として扱う。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+
+#include <string.h>
+#include "nordic_common.h"
+
+#include "ble_diag.h"
+#include "ble_srv_common.h"
+
+#include "app_error.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** キャラクタリスティックの最大長(ATT_MTU-3) */
+#define DIAG_VALUE_MAX                  (GATT_RX_MTU - 3)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** キャラクタリスティックごとのUUID */
+static const uint16_t                   m_char_uuid[BLE_DIAG_CHAR_MAX] = {
+    DIAG_UUID_CHAR_LINK,
+    DIAG_UUID_CHAR_LOG,
+    DIAG_UUID_CHAR_EVTREC,
+    DIAG_UUID_CHAR_MEM,
+    DIAG_UUID_CHAR_CRASH,
+    DIAG_UUID_CHAR_BOOT,
+    DIAG_UUID_CHAR_CPU,
+};
+
+/** キャラクタリスティックごとの最大長 */
+static const uint16_t                   m_char_max_len[BLE_DIAG_CHAR_MAX] = {
+    DIAG_VALUE_MAX,
+    DIAG_VALUE_MAX,
+    DIAG_VALUE_MAX,
+    DIAG_VALUE_MAX,
+    DIAG_CRASH_VALUE_MAX,
+    DIAG_VALUE_MAX,
+    DIAG_VALUE_MAX,
+};
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void on_connect(ble_diag_t *p_diag, ble_evt_t *p_ble_evt);
+static void on_disconnect(ble_diag_t *p_diag, ble_evt_t *p_ble_evt);
+static void on_write(ble_diag_t *p_diag, ble_evt_t *p_ble_evt);
+static uint32_t char_add_report(ble_diag_t *p_diag, ble_diag_char_t chr);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+/**
+ * @brief サービス初期化
+ *
+ * @param[in]   p_diag      サービス構造体
+ */
+void ble_diag_init(ble_diag_t *p_diag)
+{
+    uint32_t   err_code;
+    uint8_t    chr;
+
+    p_diag->conn_handle     = BLE_CONN_HANDLE_INVALID;
+    p_diag->notify_enabled  = 0;
+
+    //Base UUIDを登録し、UUID typeを取得
+    ble_uuid128_t   base_uuid = { DIAG_UUID_BASE };
+    err_code = sd_ble_uuid_vs_add(&base_uuid, &p_diag->uuid_type);
+    APP_ERROR_CHECK(err_code);
+
+    //サービス登録
+    ble_uuid_t ble_uuid;
+    ble_uuid.uuid = DIAG_UUID_SERVICE;
+    ble_uuid.type = p_diag->uuid_type;
+    err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY,
+                                        &ble_uuid, &p_diag->service_handle);
+    APP_ERROR_CHECK(err_code);
+
+    //キャラクタリスティック登録
+    for (chr = 0; chr < BLE_DIAG_CHAR_MAX; chr++) {
+        err_code = char_add_report(p_diag, (ble_diag_char_t)chr);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**
+ * @brief BLEイベントハンドラ
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   p_ble_evt   イベント構造体
+ */
+void ble_diag_on_ble_evt(ble_diag_t *p_diag, ble_evt_t *p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        on_connect(p_diag, p_ble_evt);
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        on_disconnect(p_diag, p_ble_evt);
+        break;
+
+    case BLE_GATTS_EVT_WRITE:
+        on_write(p_diag, p_ble_evt);
+        break;
+
+    default:
+        // No implementation needed.
+        break;
+    }
+}
+
+
+/**
+ * @brief 診断値更新
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   chr         更新するキャラクタリスティック
+ * @param[in]   p_value     データバッファ
+ * @param[in]   length      データサイズ
+ * @param[out]  p_hvx_result    sd_ble_gatts_hvx()の戻り値(NULL可)
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t ble_diag_value_set(ble_diag_t *p_diag, ble_diag_char_t chr, const uint8_t *p_value, uint16_t length,
+                            uint32_t *p_hvx_result)
+{
+    uint32_t            err_code;
+    ble_gatts_value_t   value;
+
+    if (p_hvx_result != NULL) {
+        *p_hvx_result = NRF_ERROR_INVALID_STATE;
+    }
+    if (length > m_char_max_len[chr]) {
+        length = m_char_max_len[chr];
+    }
+
+    if ((length <= DIAG_VALUE_MAX) && ble_diag_is_notify_enabled(p_diag, chr)) {
+        ble_gatts_hvx_params_t params;
+
+        memset(&params, 0, sizeof(params));
+        params.handle = p_diag->char_handles[chr].value_handle;
+        params.type = BLE_GATT_HVX_NOTIFICATION;
+        params.p_len = &length;
+        params.p_data = (uint8_t *)p_value;
+        err_code = sd_ble_gatts_hvx(p_diag->conn_handle, &params);
+        if (p_hvx_result != NULL) {
+            *p_hvx_result = err_code;
+        }
+        if (err_code != BLE_ERROR_NO_TX_BUFFERS) {
+            //Notify時は値も更新されている
+            return err_code;
+        }
+        //バッファが空いていなければReadで読める値だけ更新する
+    }
+
+    memset(&value, 0, sizeof(value));
+    value.len = length;
+    value.p_value = (uint8_t *)p_value;
+    return sd_ble_gatts_value_set(p_diag->conn_handle, p_diag->char_handles[chr].value_handle, &value);
+}
+
+
+/**
+ * @brief Notify送信のみ
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   chr         送信するキャラクタリスティック
+ * @param[in]   p_value     データバッファ
+ * @param[in]   length      データサイズ
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t ble_diag_notify(ble_diag_t *p_diag, ble_diag_char_t chr, const uint8_t *p_value, uint16_t length)
+{
+    ble_gatts_hvx_params_t params;
+
+    if (!ble_diag_is_notify_enabled(p_diag, chr)) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (length > DIAG_VALUE_MAX) {
+        length = DIAG_VALUE_MAX;
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.handle = p_diag->char_handles[chr].value_handle;
+    params.type = BLE_GATT_HVX_NOTIFICATION;
+    params.p_len = &length;
+    params.p_data = (uint8_t *)p_value;
+    return sd_ble_gatts_hvx(p_diag->conn_handle, &params);
+}
+
+
+/**
+ * @brief Notifyが有効かどうか
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   chr         キャラクタリスティック
+ * @retval      true        Notify有効
+ */
+bool ble_diag_is_notify_enabled(const ble_diag_t *p_diag, ble_diag_char_t chr)
+{
+    return (p_diag->conn_handle != BLE_CONN_HANDLE_INVALID) &&
+           (p_diag->notify_enabled & (1UL << chr));
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief CONNECT時
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   p_ble_evt   イベント構造体
+ */
+static void on_connect(ble_diag_t *p_diag, ble_evt_t *p_ble_evt)
+{
+    p_diag->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+}
+
+
+/**
+ * @brief DISCONNECT時
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   p_ble_evt   イベント構造体
+ */
+static void on_disconnect(ble_diag_t *p_diag, ble_evt_t *p_ble_evt)
+{
+    UNUSED_PARAMETER(p_ble_evt);
+    p_diag->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_diag->notify_enabled = 0;
+}
+
+
+/**
+ * @brief Write時
+ *
+ * CCCDへの書込みでNotifyの有効/無効を覚えておく。
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   p_ble_evt   イベント構造体
+ */
+static void on_write(ble_diag_t *p_diag, ble_evt_t *p_ble_evt)
+{
+    ble_gatts_evt_write_t *p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+    uint8_t chr;
+
+    if (p_evt_write->len != 2) {
+        return;
+    }
+    for (chr = 0; chr < BLE_DIAG_CHAR_MAX; chr++) {
+        if (p_evt_write->handle == p_diag->char_handles[chr].cccd_handle) {
+            if (ble_srv_is_notification_enabled(p_evt_write->data)) {
+                p_diag->notify_enabled |= (1UL << chr);
+            }
+            else {
+                p_diag->notify_enabled &= ~(1UL << chr);
+            }
+            break;
+        }
+    }
+}
+
+
+/**
+ * @brief キャラクタリスティック登録：診断値
+ *
+ *      permission : Read, Notify
+ *
+ * @param[in/out]   p_diag      サービス構造体
+ * @param[in]       chr         登録するキャラクタリスティック
+ */
+static uint32_t char_add_report(ble_diag_t *p_diag, ble_diag_char_t chr)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_md_t cccd_md;
+    ble_uuid_t          char_uuid;
+    ble_gatts_attr_md_t attr_md;
+    ble_gatts_attr_t    attr_char_value;
+
+    ///////////////////////
+    // Characteristicの設定
+    ///////////////////////
+
+    // CCCD(Notify/Indicate用)
+    memset(&cccd_md, 0, sizeof(cccd_md));
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
+    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
+
+    // メタデータ
+    //      Read, Notify
+    memset(&char_md, 0, sizeof(char_md));
+    char_md.char_props.read   = 1;
+    char_md.char_props.notify = 1;
+    char_md.p_cccd_md         = &cccd_md;
+
+    // UUID
+    char_uuid.type = p_diag->uuid_type;
+    char_uuid.uuid = m_char_uuid[chr];
+
+
+    ///////////////////////
+    // Attributeの設定
+    ///////////////////////
+
+    // メタデータ
+    //Read Only
+    memset(&attr_md, 0, sizeof(attr_md));
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+    attr_md.vlen       = 1;
+    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
+
+    // value
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+    attr_char_value.p_uuid       = &char_uuid;
+    attr_char_value.p_attr_md    = &attr_md;
+    attr_char_value.init_len     = 1;
+    attr_char_value.max_len      = m_char_max_len[chr];
+
+
+    ///////////////////////
+    // キャラクタリスティックの登録
+    return sd_ble_gatts_characteristic_add(p_diag->service_handle,
+                                                &char_md,
+                                                &attr_char_value,
+                                                &p_diag->char_handles[chr]);
+}
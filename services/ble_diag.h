@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    ble_diag.h
+ *
+ * 診断サービス
+ */
+#ifndef BLE_DIAG_H__
+#define BLE_DIAG_H__
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+
+#include "ble.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+//87C9xxxx-CBA0-7D7D-F1B5-E1635787F177 (I/Oサービスと同じBase UUID)
+#define DIAG_UUID_BASE { 0x77,0xf1,0x87,0x57,0x63,0xe1,0xb5,0xf1,0x7d,0x7d,0xa0,0xcb,0x00,0x00,0xc9,0x87 }
+#define DIAG_UUID_SERVICE       (0x0010)
+#define DIAG_UUID_CHAR_LINK     (0x0011)
+#define DIAG_UUID_CHAR_LOG      (0x0012)
+#define DIAG_UUID_CHAR_EVTREC   (0x0013)
+#define DIAG_UUID_CHAR_MEM      (0x0014)
+#define DIAG_UUID_CHAR_CRASH    (0x0015)
+#define DIAG_UUID_CHAR_BOOT     (0x0016)
+#define DIAG_UUID_CHAR_CPU      (0x0017)
+
+/** Crashキャラクタリスティックの最大長(Read Longで読む) */
+#define DIAG_CRASH_VALUE_MAX    (80)
+
+/** ble_diag_on_ble_evt()が扱うイベント(app_evtdisp) */
+#define BLE_DIAG_BLE_EVTS               BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED, BLE_GATTS_EVT_WRITE
+
+
+/**************************************************************************
+ * definition
+ **************************************************************************/
+
+/**@brief 診断キャラクタリスティック */
+typedef enum {
+    BLE_DIAG_CHAR_LINK,                 /**< リンク品質(app_link) */
+    BLE_DIAG_CHAR_LOG,                  /**< バイナリログ(app_log) */
+    BLE_DIAG_CHAR_EVTREC,               /**< BLEイベント記録(app_evtrec) */
+    BLE_DIAG_CHAR_MEM,                  /**< RAM使用量(app_mem) */
+    BLE_DIAG_CHAR_CRASH,                /**< クラッシュ記録(app_crash) */
+    BLE_DIAG_CHAR_BOOT,                 /**< 起動時間(app_boot) */
+    BLE_DIAG_CHAR_CPU,                  /**< CPU使用率(app_cpu) */
+    //
+    BLE_DIAG_CHAR_MAX
+} ble_diag_char_t;
+
+
+/**@brief サービス構造体 */
+typedef struct {
+    uint16_t                        service_handle;             /**< Handle of Diagnostics Service (as provided by the BLE stack). */
+    uint16_t                        conn_handle;                /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
+    uint8_t                         uuid_type;
+    //
+    ble_gatts_char_handles_t        char_handles[BLE_DIAG_CHAR_MAX];    /**< Handles related to the diagnostics characteristics. */
+    uint32_t                        notify_enabled;             /**< Notifyが有効なキャラクタリスティック(bit) */
+} ble_diag_t;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+/**@brief サービス初期化
+ *
+ * @param[in]   p_diag      サービス構造体
+ */
+void ble_diag_init(ble_diag_t *p_diag);
+
+
+/**@brief BLEイベントハンドラ
+ * アプリ層のBLEイベントハンドラから呼び出されることを想定している.
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   p_ble_evt   イベント構造体
+ */
+void ble_diag_on_ble_evt(ble_diag_t *p_diag, ble_evt_t *p_ble_evt);
+
+
+/**@brief 診断値更新
+ *
+ * Readで読める値を更新する。Notifyが有効なら送信もする。
+ * ATT_MTU-3より長い値はNotifyせず、Read Longで読んでもらう。
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   chr         更新するキャラクタリスティック
+ * @param[in]   p_value     データバッファ
+ * @param[in]   length      データサイズ
+ * @param[out]  p_hvx_result    sd_ble_gatts_hvx()の戻り値(Notifyしなかったら
+ *                              NRF_ERROR_INVALID_STATE)。送信バッファ数の管理用。NULL可。
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t ble_diag_value_set(ble_diag_t *p_diag, ble_diag_char_t chr, const uint8_t *p_value, uint16_t length,
+                            uint32_t *p_hvx_result);
+
+
+/**@brief Notify送信のみ
+ *
+ * ストリーム用。送れなかったデータはReadで読める値にも残さない。
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   chr         送信するキャラクタリスティック
+ * @param[in]   p_value     データバッファ
+ * @param[in]   length      データサイズ
+ * @retval      NRF_SUCCESS 成功
+ * @retval      NRF_ERROR_INVALID_STATE Notifyが無効
+ * @retval      BLE_ERROR_NO_TX_BUFFERS 送信バッファ無し
+ */
+uint32_t ble_diag_notify(ble_diag_t *p_diag, ble_diag_char_t chr, const uint8_t *p_value, uint16_t length);
+
+
+/**@brief Notifyが有効かどうか
+ *
+ * @param[in]   p_diag      サービス構造体
+ * @param[in]   chr         キャラクタリスティック
+ * @retval      true        接続中で、CCCDでNotifyが有効にされている
+ */
+bool ble_diag_is_notify_enabled(const ble_diag_t *p_diag, ble_diag_char_t chr);
+
+#endif // BLE_DIAG_H__
@@ -41,6 +41,95 @@
 #include "app_error.h"
 
 
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** パーミッション(0:NO_ACCESS 1:OPEN 2:暗号化必須) */
+#define IOS_PERM(lvl)                   { .sm = ((lvl) != 0), .lv = (lvl) }
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/**
+ * @brief サービス内のハンドル番号(service_handleからのオフセット)
+ *
+ * SoftDeviceはサービスの属性を登録順に連番で割り当てるので、表から決まる。
+ * 1キャラクタリスティックあたり、宣言・値・(NotifyならCCCD)。
+ */
+enum {
+    IOS_HDL_SERVICE,
+#define IOS_HDL_(name, uuid, rd, wr, ntf, vl, opt)                                    \
+    IOS_HDL_##name##_DECL, IOS_HDL_##name##_VALUE, IOS_HDL_##name##_LAST = IOS_HDL_##name##_VALUE + (ntf),
+    BLE_IOS_CHAR_TABLE(IOS_HDL_)
+#undef IOS_HDL_
+    //
+    IOS_HDL_NUM
+};
+
+
+/** CCCD */
+static const ble_gatts_attr_md_t        m_cccd_md = {
+    .read_perm  = IOS_PERM(1),
+    .write_perm = IOS_PERM(1),
+    .vloc       = BLE_GATTS_VLOC_STACK,
+};
+
+/** キャラクタリスティックのメタデータ */
+static const ble_gatts_char_md_t        m_char_md[BLE_IOS_CHAR_MAX] = {
+#define IOS_CHAR_MD_(name, uuid, rd, wr, ntf, vl, opt)                                \
+    [BLE_IOS_CHAR_##name] = {                                                           \
+        .char_props = { .read = ((rd) != 0), .write = ((wr) != 0), .notify = (ntf) },   \
+        .p_cccd_md  = (ntf) ? (ble_gatts_attr_md_t *)&m_cccd_md : NULL,                 \
+    },
+    BLE_IOS_CHAR_TABLE(IOS_CHAR_MD_)
+#undef IOS_CHAR_MD_
+};
+
+/** 値のメタデータ */
+static const ble_gatts_attr_md_t        m_attr_md[BLE_IOS_CHAR_MAX] = {
+#define IOS_ATTR_MD_(name, uuid, rd, wr, ntf, vl, opt)                                \
+    [BLE_IOS_CHAR_##name] = {                                                           \
+        .read_perm  = IOS_PERM(rd),                                                     \
+        .write_perm = IOS_PERM(wr),                                                     \
+        .vlen       = (vl),                                                           \
+        .vloc       = BLE_GATTS_VLOC_STACK,                                             \
+    },
+    BLE_IOS_CHAR_TABLE(IOS_ATTR_MD_)
+#undef IOS_ATTR_MD_
+};
+
+/** UUID */
+static const uint16_t                   m_char_uuid[BLE_IOS_CHAR_MAX] = {
+#define IOS_UUID_(name, uuid, rd, wr, ntf, vl, opt)   [BLE_IOS_CHAR_##name] = (uuid),
+    BLE_IOS_CHAR_TABLE(IOS_UUID_)
+#undef IOS_UUID_
+};
+
+/** 省略可 */
+static const bool                       m_char_optional[BLE_IOS_CHAR_MAX] = {
+#define IOS_OPT_(name, uuid, rd, wr, ntf, vl, opt)    [BLE_IOS_CHAR_##name] = (opt),
+    BLE_IOS_CHAR_TABLE(IOS_OPT_)
+#undef IOS_OPT_
+};
+
+/** 値のハンドル番号 */
+static const uint8_t                    m_value_offset[BLE_IOS_CHAR_MAX] = {
+#define IOS_VOFS_(name, uuid, rd, wr, ntf, vl, opt)   [BLE_IOS_CHAR_##name] = IOS_HDL_##name##_VALUE,
+    BLE_IOS_CHAR_TABLE(IOS_VOFS_)
+#undef IOS_VOFS_
+};
+
+/** ハンドル番号からキャラクタリスティックを引く(値のハンドルのみ。0:該当なし、それ以外:chr+1) */
+static const uint8_t                    m_handle_chr[IOS_HDL_NUM] = {
+#define IOS_HCHR_(name, uuid, rd, wr, ntf, vl, opt)   [IOS_HDL_##name##_VALUE] = BLE_IOS_CHAR_##name + 1,
+    BLE_IOS_CHAR_TABLE(IOS_HCHR_)
+#undef IOS_HCHR_
+};
+
+
 /**************************************************************************
  * prototype
  **************************************************************************/
@@ -48,8 +137,6 @@
 static void on_connect(ble_ios_t *p_ios, ble_evt_t *p_ble_evt);
 static void on_disconnect(ble_ios_t *p_ios, ble_evt_t *p_ble_evt);
 static void on_write(ble_ios_t *p_ios, ble_evt_t *p_ble_evt);
-static uint32_t char_add_input(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_init);
-static uint32_t char_add_output(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_init);
 
 
 /**************************************************************************
@@ -59,15 +146,22 @@ static uint32_t char_add_output(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_in
 /**
  * @brief サービス初期化
  *
+ * キャラクタリスティックはBLE_IOS_CHAR_TABLEの順に登録する。
+ *
  * @param[in]   p_ios       サービス構造体
  * @param[in]   p_ios_init  サービス初期化構造体
  */
 void ble_ios_init(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_init)
 {
-    uint32_t   err_code;
+    uint32_t            err_code;
+    uint8_t             chr;
+    ble_uuid_t          char_uuid;
+    ble_gatts_attr_t    attr_char_value;
 
     //ハンドラ
-    p_ios->evt_handler_in   = p_ios_init->evt_handler_in;
+    memset(p_ios->write_handler, 0, sizeof(p_ios->write_handler));
+    p_ios->write_handler[BLE_IOS_CHAR_INPUT]  = p_ios_init->evt_handler_in;
+    p_ios->write_handler[BLE_IOS_CHAR_CONFIG] = p_ios_init->evt_handler_cfg;
     p_ios->conn_handle      = BLE_CONN_HANDLE_INVALID;
 
     //Base UUIDを登録し、UUID typeを取得
@@ -84,11 +178,34 @@ void ble_ios_init(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_init)
     APP_ERROR_CHECK(err_code);
 
     //キャラクタリスティック登録
-    err_code = char_add_input(p_ios, p_ios_init);
-    APP_ERROR_CHECK(err_code);
+    memset(p_ios->char_handles, 0, sizeof(p_ios->char_handles));
+    for (chr = 0; chr < BLE_IOS_CHAR_MAX; chr++) {
+        if (m_char_optional[chr] && (p_ios->write_handler[chr] == NULL)) {
+            continue;
+        }
+
+        // UUID
+        char_uuid.type = p_ios->uuid_type;
+        char_uuid.uuid = m_char_uuid[chr];
+
+        // value
+        memset(&attr_char_value, 0, sizeof(attr_char_value));
+        attr_char_value.p_uuid       = &char_uuid;
+        attr_char_value.p_attr_md    = (ble_gatts_attr_md_t *)&m_attr_md[chr];
+        attr_char_value.init_len     = 1;
+        attr_char_value.max_len      = p_ios_init->max_len[chr];
+
+        err_code = sd_ble_gatts_characteristic_add(p_ios->service_handle,
+                                                &m_char_md[chr],
+                                                &attr_char_value,
+                                                &p_ios->char_handles[chr]);
+        APP_ERROR_CHECK(err_code);
 
-    err_code = char_add_output(p_ios, p_ios_init);
-    APP_ERROR_CHECK(err_code);
+        //on_write()はハンドル番号が表どおりであることを前提にしている
+        if (p_ios->char_handles[chr].value_handle != p_ios->service_handle + m_value_offset[chr]) {
+            APP_ERROR_CHECK(NRF_ERROR_INTERNAL);
+        }
+    }
 }
 
 
@@ -138,7 +255,7 @@ uint32_t ble_ios_on_output(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t le
     ble_gatts_hvx_params_t params;
 
     memset(&params, 0, sizeof(params));
-    params.handle = p_ios->char_handle_out.value_handle;
+    params.handle = p_ios->char_handles[BLE_IOS_CHAR_OUTPUT].value_handle;
     params.type = BLE_GATT_HVX_NOTIFICATION;    //Notification
 //    params.offset = 0;
     if (length > (uint16_t)(GATT_RX_MTU - 3)) {
@@ -152,6 +269,28 @@ uint32_t ble_ios_on_output(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t le
 }
 
 
+/**
+ * @brief Config読み出し値設定
+ *
+ * Config Write後に、Centralが読み出して結果を確認できるようにする。
+ *
+ * @param[in]   p_ios       サービス構造体
+ * @param[in]   p_value     設定データバッファ
+ * @param[in]   length      設定データサイズ
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t ble_ios_cfg_value_set(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length)
+{
+    ble_gatts_value_t value;
+
+    memset(&value, 0, sizeof(value));
+    value.len = length;
+    value.p_value = (uint8_t *)p_value;
+
+    return sd_ble_gatts_value_set(p_ios->conn_handle, p_ios->char_handles[BLE_IOS_CHAR_CONFIG].value_handle, &value);
+}
+
+
 /**************************************************************************
  * private function
  **************************************************************************/
@@ -190,151 +329,15 @@ static void on_disconnect(ble_ios_t *p_ios, ble_evt_t *p_ble_evt)
 static void on_write(ble_ios_t *p_ios, ble_evt_t *p_ble_evt)
 {
     ble_gatts_evt_write_t *p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+    uint16_t offset = p_evt_write->handle - p_ios->service_handle;
+    uint8_t chr;
 
-    if ((p_evt_write->handle == p_ios->char_handle_in.value_handle) &&
-      (p_ios->evt_handler_in != NULL)) {
-        p_ios->evt_handler_in(p_ios, p_evt_write->data, p_evt_write->len);
+    //ハンドルを1つずつ比べず、表から引く
+    if ((offset >= IOS_HDL_NUM) || (m_handle_chr[offset] == 0)) {
+        return;
+    }
+    chr = m_handle_chr[offset] - 1;
+    if (p_ios->write_handler[chr] != NULL) {
+        p_ios->write_handler[chr](p_ios, p_evt_write->data, p_evt_write->len);
     }
-}
-
-
-/**
- * @brief キャラクタリスティック登録：Input
- *
- *      permission : Write
- *
- * @param[in/out]   p_ios       サービス構造体
- * @param[in]       p_ios_init  サービス初期化構造体
- */
-static uint32_t char_add_input(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_init)
-{
-    ble_gatts_char_md_t char_md;
-    ble_uuid_t          char_uuid;
-    ble_gatts_attr_md_t attr_md;
-    ble_gatts_attr_t    attr_char_value;
-
-    ///////////////////////
-    //Characteristicの設定
-    ///////////////////////
-
-    // メタデータ
-    //      Write
-    memset(&char_md, 0, sizeof(char_md));
-    char_md.char_props.write  = 1;
-//    char_md.p_char_user_desc  = NULL;
-//    char_md.p_char_pf         = NULL;
-//    char_md.p_user_desc_md    = NULL;
-//    char_md.p_cccd_md         = NULL;
-//    char_md.p_sccd_md         = NULL;
-
-    // UUID
-    char_uuid.type = p_ios->uuid_type;
-    char_uuid.uuid = IOS_UUID_CHAR_INPUT;
-
-
-    ///////////////////////
-    // Attributeの設定
-    ///////////////////////
-
-    // メタデータ
-    //Write Only
-    memset(&attr_md, 0, sizeof(attr_md));
-    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.read_perm);
-    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.write_perm);
-//    attr_md.vlen       = 0;
-    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
-//    attr_md.rd_auth    = 0;
-//    attr_md.wr_auth    = 0;
-
-    // value
-    memset(&attr_char_value, 0, sizeof(attr_char_value));
-    attr_char_value.p_uuid       = &char_uuid;
-    attr_char_value.p_attr_md    = &attr_md;
-    attr_char_value.init_len     = 1;
-//    attr_char_value.init_offs    = 0;
-    attr_char_value.max_len      = p_ios_init->len_in;
-//    attr_char_value.p_value      = NULL;
-
-
-    ///////////////////////
-    // キャラクタリスティックの登録
-    return sd_ble_gatts_characteristic_add(p_ios->service_handle,
-                                                &char_md,
-                                                &attr_char_value,
-                                                &p_ios->char_handle_in);
-}
-
-
-/**
- * @brief キャラクタリスティック登録：Output
- *
- *      permission : Read, Notify
- *
- * @param[in/out]   p_ios       サービス構造体
- * @param[in]       p_ios_init  サービス初期化構造体
- */
-static uint32_t char_add_output(ble_ios_t *p_ios, const ble_ios_init_t *p_ios_init)
-{
-    ble_gatts_char_md_t char_md;
-    ble_gatts_attr_md_t cccd_md;
-    ble_uuid_t          char_uuid;
-    ble_gatts_attr_md_t attr_md;
-    ble_gatts_attr_t    attr_char_value;
-
-    ///////////////////////
-    // Characteristicの設定
-    ///////////////////////
-
-    // CCCD(Notify/Indicate用)
-    memset(&cccd_md, 0, sizeof(cccd_md));
-    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
-    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
-    cccd_md.vloc = BLE_GATTS_VLOC_STACK;
-
-    // メタデータ
-    //      Read, Notify
-    memset(&char_md, 0, sizeof(char_md));
-    char_md.char_props.read   = 1;
-    char_md.char_props.notify = 1;
-//    char_md.p_char_user_desc  = NULL;
-//    char_md.p_char_pf         = NULL;
-//    char_md.p_user_desc_md    = NULL;
-    char_md.p_cccd_md         = &cccd_md;
-//    char_md.p_sccd_md         = NULL;
-
-    // UUID
-    char_uuid.type = p_ios->uuid_type;
-    char_uuid.uuid = IOS_UUID_CHAR_OUTPUT;
-
-
-    ///////////////////////
-    // Attributeの設定
-    ///////////////////////
-
-    // メタデータ
-    //Read Only
-    memset(&attr_md, 0, sizeof(attr_md));
-    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
-    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
-//    attr_md.vlen       = 0;
-    attr_md.vloc       = BLE_GATTS_VLOC_STACK;
-//    attr_md.rd_auth    = 0;       //0:without response
-//    attr_md.wr_auth    = 0;       //0:without response
-
-    // value
-    memset(&attr_char_value, 0, sizeof(attr_char_value));
-    attr_char_value.p_uuid       = &char_uuid;
-    attr_char_value.p_attr_md    = &attr_md;
-    attr_char_value.init_len     = 1;
-//    attr_char_value.init_offs    = 0;
-    attr_char_value.max_len      = p_ios_init->len_out;
-//    attr_char_value.p_value      = NULL;
-
-
-    ///////////////////////
-    // キャラクタリスティックの登録
-    return sd_ble_gatts_characteristic_add(p_ios->service_handle,
-                                                &char_md,
-                                                &attr_char_value,
-                                                &p_ios->char_handle_out);
 }
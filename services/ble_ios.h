@@ -49,12 +49,39 @@
 #define IOS_UUID_SERVICE        (0x0001)
 #define IOS_UUID_CHAR_INPUT     (0x0002)
 #define IOS_UUID_CHAR_OUTPUT    (0x0003)
+#define IOS_UUID_CHAR_CONFIG    (0x0004)
+
+/**
+ * @brief キャラクタリスティック定義
+ *
+ * X(名前, UUID, Read, Write, Notify, 可変長, 省略可)
+ *  - Read/Writeは0:プロパティ無し(NO_ACCESS)、1:OPEN、2:暗号化必須(Security Mode 1 Level 2)
+ *  - 省略可のものは、Writeハンドラが無ければ登録しない(末尾に置くこと)
+ * 追加はこの表に1行足すだけでよい(ハンドル番号は登録順で決まるので、並べ替えないこと)。
+ */
+#define BLE_IOS_CHAR_TABLE(X)                                                           \
+    X(INPUT,    IOS_UUID_CHAR_INPUT,    0, 1, 0, 0, false)                              \
+    X(OUTPUT,   IOS_UUID_CHAR_OUTPUT,   1, 0, 1, 0, false)                              \
+    X(CONFIG,   IOS_UUID_CHAR_CONFIG,   1, 2, 0, 1, true)
+
+/** ble_ios_on_ble_evt()が扱うイベント(app_evtdisp) */
+#define BLE_IOS_BLE_EVTS                BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED, BLE_GATTS_EVT_WRITE
 
 
 /**************************************************************************
  * definition
  **************************************************************************/
 
+/**@brief キャラクタリスティック */
+typedef enum {
+#define BLE_IOS_CHAR_ENUM_(name, uuid, rd, wr, ntf, vl, opt)  BLE_IOS_CHAR_##name,
+    BLE_IOS_CHAR_TABLE(BLE_IOS_CHAR_ENUM_)
+#undef BLE_IOS_CHAR_ENUM_
+    //
+    BLE_IOS_CHAR_MAX
+} ble_ios_char_t;
+
+
 // Forward declaration of the ble_ios_t type.
 typedef struct ble_ios_s ble_ios_t;
 
@@ -72,8 +99,8 @@ typedef void (*ble_ios_evt_handler_t) (ble_ios_t *p_ios, const uint8_t *p_value,
 /**@brief サービス初期化構造体 */
 typedef struct {
     ble_ios_evt_handler_t           evt_handler_in;             /**< イベントハンドラ : Input Notify発生 */
-    uint16_t                        len_in;                     /**< Inputデータ長 */
-    uint16_t                        len_out;                    /**< Outputデータ長 */
+    ble_ios_evt_handler_t           evt_handler_cfg;            /**< イベントハンドラ : Config Write発生(NULLならConfig無し) */
+    uint16_t                        max_len[BLE_IOS_CHAR_MAX];  /**< キャラクタリスティックごとのデータ長 */
 } ble_ios_init_t;
 
 
@@ -82,11 +109,8 @@ typedef struct ble_ios_s {
     uint16_t                        service_handle;             /**< Handle of I/O Service (as provided by the BLE stack). */
     uint16_t                        conn_handle;                /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection). */
     uint8_t                         uuid_type;
-    //
-    ble_gatts_char_handles_t        char_handle_in;             /**< Handles related to the Input characteristic. */
-    ble_ios_evt_handler_t           evt_handler_in;             /**< Event handler to be called for handling events in the I/O Service. */
-    //
-    ble_gatts_char_handles_t        char_handle_out;            /**< Handles related to the Output characteristic. */
+    ble_gatts_char_handles_t        char_handles[BLE_IOS_CHAR_MAX];     /**< Handles related to the I/O characteristics. */
+    ble_ios_evt_handler_t           write_handler[BLE_IOS_CHAR_MAX];    /**< Write時のハンドラ(NULL:無し) */
 } ble_ios_t;
 
 
@@ -120,5 +144,15 @@ void ble_ios_on_ble_evt(ble_ios_t *p_ios, ble_evt_t *p_ble_evt);
  */
 uint32_t ble_ios_on_output(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
 
+
+/**@brief Config読み出し値設定
+ *
+ * @param[in]   p_ios       サービス構造体
+ * @param[in]   p_value     設定データバッファ
+ * @param[in]   length      設定データサイズ
+ * @retval      NRF_SUCCESS 成功
+ */
+uint32_t ble_ios_cfg_value_set(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
+
 #endif // BLE_IOS_H__
 
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    bench_dsp.c
+ *
+ * app_dspのベンチマーク
+ *
+ * 1入力サンプルあたりの時間をホストで測る。
+ * 絶対値はCortex-M0とは比べられないので、カーネル同士や変更前後の比較に使う。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "app_dsp.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define BENCH_LEN                       (1 << 22)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static int16_t                          m_input[BENCH_LEN];
+
+/** 最適化で消されないよう、出力を足し込む */
+static volatile int32_t                 m_sink;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint64_t now_ns(void);
+static void report(const char *p_name, uint64_t ns);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    static int16_t ma_buf[1 << 4];
+    static int16_t fir_buf[APP_DSP_FIR_LP4_TAPS];
+    app_dsp_ma_t ma;
+    app_dsp_fir_t fir;
+    app_dsp_cic_t cic;
+    app_dsp_stats_t stats;
+    app_dsp_stats_result_t res;
+    app_dsp_thr_t thr;
+    uint32_t lp;
+    uint64_t t0;
+    int32_t sink = 0;
+    int16_t y;
+
+    srand(1);
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        m_input[lp] = (int16_t)((rand() & 0xffff) - 0x8000);
+    }
+
+    printf("kernel                      ns/sample\n");
+
+    app_dsp_ma_init(&ma, ma_buf, 4);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        sink += app_dsp_ma_put(&ma, m_input[lp]);
+    }
+    report("ma(16)", now_ns() - t0);
+
+    app_dsp_fir_init(&fir, app_dsp_fir_lp4, fir_buf, APP_DSP_FIR_LP4_TAPS, 1);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        if (app_dsp_fir_put(&fir, m_input[lp], &y)) {
+            sink += y;
+        }
+    }
+    report("fir(16 taps, decim 1)", now_ns() - t0);
+
+    app_dsp_fir_init(&fir, app_dsp_fir_lp4, fir_buf, APP_DSP_FIR_LP4_TAPS, 4);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        if (app_dsp_fir_put(&fir, m_input[lp], &y)) {
+            sink += y;
+        }
+    }
+    report("fir(16 taps, decim 4)", now_ns() - t0);
+
+    app_dsp_cic_init(&cic, 3, 2);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        if (app_dsp_cic_put(&cic, m_input[lp], &y)) {
+            sink += y;
+        }
+    }
+    report("cic(order 3, decim 4)", now_ns() - t0);
+
+    app_dsp_stats_init(&stats, 6);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        if (app_dsp_stats_put(&stats, m_input[lp], &res)) {
+            sink += res.rms;
+        }
+    }
+    report("stats(64)", now_ns() - t0);
+
+    app_dsp_thr_init(&thr, 1000, -1000, 2);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        sink += app_dsp_thr_put(&thr, m_input[lp]);
+    }
+    report("thr", now_ns() - t0);
+
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_LEN; lp++) {
+        sink += app_dsp_isqrt(((uint32_t)m_input[lp] << 15) ^ lp);
+    }
+    report("isqrt", now_ns() - t0);
+
+    m_sink = sink;
+    return 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static void report(const char *p_name, uint64_t ns)
+{
+    printf("%-26s  %9.2f\n", p_name, (double)ns / BENCH_LEN);
+}
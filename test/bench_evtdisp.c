@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    bench_evtdisp.c
+ *
+ * app_evtdispのベンチマーク
+ *
+ * サービス数2/8/16で、1イベントあたりの振り分け時間を
+ * 「全ハンドラを呼んでそれぞれのswitchで捨てる(変更前)」と「app_evtdisp_run()」で比べる。
+ * 両方で各ハンドラが処理した回数が一致することも確かめる。
+ * 時刻はsim_ts.c(変数を読むだけ)にして、実機のRTCレジスタ読出しに近づける。
+ *
+ * -DBENCH_EVTDISP_TOO_MANYでIDを13個並べた行を作る(コンパイルエラーになることをMakefileで確かめる)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_evtdisp.h"
+#include "app_ts.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define BENCH_EVENTS                    (1 << 22)
+#define SERVICE_MAX                     (16)
+
+/**
+ * 各サービスは接続/切断と、もう1つのイベントを扱う
+ */
+#define SERVICE(n, id)                                                                  \
+    static void handler_##n(void *p_context, ble_evt_t *p_ble_evt)                      \
+    {                                                                                   \
+        switch (p_ble_evt->header.evt_id) {                                             \
+        case BLE_GAP_EVT_CONNECTED:                                                     \
+        case BLE_GAP_EVT_DISCONNECTED:                                                  \
+        case id:                                                                        \
+            ((volatile uint32_t *)p_context)[n]++;                                      \
+            break;                                                                      \
+        default:                                                                        \
+            break;                                                                      \
+        }                                                                               \
+    }
+#define ENTRY(n, id)                    APP_EVTDISP_ENTRY(handler_##n, APP_BUDGET_BLE_APP, \
+                                            BLE_GAP_EVT_CONNECTED, BLE_GAP_EVT_DISCONNECTED, id)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static volatile uint32_t                m_count[SERVICE_MAX];
+
+SERVICE(0, BLE_GATTS_EVT_WRITE)
+SERVICE(1, BLE_EVT_TX_COMPLETE)
+SERVICE(2, BLE_GAP_EVT_RSSI_CHANGED)
+SERVICE(3, BLE_GAP_EVT_CONN_PARAM_UPDATE)
+SERVICE(4, BLE_GATTS_EVT_WRITE)
+SERVICE(5, BLE_GATTS_EVT_HVC)
+SERVICE(6, BLE_GAP_EVT_SEC_PARAMS_REQUEST)
+SERVICE(7, BLE_GATTS_EVT_WRITE)
+SERVICE(8, BLE_GAP_EVT_TIMEOUT)
+SERVICE(9, BLE_GAP_EVT_AUTH_STATUS)
+SERVICE(10, BLE_GATTS_EVT_WRITE)
+SERVICE(11, BLE_GATTS_EVT_SYS_ATTR_MISSING)
+SERVICE(12, BLE_GAP_EVT_CONN_SEC_UPDATE)
+SERVICE(13, BLE_GATTS_EVT_WRITE)
+SERVICE(14, BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST)
+SERVICE(15, BLE_GAP_EVT_PASSKEY_DISPLAY)
+
+static const app_evtdisp_entry_t        m_table[SERVICE_MAX] = {
+    ENTRY(0, BLE_GATTS_EVT_WRITE),
+    ENTRY(1, BLE_EVT_TX_COMPLETE),
+    ENTRY(2, BLE_GAP_EVT_RSSI_CHANGED),
+    ENTRY(3, BLE_GAP_EVT_CONN_PARAM_UPDATE),
+    ENTRY(4, BLE_GATTS_EVT_WRITE),
+    ENTRY(5, BLE_GATTS_EVT_HVC),
+    ENTRY(6, BLE_GAP_EVT_SEC_PARAMS_REQUEST),
+    ENTRY(7, BLE_GATTS_EVT_WRITE),
+    ENTRY(8, BLE_GAP_EVT_TIMEOUT),
+    ENTRY(9, BLE_GAP_EVT_AUTH_STATUS),
+    ENTRY(10, BLE_GATTS_EVT_WRITE),
+    ENTRY(11, BLE_GATTS_EVT_SYS_ATTR_MISSING),
+    ENTRY(12, BLE_GAP_EVT_CONN_SEC_UPDATE),
+    ENTRY(13, BLE_GATTS_EVT_WRITE),
+    ENTRY(14, BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST),
+    ENTRY(15, BLE_GAP_EVT_PASSKEY_DISPLAY),
+};
+
+#ifdef BENCH_EVTDISP_TOO_MANY
+static const app_evtdisp_entry_t        m_too_many[] = {
+    APP_EVTDISP_ENTRY(handler_0, APP_BUDGET_BLE_APP,
+        0x01, 0x02, 0x03, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19),
+};
+#endif  //BENCH_EVTDISP_TOO_MANY
+
+/** 接続中のイベントの並び(送信完了とWriteが大半) */
+static const uint16_t                   EVT_MIX[] = {
+    BLE_EVT_TX_COMPLETE, BLE_EVT_TX_COMPLETE, BLE_GATTS_EVT_WRITE, BLE_EVT_TX_COMPLETE,
+    BLE_EVT_TX_COMPLETE, BLE_GATTS_EVT_WRITE, BLE_EVT_TX_COMPLETE, BLE_GAP_EVT_RSSI_CHANGED,
+    BLE_EVT_TX_COMPLETE, BLE_EVT_TX_COMPLETE, BLE_GATTS_EVT_WRITE, BLE_EVT_TX_COMPLETE,
+    BLE_GATTS_EVT_HVC, BLE_EVT_TX_COMPLETE, BLE_GAP_EVT_CONN_PARAM_UPDATE, BLE_EVT_TX_COMPLETE,
+};
+#define EVT_MIX_NUM                     (sizeof(EVT_MIX) / sizeof(EVT_MIX[0]))
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void dispatch_all(const app_evtdisp_entry_t *p_table, uint8_t num, void *p_context, ble_evt_t *p_ble_evt);
+static uint64_t run(void (*p_func)(const app_evtdisp_entry_t *, uint8_t, void *, ble_evt_t *),
+                    uint8_t num, uint32_t *p_count);
+static uint64_t now_ns(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+/* 処理時間の監視は両方で同じ回数呼ぶので、ここでは何もしない */
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start)
+{
+    return start;
+}
+
+
+int main(void)
+{
+    static const uint8_t NUM[] = { 2, 8, 16 };
+    uint32_t count_all[SERVICE_MAX];
+    uint32_t count_disp[SERVICE_MAX];
+    uint64_t ns_all;
+    uint64_t ns_disp;
+    uint8_t lp;
+
+    printf("services  all handlers[ns/evt]  app_evtdisp[ns/evt]\n");
+    for (lp = 0; lp < sizeof(NUM); lp++) {
+        ns_all = run(dispatch_all, NUM[lp], count_all);
+        ns_disp = run(app_evtdisp_run, NUM[lp], count_disp);
+        if (memcmp(count_all, count_disp, sizeof(count_all)) != 0) {
+            printf("NG: handled events differ (services=%u)\n", NUM[lp]);
+            return 1;
+        }
+        printf("%8u  %20.1f  %19.1f\n", NUM[lp],
+                (double)ns_all / BENCH_EVENTS, (double)ns_disp / BENCH_EVENTS);
+    }
+    return 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 変更前の振り分け : 全ハンドラを呼ぶ
+ */
+static void dispatch_all(const app_evtdisp_entry_t *p_table, uint8_t num, void *p_context, ble_evt_t *p_ble_evt)
+{
+    uint32_t t = app_ts_now();
+    uint8_t lp;
+
+    for (lp = 0; lp < num; lp++) {
+        p_table[lp].handler(p_context, p_ble_evt);
+        t = app_budget_check(p_table[lp].budget, t);
+    }
+}
+
+
+static uint64_t run(void (*p_func)(const app_evtdisp_entry_t *, uint8_t, void *, ble_evt_t *),
+                    uint8_t num, uint32_t *p_count)
+{
+    ble_evt_t evt;
+    uint32_t lp;
+    uint64_t t0;
+    uint64_t ns;
+
+    memset((void *)m_count, 0, sizeof(m_count));
+    memset(&evt, 0, sizeof(evt));
+
+    //接続と切断をはさむ
+    evt.header.evt_id = BLE_GAP_EVT_CONNECTED;
+    p_func(m_table, num, (void *)m_count, &evt);
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_EVENTS; lp++) {
+        evt.header.evt_id = EVT_MIX[lp % EVT_MIX_NUM];
+        p_func(m_table, num, (void *)m_count, &evt);
+    }
+    ns = now_ns() - t0;
+    evt.header.evt_id = BLE_GAP_EVT_DISCONNECTED;
+    p_func(m_table, num, (void *)m_count, &evt);
+
+    for (lp = 0; lp < SERVICE_MAX; lp++) {
+        p_count[lp] = m_count[lp];
+    }
+    return ns;
+}
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
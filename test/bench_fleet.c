@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    bench_fleet.c
+ *
+ * 多数の仮想デバイスとゲートウェイのシミュレーション
+ *
+ *      bench_fleet [-n デバイス数] [-t スレッド数] [-e イベント数]
+ *
+ * app_ble.c(services/含む)をデバイスの数だけapp_ble_tで動かし、それぞれにsim_ble_tのリンクを付ける。
+ * デバイスはスレッドに均等に割り振り、各スレッドが自分の担当を順にConnectionイベント1回分ずつ進める
+ * (app_ble_nofify()、app_ble_idle()、sim_ble_conn_event()、BLE_EVT_TX_COMPLETE)。
+ * Centralが受け取ったNotifyは、1本のキューでゲートウェイのスレッドに渡す。
+ *
+ * ゲートウェイはデバイスごとに連番の抜け・重複・順序を確かめ、受け取ったパケット数とレートを出す。
+ * Notifyの中身は[デバイス番号(4byte)][連番(4byte)][埋め]。
+ * 取り込みの速さを見るので、時刻はapp_ts.c(clock_gettime())。
+ *
+ * bench_fleet_real(SIM_APP_REAL_HELPERS)はapp_latency/app_wheel/app_bulk/app_packを本物にし、
+ *  - 偶数番のデバイスだけslave latencyありで接続し、最初のNotifyでlatency 0になるのがそのデバイスだけであること
+ *  - デバイスごとのapp_pack_tにイベントごとPACK_PER_EVENT個詰めて送り、
+ *    ゲートウェイでデバイスごとのseqが続いていること
+ * も確かめる。wheelはチップに1つなのでtickは進めない(アイドル復帰とAPP_PACK_MAX_AGEはtest_latency/test_pack)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "app_ble.h"
+#include "app_ts.h"
+#include "ble_ios.h"
+#ifdef SIM_APP_REAL_HELPERS
+#include "app_wheel.h"
+#include "app_pack.h"
+#endif  //SIM_APP_REAL_HELPERS
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define DEVICES_DEF                     (2000)
+#define THREADS_DEF                     (4)
+#define EVENTS_DEF                      (200)
+#define THREADS_MAX                     (64)
+
+#define TX_BUFFERS                      (7)
+#define PKTS_PER_EVENT                  (6)
+#define CONN_HANDLE                     (0x0010)
+
+/** 1デバイス・1イベントあたりのアプリのNotify数 */
+#define NOTIFY_PER_EVENT                (4)
+
+/** 最後に送信待ちを流し切るためのイベント数 */
+#define DRAIN_EVENTS                    (8)
+
+/** アプリのNotifyの長さ */
+#define NOTIFY_LEN                      (20)
+
+/** ゲートウェイの取り込みキュー[パケット] */
+#define GW_QUEUE_NUM                    (4096)
+
+#ifdef SIM_APP_REAL_HELPERS
+/** 偶数番のデバイスのslave latency */
+#define PEER_LATENCY                    (4)
+
+/** 1デバイス・1イベントあたりに詰めるサンプル数(詰めたらapp_pack_flush()) */
+#define PACK_PER_EVENT                  (2)
+
+/** 1サンプルのbyte数(app_ble.cのPACK_SAMPLE_SIZEと同じ) */
+#define PACK_SAMPLE_SIZE                (2)
+
+/** app_packのパケット長(NOTIFY_LENと違う長さにしてゲートウェイで見分ける) */
+#define PACK_LEN                        (APP_PACK_HDR_LEN + PACK_SAMPLE_SIZE + \
+                                            (1 + PACK_SAMPLE_SIZE) * (PACK_PER_EVENT - 1))
+#endif  //SIM_APP_REAL_HELPERS
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 仮想デバイス */
+typedef struct {
+    app_ble_t   ble;
+    sim_ble_t   *p_sim;
+    uint32_t    put;                /**< app_ble_nofify()の数(=次の連番) */
+} device_t;
+
+/** スレッドの担当 */
+typedef struct {
+    pthread_t   thread;
+    uint32_t    first;
+    uint32_t    num;
+} shard_t;
+
+/** ゲートウェイが受け取った1パケット */
+typedef struct {
+    uint16_t    handle;
+    uint16_t    length;
+    uint8_t     data[SIM_BLE_NOTIFY_MAX];
+} gw_pkt_t;
+
+/** 書込みイベント(データ分の領域を後ろに足す) */
+typedef union {
+    ble_evt_t   evt;
+    uint8_t     buf[sizeof(ble_evt_t) + 4];
+} evt_buf_t;
+
+static device_t                         *m_dev;
+static uint32_t                         m_dev_num = DEVICES_DEF;
+static uint32_t                         m_events = EVENTS_DEF;
+static uint16_t                         m_output_handle;
+
+/* ゲートウェイ */
+static pthread_mutex_t                  m_gw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t                   m_gw_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t                   m_gw_not_full = PTHREAD_COND_INITIALIZER;
+static gw_pkt_t                         m_gw_queue[GW_QUEUE_NUM];
+static uint32_t                         m_gw_rd;
+static uint32_t                         m_gw_num;
+static bool                             m_gw_stop;
+
+static uint32_t                         *m_gw_expect;   /**< デバイスごとの次の連番 */
+static uint64_t                         m_gw_pkts;
+static uint64_t                         m_gw_bytes;
+static uint32_t                         m_gw_bad;       /**< 連番やデバイス番号がおかしいパケット */
+#ifdef SIM_APP_REAL_HELPERS
+static uint32_t                         *m_gw_pack_expect;  /**< デバイスごとのapp_packのパケット数 */
+static uint64_t                         m_gw_pack_pkts;
+#endif  //SIM_APP_REAL_HELPERS
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void device_init(device_t *p_dev);
+static void device_event(device_t *p_dev, bool notify);
+static void ble_evt(app_ble_t *p_ble, uint16_t evt_id, uint8_t count);
+static void *shard_run(void *p_arg);
+static void gw_rx(uint16_t handle, const uint8_t *p_data, uint16_t length);
+static void *gw_run(void *p_arg);
+#ifdef SIM_APP_REAL_HELPERS
+static bool gw_pack_rx(const gw_pkt_t *p_pkt);
+static int helpers_check(void);
+#endif  //SIM_APP_REAL_HELPERS
+static void u32_set(uint8_t *p, uint32_t val);
+static uint32_t u32_get(const uint8_t *p);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    shard_t shard[THREADS_MAX];
+    pthread_t gw;
+    uint32_t threads = THREADS_DEF;
+    uint32_t start;
+    uint32_t elapsed;
+    uint32_t lp;
+    uint32_t lost = 0;
+    int opt;
+    int ng = 0;
+
+    while ((opt = getopt(argc, argv, "n:t:e:")) != -1) {
+        switch (opt) {
+        case 'n':
+            m_dev_num = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            threads = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            m_events = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n devices] [-t threads] [-e events]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((m_dev_num == 0) || (threads == 0) || (threads > THREADS_MAX)) {
+        fprintf(stderr, "bad -n/-t\n");
+        return 1;
+    }
+    if (threads > m_dev_num) {
+        threads = m_dev_num;
+    }
+
+    m_dev = (device_t *)calloc(m_dev_num, sizeof(device_t));
+    m_gw_expect = (uint32_t *)calloc(m_dev_num, sizeof(uint32_t));
+    if ((m_dev == NULL) || (m_gw_expect == NULL)) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+#ifdef SIM_APP_REAL_HELPERS
+    //サンプル値にデバイス番号を入れるので16bitまで
+    if (m_dev_num > 0x10000) {
+        fprintf(stderr, "bad -n\n");
+        return 1;
+    }
+    m_gw_pack_expect = (uint32_t *)calloc(m_dev_num, sizeof(uint32_t));
+    if (m_gw_pack_expect == NULL) {
+        fprintf(stderr, "no memory\n");
+        return 1;
+    }
+    app_wheel_init();
+#endif  //SIM_APP_REAL_HELPERS
+
+    //初期化は1スレッドで(SoftDeviceの登録順にハンドルが決まる)
+    for (lp = 0; lp < m_dev_num; lp++) {
+        device_init(&m_dev[lp]);
+        if (m_dev[lp].p_sim == NULL) {
+            fprintf(stderr, "no memory\n");
+            return 1;
+        }
+    }
+    sim_ble_select(NULL);
+
+    printf("%u devices, %u threads, %u events, %u notify/evt, %u tx buffers, %u pkts/evt\n",
+            m_dev_num, threads, m_events, NOTIFY_PER_EVENT, TX_BUFFERS, PKTS_PER_EVENT);
+
+    pthread_create(&gw, NULL, gw_run, NULL);
+    start = app_ts_now();
+    for (lp = 0; lp < threads; lp++) {
+        shard[lp].first = (uint32_t)((uint64_t)m_dev_num * lp / threads);
+        shard[lp].num = (uint32_t)((uint64_t)m_dev_num * (lp + 1) / threads) - shard[lp].first;
+        pthread_create(&shard[lp].thread, NULL, shard_run, &shard[lp]);
+    }
+    for (lp = 0; lp < threads; lp++) {
+        pthread_join(shard[lp].thread, NULL);
+    }
+
+    pthread_mutex_lock(&m_gw_mutex);
+    m_gw_stop = true;
+    pthread_cond_signal(&m_gw_not_empty);
+    pthread_mutex_unlock(&m_gw_mutex);
+    pthread_join(gw, NULL);
+    elapsed = app_ts_now() - start;
+
+    for (lp = 0; lp < m_dev_num; lp++) {
+        if (m_gw_expect[lp] != m_dev[lp].put) {
+            if (lost == 0) {
+                printf("NG device %u: received %u / put %u\n", lp, m_gw_expect[lp], m_dev[lp].put);
+            }
+            lost += m_dev[lp].put - m_gw_expect[lp];
+        }
+    }
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    printf("gateway: %llu pkts in %.3f s, %.0f pkts/s, %.1f KB/s, lost %u, bad %u\n",
+            (unsigned long long)m_gw_pkts, elapsed / 1000000.0,
+            (double)m_gw_pkts * 1000000 / elapsed, (double)m_gw_bytes * 1000000 / elapsed / 1024,
+            lost, m_gw_bad);
+
+    ng = (lost != 0) || (m_gw_bad != 0) ||
+            (m_gw_pkts != (uint64_t)m_dev_num * m_events * NOTIFY_PER_EVENT);
+#ifdef SIM_APP_REAL_HELPERS
+    ng |= helpers_check();
+#endif  //SIM_APP_REAL_HELPERS
+    printf("bench_fleet: %s\n", (ng) ? "NG" : "OK");
+
+    for (lp = 0; lp < m_dev_num; lp++) {
+        free(m_dev[lp].p_sim);
+    }
+#ifdef SIM_APP_REAL_HELPERS
+    free(m_gw_pack_expect);
+#endif  //SIM_APP_REAL_HELPERS
+    free(m_gw_expect);
+    free(m_dev);
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 仮想デバイスを作って接続状態にする
+ */
+static void device_init(device_t *p_dev)
+{
+    ble_gatts_char_handles_t output;
+
+    p_dev->p_sim = sim_ble_create();
+    if (p_dev->p_sim == NULL) {
+        return;
+    }
+    sim_ble_select(p_dev->p_sim);
+    sim_ble_link_set(TX_BUFFERS, PKTS_PER_EVENT, gw_rx);
+
+    app_ble_init(&p_dev->ble);
+    app_ble_init_late(&p_dev->ble);
+    app_ble_start(&p_dev->ble);
+    if (sim_ble_char_find(IOS_UUID_CHAR_OUTPUT, &output)) {
+        m_output_handle = output.value_handle;
+    }
+#ifdef SIM_APP_REAL_HELPERS
+    ble_evt(&p_dev->ble, BLE_GAP_EVT_CONNECTED, ((p_dev - m_dev) % 2 == 0) ? PEER_LATENCY : 0);
+#else   //SIM_APP_REAL_HELPERS
+    ble_evt(&p_dev->ble, BLE_GAP_EVT_CONNECTED, 0);
+#endif  //SIM_APP_REAL_HELPERS
+}
+
+
+/**
+ * @brief Connectionイベント1回分進める
+ *
+ * @param[in]   notify      アプリのNotifyを出すかどうか(falseは送信待ちを流すだけ)
+ */
+static void device_event(device_t *p_dev, bool notify)
+{
+    uint8_t data[NOTIFY_LEN];
+    uint8_t lp;
+    uint8_t count;
+
+    sim_ble_select(p_dev->p_sim);
+    if (notify) {
+        memset(data, 0, sizeof(data));
+        u32_set(&data[0], (uint32_t)(p_dev - m_dev));
+        for (lp = 0; lp < NOTIFY_PER_EVENT; lp++) {
+            u32_set(&data[4], p_dev->put);
+            app_ble_nofify(&p_dev->ble, data, sizeof(data));
+            p_dev->put++;
+        }
+#ifdef SIM_APP_REAL_HELPERS
+        {
+            //サンプル値はデバイス番号、時刻はサンプルごとに1 delta進める
+            uint8_t sample[PACK_SAMPLE_SIZE];
+
+            sample[0] = (uint8_t)(p_dev - m_dev);
+            sample[1] = (uint8_t)((p_dev - m_dev) >> 8);
+            for (lp = 0; lp < PACK_PER_EVENT; lp++) {
+                app_pack_put_at(&p_dev->ble.pack, sample, (p_dev->put + lp) * APP_PACK_DELTA_US);
+            }
+            app_pack_flush(&p_dev->ble.pack);
+        }
+#endif  //SIM_APP_REAL_HELPERS
+    }
+    app_ble_idle(&p_dev->ble);
+
+    count = sim_ble_conn_event();
+    if (count != 0) {
+        ble_evt(&p_dev->ble, BLE_EVT_TX_COMPLETE, count);
+    }
+}
+
+
+/**
+ * @brief BLEイベントを渡す
+ *
+ * @param[in]   count       BLE_EVT_TX_COMPLETEなら送信数、BLE_GAP_EVT_CONNECTEDならslave latency
+ */
+static void ble_evt(app_ble_t *p_ble, uint16_t evt_id, uint8_t count)
+{
+    evt_buf_t buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id = evt_id;
+    if (evt_id == BLE_EVT_TX_COMPLETE) {
+        buf.evt.evt.common_evt.conn_handle = CONN_HANDLE;
+        buf.evt.evt.common_evt.params.tx_complete.count = count;
+    }
+    else {
+        buf.evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+        if (evt_id == BLE_GAP_EVT_CONNECTED) {
+            buf.evt.evt.gap_evt.params.connected.conn_params.slave_latency = count;
+        }
+    }
+    app_ble_evt_dispatch(p_ble, &buf.evt);
+}
+
+
+/**
+ * @brief 担当のデバイスを、イベントごとに順に進める
+ */
+static void *shard_run(void *p_arg)
+{
+    const shard_t *p_shard = (const shard_t *)p_arg;
+    uint32_t events;
+    uint32_t lp;
+
+    for (events = 0; events < m_events + DRAIN_EVENTS; events++) {
+        for (lp = 0; lp < p_shard->num; lp++) {
+            device_event(&m_dev[p_shard->first + lp], events < m_events);
+        }
+    }
+    sim_ble_select(NULL);
+    return NULL;
+}
+
+
+/**
+ * @brief Centralが受け取ったNotifyをゲートウェイのキューに積む(満杯なら待つ)
+ */
+static void gw_rx(uint16_t handle, const uint8_t *p_data, uint16_t length)
+{
+    gw_pkt_t *p_pkt;
+
+    if (length > SIM_BLE_NOTIFY_MAX) {
+        length = SIM_BLE_NOTIFY_MAX;
+    }
+    pthread_mutex_lock(&m_gw_mutex);
+    while (m_gw_num >= GW_QUEUE_NUM) {
+        pthread_cond_wait(&m_gw_not_full, &m_gw_mutex);
+    }
+    p_pkt = &m_gw_queue[(m_gw_rd + m_gw_num) % GW_QUEUE_NUM];
+    p_pkt->handle = handle;
+    p_pkt->length = length;
+    memcpy(p_pkt->data, p_data, length);
+    m_gw_num++;
+    pthread_cond_signal(&m_gw_not_empty);
+    pthread_mutex_unlock(&m_gw_mutex);
+}
+
+
+/**
+ * @brief ゲートウェイ : キューから取り出して、デバイスごとの連番を確かめる
+ */
+static void *gw_run(void *p_arg)
+{
+    gw_pkt_t pkt;
+    uint32_t dev;
+    uint32_t seq;
+
+    for (;;) {
+        pthread_mutex_lock(&m_gw_mutex);
+        while ((m_gw_num == 0) && !m_gw_stop) {
+            pthread_cond_wait(&m_gw_not_empty, &m_gw_mutex);
+        }
+        if (m_gw_num == 0) {
+            pthread_mutex_unlock(&m_gw_mutex);
+            break;
+        }
+        pkt = m_gw_queue[m_gw_rd];
+        m_gw_rd = (m_gw_rd + 1) % GW_QUEUE_NUM;
+        m_gw_num--;
+        pthread_cond_signal(&m_gw_not_full);
+        pthread_mutex_unlock(&m_gw_mutex);
+
+#ifdef SIM_APP_REAL_HELPERS
+        if ((pkt.handle == m_output_handle) && (pkt.length == PACK_LEN)) {
+            if (!gw_pack_rx(&pkt)) {
+                m_gw_bad++;
+            }
+            continue;
+        }
+#endif  //SIM_APP_REAL_HELPERS
+        if ((pkt.handle != m_output_handle) || (pkt.length != NOTIFY_LEN)) {
+            m_gw_bad++;
+            continue;
+        }
+        dev = u32_get(&pkt.data[0]);
+        seq = u32_get(&pkt.data[4]);
+        if ((dev >= m_dev_num) || (seq != m_gw_expect[dev])) {
+            if (m_gw_bad == 0) {
+                printf("NG gateway: device %u seq %u (expect %u)\n",
+                        dev, seq, (dev < m_dev_num) ? m_gw_expect[dev] : 0);
+            }
+            m_gw_bad++;
+            continue;
+        }
+        m_gw_expect[dev]++;
+        m_gw_pkts++;
+        m_gw_bytes += pkt.length;
+    }
+    return NULL;
+}
+
+
+#ifdef SIM_APP_REAL_HELPERS
+/**
+ * @brief ゲートウェイ : app_packのパケット
+ *
+ * サンプル値(デバイス番号)でデバイスを決め、sizeとseq(4bit)を確かめる。
+ *
+ * @retval  false   おかしいパケット
+ */
+static bool gw_pack_rx(const gw_pkt_t *p_pkt)
+{
+    const uint8_t *p_data = p_pkt->data;
+    uint32_t dev;
+    uint8_t lp;
+
+    dev = (uint32_t)p_data[APP_PACK_HDR_LEN] | ((uint32_t)p_data[APP_PACK_HDR_LEN + 1] << 8);
+    if ((dev >= m_dev_num) || ((p_data[0] & 0x0f) != PACK_SAMPLE_SIZE) ||
+      ((p_data[0] >> 4) != (m_gw_pack_expect[dev] & 0x0f))) {
+        if (m_gw_bad == 0) {
+            printf("NG gateway: pack device %u hdr 0x%02x (expect seq %u)\n",
+                    dev, p_data[0], (dev < m_dev_num) ? (m_gw_pack_expect[dev] & 0x0f) : 0);
+        }
+        return false;
+    }
+    for (lp = 1; lp < PACK_PER_EVENT; lp++) {
+        p_data = &p_pkt->data[APP_PACK_HDR_LEN + PACK_SAMPLE_SIZE + (1 + PACK_SAMPLE_SIZE) * (lp - 1)];
+        if ((p_data[0] != 1) || (((uint32_t)p_data[1] | ((uint32_t)p_data[2] << 8)) != dev)) {
+            return false;
+        }
+    }
+    m_gw_pack_expect[dev]++;
+    m_gw_pack_pkts++;
+    return true;
+}
+
+
+/**
+ * @brief デバイスごとのapp_latency/app_packの状態
+ *
+ * @retval  0   OK
+ */
+static int helpers_check(void)
+{
+    app_pack_stats_t stats;
+    uint32_t fast = 0;
+    uint32_t lp;
+    uint32_t cnt;
+    bool expect;
+    int ng = 0;
+
+    for (lp = 0; lp < m_dev_num; lp++) {
+        //偶数番だけ、最初のNotifyでlatency 0にして、そのまま(tickは進めない)
+        expect = (lp % 2 == 0);
+        sim_ble_select(m_dev[lp].p_sim);
+        (void)sim_ble_local_latency(&cnt);
+        if ((m_dev[lp].ble.latency.fast != expect) || (cnt != ((expect) ? 1 : 0))) {
+            if (ng == 0) {
+                printf("NG device %u: latency fast=%d opt_set=%u\n", lp, m_dev[lp].ble.latency.fast, cnt);
+            }
+            ng = 1;
+        }
+        if (m_dev[lp].ble.latency.fast) {
+            fast++;
+        }
+
+        app_pack_stats_get(&m_dev[lp].ble.pack, &stats);
+        if ((stats.samples != m_events * PACK_PER_EVENT) || (stats.packets != m_events) ||
+          (m_gw_pack_expect[lp] != m_events)) {
+            if (ng == 0) {
+                printf("NG device %u: pack samples=%u packets=%u received=%u\n",
+                        lp, stats.samples, stats.packets, m_gw_pack_expect[lp]);
+            }
+            ng = 1;
+        }
+    }
+    sim_ble_select(NULL);
+    printf("helpers: latency 0 on %u / %u devices, pack %llu pkts\n",
+            fast, m_dev_num, (unsigned long long)m_gw_pack_pkts);
+    return ng;
+}
+#endif  //SIM_APP_REAL_HELPERS
+
+
+static void u32_set(uint8_t *p, uint32_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+    p[2] = (uint8_t)(val >> 16);
+    p[3] = (uint8_t)(val >> 24);
+}
+
+
+static uint32_t u32_get(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
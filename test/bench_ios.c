@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    bench_ios.c
+ *
+ * I/Oサービス : 表(BLE_IOS_CHAR_TABLE)と手書き版の比較
+ *
+ * 同じソースを2通りにビルドする。
+ *   bench_ios     : services/ble_ios.c(表から作る)
+ *   bench_ios_ref : test/ref/ble_ios.c(表にする前の手書き版)
+ * どちらもsim_ble.cに登録して、
+ *  - 登録されたキャラクタリスティックのハンドルが同じであること
+ *  - 書込みがInput/Configのハンドラに振り分けられ、それ以外のハンドルは無視されること
+ * を確かめ、ble_ios_tのサイズ、ble_ios_init()1回の時間、書込み1回の振り分け時間を出力する。
+ * コードと表のサイズ(ホストの-O2)は、make -C test の最後にsizeで出力する。
+ * 時間はホストでの値なので、nRF51での絶対値ではなく両者の比として見ること。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble.h"
+#include "ble_ios.h"
+#include "app_cfg.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+#ifdef BLE_IOS_CHAR_TABLE
+#define BENCH_NAME                      "bench_ios"
+#else
+#define BENCH_NAME                      "bench_ios_ref"
+#endif
+
+#define CONN_HANDLE                     (0x0010)
+
+/** ble_ios_init()を測る回数(1回ごとに仮想デバイスを作り直す) */
+#define INIT_LOOP                       (2000)
+
+/** 書込みの振り分けを測る回数 */
+#define WRITE_LOOP                      (2000000)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 書込みイベント(データ分の領域を後ろに足す) */
+typedef union {
+    ble_evt_t   evt;
+    uint8_t     buf[sizeof(ble_evt_t) + 4];
+} evt_buf_t;
+
+static uint32_t                         m_in_cnt;
+static uint32_t                         m_cfg_cnt;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void ios_init(ble_ios_t *p_ios);
+static int check_handles(void);
+static int check_write(ble_ios_t *p_ios);
+static void write_evt(evt_buf_t *p_buf, uint16_t handle);
+static void handler_in(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
+static void handler_cfg(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length);
+static uint64_t now_ns(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    static sim_ble_t *p_sim[INIT_LOOP];
+    static ble_ios_t ios[INIT_LOOP];
+    ble_gatts_char_handles_t input;
+    ble_gatts_char_handles_t config;
+    evt_buf_t evt[3];
+    uint64_t t0;
+    uint64_t init_ns;
+    uint64_t write_ns;
+    uint32_t lp;
+
+    //登録内容
+    ios_init(&ios[0]);
+    if ((check_handles() != 0) || (check_write(&ios[0]) != 0)) {
+        printf("%s: NG\n", BENCH_NAME);
+        return 1;
+    }
+
+    //初期化 : SoftDeviceへの登録を含む
+    for (lp = 0; lp < INIT_LOOP; lp++) {
+        p_sim[lp] = sim_ble_create();
+        if (p_sim[lp] == NULL) {
+            printf("%s: NG no memory\n", BENCH_NAME);
+            return 1;
+        }
+    }
+    t0 = now_ns();
+    for (lp = 0; lp < INIT_LOOP; lp++) {
+        sim_ble_select(p_sim[lp]);
+        ios_init(&ios[lp]);
+    }
+    init_ns = now_ns() - t0;
+    for (lp = 0; lp < INIT_LOOP; lp++) {
+        sim_ble_delete(p_sim[lp]);
+    }
+
+    //書込みの振り分け : Input, Config, 該当なし(CCCDなど)を順に
+    sim_ble_char_find(IOS_UUID_CHAR_INPUT, &input);
+    sim_ble_char_find(IOS_UUID_CHAR_CONFIG, &config);
+    write_evt(&evt[0], input.value_handle);
+    write_evt(&evt[1], config.value_handle);
+    write_evt(&evt[2], 0x0100);
+    t0 = now_ns();
+    for (lp = 0; lp < WRITE_LOOP; lp++) {
+        ble_ios_on_ble_evt(&ios[0], &evt[lp % 3].evt);
+    }
+    write_ns = now_ns() - t0;
+
+    printf("%-13s  sizeof(ble_ios_t)=%u  init=%.0fns  write=%.1fns\n", BENCH_NAME,
+            (unsigned)sizeof(ble_ios_t), (double)init_ns / INIT_LOOP, (double)write_ns / WRITE_LOOP);
+    printf("%s: OK\n", BENCH_NAME);
+    return 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief app_ble.cと同じ設定で初期化する
+ */
+static void ios_init(ble_ios_t *p_ios)
+{
+    ble_ios_init_t init;
+
+    memset(&init, 0, sizeof(init));
+    init.evt_handler_in = handler_in;
+    init.evt_handler_cfg = handler_cfg;
+#ifdef BLE_IOS_CHAR_TABLE
+    init.max_len[BLE_IOS_CHAR_INPUT] = 64;
+    init.max_len[BLE_IOS_CHAR_OUTPUT] = 32;
+    init.max_len[BLE_IOS_CHAR_CONFIG] = 1 + APP_CFG_VALUE_MAX;
+#else
+    init.len_in = 64;
+    init.len_out = 32;
+    init.len_cfg = 1 + APP_CFG_VALUE_MAX;
+#endif
+    ble_ios_init(p_ios, &init);
+}
+
+
+/**
+ * @brief ハンドルの割り当て(既定の1台に登録したもの)
+ *
+ * 手書き版と同じ順・同じ数で登録していれば、ハンドルも同じになる。
+ */
+static int check_handles(void)
+{
+    static const struct {
+        uint16_t    uuid;
+        uint16_t    value_handle;
+        uint16_t    cccd_handle;
+    } EXPECT[] = {
+        { IOS_UUID_CHAR_INPUT,  3, BLE_GATT_HANDLE_INVALID },
+        { IOS_UUID_CHAR_OUTPUT, 5, 6 },
+        { IOS_UUID_CHAR_CONFIG, 8, BLE_GATT_HANDLE_INVALID },
+    };
+    ble_gatts_char_handles_t handles;
+    uint8_t lp;
+
+    for (lp = 0; lp < sizeof(EXPECT) / sizeof(EXPECT[0]); lp++) {
+        CHECK(sim_ble_char_find(EXPECT[lp].uuid, &handles), "uuid %04x not found", EXPECT[lp].uuid);
+        CHECK((handles.value_handle == EXPECT[lp].value_handle) &&
+                (handles.cccd_handle == EXPECT[lp].cccd_handle),
+                "uuid %04x: value=%u cccd=%u", EXPECT[lp].uuid, handles.value_handle, handles.cccd_handle);
+    }
+    return 0;
+}
+
+
+/**
+ * @brief 書込みの振り分け
+ */
+static int check_write(ble_ios_t *p_ios)
+{
+    ble_gatts_char_handles_t handles;
+    evt_buf_t evt;
+
+    m_in_cnt = 0;
+    m_cfg_cnt = 0;
+
+    sim_ble_char_find(IOS_UUID_CHAR_INPUT, &handles);
+    write_evt(&evt, handles.value_handle);
+    ble_ios_on_ble_evt(p_ios, &evt.evt);
+    CHECK((m_in_cnt == 1) && (m_cfg_cnt == 0), "input: in=%u cfg=%u", m_in_cnt, m_cfg_cnt);
+
+    sim_ble_char_find(IOS_UUID_CHAR_CONFIG, &handles);
+    write_evt(&evt, handles.value_handle);
+    ble_ios_on_ble_evt(p_ios, &evt.evt);
+    CHECK((m_in_cnt == 1) && (m_cfg_cnt == 1), "config: in=%u cfg=%u", m_in_cnt, m_cfg_cnt);
+
+    //OutputのCCCDと、サービスの外
+    sim_ble_char_find(IOS_UUID_CHAR_OUTPUT, &handles);
+    write_evt(&evt, handles.cccd_handle);
+    ble_ios_on_ble_evt(p_ios, &evt.evt);
+    write_evt(&evt, 0x0100);
+    ble_ios_on_ble_evt(p_ios, &evt.evt);
+    CHECK((m_in_cnt == 1) && (m_cfg_cnt == 1), "other: in=%u cfg=%u", m_in_cnt, m_cfg_cnt);
+    return 0;
+}
+
+
+static void write_evt(evt_buf_t *p_buf, uint16_t handle)
+{
+    memset(p_buf, 0, sizeof(evt_buf_t));
+    p_buf->evt.header.evt_id = BLE_GATTS_EVT_WRITE;
+    p_buf->evt.evt.gatts_evt.conn_handle = CONN_HANDLE;
+    p_buf->evt.evt.gatts_evt.params.write.handle = handle;
+    p_buf->evt.evt.gatts_evt.params.write.len = 2;
+}
+
+
+static void handler_in(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length)
+{
+    m_in_cnt++;
+}
+
+
+static void handler_cfg(ble_ios_t *p_ios, const uint8_t *p_value, uint16_t length)
+{
+    m_cfg_cnt++;
+}
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
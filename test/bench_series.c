@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    bench_series.c
+ *
+ * app_seriesの圧縮率と追加時間
+ *
+ * 次のデータをリング(128byte x 8ブロック)があふれるまで追加し、
+ *  - 読み出した時刻と値が、残っているはずの最新のサンプルと一致すること(往復)
+ *  - 満杯になったブロックだけで数えた1KBあたりのサンプル数
+ *  - 1回の追加時間
+ * を、時刻と値をそのまま並べた配列(uint32_t x 2)と比べて出力する。
+ *   steady : 1000周期で時刻が±2揺れ、値は前回から±8以内で変わる(7bitに収まることが多い)
+ *   random : 時刻は同じ、値は毎回16bitの乱数
+ * READMEの数値はこれで取った。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_series.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+/** 1ケースのサンプル数(リングを何周もする) */
+#define SAMPLES                         (20000)
+
+/** 追加時間を測る回数 */
+#define BENCH_LOOP                      (50)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 比較対象 : そのまま並べた配列 */
+typedef struct {
+    uint32_t    ts;
+    uint32_t    val;
+} raw_sample_t;
+
+typedef struct {
+    const char  *p_name;
+    bool        random;         /**< true:値は毎回16bitの乱数 */
+} case_t;
+
+static raw_sample_t                     m_src[SAMPLES];
+static raw_sample_t                     m_raw[SAMPLES];
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static int run(const case_t *p_case);
+static void gen(const case_t *p_case);
+static int round_trip(void);
+static uint64_t now_ns(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    static const case_t CASE[] = {
+        { "steady", false },
+        { "random", true },
+    };
+    uint8_t lp;
+    int ng = 0;
+
+    printf("data    samples/KB  raw samples/KB  append[ns]  raw store[ns]\n");
+    for (lp = 0; lp < sizeof(CASE) / sizeof(CASE[0]); lp++) {
+        ng |= run(&CASE[lp]);
+    }
+
+    printf("bench_series: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 1ケース分
+ */
+static int run(const case_t *p_case)
+{
+    app_series_stats_t stats;
+    uint32_t samples = 0;
+    uint32_t blocks = 0;
+    uint64_t t0;
+    uint64_t series_ns;
+    uint64_t raw_ns;
+    uint32_t lp;
+    uint32_t loop;
+    double per_kb;
+
+    gen(p_case);
+
+    //往復
+    app_series_init();
+    for (lp = 0; lp < SAMPLES; lp++) {
+        app_series_append(m_src[lp].ts, m_src[lp].val);
+    }
+    if (round_trip() != 0) {
+        return 1;
+    }
+
+    //満杯のブロックだけで数える(最後のブロックは書きかけ)
+    app_series_stats_get(&stats);
+    while (stats.blocks > 1) {
+        samples += app_series_drop_oldest();
+        blocks++;
+        app_series_stats_get(&stats);
+    }
+    CHECK(blocks > 0, "no full block");
+    per_kb = (double)samples * 1024 / (blocks * APP_SERIES_BLOCK_SIZE);
+
+    //追加時間(リングがあふれて古いブロックを捨てる分も含む)
+    t0 = now_ns();
+    for (loop = 0; loop < BENCH_LOOP; loop++) {
+        app_series_init();
+        for (lp = 0; lp < SAMPLES; lp++) {
+            app_series_append(m_src[lp].ts, m_src[lp].val);
+        }
+    }
+    series_ns = now_ns() - t0;
+
+    t0 = now_ns();
+    for (loop = 0; loop < BENCH_LOOP; loop++) {
+        for (lp = 0; lp < SAMPLES; lp++) {
+            m_raw[lp].ts = m_src[lp].ts;
+            m_raw[lp].val = m_src[lp].val;
+        }
+        //最適化で消されないように
+        __asm__ volatile("" : : "r"(m_raw) : "memory");
+    }
+    raw_ns = now_ns() - t0;
+
+    printf("%-6s  %10.0f  %14.0f  %10.1f  %13.1f\n", p_case->p_name,
+            per_kb, 1024.0 / sizeof(raw_sample_t),
+            (double)series_ns / ((uint64_t)BENCH_LOOP * SAMPLES),
+            (double)raw_ns / ((uint64_t)BENCH_LOOP * SAMPLES));
+
+    //1byteのvarintに収まるデータなら、配列より詰められる
+    if (!p_case->random) {
+        CHECK(per_kb > 3 * (1024.0 / sizeof(raw_sample_t)), "%.0f samples/KB", per_kb);
+    }
+    CHECK(per_kb > 1024.0 / sizeof(raw_sample_t), "%.0f samples/KB", per_kb);
+    return 0;
+}
+
+
+/**
+ * @brief データを作る
+ */
+static void gen(const case_t *p_case)
+{
+    uint32_t ts = 1000;
+    uint32_t val = 2000;
+    uint32_t lp;
+
+    srand(1);
+    for (lp = 0; lp < SAMPLES; lp++) {
+        ts += 1000 + (rand() % 5) - 2;
+        if (p_case->random) {
+            val = (uint32_t)rand() & 0xffff;
+        }
+        else {
+            val += (rand() % 17) - 8;
+        }
+        m_src[lp].ts = ts;
+        m_src[lp].val = val;
+    }
+}
+
+
+/**
+ * @brief 読み出して、残っているはずの最新のサンプルと比べる
+ *
+ * 満杯で捨てた分(dropped)より後ろが全部残っていること。
+ */
+static int round_trip(void)
+{
+    app_series_stats_t stats;
+    app_series_iter_t it;
+    uint32_t ts;
+    uint32_t val;
+    uint32_t idx;
+
+    app_series_stats_get(&stats);
+    CHECK(stats.dropped + stats.samples == SAMPLES, "dropped %u + samples %u != %u",
+            stats.dropped, stats.samples, SAMPLES);
+
+    idx = stats.dropped;
+    app_series_iter_init(&it);
+    while (app_series_iter_next(&it, &ts, &val)) {
+        CHECK(idx < SAMPLES, "too many samples");
+        CHECK((ts == m_src[idx].ts) && (val == m_src[idx].val),
+                "[%u] ts=%u val=%u (expect %u %u)", idx, ts, val, m_src[idx].ts, m_src[idx].val);
+        idx++;
+    }
+    CHECK(idx == SAMPLES, "read %u samples (expect %u)", idx - stats.dropped, stats.samples);
+    return 0;
+}
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
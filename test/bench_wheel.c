@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    bench_wheel.c
+ *
+ * app_wheelの確認とベンチマーク
+ *
+ *  - 単発/繰り返しタイマが指定tickちょうどで満了すること(段1を越える遠いタイマを含む)
+ *  - tickの開始/停止の途中に割込みで停止/開始されても、tickの状態が食い違わないこと
+ *  - 動作中のタイマ数1～64で、開始/停止1回あたりの時間をapp_timer(SDK 8.1)のリスト操作と比べる
+ *
+ * app_timerの方は、満了までの差分で並べた片方向リストをたどって挿入/削除する部分だけを真似ている。
+ * 実際のapp_timerはこれに加えて操作キューとSWI割込みを通るので、差はここで出る値より大きい。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_wheel.h"
+#include "app_budget.h"
+#include "app_timer.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define TIMER_MAX                       (64)
+
+/** 計測する操作回数 */
+#define BENCH_OPS                       (200000)
+
+/** 満了までの最大tick(段1の範囲1024tickを越える) */
+#define TICKS_MAX                       (4096)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** app_timer(SDK 8.1)のリスト操作の模型 */
+typedef struct ref_node_t {
+    struct ref_node_t   *p_next;
+    uint32_t            ticks_to_expire;    /**< 前のノードとの差 */
+    bool                running;
+} ref_node_t;
+
+static ref_node_t                       *mp_ref_head;
+static ref_node_t                       m_ref[TIMER_MAX];
+
+static app_wheel_timer_t                m_wheel[TIMER_MAX];
+static uint32_t                         m_fired_at[TIMER_MAX];
+static uint32_t                         m_fired_cnt[TIMER_MAX];
+static uint32_t                         m_tick;
+
+/** app_wheelのtick(最初に作られるapp_timer) */
+static const app_timer_id_t             m_tick_id = 0;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void ref_start(ref_node_t *p_node, uint32_t ticks);
+static void ref_stop(ref_node_t *p_node);
+static void wheel_handler(void *p_context);
+static void wheel_tick(void);
+static int check_expire(void);
+static int check_preempt(void);
+static void isr_start(void);
+static void isr_stop(void);
+static void bench(uint16_t num);
+static uint64_t now_ns(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start)
+{
+    return 0;
+}
+
+
+int main(void)
+{
+    static const uint16_t NUM[] = { 1, 2, 4, 8, 16, 32, 64 };
+    uint8_t lp;
+
+    app_wheel_init();
+
+    if (check_expire() != 0) {
+        return 1;
+    }
+    if (check_preempt() != 0) {
+        return 1;
+    }
+
+    printf("timers  app_wheel[ns/op]  app_timer list[ns/op]\n");
+    for (lp = 0; lp < sizeof(NUM) / sizeof(NUM[0]); lp++) {
+        bench(NUM[lp]);
+    }
+    return 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief app_timer模型 : 開始
+ *
+ * 先頭から差分を引きながらたどり、入る位置で後ろのノードの差分を減らす。
+ */
+static void ref_start(ref_node_t *p_node, uint32_t ticks)
+{
+    ref_node_t **pp = &mp_ref_head;
+
+    while ((*pp != NULL) && ((*pp)->ticks_to_expire <= ticks)) {
+        ticks -= (*pp)->ticks_to_expire;
+        pp = &(*pp)->p_next;
+    }
+    p_node->ticks_to_expire = ticks;
+    p_node->p_next = *pp;
+    if (*pp != NULL) {
+        (*pp)->ticks_to_expire -= ticks;
+    }
+    *pp = p_node;
+    p_node->running = true;
+}
+
+
+/**
+ * @brief app_timer模型 : 停止
+ *
+ * 片方向リストなので先頭から探す。
+ */
+static void ref_stop(ref_node_t *p_node)
+{
+    ref_node_t **pp = &mp_ref_head;
+
+    if (!p_node->running) {
+        return;
+    }
+    while (*pp != p_node) {
+        pp = &(*pp)->p_next;
+    }
+    *pp = p_node->p_next;
+    if (p_node->p_next != NULL) {
+        p_node->p_next->ticks_to_expire += p_node->ticks_to_expire;
+    }
+    p_node->running = false;
+}
+
+
+static void wheel_handler(void *p_context)
+{
+    uint32_t idx = (uint32_t)(uintptr_t)p_context;
+
+    m_fired_at[idx] = m_tick;
+    m_fired_cnt[idx]++;
+}
+
+
+static void wheel_tick(void)
+{
+    m_tick++;
+    sim_timer_expire(m_tick_id);
+}
+
+
+/**
+ * @brief 満了時刻の確認
+ *
+ * @retval  0   OK
+ */
+static int check_expire(void)
+{
+    uint32_t ticks[TIMER_MAX];
+    uint32_t start;
+    uint32_t lp;
+    int ng = 0;
+
+    srand(1);
+
+    //単発 : 開始からちょうどticks後に1回だけ
+    start = m_tick;
+    for (lp = 0; lp < TIMER_MAX; lp++) {
+        ticks[lp] = 1 + rand() % TICKS_MAX;
+        m_fired_cnt[lp] = 0;
+        app_wheel_start(&m_wheel[lp], ticks[lp], APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, (void *)(uintptr_t)lp);
+    }
+    while (m_tick - start <= TICKS_MAX + 1) {
+        wheel_tick();
+    }
+    for (lp = 0; lp < TIMER_MAX; lp++) {
+        if ((m_fired_cnt[lp] != 1) || (m_fired_at[lp] - start != ticks[lp])) {
+            printf("NG single[%u]: ticks=%u fired=%u at=%u\n", lp, ticks[lp], m_fired_cnt[lp], m_fired_at[lp] - start);
+            ng = 1;
+        }
+    }
+    if (sim_timer_is_running(m_tick_id)) {
+        printf("NG tick still running\n");
+        ng = 1;
+    }
+
+    //繰り返し : 3周期後もずれない
+    start = m_tick;
+    for (lp = 0; lp < TIMER_MAX; lp++) {
+        ticks[lp] = 1 + rand() % (TICKS_MAX / 4);
+        m_fired_cnt[lp] = 0;
+        app_wheel_start(&m_wheel[lp], ticks[lp], APP_WHEEL_MODE_REPEATED, wheel_handler, (void *)(uintptr_t)lp);
+    }
+    while (m_tick - start < TICKS_MAX) {
+        wheel_tick();
+        for (lp = 0; lp < TIMER_MAX; lp++) {
+            if ((m_fired_cnt[lp] == 3) && app_wheel_is_running(&m_wheel[lp])) {
+                if (m_fired_at[lp] - start != 3 * ticks[lp]) {
+                    printf("NG repeated[%u]: period=%u 3rd at=%u\n", lp, ticks[lp], m_fired_at[lp] - start);
+                    ng = 1;
+                }
+                app_wheel_stop(&m_wheel[lp]);
+            }
+        }
+    }
+    for (lp = 0; lp < TIMER_MAX; lp++) {
+        if (app_wheel_is_running(&m_wheel[lp])) {
+            printf("NG repeated[%u]: fired=%u\n", lp, m_fired_cnt[lp]);
+            ng = 1;
+            app_wheel_stop(&m_wheel[lp]);
+        }
+    }
+
+    printf("expire check: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**
+ * @brief tickの開始/停止と割込みが入れ違う場合の確認
+ *
+ * sim_timer_preempt()で、app_timer_start()/stop()が効く直前に割込みを入れる。
+ *  - 最後のタイマを止めてtickを止める途中で、割込みが別のタイマを開始する
+ *  - 最初のタイマを開始してtickを動かす途中で、割込みがそのタイマを止める
+ * どちらも、終わったときにtickが動いているのは動作中のタイマがあるときだけで、
+ * 割込みで開始したタイマは満了すること。
+ *
+ * @retval  0   OK
+ */
+static int check_preempt(void)
+{
+    uint32_t lp;
+    int ng = 0;
+
+    //停止中に開始
+    m_fired_cnt[1] = 0;
+    app_wheel_start(&m_wheel[0], 100, APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, (void *)(uintptr_t)0);
+    sim_timer_preempt(isr_start);
+    app_wheel_stop(&m_wheel[0]);
+    if (!app_wheel_is_running(&m_wheel[1]) || !sim_timer_is_running(m_tick_id)) {
+        printf("NG preempt stop: wheel=%d tick=%d\n",
+                app_wheel_is_running(&m_wheel[1]), sim_timer_is_running(m_tick_id));
+        ng = 1;
+    }
+    for (lp = 0; lp < 10; lp++) {
+        wheel_tick();
+    }
+    if (m_fired_cnt[1] != 1) {
+        printf("NG preempt stop: fired=%u\n", m_fired_cnt[1]);
+        ng = 1;
+    }
+
+    //開始中に停止
+    sim_timer_preempt(isr_stop);
+    app_wheel_start(&m_wheel[0], 5, APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, (void *)(uintptr_t)0);
+    if (app_wheel_is_running(&m_wheel[0]) || sim_timer_is_running(m_tick_id)) {
+        printf("NG preempt start: wheel=%d tick=%d\n",
+                app_wheel_is_running(&m_wheel[0]), sim_timer_is_running(m_tick_id));
+        ng = 1;
+    }
+
+    //その後も普通に動く
+    m_fired_cnt[0] = 0;
+    app_wheel_start(&m_wheel[0], 5, APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, (void *)(uintptr_t)0);
+    for (lp = 0; lp < 10; lp++) {
+        wheel_tick();
+    }
+    if ((m_fired_cnt[0] != 1) || sim_timer_is_running(m_tick_id)) {
+        printf("NG preempt after: fired=%u tick=%d\n", m_fired_cnt[0], sim_timer_is_running(m_tick_id));
+        ng = 1;
+    }
+
+    printf("preempt check: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+static void isr_start(void)
+{
+    app_wheel_start(&m_wheel[1], 5, APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, (void *)(uintptr_t)1);
+}
+
+
+static void isr_stop(void)
+{
+    app_wheel_stop(&m_wheel[0]);
+}
+
+
+/**
+ * @brief 開始/停止のベンチマーク
+ *
+ * num個を動かしておき、ランダムに選んだ1個を止めて別の時間で開始し直す。
+ *
+ * @param[in]   num     動作中のタイマ数
+ */
+static void bench(uint16_t num)
+{
+    static uint16_t idx[BENCH_OPS];
+    static uint16_t ticks[BENCH_OPS];
+    uint64_t t0;
+    uint64_t wheel_ns;
+    uint64_t ref_ns;
+    uint32_t lp;
+
+    srand(num);
+    for (lp = 0; lp < BENCH_OPS; lp++) {
+        idx[lp] = rand() % num;
+        ticks[lp] = 1 + rand() % TICKS_MAX;
+    }
+
+    for (lp = 0; lp < num; lp++) {
+        app_wheel_start(&m_wheel[lp], 1 + rand() % TICKS_MAX, APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, (void *)(uintptr_t)lp);
+    }
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_OPS; lp++) {
+        app_wheel_stop(&m_wheel[idx[lp]]);
+        app_wheel_start(&m_wheel[idx[lp]], ticks[lp], APP_WHEEL_MODE_SINGLE_SHOT, wheel_handler, NULL);
+    }
+    wheel_ns = now_ns() - t0;
+    for (lp = 0; lp < num; lp++) {
+        app_wheel_stop(&m_wheel[lp]);
+    }
+
+    mp_ref_head = NULL;
+    memset(m_ref, 0, sizeof(m_ref));
+    for (lp = 0; lp < num; lp++) {
+        ref_start(&m_ref[lp], 1 + rand() % TICKS_MAX);
+    }
+    t0 = now_ns();
+    for (lp = 0; lp < BENCH_OPS; lp++) {
+        ref_stop(&m_ref[idx[lp]]);
+        ref_start(&m_ref[idx[lp]], ticks[lp]);
+    }
+    ref_ns = now_ns() - t0;
+
+    //1op = 停止 + 開始
+    printf("%6u  %17.1f  %21.1f\n", num,
+            (double)wheel_ns / (2 * BENCH_OPS), (double)ref_ns / (2 * BENCH_OPS));
+}
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,667 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    replay.c
+ *
+ * app_evtrec(BLEイベント記録)をLinuxで流し直す
+ *
+ *   replay [-o offset] [-c] <trace>
+ *      traceの記録からBLEイベントを組み立て直し、app_ble_evt_dispatch()に順に渡して、
+ *      記録時と流し直し時の処理時間をタイムラインで並べる。
+ *      traceはtools/evtrec.pyと同じ入力(EvtRecのNotifyの16進ダンプ、またはログの"evtrec:"行)。
+ *        -o : 書込みハンドルから引く値(sim_bleのハンドルは1から振るので、実機の先頭サービス分)
+ *        -c : 流し直した結果のapp_evtrecをBLE/UARTの両方から読み、traceと
+ *             イベント・Connection Handle・値・データが一致するか確かめる
+ *   replay -g
+ *      sim_bleのリンクで接続～書込み～切断～再接続のセッションを走らせ、EvtRecのNotifyを
+ *      gatttoolと同じ形式で出力する(trace/session.txtはこれで取った)。
+ *
+ * SoftDeviceはsim_ble.c、アプリ側はsim_app.c、app_ble.cとservices/は本物を使う。
+ * 時刻はapp_ts.c(Linuxではclock_gettime())なので、流し直した処理時間はホストでの値になる。
+ * 書込みデータは記録に残っている先頭APP_EVTREC_DATA_MAX byteだけ戻し、残りは0で埋める。
+ * イベントの間隔は再現せず、続けて渡す。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_ble.h"
+#include "app_evtrec.h"
+#include "app_log.h"
+#include "app_cfg.h"
+#include "app_ts.h"
+#include "app_uart.h"
+#include "ble_ios.h"
+#include "ble_diag.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** traceから読む記録数の上限 */
+#define TRACE_MAX                       (1024)
+
+/** 組み立てる書込みデータの上限(BLE_GATTS_VAR_ATTR_LEN_MAX) */
+#define WRITE_LEN_MAX                   (512)
+
+/** UARTで受け取るログの上限 */
+#define UART_BUF_SIZE                   (8192)
+
+/** app_log.cのレコード(先頭/末尾と、引数以外の長さ) */
+#define LOG_HEAD                        (0xA5)
+#define LOG_OVERHEAD                    (12)
+
+/* -gのリンク */
+#define TX_BUFFERS                      (7)
+#define PKTS_PER_EVENT                  (6)
+#define INTERVAL_US                     (7500)
+#define CONN_HANDLE                     (0x0000)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 組み立てたイベント(書込みデータ分の領域を後ろに足す) */
+typedef union {
+    ble_evt_t   evt;
+    uint8_t     buf[sizeof(ble_evt_t) + WRITE_LEN_MAX];
+} evt_buf_t;
+
+static app_ble_t                        m_ble;
+static app_evtrec_t                     m_trace[TRACE_MAX];
+static uint32_t                         m_replay_cost[TRACE_MAX];
+
+static uint16_t                         m_evtrec_handle;
+
+static uint8_t                          m_uart[UART_BUF_SIZE];
+static uint32_t                         m_uart_len;
+static bool                             m_uart_cmd;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint32_t trace_read(const char *p_path);
+static bool line_parse(const char *p_line, app_evtrec_t *p_rec);
+static void evt_build(const app_evtrec_t *p_rec, uint16_t offset, evt_buf_t *p_buf);
+static void timeline_print(uint32_t num);
+static const char *evt_name(uint8_t evt_id);
+static int check(uint32_t num, uint16_t offset);
+static uint32_t check_read_ble(app_evtrec_t *p_rec, uint32_t max);
+static uint32_t check_read_uart(app_evtrec_t *p_rec, uint32_t max);
+static bool rec_same(const app_evtrec_t *p_expect, const app_evtrec_t *p_rec, uint16_t offset);
+
+static int session_run(void);
+static void session_rx(uint16_t handle, const uint8_t *p_data, uint16_t length);
+static void session_gap(uint16_t evt_id, uint16_t arg, const ble_gap_conn_params_t *p_params);
+static void session_write(uint16_t handle, const uint8_t *p_data, uint16_t length);
+static void session_interval(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(int argc, char *argv[])
+{
+    const char *p_path = NULL;
+    uint16_t offset = 0;
+    bool do_check = false;
+    evt_buf_t buf;
+    uint32_t num;
+    uint32_t lp;
+    uint32_t start;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-g") == 0) {
+            return session_run();
+        }
+        else if (strcmp(argv[arg], "-c") == 0) {
+            do_check = true;
+        }
+        else if ((strcmp(argv[arg], "-o") == 0) && (arg + 1 < argc)) {
+            offset = (uint16_t)strtoul(argv[++arg], NULL, 0);
+        }
+        else {
+            p_path = argv[arg];
+        }
+    }
+    if (p_path == NULL) {
+        fprintf(stderr, "usage: %s [-o offset] [-c] <trace>\n", argv[0]);
+        fprintf(stderr, "       %s -g\n", argv[0]);
+        return 1;
+    }
+
+    num = trace_read(p_path);
+    if (num == 0) {
+        fprintf(stderr, "%s: no record\n", p_path);
+        return 1;
+    }
+
+    app_ble_init(&m_ble);
+    app_ble_init_late(&m_ble);
+    app_ble_start(&m_ble);
+
+    for (lp = 0; lp < num; lp++) {
+        evt_build(&m_trace[lp], offset, &buf);
+        start = app_ts_now();
+        app_ble_evt_dispatch(&m_ble, &buf.evt);
+        m_replay_cost[lp] = app_ts_now() - start;
+    }
+    timeline_print(num);
+
+    return (do_check) ? check(num, offset) : 0;
+}
+
+
+/* UART : -cでapp_evtrec_uart_poll()を確かめるときのホスト側 */
+
+uint32_t app_uart_put(uint8_t byte)
+{
+    if (m_uart_len >= sizeof(m_uart)) {
+        return NRF_ERROR_NO_MEM;
+    }
+    m_uart[m_uart_len++] = byte;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_uart_get(uint8_t *p_byte)
+{
+    if (!m_uart_cmd) {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    m_uart_cmd = false;
+    *p_byte = APP_EVTREC_UART_CMD;
+    return NRF_SUCCESS;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief traceの読込み
+ *
+ * @return  読み込んだ記録数
+ */
+static uint32_t trace_read(const char *p_path)
+{
+    FILE *fp;
+    char line[256];
+    uint32_t num = 0;
+
+    fp = fopen(p_path, "r");
+    if (fp == NULL) {
+        perror(p_path);
+        return 0;
+    }
+    while ((num < TRACE_MAX) && (fgets(line, sizeof(line), fp) != NULL)) {
+        if (line_parse(line, &m_trace[num])) {
+            num++;
+        }
+    }
+    fclose(fp);
+    return num;
+}
+
+
+/**
+ * @brief 1行から記録を取り出す(tools/evtrec.pyのrecords()と同じ)
+ *
+ * @retval  true    1記録あった
+ */
+static bool line_parse(const char *p_line, app_evtrec_t *p_rec)
+{
+    const char *p;
+    uint32_t word[sizeof(app_evtrec_t) / sizeof(uint32_t)];
+    uint8_t data[sizeof(app_evtrec_t) + 1];
+    unsigned int val;
+    int used;
+    uint16_t len = 0;
+
+    p = strstr(p_line, "evtrec:");
+    if (p != NULL) {
+        if (sscanf(p + 7, "%x %x %x %x %x", &word[0], &word[1], &word[2], &word[3], &word[4]) != 5) {
+            return false;
+        }
+        memcpy(p_rec, word, sizeof(app_evtrec_t));
+        return true;
+    }
+
+    p = strstr(p_line, "value:");
+    p = (p != NULL) ? p + 6 : p_line;
+    while (sscanf(p, " %2x%n", &val, &used) == 1) {
+        if (len >= sizeof(data)) {
+            return false;
+        }
+        data[len++] = (uint8_t)val;
+        p += used;
+    }
+    //16進以外が残っていたら記録の行ではない
+    while ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')) {
+        p++;
+    }
+    if ((*p != '\0') || (len != sizeof(app_evtrec_t))) {
+        return false;
+    }
+    memcpy(p_rec, data, sizeof(app_evtrec_t));
+    return true;
+}
+
+
+/**
+ * @brief 記録からBLEイベントを組み立てる(app_evtrec_put()の逆)
+ */
+static void evt_build(const app_evtrec_t *p_rec, uint16_t offset, evt_buf_t *p_buf)
+{
+    ble_evt_t *p_evt = &p_buf->evt;
+    ble_gap_conn_params_t params;
+    uint16_t len;
+
+    memset(p_buf, 0, sizeof(evt_buf_t));
+    p_evt->header.evt_id = p_rec->evt_id;
+
+    params.min_conn_interval = (uint16_t)(p_rec->data[0] | (p_rec->data[1] << 8));
+    params.max_conn_interval = p_rec->arg0;
+    params.slave_latency = p_rec->arg1;
+    params.conn_sup_timeout = (uint16_t)(p_rec->data[2] | (p_rec->data[3] << 8));
+
+    switch (p_rec->evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        p_evt->evt.gap_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.gap_evt.params.connected.conn_params = params;
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        p_evt->evt.gap_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.gap_evt.params.disconnected.reason = (uint8_t)p_rec->arg0;
+        break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        p_evt->evt.gap_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.gap_evt.params.conn_param_update.conn_params = params;
+        break;
+
+    case BLE_GAP_EVT_TIMEOUT:
+        p_evt->evt.gap_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.gap_evt.params.timeout.src = (uint8_t)p_rec->arg0;
+        break;
+
+    case BLE_GAP_EVT_RSSI_CHANGED:
+        p_evt->evt.gap_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.gap_evt.params.rssi_changed.rssi = (int8_t)p_rec->arg0;
+        break;
+
+    case BLE_GATTS_EVT_WRITE:
+        len = (p_rec->arg1 < WRITE_LEN_MAX) ? p_rec->arg1 : WRITE_LEN_MAX;
+        p_evt->evt.gatts_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.gatts_evt.params.write.handle = (uint16_t)(p_rec->arg0 - offset);
+        p_evt->evt.gatts_evt.params.write.len = len;
+        memcpy(p_evt->evt.gatts_evt.params.write.data, p_rec->data,
+                (len < APP_EVTREC_DATA_MAX) ? len : APP_EVTREC_DATA_MAX);
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        p_evt->evt.common_evt.conn_handle = p_rec->conn_handle;
+        p_evt->evt.common_evt.params.tx_complete.count = (uint8_t)p_rec->arg0;
+        break;
+
+    default:
+        p_evt->evt.gap_evt.conn_handle = p_rec->conn_handle;
+        break;
+    }
+}
+
+
+/**
+ * @brief タイムライン(記録時の時刻・間隔・処理時間と、流し直した処理時間)
+ */
+static void timeline_print(uint32_t num)
+{
+    uint32_t lp;
+    uint32_t delta;
+    uint64_t rec_total = 0;
+    uint64_t replay_total = 0;
+
+    printf("      time[s]     +delta[ms]  event                          conn    cost[us]  replay[us]\n");
+    for (lp = 0; lp < num; lp++) {
+        delta = (lp == 0) ? 0 : m_trace[lp].time - m_trace[lp - 1].time;
+        printf("[%10.6f] %+10.3f  %-30s 0x%04x  %s%6u  %10u\n",
+                m_trace[lp].time / 1e6, delta / 1000.0, evt_name(m_trace[lp].evt_id),
+                m_trace[lp].conn_handle, (m_trace[lp].cost == 0xffff) ? ">=" : "  ",
+                m_trace[lp].cost, m_replay_cost[lp]);
+        rec_total += m_trace[lp].cost;
+        replay_total += m_replay_cost[lp];
+    }
+    printf("%u events, cost %llu us (recorded) / %llu us (replay)\n",
+            num, (unsigned long long)rec_total, (unsigned long long)replay_total);
+}
+
+
+static const char *evt_name(uint8_t evt_id)
+{
+    static char unknown[8];
+
+    switch (evt_id) {
+    case BLE_EVT_TX_COMPLETE:               return "TX_COMPLETE";
+    case BLE_GAP_EVT_CONNECTED:             return "GAP_CONNECTED";
+    case BLE_GAP_EVT_DISCONNECTED:          return "GAP_DISCONNECTED";
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:     return "GAP_CONN_PARAM_UPDATE";
+    case BLE_GAP_EVT_SEC_PARAMS_REQUEST:    return "GAP_SEC_PARAMS_REQUEST";
+    case BLE_GAP_EVT_SEC_INFO_REQUEST:      return "GAP_SEC_INFO_REQUEST";
+    case BLE_GAP_EVT_AUTH_STATUS:           return "GAP_AUTH_STATUS";
+    case BLE_GAP_EVT_CONN_SEC_UPDATE:       return "GAP_CONN_SEC_UPDATE";
+    case BLE_GAP_EVT_TIMEOUT:               return "GAP_TIMEOUT";
+    case BLE_GAP_EVT_RSSI_CHANGED:          return "GAP_RSSI_CHANGED";
+    case BLE_GATTS_EVT_WRITE:               return "GATTS_WRITE";
+    case BLE_GATTS_EVT_SYS_ATTR_MISSING:    return "GATTS_SYS_ATTR_MISSING";
+    case BLE_GATTS_EVT_HVC:                 return "GATTS_HVC";
+    case BLE_GATTS_EVT_TIMEOUT:             return "GATTS_TIMEOUT";
+    default:
+        snprintf(unknown, sizeof(unknown), "0x%02x", evt_id);
+        return unknown;
+    }
+}
+
+
+/**
+ * @brief 流し直した結果の確認
+ *
+ * 流し直しでもapp_evtrec_put()が記録しているので、それをBLE/UARTの両方の読出し側で読み、
+ * traceの末尾(リングに残る分)と比べる。
+ */
+static int check(uint32_t num, uint16_t offset)
+{
+    static app_evtrec_t ble_rec[APP_EVTREC_NUM + 1];
+    static app_evtrec_t uart_rec[APP_EVTREC_NUM + 1];
+    uint32_t expect = (num < APP_EVTREC_NUM) ? num : APP_EVTREC_NUM;
+    uint32_t ble_num;
+    uint32_t uart_num;
+    uint32_t lp;
+
+    ble_num = check_read_ble(ble_rec, APP_EVTREC_NUM + 1);
+    uart_num = check_read_uart(uart_rec, APP_EVTREC_NUM + 1);
+    if ((ble_num != expect) || (uart_num != expect)) {
+        printf("NG records: ble=%u uart=%u expect=%u\n", ble_num, uart_num, expect);
+        printf("replay: NG\n");
+        return 1;
+    }
+    for (lp = 0; lp < expect; lp++) {
+        if (!rec_same(&m_trace[num - expect + lp], &ble_rec[lp], offset) ||
+            !rec_same(&m_trace[num - expect + lp], &uart_rec[lp], offset)) {
+            printf("NG record %u: %s\n", num - expect + lp, evt_name(m_trace[num - expect + lp].evt_id));
+            printf("replay: NG\n");
+            return 1;
+        }
+    }
+    if (app_log_dropped() != 0) {
+        printf("NG log dropped %u\n", app_log_dropped());
+        printf("replay: NG\n");
+        return 1;
+    }
+    printf("replay: OK (%u records)\n", expect);
+    return 0;
+}
+
+
+/**
+ * @brief BLEの読出し側で読む(app_ble.cのevtrec_stream()と同じ手順)
+ */
+static uint32_t check_read_ble(app_evtrec_t *p_rec, uint32_t max)
+{
+    uint32_t num = 0;
+
+    app_evtrec_freeze(&m_ble.evtrec, APP_EVTREC_READER_BLE, true);
+    while ((num < max) && app_evtrec_peek(&m_ble.evtrec, APP_EVTREC_READER_BLE, &p_rec[num])) {
+        app_evtrec_consume(&m_ble.evtrec, APP_EVTREC_READER_BLE);
+        num++;
+    }
+    app_evtrec_freeze(&m_ble.evtrec, APP_EVTREC_READER_BLE, false);
+    return num;
+}
+
+
+/**
+ * @brief UARTの読出し側で読む
+ *
+ * メインループと同じくapp_log_flush()とapp_evtrec_uart_poll()を回し、
+ * UARTに出たログから引数が5つのレコード(evtrec: ...)を取り出す。
+ */
+static uint32_t check_read_uart(app_evtrec_t *p_rec, uint32_t max)
+{
+    uint32_t num = 0;
+    uint32_t pos;
+    uint32_t loop;
+    uint8_t size;
+
+    //dispatch中のログを先に出しておく
+    app_log_flush();
+    m_uart_len = 0;
+
+    m_uart_cmd = true;
+    for (loop = 0; loop < APP_EVTREC_NUM * 4; loop++) {
+        app_log_flush();
+        app_evtrec_uart_poll(&m_ble.evtrec);
+    }
+    app_log_flush();
+
+    //[0xA5][len][id(2)][ts(3)][seq][args][sum(2)][len][0x5A]
+    pos = 0;
+    while (pos + LOG_OVERHEAD <= m_uart_len) {
+        size = m_uart[pos + 1];
+        if ((m_uart[pos] != LOG_HEAD) || (pos + size > m_uart_len)) {
+            pos++;
+            continue;
+        }
+        if ((size == LOG_OVERHEAD + sizeof(app_evtrec_t)) && (num < max)) {
+            memcpy(&p_rec[num++], &m_uart[pos + 8], sizeof(app_evtrec_t));
+        }
+        pos += size;
+    }
+    return num;
+}
+
+
+static bool rec_same(const app_evtrec_t *p_expect, const app_evtrec_t *p_rec, uint16_t offset)
+{
+    uint16_t arg0 = p_expect->arg0;
+
+    if (p_expect->evt_id == BLE_GATTS_EVT_WRITE) {
+        arg0 = (uint16_t)(arg0 - offset);
+    }
+    return (p_rec->evt_id == p_expect->evt_id) &&
+            (p_rec->conn_handle == p_expect->conn_handle) &&
+            (p_rec->arg0 == arg0) &&
+            (p_rec->arg1 == p_expect->arg1) &&
+            (memcmp(p_rec->data, p_expect->data, APP_EVTREC_DATA_MAX) == 0);
+}
+
+
+/**
+ * @brief -g : sim_bleのリンクでセッションを走らせ、EvtRecのNotifyを出力する
+ */
+static int session_run(void)
+{
+    static const uint8_t CCCD_ON[] = { 0x01, 0x00 };
+    static const uint8_t INPUT[] = { 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80 };
+    static const uint8_t CONFIG[] = { APP_CFG_KEY_CONN_MAX_INTERVAL, 50, 0 };
+    static const uint8_t OUTPUT[] = { 0x01, 0x02, 0x03, 0x04 };
+    ble_gap_conn_params_t params = { 16, 24, 0, 400 };
+    ble_gatts_char_handles_t input;
+    ble_gatts_char_handles_t output;
+    ble_gatts_char_handles_t config;
+    ble_gatts_char_handles_t evtrec;
+    uint8_t count;
+    uint8_t lp;
+
+    app_ble_init(&m_ble);
+    app_ble_init_late(&m_ble);
+    app_ble_start(&m_ble);
+    if (!sim_ble_char_find(IOS_UUID_CHAR_INPUT, &input) ||
+        !sim_ble_char_find(IOS_UUID_CHAR_OUTPUT, &output) ||
+        !sim_ble_char_find(IOS_UUID_CHAR_CONFIG, &config) ||
+        !sim_ble_char_find(DIAG_UUID_CHAR_EVTREC, &evtrec)) {
+        fprintf(stderr, "NG handle\n");
+        return 1;
+    }
+    m_evtrec_handle = evtrec.value_handle;
+    sim_ble_link_set(TX_BUFFERS, PKTS_PER_EVENT, session_rx);
+
+    session_gap(BLE_GAP_EVT_CONNECTED, 0, &params);
+    session_write(output.cccd_handle, CCCD_ON, sizeof(CCCD_ON));
+    session_write(input.value_handle, INPUT, sizeof(INPUT));
+    session_gap(BLE_GAP_EVT_RSSI_CHANGED, (uint16_t)-58, NULL);
+
+    //PPCPの最大間隔を変えて、Centralが受け入れる
+    session_write(config.value_handle, CONFIG, sizeof(CONFIG));
+    params.max_conn_interval = 40;
+    session_gap(BLE_GAP_EVT_CONN_PARAM_UPDATE, 0, &params);
+
+    for (lp = 0; lp < 3; lp++) {
+        app_ble_nofify(&m_ble, OUTPUT, sizeof(OUTPUT));
+    }
+    count = sim_ble_conn_event();
+    if (count != 0) {
+        session_gap(BLE_EVT_TX_COMPLETE, count, NULL);
+    }
+    session_gap(BLE_GAP_EVT_DISCONNECTED, 0x13, NULL);
+
+    //再接続してEvtRecを読み出す(ここからの記録は凍結で残らない)
+    session_gap(BLE_GAP_EVT_CONNECTED, 0, &params);
+    session_write(evtrec.cccd_handle, CCCD_ON, sizeof(CCCD_ON));
+    for (lp = 0; lp < APP_EVTREC_NUM; lp++) {
+        app_ble_idle(&m_ble);
+        count = sim_ble_conn_event();
+        if (count == 0) {
+            break;
+        }
+        session_gap(BLE_EVT_TX_COMPLETE, count, NULL);
+    }
+    return 0;
+}
+
+
+/**
+ * @brief -g : Centralの受信(EvtRecだけgatttoolの形式で出力)
+ */
+static void session_rx(uint16_t handle, const uint8_t *p_data, uint16_t length)
+{
+    uint16_t lp;
+
+    if (handle != m_evtrec_handle) {
+        return;
+    }
+    printf("Notification handle = 0x%04x value:", handle);
+    for (lp = 0; lp < length; lp++) {
+        printf(" %02x", p_data[lp]);
+    }
+    printf("\n");
+}
+
+
+/**
+ * @brief -g : GAPなどのイベント
+ *
+ * @param[in]   evt_id      イベント
+ * @param[in]   arg         DISCONNECTED:reason, RSSI_CHANGED:rssi, TX_COMPLETE:count
+ * @param[in]   p_params    CONNECTED/CONN_PARAM_UPDATE:接続パラメータ
+ */
+static void session_gap(uint16_t evt_id, uint16_t arg, const ble_gap_conn_params_t *p_params)
+{
+    evt_buf_t buf;
+
+    session_interval();
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id = evt_id;
+    buf.evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+    switch (evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        buf.evt.evt.gap_evt.params.connected.conn_params = *p_params;
+        break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        buf.evt.evt.gap_evt.params.conn_param_update.conn_params = *p_params;
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        buf.evt.evt.gap_evt.params.disconnected.reason = (uint8_t)arg;
+        break;
+
+    case BLE_GAP_EVT_RSSI_CHANGED:
+        buf.evt.evt.gap_evt.params.rssi_changed.rssi = (int8_t)arg;
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        buf.evt.evt.common_evt.conn_handle = CONN_HANDLE;
+        buf.evt.evt.common_evt.params.tx_complete.count = (uint8_t)arg;
+        break;
+
+    default:
+        break;
+    }
+    app_ble_evt_dispatch(&m_ble, &buf.evt);
+}
+
+
+/**
+ * @brief -g : Centralからの書込み
+ */
+static void session_write(uint16_t handle, const uint8_t *p_data, uint16_t length)
+{
+    evt_buf_t buf;
+
+    session_interval();
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id = BLE_GATTS_EVT_WRITE;
+    buf.evt.evt.gatts_evt.conn_handle = CONN_HANDLE;
+    buf.evt.evt.gatts_evt.params.write.handle = handle;
+    buf.evt.evt.gatts_evt.params.write.len = length;
+    memcpy(buf.evt.evt.gatts_evt.params.write.data, p_data, length);
+    app_ble_evt_dispatch(&m_ble, &buf.evt);
+}
+
+
+/**
+ * @brief -g : イベントの間を1 Connection Interval空ける
+ */
+static void session_interval(void)
+{
+    struct timespec ts = { 0, INTERVAL_US * 1000 };
+
+    app_ble_idle(&m_ble);
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    sim_app.c
+ *
+ * ホストテスト用 : app_bleが使うアプリ側モジュールの代わり
+ *
+ * app_ble.cをservices/、app_log/app_evtdisp/app_pool/app_link/app_evtrecの本物と一緒にリンクし、
+ * 残り(Flash、RAM監視、起動時間、System OFF、一括転送、サンプル詰めなど)はここで何もしない。
+ * app_sched_event_put()はその場でハンドラを呼ぶ。
+ *
+ * SIM_APP_REAL_HELPERSを定義したとき(bench_fleet_real)は、接続ごとの状態をapp_ble_tに持つ
+ * app_latency/app_bulk/app_pack(とapp_wheel)を本物にするので、ここからは外す。
+ * Flash・RAM・保持RAM・WDT・Radio通知などチップに1つしかないものは、どの構成でもここで何もしない。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stddef.h>
+#include <string.h>
+
+#include "app_scheduler.h"
+#include "drivers.h"
+#include "app_cfg.h"
+#include "app_latency.h"
+#include "app_prepare.h"
+#include "app_mem.h"
+#include "app_crash.h"
+#include "app_boot.h"
+#include "app_suspend.h"
+#include "app_cpu.h"
+#include "app_budget.h"
+#include "app_bulk.h"
+#include "app_pack.h"
+#include "sim_app.h"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/* gcc_startup_nrf51.s, gcc_nrf51_common.ld */
+uint32_t                                __isr_vector;
+uint32_t                                __etext;
+uint32_t                                __data_start__;
+uint32_t                                __data_end__;
+
+/* 仮想デバイスを複数スレッドで動かすとき(bench_fleet.c)は、スレッドごと */
+static __thread bool                    m_mem_poll;
+static __thread bool                    m_cpu_poll;
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void sim_app_report_request(bool mem, bool cpu)
+{
+    m_mem_poll = mem;
+    m_cpu_poll = cpu;
+}
+
+
+uint32_t app_sched_event_put(void *p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    handler(p_event_data, event_size);
+    return NRF_SUCCESS;
+}
+
+
+void led_on(int pin)
+{
+}
+
+
+void led_off(int pin)
+{
+}
+
+
+/**********************************************
+ * app_cfg
+ **********************************************/
+
+const uint8_t *app_cfg_get(app_cfg_key_t key, uint16_t *p_len)
+{
+    return NULL;
+}
+
+
+uint8_t app_cfg_get_u8(app_cfg_key_t key, uint8_t def)
+{
+    return def;
+}
+
+
+uint16_t app_cfg_get_u16(app_cfg_key_t key, uint16_t def)
+{
+    return def;
+}
+
+
+uint32_t app_cfg_set(app_cfg_key_t key, const uint8_t *p_value, uint16_t len)
+{
+    return NRF_SUCCESS;
+}
+
+
+/**********************************************
+ * app_latency
+ **********************************************/
+
+#ifndef SIM_APP_REAL_HELPERS
+void app_latency_init(app_latency_t *p_latency)
+{
+}
+
+
+void app_latency_on_ble_evt(app_latency_t *p_latency, ble_evt_t *p_ble_evt)
+{
+}
+
+
+void app_latency_wake(app_latency_t *p_latency)
+{
+}
+#endif  //SIM_APP_REAL_HELPERS
+
+
+/**********************************************
+ * app_prepare
+ **********************************************/
+
+uint32_t app_prepare_start(nrf_radio_notification_distance_t distance, app_prepare_handler_t handler)
+{
+    return NRF_SUCCESS;
+}
+
+
+void app_prepare_on_ble_evt(ble_evt_t *p_ble_evt)
+{
+}
+
+
+void app_prepare_sample_mark(void)
+{
+}
+
+
+uint32_t app_prepare_event_count(void)
+{
+    return 0;
+}
+
+
+/**********************************************
+ * app_mem, app_crash, app_boot, app_suspend, app_cpu, app_budget
+ **********************************************/
+
+bool app_mem_poll(void)
+{
+    bool ret = m_mem_poll;
+
+    m_mem_poll = false;
+    return ret;
+}
+
+
+void app_mem_report_get(app_mem_report_t *p_report)
+{
+    memset(p_report, 0, sizeof(app_mem_report_t));
+}
+
+
+const app_crash_record_t *app_crash_get(void)
+{
+    return NULL;
+}
+
+
+void app_boot_mark(app_boot_stage_t stage)
+{
+}
+
+
+void app_boot_report_get(app_boot_report_t *p_report)
+{
+    memset(p_report, 0, sizeof(app_boot_report_t));
+}
+
+
+bool app_suspend_attach(app_suspend_id_t id, void *p_data, uint16_t size, app_suspend_can_save_t can_save)
+{
+    return true;
+}
+
+
+void app_suspend_enter(void)
+{
+}
+
+
+void app_cpu_irq_add(uint32_t us)
+{
+}
+
+
+void app_cpu_sched_put(void)
+{
+}
+
+
+bool app_cpu_poll(void)
+{
+    bool ret = m_cpu_poll;
+
+    m_cpu_poll = false;
+    return ret;
+}
+
+
+void app_cpu_report_get(app_cpu_report_t *p_report)
+{
+    memset(p_report, 0, sizeof(app_cpu_report_t));
+}
+
+
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start)
+{
+    return 0;
+}
+
+
+/**********************************************
+ * app_bulk, app_pack
+ **********************************************/
+
+#ifndef SIM_APP_REAL_HELPERS
+void app_bulk_init(app_bulk_t *p_bulk, app_bulk_send_t send, app_latency_t *p_latency)
+{
+}
+
+
+uint32_t app_bulk_mem_source_set(app_bulk_t *p_bulk, uint8_t id, const uint8_t *p_data, uint32_t size)
+{
+    return NRF_SUCCESS;
+}
+
+
+bool app_bulk_on_command(app_bulk_t *p_bulk, const uint8_t *p_value, uint16_t length)
+{
+    return false;
+}
+
+
+void app_bulk_on_ble_evt(app_bulk_t *p_bulk, ble_evt_t *p_ble_evt)
+{
+}
+
+
+bool app_bulk_is_active(const app_bulk_t *p_bulk)
+{
+    return false;
+}
+
+
+void app_pack_init(app_pack_t *p_pack, uint8_t sample_size, app_pack_send_t send, void *p_context)
+{
+}
+#endif  //SIM_APP_REAL_HELPERS
@@ -0,0 +1,483 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    sim_ble.c
+ *
+ * ホストテスト用 : SoftDevice(BLE)の代わり
+ *
+ * sd_ble_gatts_hvx()はTXバッファ数まで積み、テストがsim_ble_conn_event()を呼ぶたびに
+ * 1イベント分ずつCentralへ渡す。無線の損失は再現しない(リンク層は再送で必ず届ける)。
+ *
+ * GATTのハンドルはSoftDeviceと同じく登録順の連番(サービス宣言、キャラクタリスティック宣言、値、CCCD)。
+ * 値の中身は持たない。
+ *
+ * ble_conn_paramsはSDK 8.1と同じく、希望値を初期化時にPPCPから写し、
+ * change_conn_params()は接続中だけ効く(未接続なら希望値もPPCPも変えない)。
+ *
+ * 状態は1台分ずつsim_ble_tにまとめてあり、sim_ble_select()したものをスレッドごとに操作する。
+ * 選ばなければ既定の1台(これまでのテストはこちら)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble.h"
+#include "ble_conn_params.h"
+#include "ble_srv_common.h"
+#include "ble_advdata.h"
+#include "ble_advertising.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+/** TXバッファ数の上限 */
+#define SIM_BLE_TX_MAX                  (16)
+
+/** ハンドル数の上限 */
+#define SIM_BLE_HANDLE_MAX              (64)
+
+/** キャラクタリスティック数の上限 */
+#define SIM_BLE_CHAR_MAX                (16)
+
+/** 作った直後の設定(TXバッファ7個、1イベント4パケット) */
+#define SIM_BLE_DEFAULT                 {                                       \
+        .tx_buffers = 7,                                                        \
+        .pkts_per_event = 4,                                                    \
+        .ppcp = { 400, 800, 0, 400 },                                           \
+        .preferred = { 400, 800, 0, 400 },                                      \
+        .cp_conn_handle = BLE_CONN_HANDLE_INVALID,                              \
+        .uuid_types = BLE_UUID_TYPE_VENDOR_BEGIN,                               \
+    }
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    uint16_t    handle;
+    uint16_t    length;
+    uint8_t     data[SIM_BLE_NOTIFY_MAX];
+} sim_pkt_t;
+
+typedef struct {
+    uint16_t                    uuid;
+    ble_gatts_char_handles_t    handles;
+} sim_char_t;
+
+typedef struct {
+    uint32_t    sent;
+    uint32_t    no_buf;
+} sim_handle_stats_t;
+
+/** 仮想デバイス1台分 */
+struct sim_ble_s {
+    sim_pkt_t                   tx[SIM_BLE_TX_MAX];
+    uint8_t                     tx_rd;
+    uint8_t                     tx_num;
+    uint8_t                     tx_buffers;
+    uint8_t                     pkts_per_event;
+    sim_ble_rx_t                rx;
+
+    ble_gap_conn_params_t       ppcp;
+    ble_gap_conn_params_t       requested;
+    ble_gap_conn_params_t       preferred;      /**< ble_conn_paramsのm_preferred_conn_params */
+    uint16_t                    cp_conn_handle; /**< ble_conn_paramsが見ている接続 */
+    uint16_t                    local_latency;  /**< BLE_GAP_OPT_LOCAL_CONN_LATENCY */
+    uint32_t                    local_latency_cnt;
+
+    uint16_t                    last_handle;
+    uint8_t                     uuid_types;
+    sim_char_t                  chars[SIM_BLE_CHAR_MAX];
+    uint8_t                     char_num;
+    sim_handle_stats_t          stats[SIM_BLE_HANDLE_MAX];
+};
+
+/** sim_ble_select()しないテストが使う1台 */
+static sim_ble_t                        m_default = SIM_BLE_DEFAULT;
+
+/** このスレッドが操作中のデバイス */
+static __thread sim_ble_t               *m_p_sim = &m_default;
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+sim_ble_t *sim_ble_create(void)
+{
+    static const sim_ble_t DEFAULT = SIM_BLE_DEFAULT;
+    sim_ble_t *p_sim = (sim_ble_t *)malloc(sizeof(sim_ble_t));
+
+    if (p_sim != NULL) {
+        *p_sim = DEFAULT;
+    }
+    return p_sim;
+}
+
+
+void sim_ble_delete(sim_ble_t *p_sim)
+{
+    if (m_p_sim == p_sim) {
+        m_p_sim = &m_default;
+    }
+    free(p_sim);
+}
+
+
+void sim_ble_select(sim_ble_t *p_sim)
+{
+    m_p_sim = (p_sim != NULL) ? p_sim : &m_default;
+}
+
+
+void sim_ble_link_set(uint8_t tx_buffers, uint8_t pkts_per_event, sim_ble_rx_t rx)
+{
+    m_p_sim->tx_buffers = (tx_buffers > SIM_BLE_TX_MAX) ? SIM_BLE_TX_MAX : tx_buffers;
+    m_p_sim->pkts_per_event = pkts_per_event;
+    m_p_sim->rx = rx;
+    m_p_sim->tx_rd = 0;
+    m_p_sim->tx_num = 0;
+}
+
+
+uint8_t sim_ble_conn_event(void)
+{
+    uint8_t count = 0;
+    sim_pkt_t *p_pkt;
+
+    while ((m_p_sim->tx_num > 0) && (count < m_p_sim->pkts_per_event)) {
+        p_pkt = &m_p_sim->tx[m_p_sim->tx_rd];
+        m_p_sim->tx_rd = (uint8_t)((m_p_sim->tx_rd + 1) % SIM_BLE_TX_MAX);
+        m_p_sim->tx_num--;
+        count++;
+        if (p_pkt->handle < SIM_BLE_HANDLE_MAX) {
+            m_p_sim->stats[p_pkt->handle].sent++;
+        }
+        if (m_p_sim->rx != NULL) {
+            m_p_sim->rx(p_pkt->handle, p_pkt->data, p_pkt->length);
+        }
+    }
+    return count;
+}
+
+
+uint8_t sim_ble_tx_queued(void)
+{
+    return m_p_sim->tx_num;
+}
+
+
+void sim_ble_conn_params_requested(ble_gap_conn_params_t *p_params)
+{
+    *p_params = m_p_sim->requested;
+}
+
+
+bool sim_ble_char_find(uint16_t uuid, ble_gatts_char_handles_t *p_handles)
+{
+    uint8_t lp;
+
+    for (lp = 0; lp < m_p_sim->char_num; lp++) {
+        if (m_p_sim->chars[lp].uuid == uuid) {
+            *p_handles = m_p_sim->chars[lp].handles;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void sim_ble_conn_params_preferred(ble_gap_conn_params_t *p_params)
+{
+    *p_params = m_p_sim->preferred;
+}
+
+
+uint16_t sim_ble_local_latency(uint32_t *p_cnt)
+{
+    *p_cnt = m_p_sim->local_latency_cnt;
+    return m_p_sim->local_latency;
+}
+
+
+void sim_ble_handle_stats(uint16_t handle, uint32_t *p_sent, uint32_t *p_no_buf)
+{
+    if (handle >= SIM_BLE_HANDLE_MAX) {
+        *p_sent = 0;
+        *p_no_buf = 0;
+        return;
+    }
+    *p_sent = m_p_sim->stats[handle].sent;
+    *p_no_buf = m_p_sim->stats[handle].no_buf;
+}
+
+
+/**********************************************
+ * SoftDevice
+ **********************************************/
+
+uint32_t sd_ble_enable(ble_enable_params_t *p_ble_enable_params)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_tx_buffer_count_get(uint8_t *p_count)
+{
+    *p_count = m_p_sim->tx_buffers;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_opt_set(uint32_t opt_id, const ble_opt_t *p_opt)
+{
+    if (opt_id != BLE_GAP_OPT_LOCAL_CONN_LATENCY) {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+    m_p_sim->local_latency = p_opt->gap_opt.local_conn_latency.requested_latency;
+    m_p_sim->local_latency_cnt++;
+    if (p_opt->gap_opt.local_conn_latency.p_actual_latency != NULL) {
+        *p_opt->gap_opt.local_conn_latency.p_actual_latency = m_p_sim->local_latency;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_vs_add(const ble_uuid128_t *p_vs_uuid, uint8_t *p_uuid_type)
+{
+    *p_uuid_type = m_p_sim->uuid_types++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, const ble_gatts_hvx_params_t *p_hvx_params)
+{
+    sim_pkt_t *p_pkt;
+
+    if (conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (*p_hvx_params->p_len > SIM_BLE_NOTIFY_MAX) {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if (m_p_sim->tx_num >= m_p_sim->tx_buffers) {
+        if (p_hvx_params->handle < SIM_BLE_HANDLE_MAX) {
+            m_p_sim->stats[p_hvx_params->handle].no_buf++;
+        }
+        return BLE_ERROR_NO_TX_BUFFERS;
+    }
+    p_pkt = &m_p_sim->tx[(m_p_sim->tx_rd + m_p_sim->tx_num) % SIM_BLE_TX_MAX];
+    p_pkt->handle = p_hvx_params->handle;
+    p_pkt->length = *p_hvx_params->p_len;
+    memcpy(p_pkt->data, p_hvx_params->p_data, p_pkt->length);
+    m_p_sim->tx_num++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, const ble_uuid_t *p_uuid, uint16_t *p_handle)
+{
+    *p_handle = ++m_p_sim->last_handle;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, const ble_gatts_char_md_t *p_char_md,
+                                        const ble_gatts_attr_t *p_attr_char_value,
+                                        ble_gatts_char_handles_t *p_handles)
+{
+    if ((m_p_sim->char_num >= SIM_BLE_CHAR_MAX) || (m_p_sim->last_handle + 3 >= SIM_BLE_HANDLE_MAX)) {
+        return NRF_ERROR_NO_MEM;
+    }
+    memset(p_handles, 0, sizeof(ble_gatts_char_handles_t));
+    m_p_sim->last_handle++;                    //宣言
+    p_handles->value_handle = ++m_p_sim->last_handle;
+    if (p_char_md->char_props.notify) {
+        p_handles->cccd_handle = ++m_p_sim->last_handle;
+    }
+    m_p_sim->chars[m_p_sim->char_num].uuid = p_attr_char_value->p_uuid->uuid;
+    m_p_sim->chars[m_p_sim->char_num].handles = *p_handles;
+    m_p_sim->char_num++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t *p_value)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, const uint8_t *p_sys_attr_data, uint16_t len, uint32_t flags)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t *p_conn_params)
+{
+    *p_conn_params = m_p_sim->ppcp;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_set(const ble_gap_conn_params_t *p_conn_params)
+{
+    m_p_sim->ppcp = *p_conn_params;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_set(const ble_gap_conn_sec_mode_t *p_write_perm, const uint8_t *p_dev_name, uint16_t len)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_start(const ble_gap_adv_params_t *p_adv_params)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_stop(void)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status,
+                                    const ble_gap_sec_params_t *p_sec_params,
+                                    const ble_gap_sec_keyset_t *p_sec_keyset)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, const ble_gap_enc_info_t *p_enc_info,
+                                    const ble_gap_irk_t *p_id_info, const ble_gap_sign_info_t *p_sign_info)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_rssi_start(uint16_t conn_handle)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_tx_power_set(int8_t tx_power)
+{
+    return NRF_SUCCESS;
+}
+
+
+/**********************************************
+ * ble_conn_params
+ **********************************************/
+
+/* SDK 8.1と同じく、希望値は初期化時にPPCPから写し、以降はchange_conn_params()でだけ変わる */
+uint32_t ble_conn_params_init(const ble_conn_params_init_t *p_init)
+{
+    m_p_sim->preferred = (p_init->p_conn_params != NULL) ? *p_init->p_conn_params : m_p_sim->ppcp;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_conn_params_stop(void)
+{
+    return NRF_SUCCESS;
+}
+
+
+/* 未接続では何もしない(希望値もPPCPも変わらない) */
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t *p_new_params)
+{
+    if (m_p_sim->cp_conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return NRF_SUCCESS;
+    }
+    m_p_sim->preferred = *p_new_params;
+    m_p_sim->requested = *p_new_params;
+    m_p_sim->ppcp = *p_new_params;
+    return NRF_SUCCESS;
+}
+
+
+void ble_conn_params_on_ble_evt(ble_evt_t *p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        m_p_sim->cp_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+        break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+        m_p_sim->cp_conn_handle = BLE_CONN_HANDLE_INVALID;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/**********************************************
+ * ble_srv_common, ble_advdata, ble_advertising
+ **********************************************/
+
+bool ble_srv_is_notification_enabled(uint8_t const *p_encoded_data)
+{
+    return (p_encoded_data[0] & 0x01) != 0;
+}
+
+
+uint32_t ble_advdata_set(const ble_advdata_t *p_advdata, const ble_advdata_t *p_srdata)
+{
+    return NRF_SUCCESS;
+}
+
+
+void ble_advertising_stop(void)
+{
+}
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    sim_sdk.c
+ *
+ * ホストテスト用 : nRF51 SDK/SoftDeviceの代わり
+ *
+ * 実機のタイミングは再現しない。
+ * テストが時間を進めたりタイマを満了させたりして、モジュールの動きだけを確かめる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define SIM_TIMER_MAX                   (8)
+
+/** Flashの末尾(app_cfgの2ページを含む) */
+#define SIM_FLASH_ADDR                  (0x3F000)
+#define SIM_FLASH_SIZE                  (0x1000)
+#define SIM_FLASH_PAGE_SIZE             (1024)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    app_timer_timeout_handler_t handler;
+    app_timer_mode_t            mode;
+    bool                        running;
+    uint32_t                    timeout;
+    void                        *p_context;
+} sim_timer_t;
+
+static sim_timer_t                      m_timer[SIM_TIMER_MAX];
+static uint8_t                          m_timer_num;
+
+/** CRITICAL_REGION_ENTER()/EXIT() */
+static pthread_mutex_t                  m_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread uint32_t                m_critical_nest;
+
+/** クリティカルセクション中に上げられ、抜けるまで待たせている割込み */
+static __thread void                    (*m_irq_pending)(void);
+
+/** 次のapp_timer_start()/stop()の直前に上げる割込み(1回だけ) */
+static void                             (*m_timer_preempt)(void);
+
+/* 実行中のFlash操作(sd_flash_write()はsizeが0以外、sd_flash_page_erase()は0) */
+static bool                             m_flash_busy;
+static uint32_t                         *m_flash_dst;
+static const uint32_t                   *m_flash_src;
+static uint32_t                         m_flash_size;
+
+static NRF_RTC_Type                     m_rtc1;
+NRF_RTC_Type                            *NRF_RTC1 = &m_rtc1;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void timer_preempt(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_file_name)
+{
+    fprintf(stderr, "app_error_handler: err=%u %s:%u\n", error_code, (const char *)p_file_name, line_num);
+    exit(2);
+}
+
+
+void sim_critical_enter(void)
+{
+    pthread_mutex_lock(&m_critical);
+    m_critical_nest++;
+}
+
+
+void sim_critical_exit(void)
+{
+    void (*p_isr)(void) = NULL;
+
+    m_critical_nest--;
+    if (m_critical_nest == 0) {
+        p_isr = m_irq_pending;
+        m_irq_pending = NULL;
+    }
+    pthread_mutex_unlock(&m_critical);
+
+    //割込み禁止が解けたところで、待たせていた割込みが入る
+    if (p_isr != NULL) {
+        p_isr();
+    }
+}
+
+
+void sim_irq_raise(void (*p_isr)(void))
+{
+    if (m_critical_nest == 0) {
+        p_isr();
+    }
+    else {
+        m_irq_pending = p_isr;
+    }
+}
+
+
+void sim_rtc_advance(uint32_t ticks)
+{
+    m_rtc1.COUNTER = (m_rtc1.COUNTER + ticks) & 0x00ffffff;
+}
+
+
+/**********************************************
+ * app_timer
+ **********************************************/
+
+uint32_t app_timer_create(app_timer_id_t *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler)
+{
+    if (m_timer_num >= SIM_TIMER_MAX) {
+        return NRF_ERROR_NO_MEM;
+    }
+    m_timer[m_timer_num].handler = timeout_handler;
+    m_timer[m_timer_num].mode = mode;
+    *p_timer_id = m_timer_num++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+    timer_preempt();
+    if ((timer_id >= m_timer_num) || (timeout_ticks < 5) || (timeout_ticks > 0x00ffffff)) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_timer[timer_id].running = true;
+    m_timer[timer_id].timeout = timeout_ticks;
+    m_timer[timer_id].p_context = p_context;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    timer_preempt();
+    if (timer_id >= m_timer_num) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_timer[timer_id].running = false;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_get(uint32_t *p_ticks)
+{
+    *p_ticks = NRF_RTC1->COUNTER;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t *p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & 0x00ffffff;
+    return NRF_SUCCESS;
+}
+
+
+void sim_timer_expire(app_timer_id_t timer_id)
+{
+    sim_timer_t *p_timer = &m_timer[timer_id];
+
+    if (!p_timer->running) {
+        return;
+    }
+    if (p_timer->mode == APP_TIMER_MODE_SINGLE_SHOT) {
+        p_timer->running = false;
+    }
+    p_timer->handler(p_timer->p_context);
+}
+
+
+bool sim_timer_is_running(app_timer_id_t timer_id)
+{
+    return m_timer[timer_id].running;
+}
+
+
+uint32_t sim_timer_timeout(app_timer_id_t timer_id)
+{
+    return m_timer[timer_id].timeout;
+}
+
+
+void sim_timer_preempt(void (*p_isr)(void))
+{
+    m_timer_preempt = p_isr;
+}
+
+
+/**********************************************
+ * SoftDevice(SoC)
+ **********************************************/
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type irqn)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_DisableIRQ(IRQn_Type irqn)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_SetPriority(IRQn_Type irqn, uint32_t priority)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type irqn)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_flash_write(uint32_t * const p_dst, uint32_t const * const p_src, uint32_t size)
+{
+    if (m_flash_busy) {
+        return NRF_ERROR_BUSY;
+    }
+    if (((uintptr_t)p_dst < SIM_FLASH_ADDR) ||
+      ((uintptr_t)(p_dst + size) > SIM_FLASH_ADDR + SIM_FLASH_SIZE) || (size == 0)) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_flash_busy = true;
+    m_flash_dst = p_dst;
+    m_flash_src = p_src;
+    m_flash_size = size;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_flash_page_erase(uint32_t page_number)
+{
+    uintptr_t addr = (uintptr_t)page_number * SIM_FLASH_PAGE_SIZE;
+
+    if (m_flash_busy) {
+        return NRF_ERROR_BUSY;
+    }
+    if ((addr < SIM_FLASH_ADDR) || (addr + SIM_FLASH_PAGE_SIZE > SIM_FLASH_ADDR + SIM_FLASH_SIZE)) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_flash_busy = true;
+    m_flash_dst = (uint32_t *)addr;
+    m_flash_src = NULL;
+    m_flash_size = 0;
+    return NRF_SUCCESS;
+}
+
+
+/**********************************************
+ * Flash
+ **********************************************/
+
+bool sim_flash_init(void)
+{
+    void *p;
+
+    //実機と同じアドレスで読めるように、そこへ直接マップする
+    p = mmap((void *)SIM_FLASH_ADDR, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p != (void *)SIM_FLASH_ADDR) {
+        return false;
+    }
+    memset(p, 0xff, SIM_FLASH_SIZE);
+    m_flash_busy = false;
+    return true;
+}
+
+
+uint32_t sim_flash_done(void)
+{
+    uint32_t lp;
+
+    if (!m_flash_busy) {
+        return NRF_EVT_HFCLKSTARTED;
+    }
+    if (m_flash_size == 0) {
+        memset(m_flash_dst, 0xff, SIM_FLASH_PAGE_SIZE);
+    }
+    else {
+        //1にはできない
+        for (lp = 0; lp < m_flash_size; lp++) {
+            m_flash_dst[lp] &= m_flash_src[lp];
+        }
+    }
+    m_flash_busy = false;
+    return NRF_EVT_FLASH_OPERATION_SUCCESS;
+}
+
+
+bool sim_flash_busy(void)
+{
+    return m_flash_busy;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief app_timerの操作が効く前に、sim_timer_preempt()の割込みを上げる
+ *
+ * 呼び元がクリティカルセクション中なら、抜けるまで割込みは入らない。
+ */
+static void timer_preempt(void)
+{
+    void (*p_isr)(void) = m_timer_preempt;
+
+    if (p_isr != NULL) {
+        m_timer_preempt = NULL;
+        sim_irq_raise(p_isr);
+    }
+}
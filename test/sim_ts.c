@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    sim_ts.c
+ *
+ * ホストテスト用 : app_tsの代わり
+ *
+ * app_ts.cのLinux版は実時間を返すので、時刻で結果が決まるテストではこちらをリンクし、
+ * sim_ts_advance()で時刻を進める。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include "app_ts.h"
+#include "sim_ts.h"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static uint32_t                         m_now;
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+void app_ts_init(void)
+{
+}
+
+
+uint32_t app_ts_now(void)
+{
+    return m_now;
+}
+
+
+void app_ts_request(void)
+{
+}
+
+
+void app_ts_release(void)
+{
+}
+
+
+uint32_t app_ts_overhead(void)
+{
+    return 0;
+}
+
+
+void sim_ts_advance(uint32_t us)
+{
+    m_now += us;
+}
+
+
+void sim_ts_set(uint32_t us)
+{
+    m_now = us;
+}
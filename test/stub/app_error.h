@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_error.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替
+ *
+ * エラーはsim_sdk.cのapp_error_handler()で表示して終了する。
+ */
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdint.h>
+#include "nrf_error.h"
+#include "nordic_common.h"
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t *p_file_name);
+
+#define APP_ERROR_HANDLER(err_code)                                                 \
+    do {                                                                            \
+        app_error_handler((err_code), __LINE__, (const uint8_t *)__FILE__);         \
+    } while (0)
+
+#define APP_ERROR_CHECK(err_code)                                                   \
+    do {                                                                            \
+        const uint32_t local_err_code_ = (err_code);                                \
+        if (local_err_code_ != NRF_SUCCESS) {                                       \
+            APP_ERROR_HANDLER(local_err_code_);                                     \
+        }                                                                           \
+    } while (0)
+
+#define APP_ERROR_CHECK_BOOL(boolean_value)                                         \
+    do {                                                                            \
+        if (!(boolean_value)) {                                                     \
+            APP_ERROR_HANDLER(0);                                                   \
+        }                                                                           \
+    } while (0)
+
+#endif /* APP_ERROR_H__ */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_timer.h
+ *
+ * ホストテスト用 : nRF51 SDK 8.1の代替
+ *
+ * タイマは勝手には満了しない。テストがsim_timer_expire()で満了させる。
+ */
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define APP_TIMER_TICKS(MS, PRESCALER)  ((uint32_t)(((uint64_t)(MS) * 32768) / (((PRESCALER) + 1) * 1000)))
+
+typedef uint32_t app_timer_id_t;
+
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+
+typedef enum {
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+uint32_t app_timer_create(app_timer_id_t *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(uint32_t *p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t *p_ticks_diff);
+
+
+/* 以下はsim_sdk.c */
+
+/**@brief タイマを満了させる(動作中のときだけハンドラを呼ぶ) */
+void sim_timer_expire(app_timer_id_t timer_id);
+
+/**@brief タイマが動作中かどうか */
+bool sim_timer_is_running(app_timer_id_t timer_id);
+
+/**@brief 最後に開始したときの満了時間[RTC] */
+uint32_t sim_timer_timeout(app_timer_id_t timer_id);
+
+/**@brief 次のapp_timer_start()/stop()が効く直前に割込みを上げる(1回だけ) */
+void sim_timer_preempt(void (*p_isr)(void));
+
+#endif /* APP_TIMER_H__ */
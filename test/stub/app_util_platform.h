@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    app_util_platform.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替
+ *
+ * 割込みはsim側で同期的に呼ぶ。
+ * クリティカルセクションは、複数スレッドで仮想デバイスを動かすとき(bench_fleet.c)のために
+ * sim_sdk.cのミューテックス1つで排他する(再帰可)。
+ */
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#include <stdint.h>
+#include "nordic_common.h"
+
+#define APP_IRQ_PRIORITY_HIGH           (1)
+#define APP_IRQ_PRIORITY_LOW            (3)
+
+void sim_critical_enter(void);
+void sim_critical_exit(void);
+
+/**@brief 割込みを上げる(クリティカルセクション中なら、抜けたときに呼ぶ) */
+void sim_irq_raise(void (*p_isr)(void));
+
+#define CRITICAL_REGION_ENTER()         { sim_critical_enter();
+#define CRITICAL_REGION_EXIT()          sim_critical_exit(); }
+
+#endif /* APP_UTIL_PLATFORM_H__ */
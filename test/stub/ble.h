@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    ble.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替(S110 v8.0のイベントID)
+ *
+ * ble_gap.h/ble_gatts.hの、テストで使う部分もここにまとめる。
+ * SoftDeviceの関数はsim_ble.c。
+ */
+#ifndef BLE_H__
+#define BLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_error.h"
+
+#define BLE_ERROR_NO_TX_BUFFERS         (0x3004)
+#define BLE_ERROR_GATTS_SYS_ATTR_MISSING (0x3401)
+
+#define BLE_CONN_HANDLE_INVALID         (0xFFFF)
+#define BLE_GATT_HANDLE_INVALID         (0x0000)
+#define BLE_GATT_HVX_NOTIFICATION       (0x01)
+
+#define GATT_RX_MTU                     (23)
+
+#define BLE_GAP_OPT_LOCAL_CONN_LATENCY  (0x21)
+
+#define BLE_UUID_TYPE_VENDOR_BEGIN      (0x02)
+#define BLE_GATTS_SRVC_TYPE_PRIMARY     (0x01)
+#define BLE_GATTS_VLOC_STACK            (0x01)
+#define BLE_GATTS_SYS_ATTR_FLAG_SYS_SRVCS   (1 << 0)
+#define BLE_GATTS_SYS_ATTR_FLAG_USR_SRVCS   (1 << 1)
+
+#define BLE_APPEARANCE_UNKNOWN          (0)
+#define BLE_GAP_ADV_TYPE_ADV_IND        (0x00)
+#define BLE_GAP_ADV_FP_ANY              (0x00)
+#define BLE_GAP_ADV_TIMEOUT_LIMITED_MAX (180)
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE (0x05)
+#define BLE_GAP_CP_SLAVE_LATENCY_MAX    (0x01F3)
+#define BLE_GAP_SEC_STATUS_SUCCESS      (0x00)
+#define BLE_GAP_TIMEOUT_SRC_ADVERTISING         (0x00)
+#define BLE_GAP_TIMEOUT_SRC_SECURITY_REQUEST    (0x01)
+
+#define BLE_GAP_IO_CAPS_DISPLAY_ONLY        (0x00)
+#define BLE_GAP_IO_CAPS_DISPLAY_YESNO       (0x01)
+#define BLE_GAP_IO_CAPS_KEYBOARD_ONLY       (0x02)
+#define BLE_GAP_IO_CAPS_NONE                (0x03)
+#define BLE_GAP_IO_CAPS_KEYBOARD_DISPLAY    (0x04)
+
+#define BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(ptr)    do { (ptr)->sm = 0; (ptr)->lv = 0; } while (0)
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr)         do { (ptr)->sm = 1; (ptr)->lv = 1; } while (0)
+
+enum {
+    BLE_EVT_TX_COMPLETE                 = 0x01,
+    BLE_EVT_USER_MEM_REQUEST            = 0x02,
+    BLE_EVT_USER_MEM_RELEASE            = 0x03,
+
+    BLE_GAP_EVT_CONNECTED               = 0x10,
+    BLE_GAP_EVT_DISCONNECTED            = 0x11,
+    BLE_GAP_EVT_CONN_PARAM_UPDATE       = 0x12,
+    BLE_GAP_EVT_SEC_PARAMS_REQUEST      = 0x13,
+    BLE_GAP_EVT_SEC_INFO_REQUEST        = 0x14,
+    BLE_GAP_EVT_PASSKEY_DISPLAY         = 0x15,
+    BLE_GAP_EVT_AUTH_KEY_REQUEST        = 0x16,
+    BLE_GAP_EVT_AUTH_STATUS             = 0x17,
+    BLE_GAP_EVT_CONN_SEC_UPDATE         = 0x18,
+    BLE_GAP_EVT_TIMEOUT                 = 0x19,
+    BLE_GAP_EVT_RSSI_CHANGED            = 0x1A,
+
+    BLE_GATTS_EVT_WRITE                 = 0x50,
+    BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST  = 0x51,
+    BLE_GATTS_EVT_SYS_ATTR_MISSING      = 0x52,
+    BLE_GATTS_EVT_HVC                   = 0x53,
+    BLE_GATTS_EVT_SC_CONFIRM            = 0x54,
+    BLE_GATTS_EVT_TIMEOUT               = 0x55,
+};
+
+typedef struct {
+    uint16_t    min_conn_interval;
+    uint16_t    max_conn_interval;
+    uint16_t    slave_latency;
+    uint16_t    conn_sup_timeout;
+} ble_gap_conn_params_t;
+
+typedef struct {
+    uint8_t     addr_type;
+    uint8_t     addr[6];
+} ble_gap_addr_t;
+
+typedef struct {
+    uint8_t     sm : 4;
+    uint8_t     lv : 4;
+} ble_gap_conn_sec_mode_t;
+
+typedef struct {
+    uint8_t     enc  : 1;
+    uint8_t     id   : 1;
+    uint8_t     sign : 1;
+} ble_gap_sec_kdist_t;
+
+typedef struct {
+    uint8_t             bond    : 1;
+    uint8_t             mitm    : 1;
+    uint8_t             io_caps : 3;
+    uint8_t             oob     : 1;
+    uint8_t             min_key_size;
+    uint8_t             max_key_size;
+    ble_gap_sec_kdist_t kdist_periph;
+    ble_gap_sec_kdist_t kdist_central;
+} ble_gap_sec_params_t;
+
+typedef struct {
+    uint16_t    ediv;
+    uint8_t     rand[8];
+} ble_gap_master_id_t;
+
+typedef struct {
+    uint8_t     ltk[16];
+    uint8_t     auth    : 1;
+    uint8_t     ltk_len : 7;
+} ble_gap_enc_info_t;
+
+typedef struct {
+    ble_gap_enc_info_t  enc_info;
+    ble_gap_master_id_t master_id;
+} ble_gap_enc_key_t;
+
+typedef struct {
+    uint8_t     irk[16];
+} ble_gap_irk_t;
+
+typedef struct {
+    ble_gap_irk_t   id_info;
+    ble_gap_addr_t  id_addr_info;
+} ble_gap_id_key_t;
+
+typedef struct {
+    uint8_t     csrk[16];
+} ble_gap_sign_info_t;
+
+typedef struct {
+    ble_gap_enc_key_t   *p_enc_key;
+    ble_gap_id_key_t    *p_id_key;
+    ble_gap_sign_info_t *p_sign_key;
+} ble_gap_sec_keys_t;
+
+typedef struct {
+    ble_gap_sec_keys_t  keys_periph;
+    ble_gap_sec_keys_t  keys_central;
+} ble_gap_sec_keyset_t;
+
+typedef struct {
+    uint8_t             auth_status;
+    uint8_t             error_src : 2;
+    uint8_t             bonded    : 1;
+    ble_gap_sec_kdist_t kdist_periph;
+    ble_gap_sec_kdist_t kdist_central;
+} ble_gap_evt_auth_status_t;
+
+typedef struct {
+    uint8_t     ch_37_off : 1;
+    uint8_t     ch_38_off : 1;
+    uint8_t     ch_39_off : 1;
+} ble_gap_adv_ch_mask_t;
+
+typedef struct {
+    uint8_t                 type;
+    const ble_gap_addr_t    *p_peer_addr;
+    uint8_t                 fp;
+    const void              *p_whitelist;
+    uint16_t                interval;
+    uint16_t                timeout;
+    ble_gap_adv_ch_mask_t   channel_mask;
+} ble_gap_adv_params_t;
+
+typedef struct {
+    uint16_t    conn_handle;
+    union {
+        struct {
+            ble_gap_conn_params_t   conn_params;
+        } connected;
+        struct {
+            uint8_t                 reason;
+        } disconnected;
+        struct {
+            ble_gap_conn_params_t   conn_params;
+        } conn_param_update;
+        struct {
+            int8_t                  rssi;
+        } rssi_changed;
+        ble_gap_evt_auth_status_t   auth_status;
+        struct {
+            ble_gap_addr_t          peer_addr;
+            ble_gap_master_id_t     master_id;
+        } sec_info_request;
+        struct {
+            uint8_t                 src;
+        } timeout;
+    } params;
+} ble_gap_evt_t;
+
+typedef struct {
+    uint16_t    uuid;
+    uint8_t     type;
+} ble_uuid_t;
+
+typedef struct {
+    uint8_t     uuid128[16];
+} ble_uuid128_t;
+
+typedef struct {
+    ble_gap_conn_sec_mode_t read_perm;
+    ble_gap_conn_sec_mode_t write_perm;
+    uint8_t                 vlen    : 1;
+    uint8_t                 vloc    : 2;
+    uint8_t                 rd_auth : 1;
+    uint8_t                 wr_auth : 1;
+} ble_gatts_attr_md_t;
+
+typedef struct {
+    uint8_t     broadcast     : 1;
+    uint8_t     read          : 1;
+    uint8_t     write_wo_resp : 1;
+    uint8_t     write         : 1;
+    uint8_t     notify        : 1;
+    uint8_t     indicate      : 1;
+} ble_gatt_char_props_t;
+
+typedef struct {
+    ble_gatt_char_props_t       char_props;
+    ble_gatts_attr_md_t         *p_cccd_md;
+} ble_gatts_char_md_t;
+
+typedef struct {
+    const ble_uuid_t            *p_uuid;
+    const ble_gatts_attr_md_t   *p_attr_md;
+    uint16_t                    init_len;
+    uint16_t                    init_offs;
+    uint16_t                    max_len;
+    uint8_t                     *p_value;
+} ble_gatts_attr_t;
+
+typedef struct {
+    uint16_t    value_handle;
+    uint16_t    user_desc_handle;
+    uint16_t    cccd_handle;
+    uint16_t    sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+    uint16_t    len;
+    uint16_t    offset;
+    uint8_t     *p_value;
+} ble_gatts_value_t;
+
+typedef struct {
+    struct {
+        uint8_t     service_changed : 1;
+        uint32_t    attr_tab_size;
+    } gatts_enable_params;
+} ble_enable_params_t;
+
+typedef struct {
+    uint16_t    handle;
+    uint8_t     op;
+    uint16_t    offset;
+    uint16_t    len;
+    uint8_t     data[1];
+} ble_gatts_evt_write_t;
+
+typedef struct {
+    uint16_t    conn_handle;
+    union {
+        ble_gatts_evt_write_t   write;
+    } params;
+} ble_gatts_evt_t;
+
+typedef struct {
+    uint16_t    conn_handle;
+    union {
+        struct {
+            uint8_t             count;
+        } tx_complete;
+    } params;
+} ble_common_evt_t;
+
+typedef struct {
+    uint16_t    evt_id;
+    uint16_t    evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+    ble_evt_hdr_t   header;
+    union {
+        ble_common_evt_t    common_evt;
+        ble_gap_evt_t       gap_evt;
+        ble_gatts_evt_t     gatts_evt;
+    } evt;
+} ble_evt_t;
+
+typedef struct {
+    uint16_t    handle;
+    uint8_t     type;
+    uint16_t    offset;
+    uint16_t    *p_len;
+    uint8_t     *p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct {
+    uint16_t    conn_handle;
+    uint16_t    requested_latency;
+    uint16_t    *p_actual_latency;
+} ble_gap_opt_local_conn_latency_t;
+
+typedef union {
+    ble_gap_opt_local_conn_latency_t    local_conn_latency;
+} ble_gap_opt_t;
+
+typedef union {
+    ble_gap_opt_t   gap_opt;
+} ble_opt_t;
+
+uint32_t sd_ble_enable(ble_enable_params_t *p_ble_enable_params);
+uint32_t sd_ble_tx_buffer_count_get(uint8_t *p_count);
+uint32_t sd_ble_opt_set(uint32_t opt_id, const ble_opt_t *p_opt);
+uint32_t sd_ble_uuid_vs_add(const ble_uuid128_t *p_vs_uuid, uint8_t *p_uuid_type);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, const ble_gatts_hvx_params_t *p_hvx_params);
+uint32_t sd_ble_gatts_service_add(uint8_t type, const ble_uuid_t *p_uuid, uint16_t *p_handle);
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, const ble_gatts_char_md_t *p_char_md,
+                                        const ble_gatts_attr_t *p_attr_char_value,
+                                        ble_gatts_char_handles_t *p_handles);
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t *p_value);
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, const uint8_t *p_sys_attr_data, uint16_t len, uint32_t flags);
+uint32_t sd_ble_gap_ppcp_get(ble_gap_conn_params_t *p_conn_params);
+uint32_t sd_ble_gap_ppcp_set(const ble_gap_conn_params_t *p_conn_params);
+uint32_t sd_ble_gap_device_name_set(const ble_gap_conn_sec_mode_t *p_write_perm, const uint8_t *p_dev_name, uint16_t len);
+uint32_t sd_ble_gap_appearance_set(uint16_t appearance);
+uint32_t sd_ble_gap_adv_start(const ble_gap_adv_params_t *p_adv_params);
+uint32_t sd_ble_gap_adv_stop(void);
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code);
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status,
+                                    const ble_gap_sec_params_t *p_sec_params,
+                                    const ble_gap_sec_keyset_t *p_sec_keyset);
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, const ble_gap_enc_info_t *p_enc_info,
+                                    const ble_gap_irk_t *p_id_info, const ble_gap_sign_info_t *p_sign_info);
+uint32_t sd_ble_gap_rssi_start(uint16_t conn_handle);
+uint32_t sd_ble_gap_tx_power_set(int8_t tx_power);
+
+
+/* 以下はsim_ble.c */
+
+/** Notify 1パケットの最大長(ATT_MTU 23) */
+#define SIM_BLE_NOTIFY_MAX              (20)
+
+/**@brief 仮想デバイス1台分のSoftDevice(中身はsim_ble.c) */
+typedef struct sim_ble_s sim_ble_t;
+
+/**@brief Centralが受け取ったNotify(handleは値のハンドル) */
+typedef void (*sim_ble_rx_t)(uint16_t handle, const uint8_t *p_data, uint16_t length);
+
+/**@brief 仮想デバイスを作る(リンクは既定の設定)
+ *
+ * @return      作ったデバイス(確保できなければNULL)
+ */
+sim_ble_t *sim_ble_create(void);
+
+/**@brief 仮想デバイスを捨てる(選んでいれば既定の1台に戻る) */
+void sim_ble_delete(sim_ble_t *p_sim);
+
+/**@brief 以降このスレッドで呼ぶsd_*()/sim_ble_*()の対象を切り替える
+ *
+ * @param[in]   p_sim       sim_ble_create()で作ったデバイス。NULLなら既定の1台
+ */
+void sim_ble_select(sim_ble_t *p_sim);
+
+/**@brief リンクの設定
+ *
+ * @param[in]   tx_buffers      sd_ble_tx_buffer_count_get()の値
+ * @param[in]   pkts_per_event  1回のConnectionイベントで送れるパケット数
+ * @param[in]   rx              Central側の受信関数
+ */
+void sim_ble_link_set(uint8_t tx_buffers, uint8_t pkts_per_event, sim_ble_rx_t rx);
+
+/**@brief Connectionイベント(TXバッファのNotifyを送ってrxに渡す)
+ *
+ * @return      送ったパケット数(BLE_EVT_TX_COMPLETEのcount)
+ */
+uint8_t sim_ble_conn_event(void);
+
+/**@brief TXバッファに残っているパケット数 */
+uint8_t sim_ble_tx_queued(void);
+
+/**@brief 最後にble_conn_params_change_conn_params()で要求したパラメータ */
+void sim_ble_conn_params_requested(ble_gap_conn_params_t *p_params);
+
+/**@brief ble_conn_paramsが接続時に要求する希望値(m_preferred_conn_params) */
+void sim_ble_conn_params_preferred(ble_gap_conn_params_t *p_params);
+
+/**@brief 最後にBLE_GAP_OPT_LOCAL_CONN_LATENCYで設定したlatency
+ *
+ * @param[out]  p_cnt   これまでに設定した回数
+ * @return      latency(設定していなければ0)
+ */
+uint16_t sim_ble_local_latency(uint32_t *p_cnt);
+
+/**@brief キャラクタリスティックのハンドルをUUIDで探す(sd_ble_gatts_characteristic_add()で登録した順)
+ *
+ * @param[in]   uuid        16bit UUID
+ * @param[out]  p_handles   ハンドル
+ * @retval      true        見つかった
+ */
+bool sim_ble_char_find(uint16_t uuid, ble_gatts_char_handles_t *p_handles);
+
+/**@brief ハンドルごとの送信数
+ *
+ * @param[in]   handle      値のハンドル
+ * @param[out]  p_sent      Centralへ渡したNotify数
+ * @param[out]  p_no_buf    BLE_ERROR_NO_TX_BUFFERSを返したsd_ble_gatts_hvx()の数
+ */
+void sim_ble_handle_stats(uint16_t handle, uint32_t *p_sent, uint32_t *p_no_buf);
+
+#endif /* BLE_H__ */
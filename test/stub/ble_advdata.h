@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    ble_advdata.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替
+ */
+#ifndef BLE_ADVDATA_H__
+#define BLE_ADVDATA_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+typedef enum {
+    BLE_ADVDATA_NO_NAME,
+    BLE_ADVDATA_SHORT_NAME,
+    BLE_ADVDATA_FULL_NAME
+} ble_advdata_name_type_t;
+
+typedef struct {
+    uint16_t    uuid_cnt;
+    ble_uuid_t  *p_uuids;
+} ble_advdata_uuid_list_t;
+
+typedef struct {
+    ble_advdata_name_type_t name_type;
+    uint8_t                 short_name_len;
+    bool                    include_appearance;
+    uint8_t                 flags;
+    ble_advdata_uuid_list_t uuids_more_available;
+    ble_advdata_uuid_list_t uuids_complete;
+    ble_advdata_uuid_list_t uuids_solicited;
+} ble_advdata_t;
+
+uint32_t ble_advdata_set(const ble_advdata_t *p_advdata, const ble_advdata_t *p_srdata);
+
+#endif /* BLE_ADVDATA_H__ */
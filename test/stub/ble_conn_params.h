@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    ble_conn_params.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替(sim_ble.c)
+ */
+#ifndef BLE_CONN_PARAMS_H__
+#define BLE_CONN_PARAMS_H__
+
+#include <stdint.h>
+#include "ble.h"
+
+#include <stdbool.h>
+
+typedef enum {
+    BLE_CONN_PARAMS_EVT_FAILED,
+    BLE_CONN_PARAMS_EVT_SUCCEEDED
+} ble_conn_params_evt_type_t;
+
+typedef struct {
+    ble_conn_params_evt_type_t  evt_type;
+} ble_conn_params_evt_t;
+
+typedef void (*ble_conn_params_evt_handler_t)(ble_conn_params_evt_t *p_evt);
+
+typedef struct {
+    ble_gap_conn_params_t           *p_conn_params;
+    uint32_t                        first_conn_params_update_delay;
+    uint32_t                        next_conn_params_update_delay;
+    uint8_t                         max_conn_params_update_count;
+    uint16_t                        start_on_notify_cccd_handle;
+    bool                            disconnect_on_fail;
+    ble_conn_params_evt_handler_t   evt_handler;
+    void                            (*error_handler)(uint32_t nrf_error);
+} ble_conn_params_init_t;
+
+uint32_t ble_conn_params_init(const ble_conn_params_init_t *p_init);
+uint32_t ble_conn_params_stop(void);
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t *p_new_params);
+void ble_conn_params_on_ble_evt(ble_evt_t *p_ble_evt);
+
+#endif /* BLE_CONN_PARAMS_H__ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    nrf.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替
+ *
+ * レジスタはsim_sdk.cのRAM上の構造体で、読み書きしても何も起きない。
+ * RTC1 COUNTERだけはテストが進める(sim_rtc_advance())。
+ */
+#ifndef NRF_H__
+#define NRF_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define __WFE()                         do {} while (0)
+#define __SEV()                         do {} while (0)
+#define __NOP()                         do {} while (0)
+
+typedef int IRQn_Type;
+
+typedef struct {
+    volatile uint32_t   TASKS_START, TASKS_STOP, TASKS_CLEAR, TASKS_TRIGOVRFLW;
+    volatile uint32_t   EVENTS_TICK, EVENTS_OVRFLW, EVENTS_COMPARE[4];
+    volatile uint32_t   INTENSET, INTENCLR, EVTEN, EVTENSET, EVTENCLR, COUNTER, PRESCALER, CC[4];
+} NRF_RTC_Type;
+
+extern NRF_RTC_Type *NRF_RTC1;
+
+/**@brief RTC1 COUNTERを進める(24bit) */
+void sim_rtc_advance(uint32_t ticks);
+
+#endif /* NRF_H__ */
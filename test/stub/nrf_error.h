@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    nrf_error.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替
+ */
+#ifndef NRF_ERROR_H__
+#define NRF_ERROR_H__
+
+#define NRF_SUCCESS                     (0)
+#define NRF_ERROR_INTERNAL              (3)
+#define NRF_ERROR_NO_MEM                (4)
+#define NRF_ERROR_NOT_FOUND             (5)
+#define NRF_ERROR_NOT_SUPPORTED         (6)
+#define NRF_ERROR_INVALID_PARAM         (7)
+#define NRF_ERROR_INVALID_STATE         (8)
+#define NRF_ERROR_INVALID_LENGTH        (9)
+#define NRF_ERROR_DATA_SIZE             (12)
+#define NRF_ERROR_NULL                  (14)
+#define NRF_ERROR_BUSY                  (17)
+
+#endif /* NRF_ERROR_H__ */
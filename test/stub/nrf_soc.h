@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    nrf_soc.h
+ *
+ * ホストテスト用 : nRF51 SDKの代替
+ *
+ * Radio Notification割込みはテストがRADIO_NOTIFICATION_IRQHandler()を直接呼ぶ。
+ * Flash操作は要求を保持するだけで、テストがsim_flash_done()で完了させる。
+ */
+#ifndef NRF_SOC_H__
+#define NRF_SOC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+#include "nrf_error.h"
+
+#define SWI1_IRQn                       (21)
+#define RADIO_NOTIFICATION_IRQn         SWI1_IRQn
+#define RADIO_NOTIFICATION_IRQHandler   SWI1_IRQHandler
+
+enum {
+    NRF_RADIO_NOTIFICATION_TYPE_NONE = 0,
+    NRF_RADIO_NOTIFICATION_TYPE_INT_ON_ACTIVE,
+    NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE,
+    NRF_RADIO_NOTIFICATION_TYPE_INT_ON_BOTH,
+};
+
+enum {
+    NRF_RADIO_NOTIFICATION_DISTANCE_NONE = 0,
+    NRF_RADIO_NOTIFICATION_DISTANCE_800US,
+    NRF_RADIO_NOTIFICATION_DISTANCE_1740US,
+    NRF_RADIO_NOTIFICATION_DISTANCE_2680US,
+    NRF_RADIO_NOTIFICATION_DISTANCE_3620US,
+    NRF_RADIO_NOTIFICATION_DISTANCE_4560US,
+    NRF_RADIO_NOTIFICATION_DISTANCE_5500US,
+};
+
+typedef uint8_t nrf_radio_notification_distance_t;
+
+enum {
+    NRF_EVT_HFCLKSTARTED,
+    NRF_EVT_POWER_FAILURE_WARNING,
+    NRF_EVT_FLASH_OPERATION_SUCCESS,
+    NRF_EVT_FLASH_OPERATION_ERROR,
+};
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type irqn);
+uint32_t sd_nvic_DisableIRQ(IRQn_Type irqn);
+uint32_t sd_nvic_SetPriority(IRQn_Type irqn, uint32_t priority);
+uint32_t sd_nvic_ClearPendingIRQ(IRQn_Type irqn);
+uint32_t sd_radio_notification_cfg_set(uint8_t type, uint8_t distance);
+uint32_t sd_flash_write(uint32_t * const p_dst, uint32_t const * const p_src, uint32_t size);
+uint32_t sd_flash_page_erase(uint32_t page_number);
+
+/* 以下はsim_sdk.c */
+
+/**@brief Flashの末尾(0x3F000～0x3FFFF)を、実機と同じアドレスに消去状態で置く
+ *
+ * app_cfgはFlashのアドレスを直接読むので、それより先に呼ぶこと。
+ *
+ * @retval      true        確保できた
+ */
+bool sim_flash_init(void);
+
+/**@brief 実行中のFlash操作を終える(書込みは0のbitだけ反映する)
+ *
+ * @return      NRF_EVT_FLASH_OPERATION_SUCCESS(操作が無ければNRF_EVT_HFCLKSTARTED)
+ */
+uint32_t sim_flash_done(void);
+
+/**@brief Flash操作の実行中かどうか */
+bool sim_flash_busy(void);
+
+void SWI1_IRQHandler(void);
+
+#endif /* NRF_SOC_H__ */
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_bulk.c
+ *
+ * app_bulkの転送速度(模擬リンク)
+ *
+ * sim_ble.cのリンク(TXバッファ7個)で、Connection間隔と1イベントあたりのパケット数を変えて
+ * 一括転送し、KB/s(1KB = 1024byte)を出力する。Central側は
+ *  - 16パケットごとと最後にACKを書く(書込みは次のConnectionイベントで届く)
+ *  - 取りこぼしたら(loss)、次のパケットでNACKを書く
+ * とする。受信データが元と一致すること、app_bulkの速度がリンクの時間と合うこと、
+ * 損失なしならリンク上限の9割以上出ること、終了後にPPCPが元に戻ることを確かめる。
+ * 転送中に切断した場合も、PPCPとble_conn_paramsの希望値が次の接続までに元に戻ることを確かめる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_bulk.h"
+#include "app_latency.h"
+#include "ble_conn_params.h"
+#include "nrf.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+#define SOURCE_SIZE                     (32 * 1024)
+#define XFER_OFFSET                     (100)
+#define XFER_LENGTH                     (30000)
+#define XFER_PACKETS                    ((XFER_LENGTH + APP_BULK_PAYLOAD - 1) / APP_BULK_PAYLOAD)
+
+#define TX_BUFFERS                      (7)
+#define ACK_EVERY                       (16)
+#define CONN_HANDLE                     (0x0010)
+
+/** これ以上かかったら止まったとみなす */
+#define EVENTS_MAX                      (100000)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    uint16_t    interval_us;        /**< Connection間隔[usec] */
+    uint8_t     pkts_per_event;     /**< 1イベントあたりのパケット数 */
+    uint16_t    loss_permille;      /**< Centralの取りこぼし[1/1000] */
+} link_t;
+
+/** Centralの書込み(次のイベントで届く) */
+typedef struct {
+    uint8_t     data[3];
+} cmd_t;
+
+static app_bulk_t                       m_bulk;
+static uint8_t                          m_source[SOURCE_SIZE];
+static uint8_t                          m_received[XFER_LENGTH];
+
+static uint16_t                         m_loss_permille;
+static uint16_t                         m_expect;
+static bool                             m_nack_sent;
+static bool                             m_end;
+static cmd_t                            m_cmd[64];
+static uint8_t                          m_cmd_num;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void central_rx(uint16_t handle, const uint8_t *p_data, uint16_t length);
+static void central_write(uint8_t cmd, uint16_t seq);
+static void ble_evt(uint16_t evt_id, uint8_t count);
+static uint32_t send(app_bulk_t *p_bulk, const uint8_t *p_data, uint16_t length);
+static int run(const link_t *p_link);
+static int run_disconnect(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+/* app_bulk_start()がスレーブレイテンシを解除する(ここでは何もしない) */
+void app_latency_wake(app_latency_t *p_latency)
+{
+}
+
+
+int main(void)
+{
+    static const link_t LINK[] = {
+        {  7500, 1,  0 }, {  7500, 4,  0 }, {  7500, 6,  0 },
+        { 15000, 1,  0 }, { 15000, 4,  0 }, { 15000, 6,  0 },
+        { 30000, 4,  0 }, { 30000, 6,  0 },
+        {  7500, 6, 10 }, { 15000, 4, 10 },
+    };
+    uint32_t lp;
+    int ng = 0;
+
+    srand(1);
+    for (lp = 0; lp < SOURCE_SIZE; lp++) {
+        m_source[lp] = (uint8_t)rand();
+    }
+    app_bulk_init(&m_bulk, send, NULL);
+    app_bulk_mem_source_set(&m_bulk, 0, m_source, SOURCE_SIZE);
+
+    printf("%u bytes, %u tx buffers\n", XFER_LENGTH, TX_BUFFERS);
+    printf("interval  pkts/evt  loss   link[KB/s]  bulk[KB/s]  app_bulk[KB/s]  resent\n");
+    for (lp = 0; lp < sizeof(LINK) / sizeof(LINK[0]); lp++) {
+        ng |= run(&LINK[lp]);
+    }
+    ng |= run_disconnect();
+
+    printf("test_bulk: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief Centralの受信
+ */
+static void central_rx(uint16_t handle, const uint8_t *p_data, uint16_t length)
+{
+    uint16_t seq = (uint16_t)(p_data[0] | (p_data[1] << 8));
+
+    if (length == 2) {
+        //END
+        m_end = (seq == XFER_PACKETS);
+        return;
+    }
+    if (seq != m_expect) {
+        //送り直しを待つ
+        if (!m_nack_sent) {
+            central_write(APP_BULK_CMD_NACK, m_expect);
+            m_nack_sent = true;
+        }
+        return;
+    }
+    if ((uint32_t)(rand() % 1000) < m_loss_permille) {
+        //取りこぼし(次のパケットでNACKする)
+        return;
+    }
+    memcpy(&m_received[seq * APP_BULK_PAYLOAD], &p_data[2], length - 2);
+    m_expect++;
+    m_nack_sent = false;
+    if ((m_expect % ACK_EVERY == 0) || (m_expect == XFER_PACKETS)) {
+        central_write(APP_BULK_CMD_ACK, m_expect);
+    }
+}
+
+
+static void central_write(uint8_t cmd, uint16_t seq)
+{
+    if (m_cmd_num < sizeof(m_cmd) / sizeof(m_cmd[0])) {
+        m_cmd[m_cmd_num].data[0] = cmd;
+        m_cmd[m_cmd_num].data[1] = (uint8_t)seq;
+        m_cmd[m_cmd_num].data[2] = (uint8_t)(seq >> 8);
+        m_cmd_num++;
+    }
+}
+
+
+static void ble_evt(uint16_t evt_id, uint8_t count)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id = evt_id;
+    if (evt_id == BLE_EVT_TX_COMPLETE) {
+        evt.evt.common_evt.conn_handle = CONN_HANDLE;
+        evt.evt.common_evt.params.tx_complete.count = count;
+    }
+    else {
+        evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+    }
+    //app_bleの振り分け表と同じく、ble_conn_paramsが先
+    ble_conn_params_on_ble_evt(&evt);
+    app_bulk_on_ble_evt(&m_bulk, &evt);
+}
+
+
+/**
+ * @brief app_bleのbulk_send()相当
+ */
+static uint32_t send(app_bulk_t *p_bulk, const uint8_t *p_data, uint16_t length)
+{
+    ble_gatts_hvx_params_t hvx;
+
+    hvx.handle = 0x000E;
+    hvx.type = BLE_GATT_HVX_NOTIFICATION;
+    hvx.offset = 0;
+    hvx.p_len = &length;
+    hvx.p_data = (uint8_t *)p_data;
+    return sd_ble_gatts_hvx(CONN_HANDLE, &hvx);
+}
+
+
+/**
+ * @brief 1回転送して結果を出力する
+ */
+static int run(const link_t *p_link)
+{
+    static const uint8_t START[10] = {
+        APP_BULK_CMD_START, 0,
+        (uint8_t)XFER_OFFSET, (uint8_t)(XFER_OFFSET >> 8), 0, 0,
+        (uint8_t)XFER_LENGTH, (uint8_t)(XFER_LENGTH >> 8), 0, 0
+    };
+    ble_gap_conn_params_t ppcp;
+    ble_gap_conn_params_t requested;
+    app_bulk_stats_t stats;
+    cmd_t cmd[64];
+    uint8_t cmd_num;
+    uint8_t lp;
+    uint8_t count;
+    uint32_t events = 0;
+    uint64_t elapsed_us = 0;
+    uint32_t ticks = 0;
+    uint32_t next_ticks;
+    double link_kbps;
+    double sim_kbps;
+    double bulk_kbps;
+
+    sim_ble_link_set(TX_BUFFERS, p_link->pkts_per_event, central_rx);
+    m_loss_permille = p_link->loss_permille;
+    m_expect = 0;
+    m_nack_sent = false;
+    m_end = false;
+    m_cmd_num = 0;
+    memset(m_received, 0, sizeof(m_received));
+    sd_ble_gap_ppcp_get(&ppcp);
+
+    ble_evt(BLE_GAP_EVT_CONNECTED, 0);
+    app_bulk_on_command(&m_bulk, START, sizeof(START));
+    CHECK(app_bulk_is_active(&m_bulk), "not started");
+
+    while (!m_end && (events < EVENTS_MAX)) {
+        //前のイベントで書かれたコマンドが届く
+        cmd_num = m_cmd_num;
+        memcpy(cmd, m_cmd, sizeof(cmd_t) * cmd_num);
+        m_cmd_num = 0;
+        for (lp = 0; lp < cmd_num; lp++) {
+            app_bulk_on_command(&m_bulk, cmd[lp].data, sizeof(cmd[lp].data));
+        }
+
+        count = sim_ble_conn_event();
+        if (count != 0) {
+            ble_evt(BLE_EVT_TX_COMPLETE, count);
+        }
+
+        events++;
+        elapsed_us += p_link->interval_us;
+        next_ticks = (uint32_t)(elapsed_us * 32768 / 1000000);
+        sim_rtc_advance(next_ticks - ticks);
+        ticks = next_ticks;
+    }
+    ble_evt(BLE_GAP_EVT_DISCONNECTED, 0);
+
+    app_bulk_stats_get(&m_bulk, &stats);
+    link_kbps = (double)p_link->pkts_per_event * APP_BULK_PAYLOAD * 1000000 / p_link->interval_us / 1024;
+    sim_kbps = (double)XFER_LENGTH * 1000000 / elapsed_us / 1024;
+    bulk_kbps = (double)stats.bytes_per_sec / 1024;
+    printf("%5.1fms  %8u  %3.1f%%  %10.1f  %10.1f  %14.1f  %6u\n",
+            p_link->interval_us / 1000.0, p_link->pkts_per_event, p_link->loss_permille / 10.0,
+            link_kbps, sim_kbps, bulk_kbps, stats.resent);
+
+    CHECK(m_end, "not finished (events=%u)", events);
+    CHECK(!app_bulk_is_active(&m_bulk), "still active");
+    CHECK(memcmp(m_received, &m_source[XFER_OFFSET], XFER_LENGTH) == 0, "data mismatch");
+    CHECK(stats.bytes == XFER_LENGTH, "bytes=%u", stats.bytes);
+    //app_bulkの時間は最後のイベントを含まない分だけ短い
+    CHECK((bulk_kbps > sim_kbps * 0.98) && (bulk_kbps < sim_kbps * 1.05),
+            "app_bulk=%.1f sim=%.1f", bulk_kbps, sim_kbps);
+    if (p_link->loss_permille == 0) {
+        CHECK(stats.resent == 0, "resent=%u", stats.resent);
+        CHECK(sim_kbps > link_kbps * 0.9, "sim=%.1f link=%.1f", sim_kbps, link_kbps);
+    }
+    sim_ble_conn_params_requested(&requested);
+    CHECK(memcmp(&requested, &ppcp, sizeof(ppcp)) == 0, "ppcp not restored");
+    return 0;
+}
+
+
+/**
+ * @brief 転送中に切断し、次の接続でble_conn_paramsの希望値が戻ることを確かめる
+ */
+static int run_disconnect(void)
+{
+    static const uint8_t START[10] = {
+        APP_BULK_CMD_START, 0, 0, 0, 0, 0,
+        (uint8_t)XFER_LENGTH, (uint8_t)(XFER_LENGTH >> 8), 0, 0
+    };
+    ble_gap_conn_params_t ppcp;
+    ble_gap_conn_params_t now;
+    uint8_t count;
+
+    sim_ble_link_set(TX_BUFFERS, 4, NULL);
+    m_cmd_num = 0;
+    sd_ble_gap_ppcp_get(&ppcp);
+
+    ble_evt(BLE_GAP_EVT_CONNECTED, 0);
+    app_bulk_on_command(&m_bulk, START, sizeof(START));
+    CHECK(app_bulk_is_active(&m_bulk), "not started");
+    sim_ble_conn_params_preferred(&now);
+    CHECK(now.max_conn_interval != ppcp.max_conn_interval, "bulk params not requested");
+    count = sim_ble_conn_event();
+    ble_evt(BLE_EVT_TX_COMPLETE, count);
+    ble_evt(BLE_GAP_EVT_DISCONNECTED, 0);
+    CHECK(!app_bulk_is_active(&m_bulk), "still active");
+
+    sd_ble_gap_ppcp_get(&now);
+    CHECK(memcmp(&now, &ppcp, sizeof(ppcp)) == 0, "ppcp not restored after disconnect");
+
+    //次の接続でble_conn_paramsが要求する値
+    ble_evt(BLE_GAP_EVT_CONNECTED, 0);
+    sim_ble_conn_params_preferred(&now);
+    CHECK(memcmp(&now, &ppcp, sizeof(ppcp)) == 0,
+            "ble_conn_params still prefers %u-%u", now.min_conn_interval, now.max_conn_interval);
+    ble_evt(BLE_GAP_EVT_DISCONNECTED, 0);
+
+    printf("disconnect during transfer: OK\n");
+    return 0;
+}
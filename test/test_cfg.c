@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_cfg.c
+ *
+ * app_cfgのFlashログ
+ *
+ * sim_sdk.cのFlash(実機と同じアドレス)で、
+ *  - 書込み完了前に同じKeyの長さを変えても(伸ばす/縮める)、次のレコードが正しい位置に書かれ、
+ *    読み直したときに全Keyの最新値が戻ること
+ *  - ページが一杯になってコンパクションしても最新値が残ること
+ * を確かめる。読み直しはapp_cfg_init()を呼び直す(リセット相当)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "nrf_soc.h"
+#include "app_cfg.h"
+#include "app_suspend.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+/** コンパクションを起こすまで書く回数 */
+#define FILL_LOOP                       (200)
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static int test_resize(const char *p_first, const char *p_second);
+static int test_compaction(void);
+static void flash_drain(void);
+static int name_check(const char *p_name);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+/* リセット相当なので、System OFFからの復帰ではない */
+bool app_suspend_attach(app_suspend_id_t id, void *p_data, uint16_t size, app_suspend_can_save_t can_save)
+{
+    return false;
+}
+
+
+int main(void)
+{
+    int ng = 0;
+
+    if (!sim_flash_init()) {
+        printf("NG: flash map\n");
+        return 1;
+    }
+    app_cfg_init();
+
+    //最初の書込みはページ作成(コンパクション)になるので、先に済ませておく
+    app_cfg_set(APP_CFG_KEY_SEC_MITM, (const uint8_t *)"\x01", 1);
+    flash_drain();
+
+    ng |= test_resize("abcde", "abcdefghijkl");
+    ng |= test_resize("abcdefghijklmnop", "x");
+    ng |= test_compaction();
+
+    printf("test_cfg: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief DEVICE_NAMEの書込み中に長さを変え、その後の書込みと合わせて読み直す
+ */
+static int test_resize(const char *p_first, const char *p_second)
+{
+    static uint16_t interval = 100;
+
+    interval++;
+    app_cfg_set(APP_CFG_KEY_DEVICE_NAME, (const uint8_t *)p_first, (uint16_t)strlen(p_first));
+    CHECK(sim_flash_busy(), "no flash write");
+
+    //書込み完了前に長さを変える
+    app_cfg_set(APP_CFG_KEY_DEVICE_NAME, (const uint8_t *)p_second, (uint16_t)strlen(p_second));
+    flash_drain();
+
+    //後ろに別のKeyを足す
+    app_cfg_set(APP_CFG_KEY_ADV_INTERVAL, (const uint8_t *)&interval, sizeof(interval));
+    flash_drain();
+
+    app_cfg_init();
+    if (name_check(p_second) != 0) {
+        return 1;
+    }
+    CHECK(app_cfg_get_u16(APP_CFG_KEY_ADV_INTERVAL, 0) == interval,
+            "interval %u != %u", app_cfg_get_u16(APP_CFG_KEY_ADV_INTERVAL, 0), interval);
+    printf("resize %2u -> %2u: OK\n", (unsigned)strlen(p_first), (unsigned)strlen(p_second));
+    return 0;
+}
+
+
+/**
+ * @brief ページが一杯になるまで書き、途中でも長さを変える
+ */
+static int test_compaction(void)
+{
+    static const char *NAME[] = { "n", "name-long-long-long", "mid-name" };
+    uint8_t bond;
+    uint16_t lp;
+
+    for (lp = 0; lp < FILL_LOOP; lp++) {
+        bond = (uint8_t)(lp & 1);
+        app_cfg_set(APP_CFG_KEY_DEVICE_NAME, (const uint8_t *)NAME[lp % 3], (uint16_t)strlen(NAME[lp % 3]));
+        app_cfg_set(APP_CFG_KEY_DEVICE_NAME, (const uint8_t *)NAME[(lp + 1) % 3],
+                    (uint16_t)strlen(NAME[(lp + 1) % 3]));
+        app_cfg_set(APP_CFG_KEY_SEC_BOND, &bond, sizeof(bond));
+        flash_drain();
+    }
+    CHECK(!app_cfg_is_busy(), "busy");
+
+    app_cfg_init();
+    if (name_check(NAME[FILL_LOOP % 3]) != 0) {
+        return 1;
+    }
+    CHECK(app_cfg_get_u8(APP_CFG_KEY_SEC_BOND, 0xff) == ((FILL_LOOP - 1) & 1), "bond");
+    printf("compaction x%u: OK\n", FILL_LOOP);
+    return 0;
+}
+
+
+/**
+ * @brief Flash操作を全部終わらせる
+ */
+static void flash_drain(void)
+{
+    while (sim_flash_busy()) {
+        app_cfg_on_sys_evt(sim_flash_done());
+    }
+}
+
+
+static int name_check(const char *p_name)
+{
+    const uint8_t *p;
+    uint16_t len = 0;
+
+    p = app_cfg_get(APP_CFG_KEY_DEVICE_NAME, &len);
+    CHECK((p != NULL) && (len == strlen(p_name)) && (memcmp(p, p_name, len) == 0),
+            "name len=%u (expect %s)", len, p_name);
+    return 0;
+}
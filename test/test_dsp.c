@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_dsp.c
+ *
+ * app_dspのビット一致テスト
+ *
+ * 各カーネルの出力を、int64_tで素直に書いた参照実装と1bitも違わないことを確かめる。
+ * 入力は乱数・正負の最大値・ステップを混ぜた列を使う。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "app_dsp.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define INPUT_LEN                       (1 << 18)
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static int16_t                          m_input[INPUT_LEN];
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void input_make(void);
+static int64_t floor_shift(int64_t x, uint8_t shift);
+static int16_t ref_saturate(int64_t x);
+static int test_ma(void);
+static int test_fir(void);
+static int test_cic(void);
+static int test_stats(void);
+static int test_thr(void);
+static int test_isqrt(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    int ng = 0;
+
+    input_make();
+    ng |= test_ma();
+    ng |= test_fir();
+    ng |= test_cic();
+    ng |= test_stats();
+    ng |= test_thr();
+    ng |= test_isqrt();
+
+    printf("test_dsp: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 入力列
+ *
+ * 区間ごとに 乱数 / +最大値 / -最大値 / ステップ / 正弦波 を切り替える。
+ */
+static void input_make(void)
+{
+    uint32_t lp;
+
+    srand(49);
+    for (lp = 0; lp < INPUT_LEN; lp++) {
+        switch ((lp >> 12) % 5) {
+        case 0:
+            m_input[lp] = (int16_t)((rand() & 0xffff) - 0x8000);
+            break;
+        case 1:
+            m_input[lp] = INT16_MAX;
+            break;
+        case 2:
+            m_input[lp] = INT16_MIN;
+            break;
+        case 3:
+            m_input[lp] = ((lp >> 5) & 1) ? 20000 : -20000;
+            break;
+        default:
+            m_input[lp] = (int16_t)(30000 * sin(lp * 0.01));
+            break;
+        }
+    }
+}
+
+
+/** -∞方向に丸める右シフト */
+static int64_t floor_shift(int64_t x, uint8_t shift)
+{
+    int64_t d = (int64_t)1 << shift;
+
+    return (x >= 0) ? (x / d) : -((-x + d - 1) / d);
+}
+
+
+static int16_t ref_saturate(int64_t x)
+{
+    return (x > INT16_MAX) ? INT16_MAX : (x < INT16_MIN) ? INT16_MIN : (int16_t)x;
+}
+
+
+/**
+ * @brief 移動平均 : 窓内(足りない分は0)の合計を窓の長さで割る
+ */
+static int test_ma(void)
+{
+    static int16_t buf[1 << 10];
+    app_dsp_ma_t ma;
+    uint8_t shift;
+    uint32_t n;
+    uint32_t k;
+    int64_t sum;
+    int16_t y;
+
+    for (shift = 0; shift <= 10; shift++) {
+        app_dsp_ma_init(&ma, buf, shift);
+        for (n = 0; n < INPUT_LEN / 8; n++) {
+            y = app_dsp_ma_put(&ma, m_input[n]);
+            sum = 0;
+            for (k = 0; (k < (1U << shift)) && (k <= n); k++) {
+                sum += m_input[n - k];
+            }
+            CHECK(y == floor_shift(sum, shift), "shift=%u n=%u y=%d ref=%lld", shift, n, y, (long long)floor_shift(sum, shift));
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief デシメーションFIR : 畳み込みをdecim回に1回、丸めて飽和
+ */
+static int test_fir(void)
+{
+    static const int16_t coef_big[3] = { 30000, 30000, -5000 };     //|係数|の合計は2.0未満だが飽和する
+    static const struct {
+        const int16_t   *p_coef;
+        uint16_t        taps;
+    } COEF[] = {
+        { app_dsp_fir_lp4, APP_DSP_FIR_LP4_TAPS },
+        { coef_big, 3 },
+    };
+    static int16_t buf[APP_DSP_FIR_LP4_TAPS];
+    app_dsp_fir_t fir;
+    uint8_t c;
+    uint8_t decim;
+    uint32_t n;
+    uint32_t k;
+    int64_t acc;
+    int16_t y;
+    bool out;
+
+    for (c = 0; c < sizeof(COEF) / sizeof(COEF[0]); c++) {
+        for (decim = 1; decim <= 8; decim++) {
+            app_dsp_fir_init(&fir, COEF[c].p_coef, buf, COEF[c].taps, decim);
+            for (n = 0; n < INPUT_LEN / 4; n++) {
+                out = app_dsp_fir_put(&fir, m_input[n], &y);
+                CHECK(out == ((n + 1) % decim == 0), "decim=%u n=%u out=%d", decim, n, out);
+                if (!out) {
+                    continue;
+                }
+                acc = 0;
+                for (k = 0; (k < COEF[c].taps) && (k <= n); k++) {
+                    acc += (int64_t)COEF[c].p_coef[k] * m_input[n - k];
+                }
+                CHECK(y == ref_saturate(floor_shift(acc + (1 << 14), 15)),
+                        "coef=%u decim=%u n=%u y=%d", c, decim, n, y);
+            }
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief CIC : 長さ2^decim_shiftの移動和をorder回、間引いてからゲインで割る
+ *
+ * decim_shiftが8以上(入力数が256以上)でも出力されること。
+ */
+static int test_cic(void)
+{
+    static int64_t stage[APP_DSP_CIC_ORDER_MAX + 1][INPUT_LEN];
+    app_dsp_cic_t cic;
+    uint8_t order;
+    uint8_t shift;
+    uint8_t s;
+    uint32_t n;
+    uint32_t d;
+    uint32_t outputs;
+    int64_t sum;
+    int16_t y;
+    bool out;
+
+    for (order = 1; order <= APP_DSP_CIC_ORDER_MAX; order++) {
+        for (shift = 1; order * shift <= 16; shift++) {
+            d = 1UL << shift;
+
+            //参照 : 移動和をorder段
+            for (n = 0; n < INPUT_LEN; n++) {
+                stage[0][n] = m_input[n];
+            }
+            for (s = 1; s <= order; s++) {
+                sum = 0;
+                for (n = 0; n < INPUT_LEN; n++) {
+                    sum += stage[s - 1][n];
+                    if (n >= d) {
+                        sum -= stage[s - 1][n - d];
+                    }
+                    stage[s][n] = sum;
+                }
+            }
+
+            app_dsp_cic_init(&cic, order, shift);
+            outputs = 0;
+            for (n = 0; n < INPUT_LEN; n++) {
+                out = app_dsp_cic_put(&cic, m_input[n], &y);
+                CHECK(out == ((n + 1) % d == 0), "order=%u shift=%u n=%u out=%d", order, shift, n, out);
+                if (!out) {
+                    continue;
+                }
+                outputs++;
+                CHECK(y == floor_shift(stage[order][n], order * shift),
+                        "order=%u shift=%u n=%u y=%d ref=%lld", order, shift, n, y,
+                        (long long)floor_shift(stage[order][n], order * shift));
+            }
+            CHECK(outputs == INPUT_LEN / d, "order=%u shift=%u outputs=%u", order, shift, outputs);
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief 窓統計 : 重ならない窓ごとの最小/最大/floor(sqrt(floor(2乗和/N)))
+ */
+static int test_stats(void)
+{
+    app_dsp_stats_t stats;
+    app_dsp_stats_result_t res;
+    uint8_t shift;
+    uint32_t n;
+    uint32_t k;
+    uint32_t len;
+    int16_t mn;
+    int16_t mx;
+    uint64_t sumsq;
+    uint64_t rms;
+    bool out;
+
+    for (shift = 0; shift <= 12; shift++) {
+        len = 1UL << shift;
+        app_dsp_stats_init(&stats, shift);
+        for (n = 0; n < INPUT_LEN / 4; n++) {
+            out = app_dsp_stats_put(&stats, m_input[n], &res);
+            CHECK(out == ((n + 1) % len == 0), "shift=%u n=%u out=%d", shift, n, out);
+            if (!out) {
+                continue;
+            }
+            mn = INT16_MAX;
+            mx = INT16_MIN;
+            sumsq = 0;
+            for (k = n + 1 - len; k <= n; k++) {
+                mn = (m_input[k] < mn) ? m_input[k] : mn;
+                mx = (m_input[k] > mx) ? m_input[k] : mx;
+                sumsq += (uint64_t)((int64_t)m_input[k] * m_input[k]);
+            }
+            sumsq >>= shift;
+            rms = (uint64_t)sqrt((double)sumsq);
+            while (rms * rms > sumsq) {
+                rms--;
+            }
+            while ((rms + 1) * (rms + 1) <= sumsq) {
+                rms++;
+            }
+            CHECK((res.min == mn) && (res.max == mx) && (res.rms == rms),
+                    "shift=%u n=%u min=%d/%d max=%d/%d rms=%u/%llu", shift, n,
+                    res.min, mn, res.max, mx, res.rms, (unsigned long long)rms);
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief しきい値検出 : ヒステリシスと連続回数
+ */
+static int test_thr(void)
+{
+    static const struct {
+        int16_t             x;
+        app_dsp_thr_evt_t   evt;
+    } SEQ[] = {
+        { 50, APP_DSP_THR_NONE },       //high到達1回目
+        { 10, APP_DSP_THR_NONE },       //途切れる
+        { 60, APP_DSP_THR_NONE },
+        { 70, APP_DSP_THR_NONE },
+        { 50, APP_DSP_THR_RISE },       //3回連続
+        { 0,  APP_DSP_THR_NONE },       //lowより上 : 下がらない
+        { -10, APP_DSP_THR_NONE },
+        { -20, APP_DSP_THR_NONE },
+        { -30, APP_DSP_THR_FALL },
+        { 100, APP_DSP_THR_NONE },
+    };
+    app_dsp_thr_t thr;
+    uint8_t lp;
+    app_dsp_thr_evt_t evt;
+
+    app_dsp_thr_init(&thr, 50, -10, 3);
+    for (lp = 0; lp < sizeof(SEQ) / sizeof(SEQ[0]); lp++) {
+        evt = app_dsp_thr_put(&thr, SEQ[lp].x);
+        CHECK(evt == SEQ[lp].evt, "step=%u evt=%d", lp, evt);
+    }
+    return 0;
+}
+
+
+/**
+ * @brief 整数平方根 : 全ての平方数の前後と乱数
+ */
+static int test_isqrt(void)
+{
+    uint32_t r;
+    uint32_t x;
+    uint32_t lp;
+    uint64_t ref;
+
+    for (r = 1; r <= 0xffff; r++) {
+        CHECK(app_dsp_isqrt(r * r) == r, "x=%u", r * r);
+        CHECK(app_dsp_isqrt(r * r - 1) == r - 1, "x=%u", r * r - 1);
+    }
+    CHECK(app_dsp_isqrt(0) == 0, "x=0");
+    CHECK(app_dsp_isqrt(UINT32_MAX) == 0xffff, "x=max");
+
+    srand(1);
+    for (lp = 0; lp < 1000000; lp++) {
+        x = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        ref = (uint64_t)sqrt((double)x);
+        while (ref * ref > x) {
+            ref--;
+        }
+        CHECK(app_dsp_isqrt(x) == ref, "x=%u", x);
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_latency.c
+ *
+ * app_latencyの状態遷移
+ *
+ * 接続・切断・パラメータ更新・書込み・送信完了・アプリのNotify(app_latency_wake())と
+ * 時間経過を並べたタイムラインを流し、1つ進めるごとに
+ *  - latency 0で動作中か(アイドル判定タイマが動いているか)
+ *  - SoftDeviceに設定したローカルlatency(BLE_GAP_OPT_LOCAL_CONN_LATENCY)と、設定したかどうか
+ * を確かめる。
+ * アイドルに戻す途中で割込みのapp_latency_wake()が入る場合も、最後にfastと
+ * 設定したlatencyがそろっていることを確かめる(sim_timer_preempt()で割り込ませる)。
+ *
+ * 時間はapp_wheelのtick(最初に作られるapp_timer)を満了させて進める。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "app_latency.h"
+#include "app_wheel.h"
+#include "app_budget.h"
+#include "app_timer.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+#define CONN_HANDLE                     (0x0010)
+
+/** この操作ではローカルlatencyを設定しない */
+#define LAT_KEEP                        (-1)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef enum {
+    OP_CONNECTED,           /**< arg:slave latency */
+    OP_DISCONNECTED,
+    OP_PARAM_UPDATE,        /**< arg:slave latency */
+    OP_WRITE,               /**< Centralからの書込み */
+    OP_TX_COMPLETE,
+    OP_NOTIFY,              /**< アプリのNotify(app_latency_wake()) */
+    OP_IDLE,                /**< arg:経過時間[msec] */
+    OP_IDLE_PREEMPT,        /**< OP_IDLEと同じだが、アイドルに戻す途中で割込みのapp_latency_wake()が入る */
+} op_t;
+
+typedef struct {
+    op_t        op;
+    uint16_t    arg;
+    bool        fast;       /**< 後 : latency 0で動作中 */
+    int32_t     latency;    /**< 後 : 設定したローカルlatency(LAT_KEEP:設定しない) */
+    const char  *p_note;
+} step_t;
+
+/** app_wheelのtick(最初に作られるapp_timer) */
+static const app_timer_id_t             m_tick_id = 0;
+
+static app_latency_t                    m_latency;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static int step_run(uint32_t num, const step_t *p_step);
+static void ble_evt(uint16_t evt_id, uint16_t latency);
+static void idle(uint32_t ms);
+static void isr_notify(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start)
+{
+    return 0;
+}
+
+
+int main(void)
+{
+    static const step_t TIMELINE[] = {
+        { OP_NOTIFY,        0,      false,  LAT_KEEP,   "not connected" },
+        { OP_CONNECTED,     4,      false,  LAT_KEEP,   "connected, latency 4" },
+        { OP_NOTIFY,        0,      true,   0,          "notify -> fast" },
+        { OP_NOTIFY,        0,      true,   LAT_KEEP,   "notify while fast" },
+        { OP_IDLE,          1000,   true,   LAT_KEEP,   "" },
+        { OP_TX_COMPLETE,   0,      true,   LAT_KEEP,   "" },
+        { OP_IDLE,          1000,   true,   LAT_KEEP,   "1st period had activity" },
+        { OP_IDLE,          2000,   false,  4,          "idle -> peer latency" },
+        { OP_WRITE,         0,      true,   0,          "write -> fast" },
+        { OP_PARAM_UPDATE,  8,      true,   LAT_KEEP,   "update while fast" },
+        { OP_IDLE,          4000,   false,  8,          "idle -> updated latency" },
+        { OP_PARAM_UPDATE,  0,      false,  0,          "update to 0" },
+        { OP_NOTIFY,        0,      false,  LAT_KEEP,   "already every event" },
+        { OP_PARAM_UPDATE,  4,      false,  4,          "update to 4" },
+        { OP_NOTIFY,        0,      true,   0,          "" },
+        { OP_IDLE_PREEMPT,  4000,   true,   0,          "wake during idle transition" },
+        { OP_IDLE,          4000,   false,  4,          "" },
+        { OP_NOTIFY,        0,      true,   0,          "" },
+        { OP_DISCONNECTED,  0,      false,  LAT_KEEP,   "disconnected while fast" },
+        { OP_NOTIFY,        0,      false,  LAT_KEEP,   "not connected" },
+        { OP_CONNECTED,     2,      false,  LAT_KEEP,   "reconnected, latency 2" },
+        { OP_NOTIFY,        0,      true,   0,          "" },
+        { OP_IDLE,          4000,   false,  2,          "" },
+    };
+    uint32_t lp;
+
+    app_wheel_init();
+    app_latency_init(&m_latency);
+
+    for (lp = 0; lp < sizeof(TIMELINE) / sizeof(TIMELINE[0]); lp++) {
+        if (step_run(lp, &TIMELINE[lp]) != 0) {
+            printf("test_latency: NG\n");
+            return 1;
+        }
+    }
+
+    printf("test_latency: OK\n");
+    return 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief タイムラインを1つ進めて、状態を確かめる
+ */
+static int step_run(uint32_t num, const step_t *p_step)
+{
+    uint32_t cnt_before;
+    uint32_t cnt_after;
+    uint16_t latency;
+
+    (void)sim_ble_local_latency(&cnt_before);
+    switch (p_step->op) {
+    case OP_CONNECTED:      ble_evt(BLE_GAP_EVT_CONNECTED, p_step->arg);        break;
+    case OP_DISCONNECTED:   ble_evt(BLE_GAP_EVT_DISCONNECTED, 0);               break;
+    case OP_PARAM_UPDATE:   ble_evt(BLE_GAP_EVT_CONN_PARAM_UPDATE, p_step->arg); break;
+    case OP_WRITE:          ble_evt(BLE_GATTS_EVT_WRITE, 0);                    break;
+    case OP_TX_COMPLETE:    ble_evt(BLE_EVT_TX_COMPLETE, 0);                    break;
+    case OP_NOTIFY:         app_latency_wake(&m_latency);                       break;
+    case OP_IDLE:           idle(p_step->arg);                                  break;
+    case OP_IDLE_PREEMPT:
+        sim_timer_preempt(isr_notify);
+        idle(p_step->arg);
+        break;
+    }
+    latency = sim_ble_local_latency(&cnt_after);
+
+    CHECK(m_latency.fast == p_step->fast, "step %u(%s): fast=%d", num, p_step->p_note, m_latency.fast);
+    CHECK(app_wheel_is_running(&m_latency.idle_timer) == p_step->fast,
+            "step %u(%s): idle timer=%d", num, p_step->p_note, app_wheel_is_running(&m_latency.idle_timer));
+    if (p_step->latency == LAT_KEEP) {
+        CHECK(cnt_after == cnt_before, "step %u(%s): latency set to %u", num, p_step->p_note, latency);
+    }
+    else {
+        CHECK((cnt_after != cnt_before) && (latency == p_step->latency),
+                "step %u(%s): latency=%u (set %u times, expect %d)",
+                num, p_step->p_note, latency, cnt_after - cnt_before, p_step->latency);
+    }
+    return 0;
+}
+
+
+static void ble_evt(uint16_t evt_id, uint16_t latency)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id = evt_id;
+    switch (evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+        evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+        evt.evt.gap_evt.params.connected.conn_params.slave_latency = latency;
+        break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+        evt.evt.gap_evt.params.conn_param_update.conn_params.slave_latency = latency;
+        break;
+
+    case BLE_GATTS_EVT_WRITE:
+        evt.evt.gatts_evt.conn_handle = CONN_HANDLE;
+        break;
+
+    case BLE_EVT_TX_COMPLETE:
+        evt.evt.common_evt.conn_handle = CONN_HANDLE;
+        evt.evt.common_evt.params.tx_complete.count = 1;
+        break;
+
+    default:
+        evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+        break;
+    }
+    app_latency_on_ble_evt(&m_latency, &evt);
+}
+
+
+/**
+ * @brief 時間を進める(app_wheelのtick単位)
+ */
+static void idle(uint32_t ms)
+{
+    uint32_t lp;
+
+    for (lp = 0; lp < APP_WHEEL_TICKS(ms); lp++) {
+        sim_timer_expire(m_tick_id);
+    }
+}
+
+
+/**
+ * @brief 割込み(SWI1)からのアプリのNotify
+ */
+static void isr_notify(void)
+{
+    app_latency_wake(&m_latency);
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_log.c
+ *
+ * app_logのレコードとtools/logdec.pyの往復テスト
+ *
+ * 引数やID、タイムスタンプに0xA5/0x5Aを含むレコードを積み、読出し側(UART)で取り出したバイト列に
+ *  - 0xA5で始まる偽ヘッダ(lenは正しいがsumが合わない)
+ *  - 後ろの本物のレコードにまたがる長いlen
+ *  - 途中で切れたレコード(UARTの取りこぼし)
+ * を混ぜてlog_out/stream.binに書く。
+ * 書式文字列の表はlog_out/table.binに、ここで整形した期待値をlog_out/stream.refに書く
+ * (Makefileがlogdec.pyの出力と比べる)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "nrf.h"
+#include "app_log.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define OUT_DIR                         "log_out"
+
+#define TABLE_SIZE                      (0xa600)
+#define STREAM_MAX                      (4096)
+
+/** logdec.pyのRTC_HZ */
+#define RTC_HZ                          (32768.0)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 取り出したレコードに混ぜるもの */
+typedef enum {
+    INJECT_NONE,
+    INJECT_FAKE_HDR,                    /**< 前に偽ヘッダ */
+    INJECT_LONG_LEN,                    /**< 前に[0xA5][44](本物のレコードにまたがる) */
+    INJECT_TRUNCATE,                    /**< 後半を落とす */
+} inject_t;
+
+typedef struct {
+    uint16_t    id;                     /**< 表のオフセット */
+    const char  *p_fmt;
+    uint8_t     nargs;
+    uint32_t    args[APP_LOG_ARGS_MAX];
+    uint32_t    ticks;                  /**< 積む前に進めるRTC1 COUNTER */
+    inject_t    inject;
+} record_t;
+
+static const record_t                   m_records[] = {
+    { 0x0001, "boot", 0, { 0 }, 0xa5a5a5, INJECT_FAKE_HDR },
+    { 0x00a5, "x=%x", 1, { 0xa5a5a5a5 }, 0x5a, INJECT_NONE },
+    { 0x5aa5, "a=%d b=%u", 2, { 0xffffffa5, 0x5a0ca5a5 }, 0xa5, INJECT_LONG_LEN },
+    { 0x0100, "c=%c%c n=%d", 3, { 'A', 'Z', 0xa50c0000 }, 0x5a5a, INJECT_TRUNCATE },
+    { 0xa55a, "%x %x %x %x %x %x %x %x", 8,
+        { 0xa52c5aa5, 0x5a2ca5a5, 0x0ca5005a, 0xa5a5a5a5, 0x2c, 0xa5, 0x5a, 0xa50c5a2c }, 1, INJECT_NONE },
+    { 0x0010, "seq after drop", 0, { 0 }, 0xa5a5, INJECT_NONE },
+    { 0xa5a5, "y=%u", 1, { 0x2ca5 }, 0x10, INJECT_LONG_LEN },
+};
+
+static uint8_t                          m_table[TABLE_SIZE];
+static uint8_t                          m_stream[STREAM_MAX];
+static uint16_t                         m_stream_len;
+static uint32_t                         m_ng;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static uint16_t record_read(uint8_t *p_buf);
+static void stream_add(const uint8_t *p_data, uint16_t length);
+static void file_write(const char *p_path, const uint8_t *p_data, uint32_t length);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    static const uint8_t fake_hdr[] = { 0xa5, 0x0c, 0x10, 0x00, 0xa5, 0x00, 0x00, 0x00, 0x12, 0x34, 0x0c, 0x5a };
+    static const uint8_t long_len[] = { 0xa5, 0x2c };
+    const record_t *p;
+    uint8_t buf[64];
+    uint16_t len;
+    uint32_t ts;
+    uint32_t lp;
+    FILE *fp;
+
+    mkdir(OUT_DIR, 0755);
+    for (lp = 0; lp < sizeof(m_records) / sizeof(m_records[0]); lp++) {
+        p = &m_records[lp];
+        memcpy(&m_table[p->id], p->p_fmt, strlen(p->p_fmt) + 1);
+    }
+    file_write(OUT_DIR "/table.bin", m_table, sizeof(m_table));
+
+    fp = fopen(OUT_DIR "/stream.ref", "w");
+    if (fp == NULL) {
+        perror(OUT_DIR "/stream.ref");
+        return 1;
+    }
+
+    app_log_reader_enable(APP_LOG_READER_UART, true);
+    for (lp = 0; lp < sizeof(m_records) / sizeof(m_records[0]); lp++) {
+        p = &m_records[lp];
+        sim_rtc_advance(p->ticks);
+        ts = NRF_RTC1->COUNTER;
+        app_log_put(p->id, p->args, p->nargs);
+
+        len = record_read(buf);
+        if (len != 12 + 4 * p->nargs) {
+            printf("NG record %u: len=%u\n", lp, len);
+            m_ng++;
+        }
+        switch (p->inject) {
+        case INJECT_FAKE_HDR:
+            stream_add(fake_hdr, sizeof(fake_hdr));
+            break;
+        case INJECT_LONG_LEN:
+            stream_add(long_len, sizeof(long_len));
+            break;
+        case INJECT_TRUNCATE:
+            stream_add(buf, len / 2);
+            fprintf(fp, "[%10.6f] *** 1 records dropped ***\n", (ts + p[1].ticks) / RTC_HZ);
+            continue;
+        default:
+            break;
+        }
+        stream_add(buf, len);
+
+        fprintf(fp, "[%10.6f] ", ts / RTC_HZ);
+        fprintf(fp, p->p_fmt, p->args[0], p->args[1], p->args[2], p->args[3],
+                            p->args[4], p->args[5], p->args[6], p->args[7]);
+        fprintf(fp, "\n");
+    }
+    fclose(fp);
+    file_write(OUT_DIR "/stream.bin", m_stream, m_stream_len);
+
+    if (app_log_dropped() != 0) {
+        printf("NG dropped=%u\n", app_log_dropped());
+        m_ng++;
+    }
+    printf("records=%u stream=%ubyte\n", lp, m_stream_len);
+    printf("test_log: %s\n", (m_ng) ? "NG" : "OK");
+    return (m_ng) ? 1 : 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief UART側の読出し位置から1レコード分を取り出す
+ *
+ * @param[out]  p_buf   取り出したバイト列
+ * @return      取り出したbyte数
+ */
+static uint16_t record_read(uint8_t *p_buf)
+{
+    uint32_t pos;
+    uint16_t len;
+
+    len = app_log_peek(APP_LOG_READER_UART, p_buf, 64, &pos);
+    app_log_consume(APP_LOG_READER_UART, pos, len);
+    return len;
+}
+
+
+static void stream_add(const uint8_t *p_data, uint16_t length)
+{
+    if (m_stream_len + length > STREAM_MAX) {
+        printf("NG stream overflow\n");
+        exit(1);
+    }
+    memcpy(&m_stream[m_stream_len], p_data, length);
+    m_stream_len += length;
+}
+
+
+static void file_write(const char *p_path, const uint8_t *p_data, uint32_t length)
+{
+    FILE *fp = fopen(p_path, "wb");
+
+    if ((fp == NULL) || (fwrite(p_data, 1, length, fp) != length)) {
+        perror(p_path);
+        exit(1);
+    }
+    fclose(fp);
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_pack.c
+ *
+ * app_packの往復テスト
+ *
+ * app_packで詰めたパケットをここでデコードし、
+ *  - サンプルが順番通り、値も全部戻ること
+ *  - 時刻の誤差がAPP_PACK_DELTA_USの半分以内で、積もらないこと
+ *  - seqが1ずつ進むこと
+ *  - 詰め終わらなくてもAPP_PACK_MAX_AGEで送られること
+ *  - 送信先(app_pack_t)を2つ並べても、seq・詰めかけのパケット・統計が混ざらないこと
+ * を確かめる。
+ *
+ * パケットはpack_out/caseN.hexに、ここでデコードした結果をtools/packdec.pyと同じ形式で
+ * pack_out/caseN.refに書く(Makefileがpackdec.pyの出力と比べる)。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "app_pack.h"
+#include "app_wheel.h"
+#include "app_budget.h"
+#include "app_timer.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define SAMPLE_MAX                      (4096)
+
+#define OUT_DIR                         "pack_out"
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    uint32_t    ts;
+    uint8_t     value[APP_PACK_SAMPLE_MAX];
+} sample_t;
+
+/** 送信先ごとの受信 */
+typedef struct {
+    uint32_t    packets;
+    uint8_t     seq[4];
+    uint8_t     size;
+} inst_rx_t;
+
+static sample_t                         m_in[SAMPLE_MAX];
+static uint32_t                         m_in_num;
+
+static sample_t                         m_out[SAMPLE_MAX];
+static uint32_t                         m_out_num;
+
+static uint8_t                          m_size;
+static int                              m_expect_seq;
+static uint32_t                         m_packets;
+static uint32_t                         m_ng;
+
+static FILE                             *mp_hex;
+static FILE                             *mp_ref;
+
+static app_pack_t                       m_pack;
+
+/** app_wheelのtick(最初に作られるapp_timer) */
+static const app_timer_id_t             m_tick_id = 0;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void pack_send(void *p_context, const uint8_t *p_data, uint16_t length);
+static void case_begin(uint8_t num, uint8_t size);
+static void case_put(uint32_t ts);
+static void case_end(uint32_t min_per_packet);
+static void check_instances(void);
+static void inst_send(void *p_context, const uint8_t *p_data, uint16_t length);
+static uint32_t rnd(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+uint32_t app_budget_check(app_budget_id_t id, uint32_t start)
+{
+    return 0;
+}
+
+
+int main(void)
+{
+    app_pack_stats_t stats;
+    uint32_t ts;
+    uint32_t lp;
+
+    mkdir(OUT_DIR, 0755);
+    app_wheel_init();
+
+    //1 : 250Hz、2byte(パケットが一杯になるまで詰める)
+    case_begin(1, 2);
+    for (lp = 0, ts = 1000000; lp < 1000; lp++, ts += 4000) {
+        case_put(ts);
+    }
+    case_end((APP_PACK_PAYLOAD - APP_PACK_HDR_LEN - 2) / 3 + 1);
+
+    //2 : 揺らぎのある間隔(deltaの丸め誤差が積もらないこと)、間に255msec超の空き
+    case_begin(2, 2);
+    for (lp = 0, ts = 5000; lp < 2000; lp++) {
+        ts += 1000 + rnd() % 9000;
+        if (lp % 300 == 299) {
+            ts += 400000;
+        }
+        case_put(ts);
+    }
+    case_end(1);
+
+    //3 : 時刻の32bit折り返し、1byte
+    case_begin(3, 1);
+    for (lp = 0, ts = 0xffffffff - 300000; lp < 600; lp++, ts += 1500) {
+        case_put(ts);
+    }
+    case_end(1);
+
+    //4 : 最大サイズ(1パケット1サンプル)
+    case_begin(4, APP_PACK_SAMPLE_MAX);
+    for (lp = 0, ts = 0; lp < 40; lp++, ts += 20000) {
+        case_put(ts);
+    }
+    case_end(1);
+
+    //5 : APP_PACK_MAX_AGE(詰め終わらなくても送る)
+    case_begin(5, 2);
+    case_put(100);
+    case_put(2100);
+    for (lp = 0; lp < APP_WHEEL_TICKS(APP_PACK_MAX_AGE) + 1; lp++) {
+        sim_timer_expire(m_tick_id);
+    }
+    if (m_packets != 1) {
+        printf("NG age flush: packets=%u\n", m_packets);
+        m_ng++;
+    }
+    app_pack_stats_get(&m_pack, &stats);
+    if (stats.age_flush != 1) {
+        printf("NG age flush: stats=%u\n", stats.age_flush);
+        m_ng++;
+    }
+    case_end(1);
+
+    check_instances();
+
+    printf("test_pack: %s\n", (m_ng) ? "NG" : "OK");
+    return (m_ng) ? 1 : 0;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief パケット受信(デコード)
+ *
+ * tools/packdec.pyのsamples()と同じ手順。
+ * p_contextはapp_pack_init()で渡したm_outが返ってくるはず。
+ */
+static void pack_send(void *p_context, const uint8_t *p_data, uint16_t length)
+{
+    uint8_t seq = p_data[0] >> 4;
+    uint8_t size = p_data[0] & 0x0f;
+    uint32_t ts;
+    uint16_t pos;
+    uint16_t lp;
+
+    for (lp = 0; lp < length; lp++) {
+        fprintf(mp_hex, "%02x", p_data[lp]);
+    }
+    fprintf(mp_hex, "\n");
+
+    if (p_context != m_out) {
+        printf("NG context: %p\n", p_context);
+        m_ng++;
+    }
+    if ((length > APP_PACK_PAYLOAD) || (size != m_size) ||
+      ((length - APP_PACK_HDR_LEN - size) % (size + 1) != 0)) {
+        printf("NG packet: len=%u size=%u\n", length, size);
+        m_ng++;
+        return;
+    }
+    if ((m_expect_seq >= 0) && (seq != m_expect_seq)) {
+        printf("NG seq: %u expect=%d\n", seq, m_expect_seq);
+        m_ng++;
+    }
+    m_expect_seq = (seq + 1) & 0x0f;
+    m_packets++;
+
+    ts = p_data[1] | (p_data[2] << 8) | (p_data[3] << 16) | ((uint32_t)p_data[4] << 24);
+    pos = APP_PACK_HDR_LEN;
+    while (pos < length) {
+        if (pos != APP_PACK_HDR_LEN) {
+            ts += p_data[pos++] * APP_PACK_DELTA_US;
+        }
+        if (m_out_num < SAMPLE_MAX) {
+            m_out[m_out_num].ts = ts;
+            memcpy(m_out[m_out_num].value, &p_data[pos], size);
+            m_out_num++;
+        }
+        fprintf(mp_ref, "[%10.6f] ", ts / 1e6);
+        for (lp = 0; lp < size; lp++) {
+            fprintf(mp_ref, "%02x", p_data[pos + lp]);
+        }
+        fprintf(mp_ref, "\n");
+        pos += size;
+    }
+}
+
+
+static void case_begin(uint8_t num, uint8_t size)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), OUT_DIR "/case%u.hex", num);
+    mp_hex = fopen(path, "w");
+    snprintf(path, sizeof(path), OUT_DIR "/case%u.ref", num);
+    mp_ref = fopen(path, "w");
+    if ((mp_hex == NULL) || (mp_ref == NULL)) {
+        perror(path);
+        exit(1);
+    }
+
+    m_size = size;
+    m_in_num = 0;
+    m_out_num = 0;
+    m_packets = 0;
+    m_expect_seq = -1;
+    app_pack_init(&m_pack, size, pack_send, m_out);
+}
+
+
+static void case_put(uint32_t ts)
+{
+    sample_t *p = &m_in[m_in_num++];
+    uint8_t lp;
+
+    p->ts = ts;
+    for (lp = 0; lp < m_size; lp++) {
+        p->value[lp] = (uint8_t)rnd();
+    }
+    app_pack_put_at(&m_pack, p->value, ts);
+}
+
+
+/**
+ * @brief 送ったサンプルと戻ったサンプルを比べる
+ *
+ * @param[in]   min_per_packet  1パケットあたりの最小平均サンプル数
+ */
+static void case_end(uint32_t min_per_packet)
+{
+    uint32_t lp;
+    int32_t err;
+    int32_t err_max = 0;
+
+    app_pack_flush(&m_pack);
+    fclose(mp_hex);
+    fclose(mp_ref);
+
+    if (m_out_num != m_in_num) {
+        printf("NG samples: in=%u out=%u\n", m_in_num, m_out_num);
+        m_ng++;
+        return;
+    }
+    for (lp = 0; lp < m_in_num; lp++) {
+        if (memcmp(m_in[lp].value, m_out[lp].value, m_size) != 0) {
+            printf("NG value[%u]\n", lp);
+            m_ng++;
+            return;
+        }
+        err = (int32_t)(m_out[lp].ts - m_in[lp].ts);
+        if (abs(err) > abs(err_max)) {
+            err_max = err;
+        }
+    }
+    if (abs(err_max) > APP_PACK_DELTA_US / 2) {
+        printf("NG ts error=%dusec\n", err_max);
+        m_ng++;
+    }
+    if (m_in_num < min_per_packet * m_packets) {
+        printf("NG %u samples in %u packets\n", m_in_num, m_packets);
+        m_ng++;
+    }
+    printf("size=%2u samples=%4u packets=%4u (%.2f/packet) max ts error=%+dusec\n",
+            m_size, m_in_num, m_packets, (double)m_in_num / m_packets, err_max);
+}
+
+
+/**
+ * @brief 送信先2つ
+ *
+ * 0は2byteで一杯になるまで(5サンプル/パケット)2パケット分、その間に1へ4byteを1つだけ詰め、
+ * 1はAPP_PACK_MAX_AGEで送られるのを待つ。
+ */
+static void check_instances(void)
+{
+    static const uint8_t SAMPLE[4] = { 0x12, 0x34, 0x56, 0x78 };
+    static app_pack_t pack[2];
+    static inst_rx_t rx[2];
+    app_pack_stats_t stats[2];
+    uint32_t lp;
+
+    memset(rx, 0, sizeof(rx));
+    app_pack_init(&pack[0], 2, inst_send, &rx[0]);
+    app_pack_init(&pack[1], 4, inst_send, &rx[1]);
+    for (lp = 0; lp < 10; lp++) {
+        app_pack_put_at(&pack[0], SAMPLE, lp * 1000);
+        if (lp == 3) {
+            app_pack_put_at(&pack[1], SAMPLE, lp * 1000);
+        }
+    }
+    for (lp = 0; lp < APP_WHEEL_TICKS(APP_PACK_MAX_AGE) + 1; lp++) {
+        sim_timer_expire(m_tick_id);
+    }
+    app_pack_stats_get(&pack[0], &stats[0]);
+    app_pack_stats_get(&pack[1], &stats[1]);
+
+    if ((rx[0].packets != 2) || (rx[0].size != 2) || (rx[0].seq[0] != 0) || (rx[0].seq[1] != 1) ||
+      (stats[0].samples != 10) || (stats[0].packets != 2) || (stats[0].age_flush != 0)) {
+        printf("NG instance 0: packets=%u size=%u seq=%u,%u stats=%u/%u/%u\n",
+                rx[0].packets, rx[0].size, rx[0].seq[0], rx[0].seq[1],
+                stats[0].samples, stats[0].packets, stats[0].age_flush);
+        m_ng++;
+    }
+    if ((rx[1].packets != 1) || (rx[1].size != 4) || (rx[1].seq[0] != 0) ||
+      (stats[1].samples != 1) || (stats[1].packets != 1) || (stats[1].age_flush != 1)) {
+        printf("NG instance 1: packets=%u size=%u seq=%u stats=%u/%u/%u\n",
+                rx[1].packets, rx[1].size, rx[1].seq[0],
+                stats[1].samples, stats[1].packets, stats[1].age_flush);
+        m_ng++;
+    }
+}
+
+
+/**
+ * @brief 送信先2つ : パケット受信(p_contextは送信先ごとのinst_rx_t)
+ */
+static void inst_send(void *p_context, const uint8_t *p_data, uint16_t length)
+{
+    inst_rx_t *p_rx = (inst_rx_t *)p_context;
+
+    if (p_rx->packets < sizeof(p_rx->seq)) {
+        p_rx->seq[p_rx->packets] = p_data[0] >> 4;
+    }
+    p_rx->size = p_data[0] & 0x0f;
+    p_rx->packets++;
+}
+
+
+/** 再現性のある乱数 */
+static uint32_t rnd(void)
+{
+    static uint32_t x = 2463534242UL;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_prepare.c
+ *
+ * app_prepareのsample-to-air遅延の分布
+ *
+ * 接続間隔ごとにRadio Notificationを起こし、サンプルを
+ *  - なし : 接続と無関係な周期のタイマで取る(app_ble_nofify()から)
+ *  - あり : データ準備ハンドラの中で取る
+ * の2通りで与えて、ヒストグラムを出力する。
+ * ありのときは全サンプルが通知距離(800usec)で送信されるので、1msec未満の区間だけに入ること、
+ * なしのときは接続間隔の中に散らばることを確かめる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "app_prepare.h"
+#include "app_ts.h"
+#include "sim_ts.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+/** 接続間隔[usec] */
+#define CONN_INTERVAL_US                (30000)
+
+/** 通知距離[usec](NRF_RADIO_NOTIFICATION_DISTANCE_800US) */
+#define DISTANCE_US                     (800)
+
+/** なしのときのサンプル周期[usec](接続間隔と同期しない) */
+#define SAMPLE_PERIOD_US                (97000)
+
+/** 接続イベント数 */
+#define EVENTS                          (20000)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+static const char                       *HIST_NAME[APP_PREPARE_HIST_NUM] = {
+    "<1ms", "<2ms", "<5ms", "<10ms", "<50ms", "<100ms", "<500ms", ">=500ms"
+};
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void prepare_handler(void);
+static void conn_evt(uint16_t evt_id);
+static void run(bool with_prepare, uint16_t *p_hist);
+static void print_hist(const char *p_name, const uint16_t *p_hist);
+static int check(const uint16_t *p_without, const uint16_t *p_with);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    uint16_t without[APP_PREPARE_HIST_NUM];
+    uint16_t with[APP_PREPARE_HIST_NUM];
+    int ng;
+
+    run(false, without);
+    run(true, with);
+
+    printf("sample-to-air (interval %ums, %u events)\n", CONN_INTERVAL_US / 1000, EVENTS);
+    printf("%-16s", "");
+    for (uint8_t lp = 0; lp < APP_PREPARE_HIST_NUM; lp++) {
+        printf("%8s", HIST_NAME[lp]);
+    }
+    printf("\n");
+    print_hist("without prepare", without);
+    print_hist("with prepare", with);
+
+    ng = check(without, with);
+    printf("test_prepare: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief データ準備ハンドラ : ここでサンプリングしてapp_ble_nofify()する
+ */
+static void prepare_handler(void)
+{
+    app_prepare_sample_mark();
+}
+
+
+static void conn_evt(uint16_t evt_id)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id = evt_id;
+    app_prepare_on_ble_evt(&evt);
+}
+
+
+/**
+ * @brief 通知とサンプルを時刻順に起こす
+ */
+static void run(bool with_prepare, uint16_t *p_hist)
+{
+    uint32_t notify_ts = CONN_INTERVAL_US - DISTANCE_US;
+    uint32_t sample_ts = 1234;
+    uint32_t events = 0;
+
+    sim_ts_set(0);
+    app_prepare_start(NRF_RADIO_NOTIFICATION_DISTANCE_800US, (with_prepare) ? prepare_handler : NULL);
+    app_prepare_hist_clear();
+    conn_evt(BLE_GAP_EVT_CONNECTED);
+
+    while (events < EVENTS) {
+        if (!with_prepare && (sample_ts < notify_ts)) {
+            sim_ts_set(sample_ts);
+            app_prepare_sample_mark();
+            sample_ts += SAMPLE_PERIOD_US;
+        } else {
+            sim_ts_set(notify_ts);
+            RADIO_NOTIFICATION_IRQHandler();
+            notify_ts += CONN_INTERVAL_US;
+            events++;
+        }
+    }
+
+    conn_evt(BLE_GAP_EVT_DISCONNECTED);
+    app_prepare_stop();
+    app_prepare_hist_get(p_hist);
+}
+
+
+static void print_hist(const char *p_name, const uint16_t *p_hist)
+{
+    uint8_t lp;
+
+    printf("%-16s", p_name);
+    for (lp = 0; lp < APP_PREPARE_HIST_NUM; lp++) {
+        printf("%8u", p_hist[lp]);
+    }
+    printf("\n");
+}
+
+
+static int check(const uint16_t *p_without, const uint16_t *p_with)
+{
+    uint32_t sum_without = 0;
+    uint8_t lp;
+
+    //ありは全イベントで、通知距離だけ前のサンプルを送る
+    CHECK(p_with[0] == EVENTS, "with[<1ms]=%u", p_with[0]);
+    for (lp = 1; lp < APP_PREPARE_HIST_NUM; lp++) {
+        CHECK(p_with[lp] == 0, "with[%s]=%u", HIST_NAME[lp], p_with[lp]);
+    }
+
+    //なしは接続間隔(+通知距離)未満に散らばり、サンプルの数だけ数える
+    for (lp = 0; lp < APP_PREPARE_HIST_NUM; lp++) {
+        sum_without += p_without[lp];
+    }
+    CHECK(sum_without == (uint32_t)EVENTS * CONN_INTERVAL_US / SAMPLE_PERIOD_US + 1,
+            "without total=%u", sum_without);
+    CHECK(p_without[5] + p_without[6] + p_without[7] == 0, "without >=50ms");
+    CHECK(p_without[4] > p_without[3], "without <50ms=%u <10ms=%u", p_without[4], p_without[3]);
+    return 0;
+}
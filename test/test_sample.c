@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_sample.c
+ *
+ * app_sampleのテスト(周辺機能の代わりにapp_sample_sim_convert()で変換完了を起こす)
+ *
+ *  - ブロックが順番通り、値も欠けずに届き、先頭サンプルの時刻が変換した時刻と一致すること
+ *  - メインループが遅れてリングが一杯になったら、あふれた数だけ捨てて数えること
+ *  - 書込み/読出し位置(16bit)が一周しても続くこと
+ *  - 範囲外の設定を受け付けないこと、停止後の変換は無視すること
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "app_sample.h"
+#include "app_ts.h"
+#include "nrf_error.h"
+#include "sim_ts.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+/** 次に届くはずの値と時刻 */
+static int16_t                          m_expect_value;
+static uint32_t                         m_expect_ts;
+static uint32_t                         m_received;
+static uint32_t                         m_errors;
+
+/** 変換した値と時刻 */
+static int16_t                          m_next_value;
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static void block_handler(const int16_t *p_samples, uint16_t num, uint32_t ts);
+static void convert(uint32_t num);
+static int start(uint16_t rate_hz, uint16_t block_size);
+static int test_blocks(void);
+static int test_overrun(void);
+static int test_wrap(void);
+static int test_param(void);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    int ng = 0;
+
+    ng |= test_param();
+    ng |= test_blocks();
+    ng |= test_overrun();
+    ng |= test_wrap();
+
+    printf("test_sample: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief ブロック処理 : 値が連番で、時刻が周期ずつ進むこと
+ */
+static void block_handler(const int16_t *p_samples, uint16_t num, uint32_t ts)
+{
+    uint16_t lp;
+
+    if (ts != m_expect_ts) {
+        if (m_errors++ == 0) {
+            printf("ts=%u expect=%u\n", ts, m_expect_ts);
+        }
+    }
+    for (lp = 0; lp < num; lp++) {
+        if (p_samples[lp] != m_expect_value) {
+            if (m_errors++ == 0) {
+                printf("value=%d expect=%d\n", p_samples[lp], m_expect_value);
+            }
+        }
+        m_expect_value = p_samples[lp] + 1;
+    }
+    m_expect_ts = ts + num * app_sample_period_us();
+    m_received += num;
+}
+
+
+/**
+ * @brief 周期ごとに変換完了を起こす
+ */
+static void convert(uint32_t num)
+{
+    while (num--) {
+        sim_ts_advance(app_sample_period_us());
+        app_sample_sim_convert(m_next_value++);
+    }
+}
+
+
+static int start(uint16_t rate_hz, uint16_t block_size)
+{
+    const app_sample_config_t config = { .rate_hz = rate_hz, .block_size = block_size, .ain = 2 };
+    uint32_t err_code;
+
+    err_code = app_sample_start(&config, block_handler);
+    CHECK(err_code == NRF_SUCCESS, "err=%u", err_code);
+    m_next_value = 0;
+    m_expect_value = 0;
+    m_expect_ts = app_ts_now() + app_sample_period_us();
+    m_received = 0;
+    m_errors = 0;
+    return 0;
+}
+
+
+static int test_param(void)
+{
+    static const app_sample_config_t NG[] = {
+        { .rate_hz = 0,                      .block_size = 32,                       .ain = 0 },
+        { .rate_hz = APP_SAMPLE_RATE_MAX + 1, .block_size = 32,                      .ain = 0 },
+        { .rate_hz = 100,                    .block_size = 0,                        .ain = 0 },
+        { .rate_hz = 100,                    .block_size = APP_SAMPLE_BLOCK_MAX + 1, .ain = 0 },
+        { .rate_hz = 100,                    .block_size = 32,                       .ain = 8 },
+    };
+    app_sample_stats_t stats;
+    uint8_t lp;
+
+    for (lp = 0; lp < sizeof(NG) / sizeof(NG[0]); lp++) {
+        CHECK(app_sample_start(&NG[lp], block_handler) == NRF_ERROR_INVALID_PARAM, "case %u", lp);
+    }
+    CHECK(app_sample_start(&NG[0], NULL) == NRF_ERROR_INVALID_PARAM, "handler NULL");
+
+    //停止中の変換は積まない
+    app_sample_sim_convert(1);
+    app_sample_poll();
+    app_sample_stats_get(&stats);
+    CHECK(stats.samples == 0, "samples=%u", stats.samples);
+    return 0;
+}
+
+
+/**
+ * @brief 周波数とブロック長を変えて、毎周期/数ブロックおきにpollする
+ */
+static int test_blocks(void)
+{
+    static const uint16_t RATE[] = { 1, 200, 1000, APP_SAMPLE_RATE_MAX };
+    static const uint16_t BLOCK[] = { 1, 7, 32, APP_SAMPLE_BLOCK_MAX };
+    app_sample_stats_t stats;
+    uint8_t r;
+    uint8_t b;
+    uint32_t lp;
+
+    for (r = 0; r < sizeof(RATE) / sizeof(RATE[0]); r++) {
+        for (b = 0; b < sizeof(BLOCK) / sizeof(BLOCK[0]); b++) {
+            if (start(RATE[r], BLOCK[b]) != 0) {
+                return 1;
+            }
+            for (lp = 0; lp < 1000; lp++) {
+                convert(1 + lp % 100);
+                app_sample_poll();
+            }
+            app_sample_stats_get(&stats);
+            CHECK(m_errors == 0, "rate=%u block=%u errors=%u", RATE[r], BLOCK[b], m_errors);
+            CHECK(stats.overruns == 0, "overruns=%u", stats.overruns);
+            CHECK(stats.samples - m_received < BLOCK[b], "rate=%u block=%u samples=%u received=%u",
+                    RATE[r], BLOCK[b], stats.samples, m_received);
+            app_sample_stop();
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief メインループが止まっている間にリング以上変換する
+ */
+static int test_overrun(void)
+{
+    app_sample_stats_t stats;
+
+    if (start(1000, 32) != 0) {
+        return 1;
+    }
+    convert(APP_SAMPLE_RING_SIZE + 100);
+    app_sample_stats_get(&stats);
+    CHECK(stats.overruns == 100, "overruns=%u", stats.overruns);
+
+    //リングに残った分は欠けずに届く(時刻はあふれた分だけ後ろにずれたものとして扱われる)
+    app_sample_poll();
+    CHECK(m_received == APP_SAMPLE_RING_SIZE, "received=%u", m_received);
+    CHECK(m_expect_value == APP_SAMPLE_RING_SIZE, "last=%d", m_expect_value - 1);
+
+    app_sample_stop();
+    return 0;
+}
+
+
+/**
+ * @brief 書込み/読出し位置(16bit)の一周をまたぐ
+ */
+static int test_wrap(void)
+{
+    uint32_t lp;
+
+    if (start(4000, 48) != 0) {
+        return 1;
+    }
+    for (lp = 0; lp < 140000 / 100; lp++) {
+        convert(100);
+        app_sample_poll();
+    }
+    CHECK(m_errors == 0, "errors=%u", m_errors);
+    CHECK(m_received >= 140000 - 48, "received=%u", m_received);
+    app_sample_stop();
+    return 0;
+}
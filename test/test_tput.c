@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2012-2014, hiro99ma
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *         this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ *         this list of conditions and the following disclaimer
+ *         in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+/**
+ * @file    test_tput.c
+ *
+ * app_bleのNotify送信の非劣化テスト
+ *
+ * app_ble.c(services/含む)をsim_ble.cのリンク(TXバッファ7個、1イベント6パケット)につなぎ、
+ * アプリのNotify(app_ble_nofify())を1イベントあたり一定数出しながら、
+ *  - 診断サービスのLogキャラクタリスティック(ログ送信)の有無
+ *  - MEM/CPU/LINKのNotify(ble_diag_value_set()経由)の有無
+ *  - 重複したBLE_EVT_TX_COMPLETE(送信バッファ数の数え過ぎ)
+ * を組み合わせて走らせ、
+ *  - アプリのNotifyが99%以上届くこと
+ *  - ログを流してもアプリの送信数が減らないこと
+ *  - ログ送信がBLE_ERROR_NO_TX_BUFFERSにならないこと(空きを正しく数えている)
+ *  - アプリに空きがあればログも流れること
+ * を確かめる。
+ * 最後に、未接続中にConfigでPPCPを変えると、次の接続でble_conn_paramsの希望値も変わることを確かめる。
+ */
+
+/**************************************************************************
+ * include
+ **************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_ble.h"
+#include "app_log.h"
+#include "nordic_common.h"
+#include "app_cfg.h"
+#include "ble_ios.h"
+#include "ble_diag.h"
+#include "sim_app.h"
+#include "sim_ts.h"
+
+
+/**************************************************************************
+ * macro
+ **************************************************************************/
+
+#define CHECK(cond, ...)                                                            \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            printf("NG %s:%d ", __func__, __LINE__);                                \
+            printf(__VA_ARGS__);                                                    \
+            printf("\n");                                                           \
+            return 1;                                                               \
+        }                                                                           \
+    } while (0)
+
+#define TX_BUFFERS                      (7)
+#define PKTS_PER_EVENT                  (6)
+#define INTERVAL_US                     (7500)
+#define CONN_HANDLE                     (0x0010)
+
+/** 1ケースのConnectionイベント数 */
+#define EVENTS                          (4000)
+
+/** 重複したTX_COMPLETEを入れる間隔[イベント] */
+#define DUP_EVERY                       (50)
+
+/** アプリのNotifyの長さ */
+#define APP_NOTIFY_LEN                  (20)
+
+/** app_ble.cのLOG_TX_RESERVE(ログ送信時に残す送信バッファ数) */
+#define LOG_TX_RESERVE_TEST             (2)
+
+
+/**************************************************************************
+ * declaration
+ **************************************************************************/
+
+typedef struct {
+    uint8_t     app_per_event;      /**< アプリのNotify数/イベント */
+    bool        log;                /**< LogのNotify有効 */
+    bool        diag;               /**< MEM/CPU/LINKのNotify有効 */
+    bool        dup;                /**< 重複したTX_COMPLETE */
+} case_t;
+
+typedef struct {
+    uint32_t    app_put;            /**< app_ble_nofify()の数 */
+    uint32_t    app_sent;           /**< Centralが受け取ったアプリのNotify */
+    uint32_t    log_sent;           /**< Centralが受け取ったLogのNotify */
+    uint32_t    log_no_buf;         /**< LogのNotifyがNO_TX_BUFFERSになった数 */
+    uint32_t    diag_sent;          /**< Centralが受け取ったMEM/CPU/LINKのNotify */
+} result_t;
+
+/** 書込みイベント(データ分の領域を後ろに足す) */
+typedef union {
+    ble_evt_t   evt;
+    uint8_t     buf[sizeof(ble_evt_t) + 4];
+} evt_buf_t;
+
+static app_ble_t                        m_ble;
+static ble_gatts_char_handles_t         m_output;
+static ble_gatts_char_handles_t         m_diag[BLE_DIAG_CHAR_MAX];
+
+
+/**************************************************************************
+ * prototype
+ **************************************************************************/
+
+static int run(const case_t *p_case, result_t *p_result);
+static void ble_evt(uint16_t evt_id, uint8_t count);
+static int check_ppcp(void);
+static void cccd_write(uint16_t handle, bool enable);
+static void gatts_write(uint16_t handle, const uint8_t *p_data, uint16_t len);
+static void stats_get(result_t *p_result);
+
+
+/**************************************************************************
+ * public function
+ **************************************************************************/
+
+int main(void)
+{
+    static const case_t CASE[] = {
+        { 4, false, false, false }, { 4, true, false, false },
+        { 4, false, true,  false }, { 4, true, true,  false },
+        { 4, true,  true,  true  },
+        { 2, false, false, false }, { 2, true, false, false },
+        { 2, true,  true,  false }, { 2, true, true,  true  },
+    };
+    static const uint16_t DIAG_UUID[BLE_DIAG_CHAR_MAX] = {
+        DIAG_UUID_CHAR_LINK, DIAG_UUID_CHAR_LOG, DIAG_UUID_CHAR_EVTREC, DIAG_UUID_CHAR_MEM,
+        DIAG_UUID_CHAR_CRASH, DIAG_UUID_CHAR_BOOT, DIAG_UUID_CHAR_CPU,
+    };
+    result_t result[sizeof(CASE) / sizeof(CASE[0])];
+    uint32_t base_sent = 0;
+    uint32_t lp;
+    int ng = 0;
+
+    app_ble_init(&m_ble);
+    app_ble_init_late(&m_ble);
+    app_ble_start(&m_ble);
+    if (!sim_ble_char_find(IOS_UUID_CHAR_OUTPUT, &m_output)) {
+        printf("NG output handle\n");
+        return 1;
+    }
+    for (lp = 0; lp < BLE_DIAG_CHAR_MAX; lp++) {
+        if (!sim_ble_char_find(DIAG_UUID[lp], &m_diag[lp])) {
+            printf("NG diag handle %u\n", lp);
+            return 1;
+        }
+    }
+
+    printf("%u tx buffers, %u pkts/evt, %u events\n", TX_BUFFERS, PKTS_PER_EVENT, EVENTS);
+    printf("app/evt  log  diag  dup   app put    sent  ratio  app[KB/s]  log pkts  log no_buf  diag pkts\n");
+    for (lp = 0; lp < sizeof(CASE) / sizeof(CASE[0]); lp++) {
+        ng |= run(&CASE[lp], &result[lp]);
+    }
+
+    //ログ無しを基準に、同じアプリのレートで比べる
+    for (lp = 0; lp < sizeof(CASE) / sizeof(CASE[0]); lp++) {
+        if (!CASE[lp].log && !CASE[lp].diag) {
+            base_sent = result[lp].app_sent;
+            continue;
+        }
+        if (result[lp].app_sent < base_sent) {
+            printf("NG case %u: app sent %u < %u without log/diag\n", lp, result[lp].app_sent, base_sent);
+            ng = 1;
+        }
+    }
+
+    ng |= check_ppcp();
+
+    printf("test_tput: %s\n", (ng) ? "NG" : "OK");
+    return ng;
+}
+
+
+/**************************************************************************
+ * private function
+ **************************************************************************/
+
+/**
+ * @brief 1ケース走らせて結果を出力する
+ */
+static int run(const case_t *p_case, result_t *p_result)
+{
+    uint8_t data[APP_NOTIFY_LEN];
+    result_t before;
+    result_t after;
+    uint32_t events;
+    uint32_t ticks = 0;
+    uint32_t next_ticks;
+    uint8_t lp;
+    uint8_t count;
+
+    sim_ble_link_set(TX_BUFFERS, PKTS_PER_EVENT, NULL);
+    stats_get(&before);
+    memset(data, 0, sizeof(data));
+    p_result->app_put = 0;
+
+    ble_evt(BLE_GAP_EVT_CONNECTED, 0);
+    cccd_write(m_diag[BLE_DIAG_CHAR_LOG].cccd_handle, p_case->log);
+    cccd_write(m_diag[BLE_DIAG_CHAR_MEM].cccd_handle, p_case->diag);
+    cccd_write(m_diag[BLE_DIAG_CHAR_CPU].cccd_handle, p_case->diag);
+    cccd_write(m_diag[BLE_DIAG_CHAR_LINK].cccd_handle, p_case->diag);
+
+    for (events = 0; events < EVENTS; events++) {
+        //メインループ : アプリのNotify、ログ、アイドル処理
+        for (lp = 0; lp < p_case->app_per_event; lp++) {
+            data[0] = (uint8_t)p_result->app_put;
+            app_ble_nofify(&m_ble, data, sizeof(data));
+            p_result->app_put++;
+        }
+        APP_LOG("tput: event=%u", events);
+        if (p_case->diag) {
+            sim_app_report_request(true, true);
+            ble_evt(BLE_GAP_EVT_RSSI_CHANGED, 0);
+        }
+        app_ble_idle(&m_ble);
+
+        //Connectionイベント
+        count = sim_ble_conn_event();
+        if (count != 0) {
+            ble_evt(BLE_EVT_TX_COMPLETE, count);
+        }
+        if (p_case->dup && (events % DUP_EVERY == 0)) {
+            ble_evt(BLE_EVT_TX_COMPLETE, TX_BUFFERS);
+        }
+
+        sim_ts_advance(INTERVAL_US);
+        next_ticks = (uint32_t)((uint64_t)(events + 1) * INTERVAL_US * 32768 / 1000000);
+        sim_rtc_advance(next_ticks - ticks);
+        ticks = next_ticks;
+    }
+    stats_get(&after);
+    ble_evt(BLE_GAP_EVT_DISCONNECTED, 0);
+
+    p_result->app_sent   = after.app_sent - before.app_sent;
+    p_result->log_sent   = after.log_sent - before.log_sent;
+    p_result->log_no_buf = after.log_no_buf - before.log_no_buf;
+    p_result->diag_sent  = after.diag_sent - before.diag_sent;
+
+    printf("%7u  %3s  %4s  %3s  %8u  %6u  %4.1f%%  %9.1f  %8u  %10u  %9u\n",
+            p_case->app_per_event, (p_case->log) ? "on" : "off", (p_case->diag) ? "on" : "off",
+            (p_case->dup) ? "on" : "off", p_result->app_put, p_result->app_sent,
+            100.0 * p_result->app_sent / p_result->app_put,
+            (double)p_result->app_sent * APP_NOTIFY_LEN * 1000000 / ((double)EVENTS * INTERVAL_US) / 1024,
+            p_result->log_sent, p_result->log_no_buf, p_result->diag_sent);
+
+    CHECK(p_result->app_sent * 100 >= p_result->app_put * 99, "app delivery");
+    CHECK(p_result->log_no_buf == 0, "log hvx without tx buffer");
+    if (p_case->log && (p_case->app_per_event + ((p_case->diag) ? 2 : 0) + LOG_TX_RESERVE_TEST <= TX_BUFFERS)) {
+        CHECK(p_result->log_sent > 0, "no log");
+    }
+    if (!p_case->log) {
+        CHECK(p_result->log_sent == 0, "log without notify enabled");
+    }
+    return 0;
+}
+
+
+static void ble_evt(uint16_t evt_id, uint8_t count)
+{
+    evt_buf_t buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id = evt_id;
+    switch (evt_id) {
+    case BLE_EVT_TX_COMPLETE:
+        buf.evt.evt.common_evt.conn_handle = CONN_HANDLE;
+        buf.evt.evt.common_evt.params.tx_complete.count = count;
+        break;
+
+    case BLE_GAP_EVT_RSSI_CHANGED:
+        buf.evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+        buf.evt.evt.gap_evt.params.rssi_changed.rssi = -60;
+        break;
+
+    default:
+        buf.evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+        break;
+    }
+    app_ble_evt_dispatch(&m_ble, &buf.evt);
+}
+
+
+/**
+ * @brief 未接続中にConfigでConnection間隔を変え、次の接続でble_conn_paramsの希望値になること
+ *
+ * SDK 8.1のble_conn_paramsは、未接続中のchange_conn_params()を無視する。
+ * 希望値が起動時のままだと、接続後に古い値へ更新を要求してしまう。
+ */
+static int check_ppcp(void)
+{
+    //Connection最大間隔 = 800ms
+    static const uint8_t CONFIG[] = { APP_CFG_KEY_CONN_MAX_INTERVAL, 0x20, 0x03 };
+    ble_gatts_char_handles_t config;
+    ble_gap_conn_params_t ppcp;
+    ble_gap_conn_params_t preferred;
+
+    CHECK(sim_ble_char_find(IOS_UUID_CHAR_CONFIG, &config), "config handle");
+
+    //未接続(run()の最後で切断している)
+    gatts_write(config.value_handle, CONFIG, sizeof(CONFIG));
+    CHECK(sd_ble_gap_ppcp_get(&ppcp) == NRF_SUCCESS, "ppcp_get");
+    CHECK(ppcp.max_conn_interval == MSEC_TO_UNITS(800, UNIT_1_25_MS), "ppcp max=%u", ppcp.max_conn_interval);
+
+    ble_evt(BLE_GAP_EVT_CONNECTED, 0);
+    sim_ble_conn_params_preferred(&preferred);
+    ble_evt(BLE_GAP_EVT_DISCONNECTED, 0);
+    CHECK(memcmp(&preferred, &ppcp, sizeof(ppcp)) == 0,
+            "ble_conn_params prefers %u-%u (ppcp %u-%u)",
+            preferred.min_conn_interval, preferred.max_conn_interval,
+            ppcp.min_conn_interval, ppcp.max_conn_interval);
+
+    printf("ppcp while disconnected: OK\n");
+    return 0;
+}
+
+
+/**
+ * @brief CentralからのCCCD書込み
+ */
+static void cccd_write(uint16_t handle, bool enable)
+{
+    uint8_t data[2] = { (enable) ? 0x01 : 0x00, 0x00 };
+
+    gatts_write(handle, data, sizeof(data));
+}
+
+
+/**
+ * @brief Centralからの書込み
+ */
+static void gatts_write(uint16_t handle, const uint8_t *p_data, uint16_t len)
+{
+    evt_buf_t buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id = BLE_GATTS_EVT_WRITE;
+    buf.evt.evt.gatts_evt.conn_handle = CONN_HANDLE;
+    buf.evt.evt.gatts_evt.params.write.handle = handle;
+    buf.evt.evt.gatts_evt.params.write.len = len;
+    memcpy(buf.evt.evt.gatts_evt.params.write.data, p_data, len);
+    app_ble_evt_dispatch(&m_ble, &buf.evt);
+}
+
+
+/**
+ * @brief sim_ble.cのハンドルごとの送信数(累計)
+ */
+static void stats_get(result_t *p_result)
+{
+    static const ble_diag_char_t DIAG[] = { BLE_DIAG_CHAR_MEM, BLE_DIAG_CHAR_CPU, BLE_DIAG_CHAR_LINK };
+    uint32_t sent;
+    uint32_t no_buf;
+    uint8_t lp;
+
+    sim_ble_handle_stats(m_output.value_handle, &p_result->app_sent, &no_buf);
+    sim_ble_handle_stats(m_diag[BLE_DIAG_CHAR_LOG].value_handle, &p_result->log_sent, &p_result->log_no_buf);
+    p_result->diag_sent = 0;
+    for (lp = 0; lp < sizeof(DIAG) / sizeof(DIAG[0]); lp++) {
+        sim_ble_handle_stats(m_diag[DIAG[lp]].value_handle, &sent, &no_buf);
+        p_result->diag_sent += sent;
+    }
+}
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (c) 2012-2014, hiro99ma
+# All rights reserved.
+#
+# app_evtrec(BLEイベント記録)をタイムラインとして表示する。
+#
+#   usage: evtrec.py [dump file]
+#
+#   診断サービスのEvtRecキャラクタリスティック(0x0013)のNotifyを、
+#   1行1Notifyの16進テキストで受け取る。"value:"があればその後ろを読む。
+#     gatttool -b <addr> --char-write-req -a <EvtRecのcccd handle> -n 0100 --listen | evtrec.py
+#
+#   UARTで'E'を送ると、記録がログに"evtrec: <8桁16進 x 5>"として流れる。その行も読める。
+#     logdec.py <string table> /dev/ttyUSB0 | evtrec.py
+#
+#   イベントIDはS110 8.0の値。
+
+import struct
+import sys
+
+REC = struct.Struct('<IHBBHHH6s')
+LOG_WORDS = struct.Struct('<5I')
+
+EVT_NAME = {
+    0x01: 'TX_COMPLETE',
+    0x02: 'USER_MEM_REQUEST',
+    0x03: 'USER_MEM_RELEASE',
+    0x10: 'GAP_CONNECTED',
+    0x11: 'GAP_DISCONNECTED',
+    0x12: 'GAP_CONN_PARAM_UPDATE',
+    0x13: 'GAP_SEC_PARAMS_REQUEST',
+    0x14: 'GAP_SEC_INFO_REQUEST',
+    0x15: 'GAP_PASSKEY_DISPLAY',
+    0x16: 'GAP_AUTH_KEY_REQUEST',
+    0x17: 'GAP_AUTH_STATUS',
+    0x18: 'GAP_CONN_SEC_UPDATE',
+    0x19: 'GAP_TIMEOUT',
+    0x1A: 'GAP_RSSI_CHANGED',
+    0x1C: 'GAP_SEC_REQUEST',
+    0x1D: 'GAP_CONN_PARAM_UPDATE_REQUEST',
+    0x50: 'GATTS_WRITE',
+    0x51: 'GATTS_RW_AUTHORIZE_REQUEST',
+    0x52: 'GATTS_SYS_ATTR_MISSING',
+    0x53: 'GATTS_HVC',
+    0x54: 'GATTS_SC_CONFIRM',
+    0x55: 'GATTS_TIMEOUT',
+}
+
+
+def detail(evt_id, arg0, arg1, data):
+    if evt_id in (0x10, 0x12):
+        min_interval, timeout = struct.unpack_from('<HH', data)
+        return 'interval=%.2f-%.2fms latency=%d timeout=%dms' % (
+            min_interval * 1.25, arg0 * 1.25, arg1, timeout * 10)
+    if evt_id == 0x11:
+        return 'reason=0x%02x' % arg0
+    if evt_id == 0x19:
+        return 'src=%d' % arg0
+    if evt_id == 0x1A:
+        return 'rssi=%d' % struct.unpack('<h', struct.pack('<H', arg0))[0]
+    if evt_id == 0x50:
+        return 'handle=0x%04x len=%d data=%s%s' % (
+            arg0, arg1, data[:min(arg1, len(data))].hex(), '..' if arg1 > len(data) else '')
+    if evt_id == 0x01:
+        return 'count=%d' % arg0
+    return ''
+
+
+def records(stream):
+    for line in stream:
+        if 'evtrec:' in line:
+            try:
+                words = [int(w, 16) for w in line.split('evtrec:', 1)[1].split()]
+            except ValueError:
+                continue
+            if len(words) == 5:
+                yield REC.unpack(LOG_WORDS.pack(*words))
+            continue
+        if 'value:' in line:
+            line = line.split('value:', 1)[1]
+        try:
+            data = bytes.fromhex(line.strip())
+        except ValueError:
+            continue
+        if len(data) == REC.size:
+            yield REC.unpack(data)
+
+
+def main():
+    stream = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    expect = None
+    prev = None
+    for ts, cost, evt_id, seq, conn, arg0, arg1, data in records(stream):
+        if (expect is not None) and (seq != expect):
+            print('*** %d events lost ***' % ((seq - expect) & 0xff))
+        expect = (seq + 1) & 0xff
+        delta = 0 if prev is None else (ts - prev) & 0xffffffff
+        prev = ts
+        print('[%10.6f] +%8.3fms %-30s conn=0x%04x cost=%s%.0fus %s' % (
+            ts / 1e6, delta / 1000.0,
+            EVT_NAME.get(evt_id, '0x%02x' % evt_id), conn,
+            '>=' if cost == 0xffff else '', cost,
+            detail(evt_id, arg0, arg1, data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (c) 2012-2014, hiro99ma
+# All rights reserved.
+#
+# app_log(APP_LOG)のバイナリログをテキストに戻す。
+#
+#   usage: logdec.py [--hex] <string table> [log file | serial device]
+#
+#   string table : make時に作られる _build/<出力名>.logstr.bin
+#   入力を省略すると標準入力から読む。
+#   シリアルポートは事前に stty -F /dev/ttyUSB0 38400 raw などで設定しておくこと。
+#
+#   --hex : 診断サービスのLogキャラクタリスティック(0x0012)のNotifyを
+#           16進テキストで受け取る。1行1Notifyで、"value:"があればその後ろを読む。
+#             gatttool -b <addr> --char-write-req -a <Logのcccd handle> -n 0100 --listen \
+#                 | logdec.py --hex _build/<出力名>.logstr.bin
+#
+#   レコードの連番(seq)が飛んだら、取りこぼした数を表示する。
+
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+END = 0x5A
+ARGS_MAX = 8
+OVERHEAD = 12
+RTC_HZ = 32768
+
+CONV = re.compile(r'%[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l)?([diuxXc%])')
+
+
+def load_table(path):
+    with open(path, 'rb') as f:
+        return f.read()
+
+
+def lookup(table, sid):
+    if sid >= len(table):
+        return None
+    end = table.find(b'\0', sid)
+    if end < 0:
+        end = len(table)
+    return table[sid:end].decode('utf-8', 'replace')
+
+
+def format_c(fmt, args):
+    """C言語のprintf書式を整数引数で整形する"""
+    out = []
+    pos = 0
+    idx = 0
+    for m in CONV.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        conv = m.group(1)
+        if conv == '%':
+            out.append('%')
+            continue
+        val = args[idx] if idx < len(args) else 0
+        idx += 1
+        spec = re.sub(r'(hh|h|ll|l)', '', m.group(0))
+        if conv in 'di':
+            val = struct.unpack('<i', struct.pack('<I', val))[0]
+            spec = spec[:-1] + 'd'
+        elif conv == 'u':
+            spec = spec[:-1] + 'd'
+        elif conv == 'c':
+            val = chr(val & 0xff)
+        out.append(spec % val)
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+class HexStream(object):
+    """1行1Notifyの16進テキストをバイト列として読む"""
+
+    def __init__(self, stream):
+        self.stream = stream
+
+    def read(self, size):
+        while True:
+            line = self.stream.readline()
+            if not line:
+                return b''
+            line = line.decode('ascii', 'replace')
+            if 'value:' in line:
+                line = line.split('value:', 1)[1]
+            try:
+                data = bytes.fromhex(line.strip())
+            except ValueError:
+                continue
+            if data:
+                return data
+
+
+def checksum(data):
+    """8bit Fletcher(ck_a, ck_b)"""
+    ck_a = 0
+    ck_b = 0
+    for b in data:
+        ck_a = (ck_a + b) & 0xff
+        ck_b = (ck_b + ck_a) & 0xff
+    return ck_a, ck_b
+
+
+def frame_ok(buf, size):
+    """末尾の[sum(2)][len][0x5A]がヘッダと合うか"""
+    if (buf[size - 1] != END) or (buf[size - 2] != size):
+        return False
+    return checksum(buf[1:size - 4]) == (buf[size - 4], buf[size - 3])
+
+
+def records(stream):
+    """[0xA5][len][id(2)][ts(3)][seq][args][sum(2)][len][0x5A]を切り出す。
+    合わなければ1byteずらして同期し直す(引数の中の0xA5を先頭と間違えないように)"""
+    buf = b''
+    eof = False
+    while not eof:
+        data = stream.read(256)
+        if data:
+            buf += data
+        else:
+            #終端では、足りない分を待たずに残りから探す
+            eof = True
+        while True:
+            start = buf.find(bytes([SYNC]))
+            if start < 0:
+                buf = b''
+                break
+            buf = buf[start:]
+            if len(buf) < 2:
+                break
+            size = buf[1]
+            if (size < OVERHEAD) or (size > OVERHEAD + 4 * ARGS_MAX) or (size % 4 != 0):
+                buf = buf[1:]
+                continue
+            if len(buf) < size:
+                if eof:
+                    buf = buf[1:]
+                    continue
+                break
+            if not frame_ok(buf, size):
+                buf = buf[1:]
+                continue
+            nargs = (size - OVERHEAD) // 4
+            sid, ts = struct.unpack_from('<HI', buf, 2)
+            args = list(struct.unpack_from('<%dI' % nargs, buf, 8))
+            buf = buf[size:]
+            yield sid, ts & 0xffffff, ts >> 24, args
+
+
+def main():
+    argv = sys.argv[1:]
+    hexmode = False
+    if argv and argv[0] == '--hex':
+        hexmode = True
+        argv = argv[1:]
+    if not argv:
+        sys.stderr.write('usage: %s [--hex] <string table> [log file | serial device]\n' % sys.argv[0])
+        return 1
+    table = load_table(argv[0])
+    stream = open(argv[1], 'rb') if len(argv) > 1 else sys.stdin.buffer
+    if hexmode:
+        stream = HexStream(stream)
+
+    expect = None
+    for sid, ts, seq, args in records(stream):
+        stamp = '[%10.6f]' % (ts / RTC_HZ)
+        if (expect is not None) and (seq != expect):
+            print('%s *** %d records dropped ***' % (stamp, (seq - expect) & 0xff))
+        expect = (seq + 1) & 0xff
+        fmt = lookup(table, sid)
+        if fmt is None:
+            print('%s ??? id=0x%04x args=%s' % (stamp, sid, args))
+            continue
+        print('%s %s' % (stamp, format_c(fmt, args).rstrip('\r\n')))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (c) 2012-2014, hiro99ma
+# All rights reserved.
+#
+# app_pack(サンプルの詰め込み)のパケットをサンプルに戻す。
+#
+#   usage: packdec.py [dump file]
+#
+#   I/OサービスのOutputキャラクタリスティックのNotifyを、
+#   1行1Notifyの16進テキストで受け取る。"value:"があればその後ろを読む。
+#     gatttool -b <addr> --char-write-req -a <Outputのcccd handle> -n 0100 --listen | packdec.py
+#
+#   1行1サンプルで、時刻[sec]とサンプル(16進)を出す。
+#   終わりにサンプル数/パケット数/欠落パケット数を出す。
+
+import struct
+import sys
+
+HDR = struct.Struct('<BI')
+
+# app_pack.h APP_PACK_DELTA_US
+DELTA_US = 1000
+
+
+def packets(stream):
+    for line in stream:
+        if 'value:' in line:
+            line = line.split('value:', 1)[1]
+        try:
+            data = bytes.fromhex(line.strip())
+        except ValueError:
+            continue
+        if len(data) > HDR.size:
+            yield data
+
+
+def samples(data):
+    hdr, base = HDR.unpack_from(data)
+    size = hdr & 0x0f
+    if size == 0 or (len(data) - HDR.size - size) % (size + 1) != 0:
+        return hdr >> 4, None
+    pos = HDR.size
+    ts = base
+    out = [(ts, data[pos:pos + size])]
+    pos += size
+    while pos < len(data):
+        ts = (ts + data[pos] * DELTA_US) & 0xffffffff
+        out.append((ts, data[pos + 1:pos + 1 + size]))
+        pos += 1 + size
+    return hdr >> 4, out
+
+
+def main():
+    stream = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    expect = None
+    n_samples = 0
+    n_packets = 0
+    n_lost = 0
+    for data in packets(stream):
+        seq, recs = samples(data)
+        if recs is None:
+            print('*** bad packet: %s ***' % data.hex())
+            continue
+        if (expect is not None) and (seq != expect):
+            lost = (seq - expect) & 0x0f
+            n_lost += lost
+            print('*** %d packets lost ***' % lost)
+        expect = (seq + 1) & 0x0f
+        for ts, value in recs:
+            print('[%10.6f] %s' % (ts / 1e6, value.hex()))
+        n_samples += len(recs)
+        n_packets += 1
+    if n_packets:
+        print('samples=%d packets=%d (%.2f/packet) lost=%d' % (
+            n_samples, n_packets, n_samples / float(n_packets), n_lost),
+            file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (c) 2012-2014, hiro99ma
+# All rights reserved.
+#
+# app_prof(PCサンプリング)の結果を、ELFのシンボルに対応付ける。
+#
+#   usage: profsym.py [--nm <nm>] _build/<出力名>.out [logdec.pyの出力]
+#
+#   logdec.pyでテキストにしたログから"prof:"の行を読む。入力を省略すると標準入力から読む。
+#     logdec.py _build/<出力名>.logstr.bin /dev/ttyUSB0 | profsym.py _build/<出力名>.out
+#
+#   1バケットは複数の関数にまたがるので、バケットのサンプル数を
+#   重なっているbyte数で按分した推定値を出す。
+#   同じ出力が複数回(APP_PROF_DUMP_SEC毎)あれば合算する。
+
+import collections
+import re
+import subprocess
+import sys
+
+HDR = re.compile(r'prof: hdr base=0x([0-9a-fA-F]+) shift=(\d+)')
+SUM = re.compile(r'prof: sum total=(\d+) thread=(\d+) sd=(\d+) out=(\d+)')
+BUCKET = re.compile(r'prof: b ((?:\d+=\d+\s*)+)')
+
+
+def load_symbols(nm, elf):
+    """コード領域の関数シンボル(開始, 終了, 名前)"""
+    out = subprocess.check_output([nm, '-n', '-S', '--defined-only', elf],
+                                  universal_newlines=True)
+    syms = []
+    for line in out.splitlines():
+        cols = line.split()
+        if len(cols) != 4 or cols[2] not in 'tTwW':
+            continue
+        addr = int(cols[0], 16) & ~1
+        size = int(cols[1], 16)
+        if size != 0:
+            syms.append((addr, addr + size, cols[3]))
+    return syms
+
+
+def main():
+    args = sys.argv[1:]
+    nm = 'arm-none-eabi-nm'
+    if len(args) >= 2 and args[0] == '--nm':
+        nm = args[1]
+        args = args[2:]
+    if not args:
+        sys.stderr.write('usage: profsym.py [--nm <nm>] <elf> [log]\n')
+        return 1
+    syms = load_symbols(nm, args[0])
+    stream = open(args[1]) if len(args) > 1 else sys.stdin
+
+    base = None
+    shift = None
+    total = collections.Counter()
+    buckets = collections.Counter()
+    for line in stream:
+        m = HDR.search(line)
+        if m:
+            base = int(m.group(1), 16)
+            shift = int(m.group(2))
+            continue
+        m = SUM.search(line)
+        if m:
+            total.update(dict(zip(('total', 'thread', 'sd', 'out'),
+                                  (int(v) for v in m.groups()))))
+            continue
+        m = BUCKET.search(line)
+        if m:
+            for pair in m.group(1).split():
+                idx, cnt = pair.split('=')
+                buckets[int(idx)] += int(cnt)
+
+    if base is None or total['total'] == 0:
+        sys.stderr.write('no profile data\n')
+        return 1
+
+    whole = total['total']
+    print('samples=%d  main loop=%.1f%%  interrupt=%.1f%%  softdevice/idle=%.1f%%  out of range=%.1f%%' % (
+        whole, 100.0 * total['thread'] / whole, 100.0 * (whole - total['thread']) / whole,
+        100.0 * total['sd'] / whole, 100.0 * total['out'] / whole))
+
+    est = collections.Counter()
+    width = 1 << shift
+    for idx, cnt in buckets.items():
+        lo = base + (idx << shift)
+        hi = lo + width
+        overlap = [(min(e, hi) - max(s, lo), name) for s, e, name in syms if s < hi and e > lo]
+        covered = sum(o for o, _ in overlap)
+        if covered == 0:
+            est['?? 0x%08x-0x%08x' % (lo, hi)] += cnt
+            continue
+        for o, name in overlap:
+            est[name] += cnt * o / covered
+
+    print('%8s %6s  %s' % ('samples', '%', 'symbol'))
+    for name, cnt in est.most_common():
+        print('%8.1f %5.1f%%  %s' % (cnt, 100.0 * cnt / whole, name))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
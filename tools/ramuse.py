@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+#
+# Copyright (c) 2012-2014, hiro99ma
+# All rights reserved.
+#
+# mapファイルから、オブジェクトごとの静的RAM使用量(.data + .bss)を出す。
+#
+#   usage: ramuse.py _build/<出力名>.map
+#
+# 実行時の合計やスタック最大使用量は診断サービスのMemキャラクタリスティック(0x0014)で読める。
+
+import collections
+import re
+import sys
+
+RAM_SECTIONS = ('.data', '.bss')
+
+OUT_SECTION = re.compile(r'^(\.\S+)\s+0x[0-9a-fA-F]+')
+OUT_SECTION_NAME = re.compile(r'^(\.\S+)\s*$')
+IN_SECTION = re.compile(r'^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+)\s*$')
+IN_SECTION_NAME = re.compile(r'^ (\.\S+)\s*$')
+
+
+def parse(path):
+    usage = collections.defaultdict(lambda: collections.Counter())
+    current = None
+    in_map = False
+    for line in open(path, errors='replace'):
+        line = line.rstrip('\n')
+        if line.startswith('Linker script and memory map'):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+        m = OUT_SECTION.match(line) or OUT_SECTION_NAME.match(line)
+        if m:
+            current = m.group(1)
+            continue
+        if current not in RAM_SECTIONS:
+            continue
+        if IN_SECTION_NAME.match(line):
+            continue
+        m = IN_SECTION.match(line)
+        if m and ('.o' in m.group(4)):
+            size = int(m.group(3), 16)
+            if size:
+                obj = m.group(4).split('/')[-1]
+                usage[obj][current] += size
+    return usage
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write('usage: %s <map file>\n' % sys.argv[0])
+        return 1
+    usage = parse(sys.argv[1])
+    total = collections.Counter()
+    print('%-40s %6s %6s %6s' % ('object', '.data', '.bss', 'total'))
+    for obj, c in sorted(usage.items(), key=lambda kv: -sum(kv[1].values())):
+        print('%-40s %6d %6d %6d' % (obj, c['.data'], c['.bss'], c['.data'] + c['.bss']))
+        total.update(c)
+    print('%-40s %6d %6d %6d' % ('(total)', total['.data'], total['.bss'], total['.data'] + total['.bss']))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())